@@ -317,6 +317,16 @@ static struct s3c_dma_map __initdata s3c6410_dma_mappings[] = {
 		.channels	= MAP1(S3C_DMA1_EXT),
 		.hw_addr.from	= S3C_DMA1_EXT,
 	},
+	[DMACH_DM9000] = {
+		.name		= "dm9000",
+		.channels	= MAP1(S3C_DMA1_EXT),
+		.hw_addr.from	= S3C_DMA1_EXT,
+	},
+	[DMACH_NAND] = {
+		.name		= "nand",
+		.channels	= MAP1(S3C_DMA1_EXT),
+		.hw_addr.from	= S3C_DMA1_EXT,
+	},
         [DMACH_I2S_V40_IN] = {                                                           
 		.name           = "i2s-v40-in",                                          
 		.channels       = MAP0(S3C_DMA0_HSI_RX),                                 
@@ -1281,6 +1281,40 @@ int s3c2410_dma_devconfig(int channel,
 		
 		return 0;
 
+	case S3C_DMA_FIXED2MEM:
+		/* source is a non-incrementing bus address, e.g. a SROM data port */
+		chan->config_flags = S3C_DMACONFIG_TCMASK | S3C_DMACONFIG_FLOWCTRL_MEM2MEM |
+			S3C_DMACONFIG_CHANNEL_ENABLE;
+
+		dma_wrreg(chan, S3C_DMAC_CxLLI, 0);
+
+		/* devaddr : fixed address (source) */
+		dma_wrreg(chan, S3C_DMAC_CxSRCADDR, devaddr);
+
+		/* destination address : memory(buffer) address */
+		chan->addr_reg = dma_regaddr(chan, S3C_DMAC_CxDESTADDR);
+
+		chan->control_flags = S3C_DMACONTROL_DEST_INC |
+			S3C_DMACONTROL_SBSIZE_4 | S3C_DMACONTROL_DBSIZE_4;
+		return 0;
+
+	case S3C_DMA_MEM2FIXED:
+		/* destination is a non-incrementing bus address */
+		chan->config_flags = S3C_DMACONFIG_TCMASK | S3C_DMACONFIG_FLOWCTRL_MEM2MEM |
+			S3C_DMACONFIG_CHANNEL_ENABLE;
+
+		dma_wrreg(chan, S3C_DMAC_CxLLI, 0);
+
+		/* devaddr : fixed address (destination) */
+		dma_wrreg(chan, S3C_DMAC_CxDESTADDR, devaddr);
+
+		/* source address : memory(buffer) address */
+		chan->addr_reg = dma_regaddr(chan, S3C_DMAC_CxSRCADDR);
+
+		chan->control_flags = S3C_DMACONTROL_SRC_INC |
+			S3C_DMACONTROL_SBSIZE_4 | S3C_DMACONTROL_DBSIZE_4;
+		return 0;
+
 	case S3C_DMA_PER2PER:
 		printk("Peripheral-to-Peripheral DMA NOT YET implemented !! \n");
 		return -EINVAL;
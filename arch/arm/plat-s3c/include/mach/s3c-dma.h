@@ -64,6 +64,8 @@ enum dma_ch {
 	DMACH_AC97_MIC_IN,
 	DMACH_ONENAND_IN,
 	DMACH_3D_M2M,
+	DMACH_DM9000,		/* memory <-> DM9000 data port */
+	DMACH_NAND,		/* memory <-> NAND controller NFDATA */
 	DMACH_MAX,		/* the end entry */
 };
 
@@ -123,7 +125,9 @@ enum s3c2410_dmasrc {
 	S3C_DMA_MEM2MEM,      		/* source is memory - READ/WRITE */
 	S3C_DMA_MEM2MEM_SET,      	/* source is memory - READ/WRITE for MEMSET*/
 	S3C_DMA_MEM2MEM_P,      	/* source is hardware - READ/WRITE */
-	S3C_DMA_PER2PER      		/* source is hardware - READ/WRITE */
+	S3C_DMA_PER2PER,      		/* source is hardware - READ/WRITE */
+	S3C_DMA_FIXED2MEM,		/* source is a fixed bus address (data port) */
+	S3C_DMA_MEM2FIXED		/* destination is a fixed bus address (data port) */
 };
 
 /* enum s3c_chan_op
@@ -108,6 +108,8 @@
 #define S3C_G2D_ALPHA(x)				((x)&0xFF)
 
 /* interrupt mode select */
+#define	S3C_G2D_CONTROL_REG_SWRESET			(1<<0)
+
 #define	S3C_G2D_INTC_PEND_REG_CLRSEL_LEVEL		(1<<31)
 #define	S3C_G2D_INTC_PEND_REG_CLRSEL_PULSE		(0<<31)
 
@@ -14,6 +14,10 @@
 #include <linux/mm.h>
 #include <linux/bootmem.h>
 #include <linux/swap.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <asm/setup.h>
 #include <asm/io.h>
 #include <mach/memory.h>
@@ -94,6 +98,33 @@ static struct s3c_media_device s3c_mdevs[S3C_MDEV_MAX] = {
 	}
 };
 
+/*
+ * All media devices allocate from one pool reserved at boot. The pool is
+ * managed best-fit: the blocks tile the pool in address order, a free
+ * block is split on allocation and merged with its free neighbours on
+ * release. Block descriptors come from a fixed table since the pool is
+ * set up before the slab allocator.
+ */
+#define S3C_MEDIA_MAX_BLOCKS	64
+#define S3C_MEDIA_FREE		(-1)
+
+struct s3c_media_block {
+	struct list_head	list;
+	dma_addr_t		paddr;
+	size_t			size;
+	int			dev_id;		/* owner, S3C_MEDIA_FREE if free */
+	int			pins;		/* see s3c_pin_media_memory() */
+	int			released;	/* freed by its owner while pinned */
+};
+
+static struct s3c_media_block s3c_media_blocks[S3C_MEDIA_MAX_BLOCKS];
+static LIST_HEAD(s3c_media_pool);	/* blocks in address order */
+static LIST_HEAD(s3c_media_spare);	/* unused descriptors */
+static DEFINE_SPINLOCK(s3c_media_lock);
+
+static dma_addr_t s3c_media_pool_start;
+static size_t s3c_media_pool_size;
+
 static struct s3c_media_device *s3c_get_media_device(int dev_id)
 {
 	struct s3c_media_device *mdev = NULL;
@@ -118,9 +149,244 @@ static struct s3c_media_device *s3c_get_media_device(int dev_id)
 	return mdev;
 }
 
+/* called with s3c_media_lock held */
+static dma_addr_t __s3c_media_alloc(struct s3c_media_device *mdev, size_t size)
+{
+	struct s3c_media_block *blk, *best = NULL, *rest;
+
+	list_for_each_entry(blk, &s3c_media_pool, list) {
+		if (blk->dev_id != S3C_MEDIA_FREE || blk->size < size)
+			continue;
+
+		if (!best || blk->size < best->size)
+			best = blk;
+	}
+
+	if (!best) {
+		mdev->nr_fails++;
+		return 0;
+	}
+
+	if (best->size > size) {
+		if (list_empty(&s3c_media_spare)) {
+			mdev->nr_fails++;
+			return 0;
+		}
+
+		rest = list_first_entry(&s3c_media_spare,
+					struct s3c_media_block, list);
+		list_del(&rest->list);
+
+		rest->paddr = best->paddr + size;
+		rest->size = best->size - size;
+		rest->dev_id = S3C_MEDIA_FREE;
+		list_add(&rest->list, &best->list);
+
+		best->size = size;
+	}
+
+	best->dev_id = mdev->id;
+	best->pins = 0;
+	best->released = 0;
+
+	mdev->used += size;
+	if (mdev->used > mdev->peak)
+		mdev->peak = mdev->used;
+	mdev->nr_allocs++;
+
+	return best->paddr;
+}
+
+/* called with s3c_media_lock held */
+static void __s3c_media_give_back(struct s3c_media_device *mdev,
+				  struct s3c_media_block *blk)
+{
+	struct s3c_media_block *prev, *next;
+
+	mdev->used -= blk->size;
+	blk->dev_id = S3C_MEDIA_FREE;
+
+	if (blk->list.next != &s3c_media_pool) {
+		next = list_entry(blk->list.next, struct s3c_media_block, list);
+		if (next->dev_id == S3C_MEDIA_FREE) {
+			blk->size += next->size;
+			list_move(&next->list, &s3c_media_spare);
+		}
+	}
+
+	if (blk->list.prev != &s3c_media_pool) {
+		prev = list_entry(blk->list.prev, struct s3c_media_block, list);
+		if (prev->dev_id == S3C_MEDIA_FREE) {
+			prev->size += blk->size;
+			list_move(&blk->list, &s3c_media_spare);
+		}
+	}
+}
+
+/*
+ * Called with s3c_media_lock held. A pinned block stays allocated until
+ * its last pin is dropped.
+ */
+static int __s3c_media_free(struct s3c_media_device *mdev, dma_addr_t paddr)
+{
+	struct s3c_media_block *blk;
+
+	list_for_each_entry(blk, &s3c_media_pool, list) {
+		if (blk->paddr == paddr)
+			break;
+	}
+
+	if (&blk->list == &s3c_media_pool || blk->dev_id != mdev->id ||
+	    blk->released)
+		return -EINVAL;
+
+	if (blk->pins) {
+		blk->released = 1;
+		return 0;
+	}
+
+	__s3c_media_give_back(mdev, blk);
+
+	return 0;
+}
+
+/*
+ * Allocate size bytes of physically contiguous memory for dev_id.
+ * Returns the physical address, or 0 if the pool cannot satisfy it.
+ */
+dma_addr_t s3c_alloc_media_memory(int dev_id, size_t size)
+{
+	struct s3c_media_device *mdev;
+	unsigned long flags;
+	dma_addr_t paddr;
+
+	mdev = s3c_get_media_device(dev_id);
+	if (!mdev || !size) {
+		printk(KERN_ERR "invalid media device\n");
+		return 0;
+	}
+
+	spin_lock_irqsave(&s3c_media_lock, flags);
+	paddr = __s3c_media_alloc(mdev, PAGE_ALIGN(size));
+	spin_unlock_irqrestore(&s3c_media_lock, flags);
+
+	if (!paddr)
+		printk(KERN_ERR "no memory for %s (%lu bytes)\n",
+			mdev->name, (unsigned long) size);
+
+	return paddr;
+}
+EXPORT_SYMBOL(s3c_alloc_media_memory);
+
+void s3c_free_media_memory(int dev_id, dma_addr_t paddr)
+{
+	struct s3c_media_device *mdev;
+	unsigned long flags;
+	int ret;
+
+	mdev = s3c_get_media_device(dev_id);
+	if (!mdev || !paddr)
+		return;
+
+	spin_lock_irqsave(&s3c_media_lock, flags);
+	ret = __s3c_media_free(mdev, paddr);
+	spin_unlock_irqrestore(&s3c_media_lock, flags);
+
+	if (ret)
+		printk(KERN_ERR "%s: bad media memory free at 0x%08x\n",
+			mdev->name, paddr);
+}
+EXPORT_SYMBOL(s3c_free_media_memory);
+
+/*
+ * Whether [paddr, paddr + size) lies in one area a device allocated from
+ * the pool, for the drivers that still take physical addresses from
+ * userspace.
+ */
+int s3c_is_media_memory(dma_addr_t paddr, size_t size)
+{
+	struct s3c_media_block *blk;
+	unsigned long flags;
+	int ret = 0;
+
+	if (paddr + size < paddr)
+		return 0;
+
+	spin_lock_irqsave(&s3c_media_lock, flags);
+	list_for_each_entry(blk, &s3c_media_pool, list) {
+		if (blk->dev_id == S3C_MEDIA_FREE)
+			continue;
+
+		if (paddr >= blk->paddr && paddr + size <= blk->paddr + blk->size) {
+			ret = 1;
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&s3c_media_lock, flags);
+
+	return ret;
+}
+EXPORT_SYMBOL(s3c_is_media_memory);
+
+/*
+ * Keep the area holding [paddr, paddr + size) allocated while something
+ * else than its owner, e.g. a buffer object, points at it. If the owner
+ * frees it meanwhile it goes back to the pool at the last unpin.
+ */
+int s3c_pin_media_memory(dma_addr_t paddr, size_t size)
+{
+	struct s3c_media_block *blk;
+	unsigned long flags;
+	int ret = -EINVAL;
+
+	if (paddr + size < paddr)
+		return -EINVAL;
+
+	spin_lock_irqsave(&s3c_media_lock, flags);
+	list_for_each_entry(blk, &s3c_media_pool, list) {
+		if (blk->dev_id == S3C_MEDIA_FREE || blk->released)
+			continue;
+
+		if (paddr >= blk->paddr && paddr + size <= blk->paddr + blk->size) {
+			blk->pins++;
+			ret = 0;
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&s3c_media_lock, flags);
+
+	return ret;
+}
+EXPORT_SYMBOL(s3c_pin_media_memory);
+
+void s3c_unpin_media_memory(dma_addr_t paddr)
+{
+	struct s3c_media_block *blk;
+	unsigned long flags;
+
+	spin_lock_irqsave(&s3c_media_lock, flags);
+	list_for_each_entry(blk, &s3c_media_pool, list) {
+		if (blk->dev_id == S3C_MEDIA_FREE || !blk->pins)
+			continue;
+
+		if (paddr >= blk->paddr && paddr < blk->paddr + blk->size) {
+			if (--blk->pins == 0 && blk->released)
+				__s3c_media_give_back(s3c_get_media_device(blk->dev_id), blk);
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&s3c_media_lock, flags);
+}
+EXPORT_SYMBOL(s3c_unpin_media_memory);
+
+/*
+ * Return the device's default area of memsize bytes, allocating it from
+ * the pool on first use. It stays allocated until s3c_put_media_memory().
+ */
 dma_addr_t s3c_get_media_memory(int dev_id)
 {
 	struct s3c_media_device *mdev;
+	unsigned long flags;
 
 	mdev = s3c_get_media_device(dev_id);
 	if (!mdev){
@@ -128,6 +394,11 @@ dma_addr_t s3c_get_media_memory(int dev_id)
 		return 0;
 	}
 
+	spin_lock_irqsave(&s3c_media_lock, flags);
+	if (!mdev->paddr && mdev->memsize > 0)
+		mdev->paddr = __s3c_media_alloc(mdev, mdev->memsize);
+	spin_unlock_irqrestore(&s3c_media_lock, flags);
+
 	if (!mdev->paddr) {
 		printk(KERN_ERR "no memory for %s\n", mdev->name);
 		return 0;
@@ -136,6 +407,33 @@ dma_addr_t s3c_get_media_memory(int dev_id)
 	return mdev->paddr;
 }
 
+/*
+ * Give the default area back to the pool. Handles exported on it are
+ * revoked first so s3c_mem_bo_get() can no longer hand out its address;
+ * the buffer objects still referenced or mapped pin the area until they
+ * are gone.
+ */
+void s3c_put_media_memory(int dev_id)
+{
+	struct s3c_media_device *mdev;
+	unsigned long flags;
+
+	mdev = s3c_get_media_device(dev_id);
+	if (!mdev)
+		return;
+
+	if (mdev->paddr)
+		s3c_mem_bo_revoke(mdev->paddr, mdev->memsize);
+
+	spin_lock_irqsave(&s3c_media_lock, flags);
+	if (mdev->paddr) {
+		__s3c_media_free(mdev, mdev->paddr);
+		mdev->paddr = 0;
+	}
+	spin_unlock_irqrestore(&s3c_media_lock, flags);
+}
+EXPORT_SYMBOL(s3c_put_media_memory);
+
 size_t s3c_get_media_memsize(int dev_id)
 {
 	struct s3c_media_device *mdev;
@@ -151,21 +449,112 @@ size_t s3c_get_media_memsize(int dev_id)
 
 void s3c64xx_reserve_bootmem(void)
 {
-	struct s3c_media_device *mdev;
+	struct s3c_media_block *blk;
+	size_t size = 0;
 	int i;
 
 	for(i = 0; i < sizeof(s3c_mdevs) / sizeof(s3c_mdevs[0]); i++) {
+		s3c_mdevs[i].memsize = PAGE_ALIGN(s3c_mdevs[i].memsize);
+		size += s3c_mdevs[i].memsize;
+	}
+
+#if defined(CONFIG_VIDEO_SAMSUNG_MEMSIZE_POOL) && (CONFIG_VIDEO_SAMSUNG_MEMSIZE_POOL > 0)
+	size = PAGE_ALIGN(CONFIG_VIDEO_SAMSUNG_MEMSIZE_POOL * SZ_1K);
+#endif
+
+	for (i = 0; i < S3C_MEDIA_MAX_BLOCKS; i++)
+		list_add_tail(&s3c_media_blocks[i].list, &s3c_media_spare);
+
+	if (!size)
+		return;
+
+	s3c_media_pool_start = virt_to_phys(alloc_bootmem_low_pages(size));
+	s3c_media_pool_size = size;
+
+	blk = list_first_entry(&s3c_media_spare, struct s3c_media_block, list);
+	list_move(&blk->list, &s3c_media_pool);
+	blk->paddr = s3c_media_pool_start;
+	blk->size = size;
+	blk->dev_id = S3C_MEDIA_FREE;
+
+	printk(KERN_INFO "s3c64xx: %lu bytes SDRAM reserved "
+		"for media devices at 0x%08x\n",
+		(unsigned long) size, s3c_media_pool_start);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int s3c_media_show(struct seq_file *s, void *unused)
+{
+	struct s3c_media_device *mdev;
+	struct s3c_media_block *blk;
+	size_t free = 0, largest = 0;
+	unsigned long flags;
+	int i, nr_free = 0;
+
+	spin_lock_irqsave(&s3c_media_lock, flags);
+
+	seq_printf(s, "pool 0x%08x-0x%08x, %lu KB\n\n",
+		s3c_media_pool_start,
+		s3c_media_pool_start + s3c_media_pool_size,
+		(unsigned long) s3c_media_pool_size / SZ_1K);
+
+	seq_printf(s, "%-6s %10s %10s %10s %8s %6s\n",
+		"client", "default", "used", "peak", "allocs", "fails");
+	for (i = 0; i < S3C_MDEV_MAX; i++) {
 		mdev = &s3c_mdevs[i];
-		if (mdev->memsize > 0) {
-			mdev->paddr = virt_to_phys(alloc_bootmem_low(mdev->memsize));
-			printk(KERN_INFO \
-				"s3c64xx: %lu bytes SDRAM reserved "
-				"for %s at 0x%08x\n",
-				(unsigned long) mdev->memsize, \
-				mdev->name, mdev->paddr);
+		seq_printf(s, "%-6s %9luK %9luK %9luK %8u %6u\n", mdev->name,
+			(unsigned long) mdev->memsize / SZ_1K,
+			(unsigned long) mdev->used / SZ_1K,
+			(unsigned long) mdev->peak / SZ_1K,
+			mdev->nr_allocs, mdev->nr_fails);
+	}
+
+	seq_printf(s, "\nblocks:\n");
+	list_for_each_entry(blk, &s3c_media_pool, list) {
+		mdev = s3c_get_media_device(blk->dev_id);
+		seq_printf(s, "  0x%08x %9luK %s\n", blk->paddr,
+			(unsigned long) blk->size / SZ_1K,
+			mdev ? mdev->name : "-");
+
+		if (blk->dev_id == S3C_MEDIA_FREE) {
+			free += blk->size;
+			nr_free++;
+			if (blk->size > largest)
+				largest = blk->size;
 		}
 	}
+
+	spin_unlock_irqrestore(&s3c_media_lock, flags);
+
+	/* share of the free memory that a single allocation cannot use */
+	seq_printf(s, "\nfree %luK in %d blocks, largest %luK, "
+		"fragmentation %lu%%\n",
+		(unsigned long) free / SZ_1K, nr_free,
+		(unsigned long) largest / SZ_1K,
+		free ? 100 - (unsigned long) (largest / SZ_1K) * 100 / (free / SZ_1K) : 0UL);
+
+	return 0;
+}
+
+static int s3c_media_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, s3c_media_show, NULL);
+}
+
+static const struct file_operations s3c_media_fops = {
+	.open		= s3c_media_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init s3c_media_debugfs_init(void)
+{
+	debugfs_create_file("s3c-media", S_IRUGO, NULL, NULL, &s3c_media_fops);
+	return 0;
 }
+late_initcall(s3c_media_debugfs_init);
+#endif
 
 /* FIXME: temporary implementation to avoid compile error */
 int dma_needs_bounce(struct device *dev, dma_addr_t addr, size_t size)
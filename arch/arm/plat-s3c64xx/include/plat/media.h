@@ -15,6 +15,7 @@
 #define _S3C_MEDIA_H
 
 #include <linux/types.h>
+#include <linux/errno.h>
 
 #define S3C_MDEV_FIMC		0
 #define S3C_MDEV_POST		1
@@ -29,9 +30,53 @@ struct s3c_media_device {
 	const char 	*name;
 	size_t		memsize;
 	dma_addr_t	paddr;
+
+	/* pool usage, see /sys/kernel/debug/s3c-media */
+	size_t		used;
+	size_t		peak;
+	unsigned int	nr_allocs;
+	unsigned int	nr_fails;
 };
 
+/* default area of memsize bytes, taken from the pool on first use */
 extern dma_addr_t s3c_get_media_memory(int dev_id);
+extern void s3c_put_media_memory(int dev_id);
 extern size_t s3c_get_media_memsize(int dev_id);
 
+extern dma_addr_t s3c_alloc_media_memory(int dev_id, size_t size);
+extern void s3c_free_media_memory(int dev_id, dma_addr_t paddr);
+extern int s3c_is_media_memory(dma_addr_t paddr, size_t size);
+extern int s3c_pin_media_memory(dma_addr_t paddr, size_t size);
+extern void s3c_unpin_media_memory(dma_addr_t paddr);
+
+/*
+ * shared buffer objects, see drivers/char/s3c_mem.c. A reference from
+ * s3c_mem_bo_get() keeps the memory, exported areas included, until
+ * s3c_mem_bo_put().
+ */
+#ifdef CONFIG_S3C_MEM
+extern int s3c_mem_bo_export(dma_addr_t paddr, size_t size);
+extern int s3c_mem_bo_get(int handle, size_t offset, size_t len, dma_addr_t *paddr);
+extern void s3c_mem_bo_put(int handle);
+extern void s3c_mem_bo_revoke(dma_addr_t paddr, size_t size);
+#else
+static inline int s3c_mem_bo_export(dma_addr_t paddr, size_t size)
+{
+	return -ENODEV;
+}
+
+static inline int s3c_mem_bo_get(int handle, size_t offset, size_t len, dma_addr_t *paddr)
+{
+	return -ENODEV;
+}
+
+static inline void s3c_mem_bo_put(int handle)
+{
+}
+
+static inline void s3c_mem_bo_revoke(dma_addr_t paddr, size_t size)
+{
+}
+#endif
+
 #endif
@@ -869,10 +869,12 @@ static const struct file_operations oldmem_fops = {
 #ifdef CONFIG_S3C_MEM
 extern int s3c_mem_mmap(struct file* filp, struct vm_area_struct *vma);
 extern int s3c_mem_ioctl(struct inode *inode, struct file *file, unsigned int cmd, unsigned long arg);
+extern int s3c_mem_release(struct inode *inode, struct file *file);
 
 static const struct file_operations s3c_mem_fops = {
 	.ioctl 	= s3c_mem_ioctl,
 	.mmap	= s3c_mem_mmap,
+	.release = s3c_mem_release,
 };
 #endif
 
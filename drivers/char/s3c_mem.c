@@ -37,11 +37,15 @@
 #include <mach/hardware.h>
 
 #include <linux/dma-mapping.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
 
 #include <asm/dma.h>
 #include <mach/dma.h>
 #include <plat/dma.h>
 
+#include <plat/media.h>
+
 #include "s3c_mem.h"
 
 /*----------------------------------------------------------------------*/
@@ -68,12 +72,390 @@ static int flag = 0;
 
 static unsigned int physical_address;
 
+/*----------------------------------------------------------------------*/
+/*                      Shared buffer objects				*/
+/*--------------------------------------------------------------------- */
+
+struct s3c_mem_bo {
+	struct list_head	list;
+	int			handle;
+	dma_addr_t		phy_addr;
+	void			*vir_addr;	/* NULL if exported by a driver */
+	size_t			size;
+	int			refcount;
+	int			revoked;	/* its memory went back to the pool */
+};
+
+/* a reference held by an open /dev/s3c-mem, dropped on close */
+struct s3c_mem_bo_ref {
+	struct list_head	list;
+	struct file		*file;
+	struct s3c_mem_bo	*bo;
+};
+
+static LIST_HEAD(s3c_mem_bos);
+static LIST_HEAD(s3c_mem_bo_refs);
+static DEFINE_SPINLOCK(s3c_mem_bo_spinlock);
+static int s3c_mem_bo_next_handle = 1;
+
+/* the object do_mmap() is mapping, set under mem_mmap_lock */
+static struct s3c_mem_bo *s3c_mem_bo_mapping;
+
+/* with s3c_mem_bo_spinlock held, revoked objects included */
+static struct s3c_mem_bo *__s3c_mem_bo_find(int handle)
+{
+	struct s3c_mem_bo *bo;
+
+	list_for_each_entry(bo, &s3c_mem_bos, list) {
+		if (bo->handle == handle)
+			return bo;
+	}
+
+	return NULL;
+}
+
+/* with s3c_mem_bo_spinlock held */
+static struct s3c_mem_bo *s3c_mem_bo_find(int handle)
+{
+	struct s3c_mem_bo *bo = __s3c_mem_bo_find(handle);
+
+	if (bo && bo->revoked)
+		return NULL;
+
+	return bo;
+}
+
+/* with s3c_mem_bo_spinlock held */
+static void s3c_mem_bo_add(struct s3c_mem_bo *bo)
+{
+	bo->handle = s3c_mem_bo_next_handle++;
+	if (s3c_mem_bo_next_handle <= 0)
+		s3c_mem_bo_next_handle = 1;
+
+	list_add_tail(&bo->list, &s3c_mem_bos);
+}
+
+static void s3c_mem_bo_unref(struct s3c_mem_bo *bo)
+{
+	int last;
+
+	spin_lock(&s3c_mem_bo_spinlock);
+	last = (--bo->refcount == 0);
+	if (last)
+		list_del(&bo->list);
+	spin_unlock(&s3c_mem_bo_spinlock);
+
+	if (!last)
+		return;
+
+	DEBUG("BO FREE : handle = %d, phy_addr = 0x%X, size = %d\n", bo->handle, bo->phy_addr, bo->size);
+
+	if (bo->vir_addr)
+		dma_free_writecombine(NULL, bo->size, bo->vir_addr, bo->phy_addr);
+	else
+		s3c_unpin_media_memory(bo->phy_addr);
+	kfree(bo);
+}
+
+/* every user mapping holds a reference, so the memory outlives a close() */
+static void s3c_mem_bo_vm_open(struct vm_area_struct *vma)
+{
+	struct s3c_mem_bo *bo = vma->vm_private_data;
+
+	spin_lock(&s3c_mem_bo_spinlock);
+	bo->refcount++;
+	spin_unlock(&s3c_mem_bo_spinlock);
+}
+
+static void s3c_mem_bo_vm_close(struct vm_area_struct *vma)
+{
+	s3c_mem_bo_unref(vma->vm_private_data);
+}
+
+static struct vm_operations_struct s3c_mem_bo_vm_ops = {
+	.open	= s3c_mem_bo_vm_open,
+	.close	= s3c_mem_bo_vm_close,
+};
+
+/* with mem_bo_lock held */
+static unsigned int s3c_mem_bo_map(struct file *file, struct s3c_mem_bo *bo)
+{
+	struct mm_struct *mm = current->mm;
+	unsigned int vir_addr;
+
+	mutex_lock(&mem_mmap_lock);
+	flag = MEM_ALLOC_BO;
+	s3c_mem_bo_mapping = bo;
+
+	down_write(&mm->mmap_sem);
+	vir_addr = do_mmap(file, 0, bo->size, PROT_READ|PROT_WRITE, MAP_SHARED, 0);
+	up_write(&mm->mmap_sem);
+
+	s3c_mem_bo_mapping = NULL;
+	flag = 0;
+	mutex_unlock(&mem_mmap_lock);
+
+	return vir_addr;
+}
+
+static int s3c_mem_bo_drop_ref(struct file *file, int handle)
+{
+	struct s3c_mem_bo_ref *ref;
+
+	spin_lock(&s3c_mem_bo_spinlock);
+	list_for_each_entry(ref, &s3c_mem_bo_refs, list) {
+		if (ref->file == file && ref->bo->handle == handle) {
+			list_del(&ref->list);
+			spin_unlock(&s3c_mem_bo_spinlock);
+
+			s3c_mem_bo_unref(ref->bo);
+			kfree(ref);
+			return 0;
+		}
+	}
+	spin_unlock(&s3c_mem_bo_spinlock);
+
+	return -EINVAL;
+}
+
+static int s3c_mem_bo_alloc(struct file *file, struct s3c_mem_bo_info *info)
+{
+	struct s3c_mem_bo *bo;
+	struct s3c_mem_bo_ref *ref;
+
+	bo = kzalloc(sizeof(struct s3c_mem_bo), GFP_KERNEL);
+	ref = kzalloc(sizeof(struct s3c_mem_bo_ref), GFP_KERNEL);
+	if (bo == NULL || ref == NULL)
+		goto err_alloc;
+
+	bo->size = PAGE_ALIGN(info->size);
+	bo->vir_addr = dma_alloc_writecombine(NULL, bo->size, &bo->phy_addr, GFP_KERNEL);
+	if (bo->vir_addr == NULL) {
+		printk("S3C_MEM_BO_ALLOC FAILED : size = %d\n", bo->size);
+		goto err_alloc;
+	}
+
+	/* the reference of this file */
+	bo->refcount = 1;
+	ref->file = file;
+	ref->bo = bo;
+
+	spin_lock(&s3c_mem_bo_spinlock);
+	s3c_mem_bo_add(bo);
+	list_add(&ref->list, &s3c_mem_bo_refs);
+	spin_unlock(&s3c_mem_bo_spinlock);
+
+	info->handle = bo->handle;
+	info->size = bo->size;
+	info->phy_addr = bo->phy_addr;
+	info->vir_addr = s3c_mem_bo_map(file, bo);
+	if (IS_ERR_VALUE(info->vir_addr)) {
+		s3c_mem_bo_drop_ref(file, bo->handle);
+		return -ENOMEM;
+	}
+
+	DEBUG("BO ALLOC : handle = %d, phy_addr = 0x%X, size = %d, vir_addr = 0x%X\n", info->handle, info->phy_addr, info->size, info->vir_addr);
+
+	return 0;
+
+err_alloc:
+	kfree(bo);
+	kfree(ref);
+	return -ENOMEM;
+}
+
+static int s3c_mem_bo_import(struct file *file, struct s3c_mem_bo_info *info)
+{
+	struct s3c_mem_bo *bo;
+	struct s3c_mem_bo_ref *ref;
+
+	ref = kzalloc(sizeof(struct s3c_mem_bo_ref), GFP_KERNEL);
+	if (ref == NULL)
+		return -ENOMEM;
+
+	spin_lock(&s3c_mem_bo_spinlock);
+	bo = s3c_mem_bo_find(info->handle);
+	if (bo == NULL) {
+		spin_unlock(&s3c_mem_bo_spinlock);
+		kfree(ref);
+		return -EINVAL;
+	}
+
+	bo->refcount++;
+	ref->file = file;
+	ref->bo = bo;
+	list_add(&ref->list, &s3c_mem_bo_refs);
+	spin_unlock(&s3c_mem_bo_spinlock);
+
+	info->size = bo->size;
+	info->phy_addr = bo->phy_addr;
+	info->vir_addr = s3c_mem_bo_map(file, bo);
+	if (IS_ERR_VALUE(info->vir_addr)) {
+		s3c_mem_bo_drop_ref(file, bo->handle);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static int s3c_mem_bo_free(struct file *file, struct s3c_mem_bo_info *info)
+{
+	struct mm_struct *mm = current->mm;
+	int ret = 0;
+
+	if (info->vir_addr) {
+		down_write(&mm->mmap_sem);
+		ret = do_munmap(mm, info->vir_addr, info->size);
+		up_write(&mm->mmap_sem);
+
+		if (ret < 0) {
+			printk("do_munmap() failed - S3C_MEM_BO_FREE!!\n");
+			return -EINVAL;
+		}
+	}
+
+	return s3c_mem_bo_drop_ref(file, info->handle);
+}
+
+int s3c_mem_release(struct inode *inode, struct file *file)
+{
+	struct s3c_mem_bo_ref *ref, *tmp;
+	LIST_HEAD(refs);
+
+	spin_lock(&s3c_mem_bo_spinlock);
+	list_for_each_entry_safe(ref, tmp, &s3c_mem_bo_refs, list) {
+		if (ref->file == file)
+			list_move(&ref->list, &refs);
+	}
+	spin_unlock(&s3c_mem_bo_spinlock);
+
+	list_for_each_entry_safe(ref, tmp, &refs, list) {
+		s3c_mem_bo_unref(ref->bo);
+		kfree(ref);
+	}
+
+	return 0;
+}
+
+/*
+ * Give a driver's own memory (a frame in its media area) a handle so
+ * other drivers and processes can import it. Such objects live until
+ * s3c_mem_bo_revoke() and the last reference is dropped, and they keep
+ * the area from going back to the pool until then. Exporting the same
+ * range again returns the same handle.
+ */
+int s3c_mem_bo_export(dma_addr_t paddr, size_t size)
+{
+	struct s3c_mem_bo *bo, *new_bo;
+	int handle;
+
+	new_bo = kzalloc(sizeof(struct s3c_mem_bo), GFP_KERNEL);
+	if (new_bo == NULL)
+		return -ENOMEM;
+
+	spin_lock(&s3c_mem_bo_spinlock);
+	list_for_each_entry(bo, &s3c_mem_bos, list) {
+		if (bo->vir_addr == NULL && !bo->revoked &&
+		    bo->phy_addr == paddr && bo->size == size) {
+			handle = bo->handle;
+			spin_unlock(&s3c_mem_bo_spinlock);
+			kfree(new_bo);
+			return handle;
+		}
+	}
+
+	if (s3c_pin_media_memory(paddr, size)) {
+		spin_unlock(&s3c_mem_bo_spinlock);
+		kfree(new_bo);
+		return -EINVAL;
+	}
+
+	new_bo->phy_addr = paddr;
+	new_bo->size = size;
+	new_bo->refcount = 1;
+	s3c_mem_bo_add(new_bo);
+	handle = new_bo->handle;
+	spin_unlock(&s3c_mem_bo_spinlock);
+
+	return handle;
+}
+
+/*
+ * Look up the physical address of [offset, offset + len) of an object and
+ * hold it until s3c_mem_bo_put(), so it can't be freed under the hardware:
+ * an allocated object keeps its memory, an exported one keeps the media
+ * area of its device pinned. Revoked handles fail with -EINVAL.
+ */
+int s3c_mem_bo_get(int handle, size_t offset, size_t len, dma_addr_t *paddr)
+{
+	struct s3c_mem_bo *bo;
+
+	spin_lock(&s3c_mem_bo_spinlock);
+	bo = s3c_mem_bo_find(handle);
+	if (bo == NULL || offset + len < offset || offset + len > bo->size) {
+		spin_unlock(&s3c_mem_bo_spinlock);
+		return -EINVAL;
+	}
+
+	bo->refcount++;
+	*paddr = bo->phy_addr + offset;
+	spin_unlock(&s3c_mem_bo_spinlock);
+
+	return 0;
+}
+
+void s3c_mem_bo_put(int handle)
+{
+	struct s3c_mem_bo *bo;
+
+	spin_lock(&s3c_mem_bo_spinlock);
+	bo = __s3c_mem_bo_find(handle);
+	spin_unlock(&s3c_mem_bo_spinlock);
+
+	/* the caller's reference keeps it on the list */
+	if (bo)
+		s3c_mem_bo_unref(bo);
+}
+
+/*
+ * Called before [paddr, paddr + size) goes back to the media pool: the
+ * exported handles on it stop resolving, so nothing new can be pointed at
+ * it. References already taken, and mappings, are still dropped as usual;
+ * the area is pinned until the last of them is gone.
+ */
+void s3c_mem_bo_revoke(dma_addr_t paddr, size_t size)
+{
+	struct s3c_mem_bo *bo, *tmp;
+
+	spin_lock(&s3c_mem_bo_spinlock);
+	list_for_each_entry_safe(bo, tmp, &s3c_mem_bos, list) {
+		if (bo->vir_addr || bo->revoked)
+			continue;
+		if (bo->phy_addr + bo->size <= paddr || bo->phy_addr >= paddr + size)
+			continue;
+
+		DEBUG("BO REVOKE : handle = %d, phy_addr = 0x%X, size = %d\n", bo->handle, bo->phy_addr, bo->size);
+
+		bo->revoked = 1;
+
+		/* the reference taken by s3c_mem_bo_export() */
+		if (--bo->refcount == 0) {
+			list_del(&bo->list);
+			s3c_unpin_media_memory(bo->phy_addr);
+			kfree(bo);
+		}
+	}
+	spin_unlock(&s3c_mem_bo_spinlock);
+}
+
 int s3c_mem_ioctl(struct inode *inode, struct file *file, unsigned int cmd, unsigned long arg)
 {
 	unsigned long *virt_addr;
 	struct mm_struct *mm = current->mm;
 	struct s3c_mem_alloc param;
 	struct s3c_mem_dma_param dma_param;
+	struct s3c_mem_bo_info bo_info;
+	int ret;
 
 	switch (cmd) {
 		case S3C_MEM_ALLOC:
@@ -82,12 +464,14 @@ int s3c_mem_ioctl(struct inode *inode, struct file *file, unsigned int cmd, unsi
 				mutex_unlock(&mem_alloc_lock);
 				return -EFAULT;
 			}
+			mutex_lock(&mem_mmap_lock);
 			flag = MEM_ALLOC;
 			param.vir_addr = do_mmap(file, 0, param.size, PROT_READ|PROT_WRITE, MAP_SHARED, 0);
 			DEBUG("param.vir_addr = %08x, %d\n", param.vir_addr, __LINE__);
 			if(param.vir_addr == -EINVAL) {
 				printk("S3C_MEM_ALLOC FAILED\n");
 				flag = 0;
+				mutex_unlock(&mem_mmap_lock);
 				mutex_unlock(&mem_alloc_lock);
 				return -EFAULT;
 			}
@@ -96,10 +480,12 @@ int s3c_mem_ioctl(struct inode *inode, struct file *file, unsigned int cmd, unsi
 
 			if(copy_to_user((struct s3c_mem_alloc *)arg, &param, sizeof(struct s3c_mem_alloc))){
 				flag = 0;
+				mutex_unlock(&mem_mmap_lock);
 				mutex_unlock(&mem_alloc_lock);
 				return -EFAULT;
 			}
 			flag = 0;
+			mutex_unlock(&mem_mmap_lock);
 			mutex_unlock(&mem_alloc_lock);
 
 			break;
@@ -110,12 +496,14 @@ int s3c_mem_ioctl(struct inode *inode, struct file *file, unsigned int cmd, unsi
 				mutex_unlock(&mem_cacheable_alloc_lock);
 				return -EFAULT;
 			}
+			mutex_lock(&mem_mmap_lock);
 			flag = MEM_ALLOC_CACHEABLE;
 			param.vir_addr = do_mmap(file, 0, param.size, PROT_READ|PROT_WRITE, MAP_SHARED, 0);
 			DEBUG("param.vir_addr = %08x, %d\n", param.vir_addr, __LINE__);
 			if(param.vir_addr == -EINVAL) {
 				printk("S3C_MEM_ALLOC FAILED\n");
 				flag = 0;
+				mutex_unlock(&mem_mmap_lock);
 				mutex_unlock(&mem_cacheable_alloc_lock);
 				return -EFAULT;
 			}
@@ -124,10 +512,12 @@ int s3c_mem_ioctl(struct inode *inode, struct file *file, unsigned int cmd, unsi
 
 			if(copy_to_user((struct s3c_mem_alloc *)arg, &param, sizeof(struct s3c_mem_alloc))){
 				flag = 0;
+				mutex_unlock(&mem_mmap_lock);
 				mutex_unlock(&mem_cacheable_alloc_lock);
 				return -EFAULT;
 			}
 			flag = 0;
+			mutex_unlock(&mem_mmap_lock);
 			mutex_unlock(&mem_cacheable_alloc_lock);
 
 			break;
@@ -138,6 +528,7 @@ int s3c_mem_ioctl(struct inode *inode, struct file *file, unsigned int cmd, unsi
 				mutex_unlock(&mem_share_alloc_lock);
 				return -EFAULT;
 			}
+			mutex_lock(&mem_mmap_lock);
 			flag = MEM_ALLOC_SHARE;
 			physical_address = param.phy_addr;
 			DEBUG("param.phy_addr = %08x, %d\n", physical_address, __LINE__);
@@ -146,6 +537,7 @@ int s3c_mem_ioctl(struct inode *inode, struct file *file, unsigned int cmd, unsi
 			if(param.vir_addr == -EINVAL) {
 				printk("S3C_MEM_SHARE_ALLOC FAILED\n");
 				flag = 0;
+				mutex_unlock(&mem_mmap_lock);
 				mutex_unlock(&mem_share_alloc_lock);
 				return -EFAULT;
 			}
@@ -153,10 +545,12 @@ int s3c_mem_ioctl(struct inode *inode, struct file *file, unsigned int cmd, unsi
 
 			if(copy_to_user((struct s3c_mem_alloc *)arg, &param, sizeof(struct s3c_mem_alloc))){
 				flag = 0;
+				mutex_unlock(&mem_mmap_lock);
 				mutex_unlock(&mem_share_alloc_lock);
 				return -EFAULT;
 			}
 			flag = 0;
+			mutex_unlock(&mem_mmap_lock);
 			mutex_unlock(&mem_share_alloc_lock);
 
 			break;
@@ -167,6 +561,7 @@ int s3c_mem_ioctl(struct inode *inode, struct file *file, unsigned int cmd, unsi
 				mutex_unlock(&mem_cacheable_share_alloc_lock);
 				return -EFAULT;
 			}
+			mutex_lock(&mem_mmap_lock);
 			flag = MEM_ALLOC_CACHEABLE_SHARE;
 			physical_address = param.phy_addr;
 			DEBUG("param.phy_addr = %08x, %d\n", physical_address, __LINE__);
@@ -174,7 +569,8 @@ int s3c_mem_ioctl(struct inode *inode, struct file *file, unsigned int cmd, unsi
 			DEBUG("param.vir_addr = %08x, %d\n", param.vir_addr, __LINE__);
 			if(param.vir_addr == -EINVAL) {
 				printk("S3C_MEM_SHARE_ALLOC FAILED\n");
-			flag = 0;
+				flag = 0;
+				mutex_unlock(&mem_mmap_lock);
 				mutex_unlock(&mem_cacheable_share_alloc_lock);
 				return -EFAULT;
 			}
@@ -182,10 +578,12 @@ int s3c_mem_ioctl(struct inode *inode, struct file *file, unsigned int cmd, unsi
 
 			if(copy_to_user((struct s3c_mem_alloc *)arg, &param, sizeof(struct s3c_mem_alloc))){
 				flag = 0;
+				mutex_unlock(&mem_mmap_lock);
 				mutex_unlock(&mem_cacheable_share_alloc_lock);
 				return -EFAULT;
 			}
 			flag = 0;
+			mutex_unlock(&mem_mmap_lock);
 			mutex_unlock(&mem_cacheable_share_alloc_lock);
 
 			break;
@@ -336,6 +734,33 @@ int s3c_mem_ioctl(struct inode *inode, struct file *file, unsigned int cmd, unsi
 			}
 			break;
 
+		case S3C_MEM_BO_ALLOC:
+		case S3C_MEM_BO_IMPORT:
+		case S3C_MEM_BO_FREE:
+			if(copy_from_user(&bo_info, (struct s3c_mem_bo_info *)arg, sizeof(struct s3c_mem_bo_info))) {
+				return -EFAULT;
+			}
+
+			if (cmd == S3C_MEM_BO_ALLOC && bo_info.size <= 0)
+				return -EINVAL;
+
+			mutex_lock(&mem_bo_lock);
+			if (cmd == S3C_MEM_BO_ALLOC)
+				ret = s3c_mem_bo_alloc(file, &bo_info);
+			else if (cmd == S3C_MEM_BO_IMPORT)
+				ret = s3c_mem_bo_import(file, &bo_info);
+			else
+				ret = s3c_mem_bo_free(file, &bo_info);
+			mutex_unlock(&mem_bo_lock);
+
+			if (ret)
+				return ret;
+
+			if(copy_to_user((struct s3c_mem_bo_info *)arg, &bo_info, sizeof(struct s3c_mem_bo_info))) {
+				return -EFAULT;
+			}
+			break;
+
 		default:
 			DEBUG("s3c_mem_ioctl() : default !!\n");
 			return -EINVAL;
@@ -348,10 +773,12 @@ int s3c_mem_mmap(struct file* filp, struct vm_area_struct *vma)
 {
 	unsigned long pageFrameNo=0, size, phys_addr;
 	unsigned long *virt_addr;
+	struct s3c_mem_bo *bo = s3c_mem_bo_mapping;
+	int type = flag;
 
 	size = vma->vm_end - vma->vm_start;
 
-	switch (flag) {
+	switch (type) {
 	case MEM_ALLOC :
 	case MEM_ALLOC_CACHEABLE :
 		virt_addr = (unsigned long *)kmalloc(size, GFP_DMA|GFP_ATOMIC);
@@ -376,11 +803,20 @@ int s3c_mem_mmap(struct file* filp, struct vm_area_struct *vma)
 		DEBUG("MMAP_KMALLOC_SHARE : vma->end = 0x%08x, vma->start = 0x%08x, size = %d, %d\n", vma->vm_end, vma->vm_start, size, __LINE__);
 		break;
 
+	case MEM_ALLOC_BO :
+		if (!bo || size > bo->size)
+			return -EINVAL;
+
+		pageFrameNo = __phys_to_pfn(bo->phy_addr);
+		/* same attributes as the kernel mapping of the buffer */
+		vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+		break;
+
 	default :
 		break;
 	}
 
-	if( (flag == MEM_ALLOC) || (flag == MEM_ALLOC_SHARE) )
+	if( (type == MEM_ALLOC) || (type == MEM_ALLOC_SHARE) )
 		vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
 
 	vma->vm_flags |= VM_RESERVED;
@@ -390,8 +826,19 @@ int s3c_mem_mmap(struct file* filp, struct vm_area_struct *vma)
 		return -EINVAL;
 	}
 
+	if (type == MEM_ALLOC_BO) {
+		vma->vm_ops = &s3c_mem_bo_vm_ops;
+		vma->vm_private_data = bo;
+		s3c_mem_bo_vm_open(vma);
+	}
+
 	return 0;
 }
 
 EXPORT_SYMBOL(s3c_mem_ioctl);
 EXPORT_SYMBOL(s3c_mem_mmap);
+EXPORT_SYMBOL(s3c_mem_release);
+EXPORT_SYMBOL(s3c_mem_bo_export);
+EXPORT_SYMBOL(s3c_mem_bo_get);
+EXPORT_SYMBOL(s3c_mem_bo_put);
+EXPORT_SYMBOL(s3c_mem_bo_revoke);
@@ -21,10 +21,15 @@
 #define S3C_MEM_DMA_COPY		_IOWR(MEM_IOCTL_MAGIC, 318, struct s3c_mem_dma_param)
 #define S3C_MEM_DMA_SET			_IOWR(MEM_IOCTL_MAGIC, 319, struct s3c_mem_dma_param)
 
+#define S3C_MEM_BO_ALLOC		_IOWR(MEM_IOCTL_MAGIC, 320, struct s3c_mem_bo_info)
+#define S3C_MEM_BO_IMPORT		_IOWR(MEM_IOCTL_MAGIC, 321, struct s3c_mem_bo_info)
+#define S3C_MEM_BO_FREE			_IOWR(MEM_IOCTL_MAGIC, 322, struct s3c_mem_bo_info)
+
 #define MEM_ALLOC			1
 #define MEM_ALLOC_SHARE			2
 #define MEM_ALLOC_CACHEABLE		3
 #define MEM_ALLOC_CACHEABLE_SHARE	4
+#define MEM_ALLOC_BO			5
 
 #define S3C_MEM_MINOR  			13
 
@@ -37,12 +42,29 @@ static DEFINE_MUTEX(mem_share_free_lock);
 static DEFINE_MUTEX(mem_cacheable_alloc_lock);
 static DEFINE_MUTEX(mem_cacheable_share_alloc_lock);
 
+static DEFINE_MUTEX(mem_bo_lock);
+
+/* flag, physical_address and s3c_mem_bo_mapping around do_mmap() */
+static DEFINE_MUTEX(mem_mmap_lock);
+
 struct s3c_mem_alloc {
 	int		size;
 	unsigned int 	vir_addr;
 	unsigned int 	phy_addr;
 };
 
+/*
+ * Shared buffer object. The handle names the buffer to every media driver
+ * (post processor, FIMC, MFC, JPEG ...), phy_addr is what the rotator,
+ * FIMG-2D and s3cfb take directly.
+ */
+struct s3c_mem_bo_info {
+	int		handle;
+	int		size;
+	unsigned int 	vir_addr;
+	unsigned int 	phy_addr;
+};
+
 struct s3c_mem_dma_param {
 	int		size;
 	unsigned int 	src_addr;
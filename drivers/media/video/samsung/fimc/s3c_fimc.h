@@ -524,6 +524,7 @@ struct s3c_fimc_control {
 	enum s3c_fimc_path_in_t		in_type;
 	struct s3c_fimc_camera		*in_cam;
 	struct s3c_fimc_in_frame	in_frame;
+	int				in_bo;
 
 	/* output */
 	enum s3c_fimc_path_out_t	out_type;
@@ -583,12 +584,14 @@ struct s3c_fimc_config {
 #define V4L2_CID_SCALER_BYPASS		(V4L2_CID_PRIVATE_BASE + 4)
 #define V4L2_CID_JPEG_INPUT		(V4L2_CID_PRIVATE_BASE + 5)
 #define V4L2_CID_OUTPUT_ADDR		(V4L2_CID_PRIVATE_BASE + 10)
+#define V4L2_CID_OUTPUT_BO		(V4L2_CID_PRIVATE_BASE + 11)
 #define V4L2_CID_INPUT_ADDR		(V4L2_CID_PRIVATE_BASE + 20)
 #define V4L2_CID_INPUT_ADDR_RGB		(V4L2_CID_PRIVATE_BASE + 21)
 #define V4L2_CID_INPUT_ADDR_Y		(V4L2_CID_PRIVATE_BASE + 22)
 #define V4L2_CID_INPUT_ADDR_CB		(V4L2_CID_PRIVATE_BASE + 23)
 #define V4L2_CID_INPUT_ADDR_CBCR	(V4L2_CID_PRIVATE_BASE + 24)
 #define V4L2_CID_INPUT_ADDR_CR		(V4L2_CID_PRIVATE_BASE + 25)
+#define V4L2_CID_INPUT_BO		(V4L2_CID_PRIVATE_BASE + 26)
 #define V4L2_CID_EFFECT_ORIGINAL	(V4L2_CID_PRIVATE_BASE + 30)
 #define V4L2_CID_EFFECT_ARBITRARY	(V4L2_CID_PRIVATE_BASE + 31)
 #define V4L2_CID_EFFECT_NEGATIVE 	(V4L2_CID_PRIVATE_BASE + 33)
@@ -626,6 +629,9 @@ extern int s3c_fimc_alloc_y_memory(struct s3c_fimc_in_frame *info, dma_addr_t ad
 extern int s3c_fimc_alloc_cb_memory(struct s3c_fimc_in_frame *info, dma_addr_t addr);
 extern int s3c_fimc_alloc_cr_memory(struct s3c_fimc_in_frame *info, dma_addr_t addr);
 extern void s3c_fimc_free_output_memory(struct s3c_fimc_out_frame *info);
+extern int s3c_fimc_set_input_bo(struct s3c_fimc_control *ctrl, int handle);
+extern void s3c_fimc_put_input_bo(struct s3c_fimc_control *ctrl);
+extern int s3c_fimc_export_output_bo(struct s3c_fimc_out_frame *info, int frame);
 extern int s3c_fimc_set_input_frame(struct s3c_fimc_control *ctrl, struct v4l2_pix_format *fmt);
 extern int s3c_fimc_set_output_frame(struct s3c_fimc_control *ctrl, struct v4l2_pix_format *fmt);
 extern int s3c_fimc_frame_handler(struct s3c_fimc_control *ctrl);
@@ -312,6 +312,45 @@ int s3c_fimc_alloc_input_memory(struct s3c_fimc_in_frame *info, dma_addr_t addr)
 	return 0;
 }
 
+/*
+ * Take the input from a shared buffer object (drivers/char/s3c_mem.c),
+ * held until replaced or the device is closed.
+ */
+int s3c_fimc_set_input_bo(struct s3c_fimc_control *ctrl, int handle)
+{
+	struct s3c_fimc_in_frame *info = &ctrl->in_frame;
+	dma_addr_t addr;
+	u32 size;
+
+	size = s3c_fimc_get_buffer_size(info->width, info->height, info->format);
+	if (s3c_mem_bo_get(handle, 0, size, &addr)) {
+		err("invalid buffer object: %d\n", handle);
+		return -EINVAL;
+	}
+
+	s3c_fimc_put_input_bo(ctrl);
+	ctrl->in_bo = handle;
+
+	return s3c_fimc_alloc_input_memory(info, addr);
+}
+
+void s3c_fimc_put_input_bo(struct s3c_fimc_control *ctrl)
+{
+	if (ctrl->in_bo) {
+		s3c_mem_bo_put(ctrl->in_bo);
+		ctrl->in_bo = 0;
+	}
+}
+
+/* a handle for an output frame, to pass it on without copying */
+int s3c_fimc_export_output_bo(struct s3c_fimc_out_frame *info, int frame)
+{
+	if (frame < 0 || frame >= info->nr_frames)
+		return -EINVAL;
+
+	return s3c_mem_bo_export(info->addr[frame].phys_y, info->buf_size);
+}
+
 int s3c_fimc_alloc_y_memory(struct s3c_fimc_in_frame *info, 
 					dma_addr_t addr)
 {
@@ -406,6 +406,8 @@ static int s3c_fimc_release(struct inode *inode, struct file *filp)
 	atomic_dec(&ctrl->in_use);
 	filp->private_data = NULL;
 
+	s3c_fimc_put_input_bo(ctrl);
+
 	mutex_unlock(&ctrl->lock);
 
 	return 0;
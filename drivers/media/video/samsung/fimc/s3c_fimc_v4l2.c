@@ -269,6 +269,12 @@ static int s3c_fimc_v4l2_g_ctrl(struct file *filp, void *fh,
 		c->value = frame->addr[c->value].phys_y;
 		break;
 
+	case V4L2_CID_OUTPUT_BO:
+		c->value = s3c_fimc_export_output_bo(frame, c->value);
+		if (c->value < 0)
+			return c->value;
+		break;
+
 	default:
 		err("invalid control id: %d\n", c->id);
 		return -EINVAL;
@@ -431,6 +437,13 @@ static int s3c_fimc_v4l2_s_ctrl(struct file *filp, void *fh,
 		s3c_fimc_set_input_address(ctrl);
 		break;
 
+	case V4L2_CID_INPUT_BO:
+		if (s3c_fimc_set_input_bo(ctrl, c->value))
+			return -EINVAL;
+
+		s3c_fimc_set_input_address(ctrl);
+		break;
+
 	case V4L2_CID_RESET:
 		ctrl->rot90 = 0;
 		ctrl->in_frame.flip = FLIP_ORIGINAL;
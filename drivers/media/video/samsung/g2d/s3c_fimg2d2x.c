@@ -21,6 +21,10 @@
 #include <linux/interrupt.h>
 #include <linux/platform_device.h>
 #include <linux/miscdevice.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/delay.h>
+#include <linux/timer.h>
 #include <asm/io.h>
 #include <mach/map.h>
 #include <plat/regs-g2d.h>
@@ -35,9 +39,32 @@ static struct resource *s3c_g2d_mem;
 static void __iomem *s3c_g2d_base;
 static wait_queue_head_t waitq_g2d;
 
-static struct mutex *h_rot_mutex;
-
-static u16 s3c_g2d_poll_flag = 0;
+/*
+ * Jobs of all open files in submission order, but for the kernel jobs,
+ * which go right behind the head job. The head job is the one on the
+ * hardware: one operation is in the FIFO at a time and the command finish
+ * interrupt starts the next, so nobody spins for a whole blit. A kernel job
+ * also takes over between two operations of a user batch, so the console
+ * never waits for more than one user operation.
+ */
+static LIST_HEAD(s3c_g2d_jobs);
+static DEFINE_SPINLOCK(s3c_g2d_lock);
+
+/* an operation that has not finished by then is failed with its job */
+static void s3c_g2d_op_timeout(unsigned long data);
+static DEFINE_TIMER(s3c_g2d_op_timer, s3c_g2d_op_timeout, 0, 0);
+
+/* jobs queued from inside the kernel, see s3c_g2d_kernel_fill() */
+static s3c_g2d_ctx s3c_g2d_kernel_ctx;
+
+/*
+ * Set when s3c_g2d_kernel_sync() timed out, the kernel users draw in software
+ * until the engine finishes a command again or is reset.
+ */
+static int s3c_g2d_kernel_failed = 0;
+
+/* probed, clocked and not suspended */
+static int s3c_g2d_ready = 0;
 
 void s3c_g2d_check_fifo(int empty_fifo)
 {
@@ -289,38 +316,447 @@ static void s3c_g2d_get_rotation_origin(u16 src_x1, u16 src_y1,
 }
 
 
-static void s3c_g2d_rotator_start(s3c_g2d_params *params, ROT_DEG rot_degree)
+/* solid fill of the destination rectangle, the fg color is the 3rd operand */
+static void s3c_g2d_fill(s3c_g2d_params *params, u32 color)
+{
+	u32 dst_x1, dst_y1, dst_x2, dst_y2;
+
+	dst_x1 = params->dst_start_x;
+	dst_y1 = params->dst_start_y;
+	dst_x2 = params->dst_start_x + params->dst_work_width;
+	dst_y2 = params->dst_start_y + params->dst_work_height;
+
+	s3c_g2d_check_fifo(25);
+	__raw_writel(S3C_G2D_INTEN_REG_CCF, s3c_g2d_base + S3C_G2D_INTEN_REG);
+
+	__raw_writel(color, s3c_g2d_base + S3C_G2D_FG_COLOR_REG);
+	__raw_writel(S3C_G2D_ROP_REG_OS_FG_COLOR | 
+			((params->alpha_mode == TRUE) ? S3C_G2D_ROP_REG_ABM_REGISTER : S3C_G2D_ROP_REG_ABM_NO_BLENDING) | 
+			S3C_G2D_ROP_REG_T_OPAQUE_MODE | 
+			G2D_ROP_3RD_OPRND_ONLY, 
+			s3c_g2d_base + S3C_G2D_ROP_REG);
+
+	s3c_g2d_bitblt(dst_x1, dst_y1, dst_x2, dst_y2, 
+			dst_x1, dst_y1, dst_x2, dst_y2);
+}
+
+
+static void s3c_g2d_start_op(s3c_g2d_op *op)
 {
+	mod_timer(&s3c_g2d_op_timer, jiffies + G2D_TIMEOUT);
+
+	s3c_g2d_init_regs(&op->params);
 
-	s3c_g2d_init_regs(params);
-	s3c_g2d_rotate_with_bitblt(params, rot_degree);
+	if (op->op == G2D_OP_FILL)
+		s3c_g2d_fill(&op->params, op->fill_color);
+	else
+		s3c_g2d_rotate_with_bitblt(&op->params, op->rot_degree);
+}
+
+
+static int s3c_g2d_check_op(s3c_g2d_op *op)
+{
+	s3c_g2d_params *params = &op->params;
+
+	if (op->op != G2D_OP_BLIT && op->op != G2D_OP_FILL)
+		return -EINVAL;
+
+	if (op->op == G2D_OP_BLIT && op->rot_degree > ROT_Y_FLIP)
+		return -EINVAL;
+
+	if (params->alpha_mode == TRUE && params->alpha_val > ALPHA_VALUE_MAX)
+		return -EINVAL;
+
+	if (params->src_full_width > G2D_MAX_WIDTH || params->src_full_height > G2D_MAX_HEIGHT ||
+		params->dst_full_width > G2D_MAX_WIDTH || params->dst_full_height > G2D_MAX_HEIGHT)
+		return -EINVAL;
+
+	return 0;
+}
+
+
+static int s3c_g2d_fence_done(s3c_g2d_ctx *ctx, u32 fence)
+{
+	return (s32)(ctx->completed - fence) >= 0;
+}
+
+
+/* Takes over job; returns its fence */
+static u32 s3c_g2d_queue_job(s3c_g2d_ctx *ctx, s3c_g2d_job *job)
+{
+	unsigned long flags;
+	int idle;
+
+	spin_lock_irqsave(&s3c_g2d_lock, flags);
+
+	job->ctx = ctx;
+	job->fence = ++ctx->submitted;
+	job->cur_op = 0;
+
+	idle = list_empty(&s3c_g2d_jobs);
+	if (ctx == &s3c_g2d_kernel_ctx && !idle) {
+		struct list_head *pos = s3c_g2d_jobs.next;
+
+		/* behind the head job and the kernel jobs already queued */
+		while (pos->next != &s3c_g2d_jobs &&
+		       list_entry(pos->next, s3c_g2d_job, list)->ctx == &s3c_g2d_kernel_ctx)
+			pos = pos->next;
+		list_add(&job->list, pos);
+	} else {
+		list_add_tail(&job->list, &s3c_g2d_jobs);
+	}
+
+	if (idle)
+		s3c_g2d_start_op(&job->ops[0]);
+
+	spin_unlock_irqrestore(&s3c_g2d_lock, flags);
+
+	return job->fence;
+}
+
+
+/* a job waits at most for all the queued operations to time out; -EIO if it did */
+static int s3c_g2d_wait_fence(s3c_g2d_ctx *ctx, u32 fence)
+{
+	int ret;
+
+	ret = wait_event_interruptible(waitq_g2d, s3c_g2d_fence_done(ctx, fence));
+	if (ret < 0)
+		return ret;
+
+	if (ctx->failed == fence)
+		return -EIO;
+
+	return 0;
+}
+
+
+/* Block while the file has G2D_MAX_PENDING_JOBS queued, or -EBUSY with nonblock */
+static int s3c_g2d_wait_room(s3c_g2d_ctx *ctx, int nonblock)
+{
+	if (ctx->submitted - ctx->completed < G2D_MAX_PENDING_JOBS)
+		return 0;
+
+	if (nonblock)
+		return -EBUSY;
+
+	return wait_event_interruptible(waitq_g2d, 
+			ctx->submitted - ctx->completed < G2D_MAX_PENDING_JOBS);
+}
+
+
+/* Current operation finished, called with s3c_g2d_lock held */
+static void s3c_g2d_op_done(void)
+{
+	s3c_g2d_job *job, *next;
+
+	if (list_empty(&s3c_g2d_jobs))
+		return;
+
+	job = list_first_entry(&s3c_g2d_jobs, s3c_g2d_job, list);
+
+	if (++job->cur_op < job->num_ops) {
+		/* a queued kernel job goes first, the batch resumes after it */
+		if (job->ctx != &s3c_g2d_kernel_ctx && job->list.next != &s3c_g2d_jobs) {
+			next = list_entry(job->list.next, s3c_g2d_job, list);
+			if (next->ctx == &s3c_g2d_kernel_ctx) {
+				list_move(&next->list, &s3c_g2d_jobs);
+				job = next;
+			}
+		}
+
+		s3c_g2d_start_op(&job->ops[job->cur_op]);
+		return;
+	}
+
+	/* the kernel fence may be ahead, see s3c_g2d_kernel_give_up() */
+	if (job->ctx && (s32)(job->fence - job->ctx->completed) > 0)
+		job->ctx->completed = job->fence;
+
+	list_del(&job->list);
+	kfree(job);
+
+	if (!list_empty(&s3c_g2d_jobs)) {
+		/* a batch may have been interrupted by kernel jobs */
+		job = list_first_entry(&s3c_g2d_jobs, s3c_g2d_job, list);
+		s3c_g2d_start_op(&job->ops[job->cur_op]);
+	} else {
+		del_timer(&s3c_g2d_op_timer);
+	}
+}
+
+
+/*
+ * A lost interrupt or a hung engine would stall every file and fbcon
+ * behind the head job: reset the engine, fail the job and go on.
+ */
+static void s3c_g2d_op_timeout(unsigned long data)
+{
+	s3c_g2d_job *job;
+	unsigned long flags;
+
+	spin_lock_irqsave(&s3c_g2d_lock, flags);
+
+	if (list_empty(&s3c_g2d_jobs)) {
+		spin_unlock_irqrestore(&s3c_g2d_lock, flags);
+		return;
+	}
+
+	printk(KERN_ERR "%s: operation timed out, resetting the engine\n", __FUNCTION__);
+
+	__raw_writel(S3C_G2D_CONTROL_REG_SWRESET, s3c_g2d_base + S3C_G2D_CONTROL_REG);
+	__raw_writel(S3C_G2D_PEND_REG_INTP_CMD_FIN | S3C_G2D_PEND_REG_INTP_ALL_FIN,
+			s3c_g2d_base + S3C_G2D_INTC_PEND_REG);
+	s3c_g2d_kernel_failed = 0;
+
+	job = list_first_entry(&s3c_g2d_jobs, s3c_g2d_job, list);
+	if (job->ctx)
+		job->ctx->failed = job->fence;
+
+	/* completes the job and starts the next one */
+	job->cur_op = job->num_ops - 1;
+	s3c_g2d_op_done();
+
+	spin_unlock_irqrestore(&s3c_g2d_lock, flags);
+
+	wake_up_interruptible(&waitq_g2d);
+}
+
+
+/*
+ * Ack a finished command and start the next one, called with s3c_g2d_lock
+ * held. Both the irq and s3c_g2d_kernel_sync() come through here, so the
+ * pending bit is tested under the lock.
+ */
+static int s3c_g2d_handle_fin(void)
+{
+	if(!(__raw_readl(s3c_g2d_base + S3C_G2D_INTC_PEND_REG) & S3C_G2D_PEND_REG_INTP_CMD_FIN))
+		return 0;
+
+	__raw_writel ( S3C_G2D_PEND_REG_INTP_CMD_FIN, s3c_g2d_base + S3C_G2D_INTC_PEND_REG );
+	s3c_g2d_kernel_failed = 0;
+	s3c_g2d_op_done();
+
+	return 1;
 }
 
 
 irqreturn_t s3c_g2d_irq(int irq, void *dev_id)
 {
-	if(__raw_readl(s3c_g2d_base + S3C_G2D_INTC_PEND_REG) & S3C_G2D_PEND_REG_INTP_CMD_FIN) {
-	 	__raw_writel ( S3C_G2D_PEND_REG_INTP_CMD_FIN, s3c_g2d_base + S3C_G2D_INTC_PEND_REG );
+	int done;
+
+	spin_lock(&s3c_g2d_lock);
+	done = s3c_g2d_handle_fin();
+	spin_unlock(&s3c_g2d_lock);
+
+	if (done)
 		wake_up_interruptible(&waitq_g2d);
-		s3c_g2d_poll_flag = 1;
-	}
 
 	return IRQ_HANDLED;
 }
 
 
+static int s3c_g2d_kernel_submit(s3c_g2d_op *op)
+{
+	s3c_g2d_job *job;
+
+	if (!s3c_g2d_ready)
+		return -ENODEV;
+
+	if (s3c_g2d_kernel_failed)
+		return -EIO;
+
+	job = kmalloc(sizeof(s3c_g2d_job) + sizeof(s3c_g2d_op), GFP_ATOMIC);
+	if (job == NULL)
+		return -ENOMEM;
+
+	memcpy(job->ops, op, sizeof(s3c_g2d_op));
+	job->num_ops = 1;
+	s3c_g2d_queue_job(&s3c_g2d_kernel_ctx, job);
+
+	return 0;
+}
+
+
+static int s3c_g2d_kernel_params(s3c_g2d_params *params, u32 base, int bpp,
+				u32 full_width, u32 full_height)
+{
+	memset(params, 0, sizeof(s3c_g2d_params));
+
+	switch (bpp) {
+	case 16:
+		params->bpp = RGB16;
+		break;
+
+	case 32:
+		params->bpp = RGB24;
+		break;
+
+	default:
+		return -EINVAL;
+	}
+
+	params->src_base_addr = base;
+	params->src_full_width = full_width;
+	params->src_full_height = full_height;
+	params->dst_base_addr = base;
+	params->dst_full_width = full_width;
+	params->dst_full_height = full_height;
+
+	params->cw_x2 = full_width - 1;
+	params->cw_y2 = full_height - 1;
+
+	return 0;
+}
+
+
+/*
+ * The engine coordinates are inclusive, hence the work sizes of width - 1.
+ * Returns non zero if the caller has to do it in software.
+ */
+int s3c_g2d_kernel_fill(u32 base, int bpp, u32 full_width, u32 full_height,
+			u32 x, u32 y, u32 width, u32 height, u32 color)
+{
+	s3c_g2d_op op;
+
+	if (width == 0 || height == 0)
+		return 0;
+
+	if (s3c_g2d_kernel_params(&op.params, base, bpp, full_width, full_height))
+		return -EINVAL;
+
+	op.op = G2D_OP_FILL;
+	op.rot_degree = ROT_0;
+	op.fill_color = color;
+	op.params.dst_start_x = x;
+	op.params.dst_start_y = y;
+	op.params.dst_work_width = width - 1;
+	op.params.dst_work_height = height - 1;
+
+	return s3c_g2d_kernel_submit(&op);
+}
+EXPORT_SYMBOL(s3c_g2d_kernel_fill);
+
+
+/*
+ * Copies within one surface. The engine walks top to bottom, left to right,
+ * so overlapping copies that move down or right are left to the caller.
+ */
+int s3c_g2d_kernel_copy(u32 base, int bpp, u32 full_width, u32 full_height,
+			u32 sx, u32 sy, u32 dx, u32 dy, u32 width, u32 height)
+{
+	s3c_g2d_op op;
+
+	if (width == 0 || height == 0)
+		return 0;
+
+	if (dy > sy || (dy == sy && dx > sx)) {
+		if (dy < sy + height && sy < dy + height &&
+			dx < sx + width && sx < dx + width)
+			return -EINVAL;
+	}
+
+	if (s3c_g2d_kernel_params(&op.params, base, bpp, full_width, full_height))
+		return -EINVAL;
+
+	op.op = G2D_OP_BLIT;
+	op.rot_degree = ROT_0;
+	op.fill_color = 0;
+	op.params.src_start_x = sx;
+	op.params.src_start_y = sy;
+	op.params.src_work_width = width - 1;
+	op.params.src_work_height = height - 1;
+	op.params.dst_start_x = dx;
+	op.params.dst_start_y = dy;
+	op.params.dst_work_width = width - 1;
+	op.params.dst_work_height = height - 1;
+
+	return s3c_g2d_kernel_submit(&op);
+}
+EXPORT_SYMBOL(s3c_g2d_kernel_copy);
+
+
+/*
+ * Give up on the engine for the kernel users until it works again: drop
+ * their jobs that have not started, the one on the engine is left to
+ * s3c_g2d_op_timeout(). Called with s3c_g2d_lock held.
+ */
+static void s3c_g2d_kernel_give_up(void)
+{
+	s3c_g2d_job *job, *tmp;
+
+	printk(KERN_ERR "%s: console drawing falls back to software\n", __FUNCTION__);
+
+	s3c_g2d_kernel_failed = 1;
+
+	list_for_each_entry_safe(job, tmp, &s3c_g2d_jobs, list) {
+		if (job->list.prev == &s3c_g2d_jobs || job->ctx != &s3c_g2d_kernel_ctx)
+			continue;
+
+		list_del(&job->list);
+		kfree(job);
+	}
+
+	/* nothing the kernel queued is waited for any more */
+	s3c_g2d_kernel_ctx.completed = s3c_g2d_kernel_ctx.submitted;
+}
+
+
+/*
+ * Wait for everything queued through s3c_g2d_kernel_*(), which is only
+ * behind the operation on the engine. Does not sleep and polls the engine
+ * itself, so it also works with interrupts off. After a timeout it returns
+ * at once, as nothing more is queued until the engine recovers.
+ */
+int s3c_g2d_kernel_sync(void)
+{
+	unsigned long flags;
+	int timeout = G2D_SYNC_TIMEOUT_US;
+	int woken = 0, done;
+
+	if (!s3c_g2d_ready || s3c_g2d_kernel_failed)
+		return 0;
+
+	for (;;) {
+		spin_lock_irqsave(&s3c_g2d_lock, flags);
+		woken |= s3c_g2d_handle_fin();
+		done = s3c_g2d_fence_done(&s3c_g2d_kernel_ctx, s3c_g2d_kernel_ctx.submitted);
+		spin_unlock_irqrestore(&s3c_g2d_lock, flags);
+
+		if (done)
+			break;
+
+		if (--timeout == 0) {
+			printk(KERN_ERR "\n%s: Waiting for the engine is timeout\n", __FUNCTION__);
+			spin_lock_irqsave(&s3c_g2d_lock, flags);
+			s3c_g2d_kernel_give_up();
+			spin_unlock_irqrestore(&s3c_g2d_lock, flags);
+			break;
+		}
+
+		udelay(1);
+	}
+
+	if (woken)
+		wake_up_interruptible(&waitq_g2d);
+
+	return done ? 0 : -ETIMEDOUT;
+}
+EXPORT_SYMBOL(s3c_g2d_kernel_sync);
+
+
 int s3c_g2d_open(struct inode *inode, struct file *file)
 {
-	s3c_g2d_params *params;
-	params = (s3c_g2d_params *)kmalloc(sizeof(s3c_g2d_params), GFP_KERNEL);
-	if(params == NULL) {
+	s3c_g2d_ctx *ctx;
+	ctx = (s3c_g2d_ctx *)kmalloc(sizeof(s3c_g2d_ctx), GFP_KERNEL);
+	if(ctx == NULL) {
 		printk(KERN_ERR "Instance memory allocation was failed\n");
 		return -1;
 	}
 
-	memset(params, 0, sizeof(s3c_g2d_params));
+	memset(ctx, 0, sizeof(s3c_g2d_ctx));
 
-	file->private_data	= (s3c_g2d_params *)params;
+	file->private_data	= (s3c_g2d_ctx *)ctx;
 	
 	printk("s3c_g2d_open() \n");
 
@@ -330,15 +766,27 @@ int s3c_g2d_open(struct inode *inode, struct file *file)
 
 int s3c_g2d_release(struct inode *inode, struct file *file)
 {
-	s3c_g2d_params *params;
+	s3c_g2d_ctx *ctx;
+	s3c_g2d_job *job;
+	unsigned long flags;
 
-	params = (s3c_g2d_params *)file->private_data;
-	if (params == NULL) {
+	ctx = (s3c_g2d_ctx *)file->private_data;
+	if (ctx == NULL) {
 		printk(KERN_ERR "Can't release s3c_rotator!!\n");
 		return -1;
 	}
 
-	kfree(params);
+	wait_event_timeout(waitq_g2d, s3c_g2d_fence_done(ctx, ctx->submitted), G2D_TIMEOUT);
+
+	/* whatever is left still runs, but must not touch ctx */
+	spin_lock_irqsave(&s3c_g2d_lock, flags);
+	list_for_each_entry(job, &s3c_g2d_jobs, list) {
+		if (job->ctx == ctx)
+			job->ctx = NULL;
+	}
+	spin_unlock_irqrestore(&s3c_g2d_lock, flags);
+
+	kfree(ctx);
 	
 	printk("s3c_g2d_release() \n");
 
@@ -374,75 +822,135 @@ int s3c_g2d_mmap(struct file* filp, struct vm_area_struct *vma)
 }
 
 
+/*
+ * S3C_G2D_SUBMIT queues a whole batch and returns at once with a fence;
+ * S3C_G2D_WAIT_FENCE or poll() tell when it is done. The single operation
+ * ioctls are a batch of one and wait for it unless O_NONBLOCK is set.
+ */
 static int s3c_g2d_ioctl(struct inode *inode, struct file *file, unsigned int cmd, unsigned long arg)
 {
-	s3c_g2d_params *params;
+	s3c_g2d_ctx *ctx;
+	s3c_g2d_job *job;
+	s3c_g2d_batch batch;
 	ROT_DEG rot_degree;
+	u32 fence;
+	int i, ret;
 
-	params	= (s3c_g2d_params*)file->private_data;
-	if (copy_from_user(params, (s3c_g2d_params*)arg, sizeof(s3c_g2d_params)))
-		return -EFAULT;
+	ctx = (s3c_g2d_ctx*)file->private_data;
 
-	mutex_lock(h_rot_mutex);
-	
 	switch(cmd) {
+	case S3C_G2D_SUBMIT:
+		if (copy_from_user(&batch, (s3c_g2d_batch*)arg, sizeof(s3c_g2d_batch)))
+			return -EFAULT;
+
+		if (batch.num_ops == 0 || batch.num_ops > G2D_MAX_BATCH_OPS)
+			return -EINVAL;
+
+		ret = s3c_g2d_wait_room(ctx, file->f_flags & O_NONBLOCK);
+		if (ret)
+			return ret;
+
+		job = kmalloc(sizeof(s3c_g2d_job) + batch.num_ops * sizeof(s3c_g2d_op), GFP_KERNEL);
+		if (job == NULL)
+			return -ENOMEM;
+
+		if (copy_from_user(job->ops, batch.ops, batch.num_ops * sizeof(s3c_g2d_op))) {
+			kfree(job);
+			return -EFAULT;
+		}
+
+		for (i = 0; i < batch.num_ops; i++) {
+			ret = s3c_g2d_check_op(&job->ops[i]);
+			if (ret) {
+				kfree(job);
+				return ret;
+			}
+		}
+
+		job->num_ops = batch.num_ops;
+		batch.fence = s3c_g2d_queue_job(ctx, job);
+
+		if (put_user(batch.fence, &((s3c_g2d_batch*)arg)->fence))
+			return -EFAULT;
+
+		return 0;
+
+	case S3C_G2D_WAIT_FENCE:
+		if (get_user(fence, (u32*)arg))
+			return -EFAULT;
+
+		return s3c_g2d_wait_fence(ctx, fence);
+
 	case S3C_G2D_ROTATOR_0:
 		rot_degree = ROT_0;
-		s3c_g2d_rotator_start(params, rot_degree);
 		break;
 		
 	case S3C_G2D_ROTATOR_90:
 		rot_degree = ROT_90;
-		s3c_g2d_rotator_start(params, rot_degree);
 		break;
 
 	case S3C_G2D_ROTATOR_180:
 		rot_degree = ROT_180;
-		s3c_g2d_rotator_start(params, rot_degree);
 		break;
 		
 	case S3C_G2D_ROTATOR_270:
 		rot_degree = ROT_270;
-		s3c_g2d_rotator_start(params, rot_degree);
 		break;
 
 	case S3C_G2D_ROTATOR_X_FLIP:
 		rot_degree = ROT_X_FLIP;
-		s3c_g2d_rotator_start(params, rot_degree);
 		break;
 
 	case S3C_G2D_ROTATOR_Y_FLIP:
 		rot_degree = ROT_Y_FLIP;
-		s3c_g2d_rotator_start(params, rot_degree);
 		break;
 	
 	default:
-		mutex_unlock(h_rot_mutex);
 		return -EINVAL;
 	}
-	
-	if(!(file->f_flags & O_NONBLOCK)) {
-		if (interruptible_sleep_on_timeout(&waitq_g2d, G2D_TIMEOUT) == 0) {
-			printk(KERN_ERR "\n%s: Waiting for interrupt is timeout\n", __FUNCTION__);
-		}
+
+	ret = s3c_g2d_wait_room(ctx, file->f_flags & O_NONBLOCK);
+	if (ret)
+		return ret;
+
+	job = kmalloc(sizeof(s3c_g2d_job) + sizeof(s3c_g2d_op), GFP_KERNEL);
+	if (job == NULL)
+		return -ENOMEM;
+
+	if (copy_from_user(&job->ops[0].params, (s3c_g2d_params*)arg, sizeof(s3c_g2d_params))) {
+		kfree(job);
+		return -EFAULT;
+	}
+
+	job->ops[0].op = G2D_OP_BLIT;
+	job->ops[0].rot_degree = rot_degree;
+	job->num_ops = 1;
+
+	ret = s3c_g2d_check_op(&job->ops[0]);
+	if (ret) {
+		kfree(job);
+		return ret;
 	}
 
-	mutex_unlock(h_rot_mutex);
+	fence = s3c_g2d_queue_job(ctx, job);
+
+	if(!(file->f_flags & O_NONBLOCK))
+		s3c_g2d_wait_fence(ctx, fence);
 
 	return 0;
 	
 }
 
 
+/* writable when everything this file submitted has finished */
 static unsigned int s3c_g2d_poll(struct file *file, poll_table *wait)
 {
+	s3c_g2d_ctx *ctx = (s3c_g2d_ctx *)file->private_data;
 	unsigned int mask = 0;
 
 	poll_wait(file, &waitq_g2d, wait);
-	if(s3c_g2d_poll_flag == 1) {
+	if (s3c_g2d_fence_done(ctx, ctx->submitted))
 		mask = POLLOUT|POLLWRNORM;
-		s3c_g2d_poll_flag = 0;
-	}
 
 	return mask;
 }
@@ -528,11 +1036,7 @@ int s3c_g2d_probe(struct platform_device *pdev)
 		return ret;
 	}
 
-	h_rot_mutex = (struct mutex *)kmalloc(sizeof(struct mutex), GFP_KERNEL);
-	if (h_rot_mutex == NULL)
-		return -1;
-	
-	mutex_init(h_rot_mutex);
+	s3c_g2d_ready = 1;
 
 	printk(KERN_ALERT" s3c_g2d_probe Success\n");
 
@@ -544,7 +1048,11 @@ static int s3c_g2d_remove(struct platform_device *dev)
 {
 	printk(KERN_INFO "s3c_g2d_remove called !\n");
 
+	s3c_g2d_kernel_sync();
+	s3c_g2d_ready = 0;
+
 	free_irq(s3c_g2d_irq_num, NULL);
+	del_timer_sync(&s3c_g2d_op_timer);
 	
 	if (s3c_g2d_mem != NULL) { 
 		printk(KERN_INFO "S3C Rotator Driver, releasing resource\n");
@@ -561,6 +1069,10 @@ static int s3c_g2d_remove(struct platform_device *dev)
 
 static int s3c_g2d_suspend(struct platform_device *dev, pm_message_t state)
 {
+	/* let the queue drain first */
+	wait_event_timeout(waitq_g2d, list_empty(&s3c_g2d_jobs), G2D_TIMEOUT);
+
+	s3c_g2d_ready = 0;
 	clk_disable(s3c_g2d_clock);
 	return 0;
 }
@@ -569,6 +1081,7 @@ static int s3c_g2d_suspend(struct platform_device *dev, pm_message_t state)
 static int s3c_g2d_resume(struct platform_device *pdev)
 {
 	clk_enable(s3c_g2d_clock);
+	s3c_g2d_ready = 1;
 	return 0;
 }
 
@@ -600,7 +1113,6 @@ int __init s3c_g2d_init(void)
 void s3c_g2d_exit(void)
 {
 	platform_driver_unregister(&s3c_g2d_driver);
-	mutex_destroy(h_rot_mutex);
 }
 
 module_init(s3c_g2d_init);
@@ -28,10 +28,15 @@
 #define S3C_G2D_ROTATOR_270			_IO(G2D_IOCTL_MAGIC,3)
 #define S3C_G2D_ROTATOR_X_FLIP			_IO(G2D_IOCTL_MAGIC,4)
 #define S3C_G2D_ROTATOR_Y_FLIP			_IO(G2D_IOCTL_MAGIC,5)
+#define S3C_G2D_SUBMIT				_IOWR(G2D_IOCTL_MAGIC,6,s3c_g2d_batch)
+#define S3C_G2D_WAIT_FENCE			_IOW(G2D_IOCTL_MAGIC,7,u32)
 
 #define FIFO_NUM				32
 
 #define G2D_TIMEOUT				100
+#define G2D_MAX_BATCH_OPS			64
+#define G2D_MAX_PENDING_JOBS			16	// per open file
+#define G2D_SYNC_TIMEOUT_US			100000
 #define ALPHA_VALUE_MAX				255
 
 #define G2D_MAX_WIDTH				(2048)
@@ -124,6 +129,49 @@ typedef struct
 	
 }s3c_g2d_params;
 
+typedef enum
+{
+	G2D_OP_BLIT,		/* bitblt, rotated by rot_degree */
+	G2D_OP_FILL		/* fill the destination rectangle with fill_color */
+} G2D_OP_TYPE;
+
+/* one operation of an S3C_G2D_SUBMIT batch, alpha and color key as in params */
+typedef struct
+{
+	u32	op;				//G2D_OP_TYPE
+	u32	rot_degree;			//ROT_DEG, for G2D_OP_BLIT
+	u32	fill_color;			//for G2D_OP_FILL
+	s3c_g2d_params params;
+}s3c_g2d_op;
+
+typedef struct
+{
+	s3c_g2d_op *ops;			//user array of num_ops operations
+	u32	num_ops;			//up to G2D_MAX_BATCH_OPS
+	u32	fence;				//returned, for S3C_G2D_WAIT_FENCE
+}s3c_g2d_batch;
+
+#ifdef __KERNEL__
+/* per open file */
+typedef struct
+{
+	u32	submitted;			//fence of the last batch queued
+	u32	completed;			//fence of the last batch finished
+	u32	failed;				//fence of the last batch that timed out
+}s3c_g2d_ctx;
+
+/* a batch waiting in or running from the queue */
+typedef struct
+{
+	struct list_head list;
+	s3c_g2d_ctx *ctx;			//NULL once the file is gone
+	u32	fence;
+	int	num_ops;
+	int	cur_op;
+	s3c_g2d_op ops[0];
+}s3c_g2d_job;
+#endif
+
 /**** function declearation***************************/
 static int s3c_g2d_init_regs(s3c_g2d_params *params);
 void s3c_g2d_bitblt(u16 src_x1, u16 src_y1, u16 src_x2, u16 src_y2,
@@ -135,7 +183,8 @@ static void s3c_g2d_get_rotation_origin(u16 src_x1, u16 src_y1,
 					ROT_DEG rot_degree, 
 					u16* org_x, u16* org_y);
 void s3c_g2d_set_xy_incr_format(u32 uDividend, u32 uDivisor, u32* uResult);
-static void s3c_g2d_rotator_start(s3c_g2d_params *params,ROT_DEG rot_degree);
+static void s3c_g2d_fill(s3c_g2d_params *params, u32 color);
+static void s3c_g2d_start_op(s3c_g2d_op *op);
 void s3c_g2d_check_fifo(int empty_fifo);
 int s3c_g2d_open(struct inode *inode, struct file *file);
 int s3c_g2d_release(struct inode *inode, struct file *file);
@@ -144,4 +193,11 @@ static int s3c_g2d_ioctl(struct inode *inode, struct file *file,
 				unsigned int cmd, unsigned long arg);
 static unsigned int s3c_g2d_poll(struct file *file, poll_table *wait); 
 
+/* for in-kernel users, safe in atomic context */
+int s3c_g2d_kernel_fill(u32 base, int bpp, u32 full_width, u32 full_height,
+			u32 x, u32 y, u32 width, u32 height, u32 color);
+int s3c_g2d_kernel_copy(u32 base, int bpp, u32 full_width, u32 full_height,
+			u32 sx, u32 sy, u32 dx, u32 dy, u32 width, u32 height);
+int s3c_g2d_kernel_sync(void);
+
 #endif /*_S3C_G2D_DRIVER_H_*/
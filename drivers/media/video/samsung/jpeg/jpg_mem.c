@@ -79,6 +79,9 @@ void jpg_mem_free(s3c6400_jpg_ctx *base)
 -----------------------------------------------------------------------------*/
 BOOL jpg_buff_mapping(s3c6400_jpg_ctx *base)
 {    	
+	if (jpg_data_base_addr == 0)
+		return FALSE;
+
     	// JPG Data Buffer
 	base->v_pJPGData_Buff = (UINT8 *)phy_to_vir_addr(jpg_data_base_addr, JPG_TOTAL_BUF_SIZE);
 
@@ -34,11 +34,14 @@ enum{
 				input_size:
 				output_buff:
 				output_size
+				stride: NULL to have the image packed to its width, otherwise
+						the image is left at the MCU aligned width the JPEG
+						block writes and this returns the bytes per line
 *Return Value:
 *Implementation Notes: 
 -----------------------------------------------------------------------------*/
 JPG_RETURN_STATUS decode_jpg(s3c6400_jpg_ctx *jCTX,
-							JPG_DEC_PROC_PARAM *decParam)
+							JPG_DEC_PROC_PARAM *decParam, UINT32 *stride)
 {
 	volatile int		ret;
 	SAMPLE_MODE_T sampleMode;
@@ -117,10 +120,17 @@ JPG_RETURN_STATUS decode_jpg(s3c6400_jpg_ctx *jCTX,
 			orgwidth = (orgwidth/4)*4;
 
 		log_msg(LOG_TRACE, "decode_jpg", "orgwidth : %d orgheight : %d\n", orgwidth, orgheight);
-		rewrite_yuv(jCTX, width, orgwidth, height, orgheight);
 
 		// JPEG H/W IP always return YUV422
-		decParam->dataSize = getYUVSize(JPG_422, orgwidth, orgheight);
+		if(stride != NULL){
+			// lines stay MCU aligned, the caller crops
+			*stride = 2*width;
+			decParam->dataSize = getYUVSize(JPG_422, width, orgheight);
+		}
+		else{
+			rewrite_yuv(jCTX, width, orgwidth, height, orgheight);
+			decParam->dataSize = getYUVSize(JPG_422, orgwidth, orgheight);
+		}
 		decParam->width = orgwidth;
 		decParam->height = orgheight;
 	}
@@ -138,6 +148,8 @@ JPG_RETURN_STATUS decode_jpg(s3c6400_jpg_ctx *jCTX,
 		decParam->dataSize = getYUVSize(JPG_422, width, height);
 		decParam->width = width;
 		decParam->height = height;
+		if(stride != NULL)
+			*stride = 2*width;
 	}
 	
 	return JPG_SUCCESS;	
@@ -379,44 +391,35 @@ UINT32 getYUVSize(SAMPLE_MODE_T sampleMode, UINT32 width, UINT32 height)
 }
 
 /*----------------------------------------------------------------------------
-*Function: reset_jpg
+*Function: set_enc_param
 
 *Parameters:	jCTX:
+				sampleMode:
+				quality:
+				width:
+				height:
+				frmAddr: physical address of the input image
+				strAddr: physical address of the JPEG stream
 *Return Value:
-*Implementation Notes: 
+*Implementation Notes: programs an encoding, writing JPGStart starts it.
+					   It is also called from the interrupt handler.
 -----------------------------------------------------------------------------*/
-JPG_RETURN_STATUS encode_jpg(s3c6400_jpg_ctx *jCTX, 
-							JPG_ENC_PROC_PARAM	*EncParam)
+void set_enc_param(s3c6400_jpg_ctx *jCTX, SAMPLE_MODE_T sampleMode, IMAGE_QUALITY_TYPE_T quality,
+					UINT32 width, UINT32 height, UINT32 frmAddr, UINT32 strAddr)
 {
-	UINT	i, ret;
-
-	if(EncParam->width <= 0 || EncParam->width > MAX_JPG_WIDTH
-		|| EncParam->height <=0 || EncParam->height > MAX_JPG_HEIGHT){
-			log_msg(LOG_ERROR, "encode_jpg", "DD::Encoder : Invalid width/height\r\n");
-			return JPG_FAIL;
-	}
-
-	reset_jpg(jCTX);
+	UINT	i;
 
-	jCTX->v_pJPG_REG->JPGMod = (EncParam->sampleMode == JPG_422) ? (0x1<<0) : (0x2<<0);
+	jCTX->v_pJPG_REG->JPGMod = (sampleMode == JPG_422) ? (0x1<<0) : (0x2<<0);
 	jCTX->v_pJPG_REG->JPGRSTPos = 2; // MCU inserts RST marker
 	jCTX->v_pJPG_REG->JPGQTblNo = (1<<12) | (1<<14);
-	jCTX->v_pJPG_REG->JPGX = EncParam->width;
-	jCTX->v_pJPG_REG->JPGY = EncParam->height;
+	jCTX->v_pJPG_REG->JPGX = width;
+	jCTX->v_pJPG_REG->JPGY = height;
+
+	jCTX->v_pJPG_REG->JPGYUVAddr0 = frmAddr; // Address of input image
+	jCTX->v_pJPG_REG->JPGYUVAddr1 = frmAddr; // Address of input image
+	jCTX->v_pJPG_REG->JPGFileAddr0 = strAddr; // Address of JPEG stream
+	jCTX->v_pJPG_REG->JPGFileAddr1 = strAddr; // next address of motion JPEG stream
 
-	log_msg(LOG_TRACE, "encode_jpg", "EncParam->encType : %d\n", EncParam->encType);
-	if(EncParam->encType == JPG_MAIN){
-		jCTX->v_pJPG_REG->JPGYUVAddr0 = jpg_data_base_addr + JPG_STREAM_BUF_SIZE + JPG_STREAM_THUMB_BUF_SIZE; // Address of input image
-		jCTX->v_pJPG_REG->JPGYUVAddr1 = jpg_data_base_addr + JPG_STREAM_BUF_SIZE + JPG_STREAM_THUMB_BUF_SIZE; // Address of input image
-		jCTX->v_pJPG_REG->JPGFileAddr0 = jpg_data_base_addr; // Address of JPEG stream
-		jCTX->v_pJPG_REG->JPGFileAddr1 = jpg_data_base_addr; // next address of motion JPEG stream
-	}
-	else{ // thumbnail encoding
-		jCTX->v_pJPG_REG->JPGYUVAddr0 = jpg_data_base_addr + JPG_STREAM_BUF_SIZE + JPG_STREAM_THUMB_BUF_SIZE + JPG_FRAME_BUF_SIZE; // Address of input image
-		jCTX->v_pJPG_REG->JPGYUVAddr1 = jpg_data_base_addr + JPG_STREAM_BUF_SIZE + JPG_STREAM_THUMB_BUF_SIZE + JPG_FRAME_BUF_SIZE; // Address of input image
-		jCTX->v_pJPG_REG->JPGFileAddr0 = jpg_data_base_addr + JPG_STREAM_BUF_SIZE; // Address of JPEG stream
-		jCTX->v_pJPG_REG->JPGFileAddr1 = jpg_data_base_addr + JPG_STREAM_BUF_SIZE; // next address of motion JPEG stream
-	}
 	jCTX->v_pJPG_REG->JPGCOEF1 = COEF1_RGB_2_YUV; // Coefficient value 1 for RGB to YCbCr
 	jCTX->v_pJPG_REG->JPGCOEF2 = COEF2_RGB_2_YUV; // Coefficient value 2 for RGB to YCbCr
 	jCTX->v_pJPG_REG->JPGCOEF3 = COEF3_RGB_2_YUV; // Coefficient value 3 for RGB to YCbCr
@@ -427,10 +430,10 @@ JPG_RETURN_STATUS encode_jpg(s3c6400_jpg_ctx *jCTX,
 
 	// Quantiazation and Huffman Table setting
 	for (i=0; i<64; i++)
-		jCTX->v_pJPG_REG->JQTBL0[i] = (UINT32)QTBL_Luminance[EncParam->quality][i];
+		jCTX->v_pJPG_REG->JQTBL0[i] = (UINT32)QTBL_Luminance[quality][i];
 
 	for (i=0; i<64; i++)
-		jCTX->v_pJPG_REG->JQTBL1[i] = (UINT32)QTBL_Chrominance[EncParam->quality][i];
+		jCTX->v_pJPG_REG->JQTBL1[i] = (UINT32)QTBL_Chrominance[quality][i];
 
 	for (i=0; i<16; i++)
 		jCTX->v_pJPG_REG->JHDCTBL0[i] = (UINT32)HDCTBL0[i];
@@ -443,6 +446,42 @@ JPG_RETURN_STATUS encode_jpg(s3c6400_jpg_ctx *jCTX,
 
 	for (i=0; i<162; i++)
 		jCTX->v_pJPG_REG->JHACTBLG0[i] = (UINT32)HACTBLG0[i];
+}
+
+/*----------------------------------------------------------------------------
+*Function: encode_jpg
+
+*Parameters:	jCTX:
+				EncParam:
+*Return Value:
+*Implementation Notes: 
+-----------------------------------------------------------------------------*/
+JPG_RETURN_STATUS encode_jpg(s3c6400_jpg_ctx *jCTX, 
+							JPG_ENC_PROC_PARAM	*EncParam)
+{
+	UINT	ret;
+	UINT32	frmAddr, strAddr;
+
+	if(EncParam->width <= 0 || EncParam->width > MAX_JPG_WIDTH
+		|| EncParam->height <=0 || EncParam->height > MAX_JPG_HEIGHT){
+			log_msg(LOG_ERROR, "encode_jpg", "DD::Encoder : Invalid width/height\r\n");
+			return JPG_FAIL;
+	}
+
+	reset_jpg(jCTX);
+
+	log_msg(LOG_TRACE, "encode_jpg", "EncParam->encType : %d\n", EncParam->encType);
+	if(EncParam->encType == JPG_MAIN){
+		frmAddr = jpg_data_base_addr + JPG_STREAM_BUF_SIZE + JPG_STREAM_THUMB_BUF_SIZE;
+		strAddr = jpg_data_base_addr;
+	}
+	else{ // thumbnail encoding
+		frmAddr = jpg_data_base_addr + JPG_STREAM_BUF_SIZE + JPG_STREAM_THUMB_BUF_SIZE + JPG_FRAME_BUF_SIZE;
+		strAddr = jpg_data_base_addr + JPG_STREAM_BUF_SIZE;
+	}
+
+	set_enc_param(jCTX, EncParam->sampleMode, EncParam->quality, 
+					EncParam->width, EncParam->height, frmAddr, strAddr);
 
 	jCTX->v_pJPG_REG->JPGStart = 0;
 
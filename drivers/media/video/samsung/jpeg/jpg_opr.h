@@ -60,6 +60,12 @@ typedef struct tagJPG_DEC_PROC_PARAM{
 	UINT32	fileSize;
 } JPG_DEC_PROC_PARAM;
 
+/* decoding without packing the image to its width, see IOCTL_JPG_DECODE_STRIDE */
+typedef struct tagJPG_DEC_STRIDE_PARAM{
+	JPG_DEC_PROC_PARAM	dec;
+	UINT32	stride;			/* out: bytes per line of the YCbYCr image */
+} JPG_DEC_STRIDE_PARAM;
+
 typedef struct tagJPG_ENC_PROC_PARAM{
 	SAMPLE_MODE_T	sampleMode;
 	ENCDEC_TYPE_T	encType;
@@ -70,7 +76,22 @@ typedef struct tagJPG_ENC_PROC_PARAM{
 	UINT32	fileSize;
 } JPG_ENC_PROC_PARAM;
 
-JPG_RETURN_STATUS decode_jpg(s3c6400_jpg_ctx *jCTX, JPG_DEC_PROC_PARAM *decParam);
+/* queued encoding, see jpg_queue.c */
+typedef struct tagJPG_ENC_JOB_PARAM{
+	SAMPLE_MODE_T	sampleMode;		/* JPG_422 or JPG_420, the input image is YCbYCr */
+	IMAGE_QUALITY_TYPE_T quality;
+	UINT32	width;
+	UINT32	height;
+	int		frmHandle;		/* shared buffer object of the input image, 0 if none */
+	UINT32	frmOffset;		/* offset of the input image in frmHandle */
+	UINT32	frmAddr;		/* physical address of the input image if frmHandle is 0,
+					   it must lie in the media memory of a device */
+	UINT32	strIndex;		/* stream buffer of the ring the image is encoded into */
+	UINT32	strOffset;		/* out: offset of the stream buffer in the ring mapping */
+	UINT32	fileSize;		/* out: 0 if the encoding failed */
+} JPG_ENC_JOB_PARAM;
+
+JPG_RETURN_STATUS decode_jpg(s3c6400_jpg_ctx *jCTX, JPG_DEC_PROC_PARAM *decParam, UINT32 *stride);
 void reset_jpg(s3c6400_jpg_ctx *jCTX);
 void decode_header(s3c6400_jpg_ctx *jCTX);
 void decode_body(s3c6400_jpg_ctx *jCTX);
@@ -81,5 +102,7 @@ BOOL is_correct_header(SAMPLE_MODE_T sampleMode, UINT32 *width, UINT32 *height);
 void rewrite_header(s3c6400_jpg_ctx *jCTX, UINT32 file_size, UINT32 width, UINT32 height);
 void rewrite_yuv(s3c6400_jpg_ctx *jCTX, UINT32 width, UINT32 orgwidth, UINT32 height, UINT32 orgheight);
 JPG_RETURN_STATUS encode_jpg(s3c6400_jpg_ctx *jCTX, JPG_ENC_PROC_PARAM	*EncParam);
+void set_enc_param(s3c6400_jpg_ctx *jCTX, SAMPLE_MODE_T sampleMode, IMAGE_QUALITY_TYPE_T quality,
+					UINT32 width, UINT32 height, UINT32 frmAddr, UINT32 strAddr);
 
 #endif
@@ -0,0 +1,427 @@
+/* linux/drivers/media/video/samsung/jpeg/jpg_queue.c
+ *
+ * Driver file for Samsung JPEG Encoder/Decoder
+ * Queued encoding of captured frames: a frame is encoded straight from
+ * its physical address into a stream buffer of a ring, and the next
+ * queued frame is started from the interrupt handler.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/sched.h>
+#include <linux/timer.h>
+#include <linux/poll.h>
+
+#include "jpg_misc.h"
+#include "jpg_mem.h"
+#include "jpg_opr.h"
+#include "jpg_queue.h"
+#include "log_msg.h"
+
+/* as long as wait_for_interrupt() waits for a synchronous one */
+#define JPG_ENC_TIMEOUT		100	/* jiffies */
+
+typedef enum tagJPG_JOB_STATE_T{
+	JPG_JOB_FREE,
+	JPG_JOB_QUEUED,
+	JPG_JOB_RUNNING,
+	JPG_JOB_DONE
+}JPG_JOB_STATE_T;
+
+typedef struct tagJPG_ENC_JOB{
+	struct list_head	list;
+	JPG_JOB_STATE_T		state;
+	JPG_ENC_JOB_PARAM	param;
+	UINT32				frmAddr;
+	UINT32				strAddr;
+}JPG_ENC_JOB;
+
+static JPG_ENC_JOB		jpgEncJobs[JPG_ENC_NR_SLOTS];
+static LIST_HEAD(jpgEncQueue);
+static LIST_HEAD(jpgEncDone);
+static JPG_ENC_JOB		*jpgEncRunning = NULL;
+static int				jpgHwHeld = 0;
+
+static struct file		*jpgEncOwner = NULL;
+static s3c6400_jpg_ctx	*jpgEncCtx = NULL;
+static UINT32			jpgEncRingAddr = 0;
+
+static DEFINE_SPINLOCK(jpgEncLock);
+static DECLARE_WAIT_QUEUE_HEAD(jpgEncWait);
+
+static void jpg_enc_timeout(unsigned long data);
+static DEFINE_TIMER(jpgEncTimer, jpg_enc_timeout, 0, 0);
+
+/*----------------------------------------------------------------------------
+*Function: jpg_enc_run_next
+
+*Parameters:
+*Return Value:
+*Implementation Notes: starts the first queued encoding,
+					   called with jpgEncLock held
+-----------------------------------------------------------------------------*/
+static void jpg_enc_run_next(void)
+{
+	JPG_ENC_JOB	*job;
+
+	if (jpgEncRunning || jpgHwHeld || list_empty(&jpgEncQueue))
+		return;
+
+	job = list_first_entry(&jpgEncQueue, JPG_ENC_JOB, list);
+	list_del_init(&job->list);
+
+	job->state = JPG_JOB_RUNNING;
+	jpgEncRunning = job;
+
+	reset_jpg(jpgEncCtx);
+	set_enc_param(jpgEncCtx, job->param.sampleMode, job->param.quality,
+					job->param.width, job->param.height, job->frmAddr, job->strAddr);
+	jpgEncCtx->v_pJPG_REG->JPGStart = 0;
+
+	mod_timer(&jpgEncTimer, jiffies + JPG_ENC_TIMEOUT);
+}
+
+/*----------------------------------------------------------------------------
+*Function: jpg_enc_complete
+
+*Parameters:	fileSize: 0 if the encoding failed
+*Return Value:
+*Implementation Notes: called with jpgEncLock held
+-----------------------------------------------------------------------------*/
+static void jpg_enc_complete(UINT32 fileSize)
+{
+	JPG_ENC_JOB	*job = jpgEncRunning;
+
+	job->param.fileSize = fileSize;
+	job->state = JPG_JOB_DONE;
+	list_add_tail(&job->list, &jpgEncDone);
+	jpgEncRunning = NULL;
+
+	wake_up(&jpgEncWait);
+}
+
+/*----------------------------------------------------------------------------
+*Function: jpg_queue_irq
+
+*Parameters:	reason: OK_ENC_OR_DEC, ERR_ENC_OR_DEC, ...
+*Return Value:	1 if the interrupt completed a queued encoding
+*Implementation Notes: called from the interrupt handler
+-----------------------------------------------------------------------------*/
+int jpg_queue_irq(int reason)
+{
+	UINT32	fileSize = 0;
+
+	spin_lock(&jpgEncLock);
+
+	if (jpgEncRunning == NULL) {
+		spin_unlock(&jpgEncLock);
+		return 0;
+	}
+
+	del_timer(&jpgEncTimer);
+
+	if (reason == OK_ENC_OR_DEC) {
+		fileSize = jpgEncCtx->v_pJPG_REG->JPGDataSize;
+		if (fileSize > JPG_ENC_SLOT_SIZE) {
+			log_msg(LOG_ERROR, "jpg_queue_irq", "DD::stream of %d bytes overran its buffer\n", fileSize);
+			fileSize = 0;
+		}
+	}
+	else
+		log_msg(LOG_ERROR, "jpg_queue_irq", "DD::JPG Encoding Error(%d)\n", reason);
+
+	jpg_enc_complete(fileSize);
+	jpg_enc_run_next();
+
+	spin_unlock(&jpgEncLock);
+
+	return 1;
+}
+
+static void jpg_enc_timeout(unsigned long data)
+{
+	unsigned long	flags;
+
+	spin_lock_irqsave(&jpgEncLock, flags);
+
+	if (jpgEncRunning) {
+		log_msg(LOG_ERROR, "jpg_enc_timeout", "DD::JPG Encoding timed out\n");
+		reset_jpg(jpgEncCtx);
+		jpg_enc_complete(0);
+		jpg_enc_run_next();
+	}
+
+	spin_unlock_irqrestore(&jpgEncLock, flags);
+}
+
+/*----------------------------------------------------------------------------
+*Function: jpg_hold_hw
+
+*Parameters:
+*Return Value:
+*Implementation Notes: takes the JPEG block for a synchronous decoding or
+					   encoding: waits for the running encoding and keeps
+					   the queued ones from starting. Called with the jpg
+					   mutex held.
+-----------------------------------------------------------------------------*/
+void jpg_hold_hw(void)
+{
+	unsigned long	flags;
+
+	spin_lock_irqsave(&jpgEncLock, flags);
+	jpgHwHeld++;
+	spin_unlock_irqrestore(&jpgEncLock, flags);
+
+	wait_event(jpgEncWait, jpgEncRunning == NULL);
+}
+
+void jpg_release_hw(void)
+{
+	unsigned long	flags;
+
+	spin_lock_irqsave(&jpgEncLock, flags);
+	if (--jpgHwHeld == 0)
+		jpg_enc_run_next();
+	spin_unlock_irqrestore(&jpgEncLock, flags);
+}
+
+/*----------------------------------------------------------------------------
+*Function: jpg_enc_ring_alloc
+
+*Parameters:	file: the opened device that queues the encodings
+				jCTX:
+*Return Value:	0 or -errno
+*Implementation Notes: one opened device at a time owns the ring.
+					   Called with the jpg mutex held.
+-----------------------------------------------------------------------------*/
+int jpg_enc_ring_alloc(struct file *file, s3c6400_jpg_ctx *jCTX)
+{
+	int		i;
+
+	if (jpgEncOwner == file)
+		return 0;
+
+	if (jpgEncOwner != NULL) {
+		log_msg(LOG_ERROR, "jpg_enc_ring_alloc", "DD::the encoding queue is in use\n");
+		return -EBUSY;
+	}
+
+	jpgEncRingAddr = s3c_alloc_media_memory(S3C_MDEV_JPEG, JPG_ENC_RING_SIZE);
+	if (jpgEncRingAddr == 0) {
+		log_msg(LOG_ERROR, "jpg_enc_ring_alloc", "DD::no memory for the stream buffers\n");
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < JPG_ENC_NR_SLOTS; i++) {
+		INIT_LIST_HEAD(&jpgEncJobs[i].list);
+		jpgEncJobs[i].state = JPG_JOB_FREE;
+		jpgEncJobs[i].strAddr = jpgEncRingAddr + i * JPG_ENC_SLOT_SIZE;
+	}
+
+	jpgEncCtx = jCTX;
+	jpgEncOwner = file;
+
+	return 0;
+}
+
+/*----------------------------------------------------------------------------
+*Function: jpg_enc_ring_free
+
+*Parameters:	file:
+*Return Value:
+*Implementation Notes: drops the queued encodings, waits for the running
+					   one and frees the ring. Called with the jpg mutex
+					   held when file is released.
+-----------------------------------------------------------------------------*/
+void jpg_enc_ring_free(struct file *file)
+{
+	JPG_ENC_JOB		*job, *tmp;
+	unsigned long	flags;
+	int				i;
+
+	if (jpgEncOwner != file)
+		return;
+
+	spin_lock_irqsave(&jpgEncLock, flags);
+	list_for_each_entry_safe(job, tmp, &jpgEncQueue, list) {
+		list_del_init(&job->list);
+		job->state = JPG_JOB_DONE;
+	}
+	spin_unlock_irqrestore(&jpgEncLock, flags);
+
+	wait_event(jpgEncWait, jpgEncRunning == NULL);
+
+	INIT_LIST_HEAD(&jpgEncDone);
+
+	for (i = 0; i < JPG_ENC_NR_SLOTS; i++) {
+		job = &jpgEncJobs[i];
+		if (job->state != JPG_JOB_FREE && job->param.frmHandle)
+			s3c_mem_bo_put(job->param.frmHandle);
+		INIT_LIST_HEAD(&job->list);
+		job->state = JPG_JOB_FREE;
+	}
+
+	s3c_free_media_memory(S3C_MDEV_JPEG, jpgEncRingAddr);
+	jpgEncRingAddr = 0;
+	jpgEncOwner = NULL;
+}
+
+/*----------------------------------------------------------------------------
+*Function: jpg_enc_ring_addr
+
+*Parameters:	file:
+*Return Value:	physical address of the ring, 0 if file does not own it
+*Implementation Notes:
+-----------------------------------------------------------------------------*/
+UINT32 jpg_enc_ring_addr(struct file *file)
+{
+	return (jpgEncOwner == file) ? jpgEncRingAddr : 0;
+}
+
+/*----------------------------------------------------------------------------
+*Function: jpg_enc_queue
+
+*Parameters:	file:
+				param: the image to encode and its stream buffer
+*Return Value:	0 or -errno
+*Implementation Notes: the input image is read by the JPEG block as it is,
+					   it is neither copied nor cache maintained.
+					   Called with the jpg mutex held.
+-----------------------------------------------------------------------------*/
+int jpg_enc_queue(struct file *file, JPG_ENC_JOB_PARAM *param)
+{
+	JPG_ENC_JOB		*job;
+	dma_addr_t		frmAddr;
+	size_t			frmSize;
+	unsigned long	flags;
+	int				ret;
+
+	if (jpgEncOwner != file)
+		return -EINVAL;
+
+	if (param->strIndex >= JPG_ENC_NR_SLOTS)
+		return -EINVAL;
+
+	if (param->width <= 0 || param->width > MAX_JPG_WIDTH
+		|| param->height <= 0 || param->height > MAX_JPG_HEIGHT
+		|| param->width * param->height * 2 > JPG_ENC_SLOT_SIZE) {
+		log_msg(LOG_ERROR, "jpg_enc_queue", "DD::Encoder : Invalid width/height\r\n");
+		return -EINVAL;
+	}
+
+	if ((param->sampleMode != JPG_422 && param->sampleMode != JPG_420)
+		|| param->quality > JPG_QUALITY_LEVEL_4)
+		return -EINVAL;
+
+	job = &jpgEncJobs[param->strIndex];
+	if (job->state != JPG_JOB_FREE)
+		return -EBUSY;
+
+	/* YCbYCr */
+	frmSize = param->width * param->height * 2;
+
+	if (param->frmHandle) {
+		ret = s3c_mem_bo_get(param->frmHandle, param->frmOffset, frmSize, &frmAddr);
+		if (ret < 0) {
+			log_msg(LOG_ERROR, "jpg_enc_queue", "DD::invalid buffer object %d\n", param->frmHandle);
+			return ret;
+		}
+	}
+	else if (param->frmAddr && s3c_is_media_memory(param->frmAddr, frmSize))
+		frmAddr = param->frmAddr;
+	else {
+		/* the JPEG block would copy any other memory into a mappable stream */
+		log_msg(LOG_ERROR, "jpg_enc_queue", "DD::invalid input address 0x%08x\n", param->frmAddr);
+		return -EINVAL;
+	}
+
+	param->strOffset = param->strIndex * JPG_ENC_SLOT_SIZE;
+	param->fileSize = 0;
+
+	job->param = *param;
+	job->frmAddr = frmAddr;
+
+	spin_lock_irqsave(&jpgEncLock, flags);
+	job->state = JPG_JOB_QUEUED;
+	list_add_tail(&job->list, &jpgEncQueue);
+	jpg_enc_run_next();
+	spin_unlock_irqrestore(&jpgEncLock, flags);
+
+	return 0;
+}
+
+/*----------------------------------------------------------------------------
+*Function: jpg_enc_dequeue
+
+*Parameters:	file:
+				param: out, the oldest completed encoding
+				nonblock:
+*Return Value:	0 or -errno
+*Implementation Notes: the stream buffer belongs to userspace until it is
+					   queued again. Called without the jpg mutex.
+-----------------------------------------------------------------------------*/
+int jpg_enc_dequeue(struct file *file, JPG_ENC_JOB_PARAM *param, int nonblock)
+{
+	JPG_ENC_JOB		*job;
+	unsigned long	flags;
+	int				ret;
+
+	if (jpgEncOwner != file)
+		return -EINVAL;
+
+	spin_lock_irqsave(&jpgEncLock, flags);
+
+	while (list_empty(&jpgEncDone)) {
+		if (list_empty(&jpgEncQueue) && jpgEncRunning == NULL) {
+			spin_unlock_irqrestore(&jpgEncLock, flags);
+			return -EINVAL;
+		}
+
+		spin_unlock_irqrestore(&jpgEncLock, flags);
+
+		if (nonblock)
+			return -EAGAIN;
+
+		ret = wait_event_interruptible(jpgEncWait, !list_empty(&jpgEncDone));
+		if (ret)
+			return ret;
+
+		spin_lock_irqsave(&jpgEncLock, flags);
+	}
+
+	job = list_first_entry(&jpgEncDone, JPG_ENC_JOB, list);
+	list_del_init(&job->list);
+	*param = job->param;
+	job->state = JPG_JOB_FREE;
+
+	spin_unlock_irqrestore(&jpgEncLock, flags);
+
+	if (param->frmHandle)
+		s3c_mem_bo_put(param->frmHandle);
+
+	return 0;
+}
+
+unsigned int jpg_enc_poll(struct file *file, poll_table *wait)
+{
+	unsigned long	flags;
+	unsigned int	mask = 0;
+
+	if (jpgEncOwner != file)
+		return POLLERR;
+
+	poll_wait(file, &jpgEncWait, wait);
+
+	spin_lock_irqsave(&jpgEncLock, flags);
+	if (!list_empty(&jpgEncDone))
+		mask |= POLLIN | POLLRDNORM;
+	spin_unlock_irqrestore(&jpgEncLock, flags);
+
+	return mask;
+}
@@ -0,0 +1,41 @@
+/* linux/drivers/media/video/samsung/jpeg/jpg_queue.h
+ *
+ * Driver header file for Samsung JPEG Encoder/Decoder
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef __JPG_QUEUE_H__
+#define __JPG_QUEUE_H__
+
+#include <linux/fs.h>
+#include <linux/poll.h>
+
+#include "jpg_mem.h"
+#include "jpg_opr.h"
+
+/*
+ * Queued encodings are written into a ring of stream buffers, which 
+ * userspace maps at JPG_ENC_RING_OFFSET. A stream buffer is as large 
+ * as the raw YCbYCr image it takes: the stream of a noisy image at the
+ * highest quality can be larger than one byte per pixel, but not larger
+ * than the image.
+ */
+#define JPG_ENC_NR_SLOTS		4
+#define JPG_ENC_SLOT_SIZE		(512 * 1024)
+#define JPG_ENC_RING_SIZE		(JPG_ENC_NR_SLOTS * JPG_ENC_SLOT_SIZE)
+#define JPG_ENC_RING_OFFSET		PAGE_ALIGN(JPG_TOTAL_BUF_SIZE)
+
+int jpg_enc_ring_alloc(struct file *file, s3c6400_jpg_ctx *jCTX);
+void jpg_enc_ring_free(struct file *file);
+UINT32 jpg_enc_ring_addr(struct file *file);
+int jpg_enc_queue(struct file *file, JPG_ENC_JOB_PARAM *param);
+int jpg_enc_dequeue(struct file *file, JPG_ENC_JOB_PARAM *param, int nonblock);
+unsigned int jpg_enc_poll(struct file *file, poll_table *wait);
+int jpg_queue_irq(int reason);
+void jpg_hold_hw(void);
+void jpg_release_hw(void);
+
+#endif
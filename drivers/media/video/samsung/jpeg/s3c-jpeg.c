@@ -48,6 +48,7 @@
 #include "jpg_mem.h"
 #include "jpg_misc.h"
 #include "jpg_opr.h"
+#include "jpg_queue.h"
 #include "log_msg.h"
 
 
@@ -67,6 +68,7 @@ irqreturn_t s3c_jpeg_irq(int irq, void *dev_id, struct pt_regs *regs)
 {
 	unsigned int	intReason;
 	unsigned int	status;
+	int				reason;
 
 	status = JPGMem.v_pJPG_REG->JPGStatus;
 	intReason = JPGMem.v_pJPG_REG->JPGIRQStatus;
@@ -76,27 +78,32 @@ irqreturn_t s3c_jpeg_irq(int irq, void *dev_id, struct pt_regs *regs)
 
 		switch(intReason) {
 			case 0x08 : 
-				jpg_irq_reason = OK_HD_PARSING; 
+				reason = OK_HD_PARSING; 
 				break;
 			case 0x00 : 
-				jpg_irq_reason = ERR_HD_PARSING; 
+				reason = ERR_HD_PARSING; 
 				break;
 			case 0x40 : 
-				jpg_irq_reason = OK_ENC_OR_DEC; 
+				reason = OK_ENC_OR_DEC; 
 				break;
 			case 0x10 : 
-				jpg_irq_reason = ERR_ENC_OR_DEC; 
+				reason = ERR_ENC_OR_DEC; 
 				break;
 			default : 
-				jpg_irq_reason = ERR_UNKNOWN;
+				reason = ERR_UNKNOWN;
 		}
-		wake_up_interruptible(&WaitQueue_JPEG);
 	}	
 	else {
-		jpg_irq_reason = ERR_UNKNOWN;
-		wake_up_interruptible(&WaitQueue_JPEG);
+		reason = ERR_UNKNOWN;
 	}
 
+	// a queued encoding completed, the next one is already started
+	if (jpg_queue_irq(reason))
+		return IRQ_HANDLED;
+
+	jpg_irq_reason = reason;
+	wake_up_interruptible(&WaitQueue_JPEG);
+
 	return IRQ_HANDLED;
 }
 
@@ -120,15 +127,25 @@ static int s3c_jpeg_open(struct inode *inode, struct file *file)
 		return FALSE;
 	}
 
-	JPGRegCtx->v_pJPG_REG = JPGMem.v_pJPG_REG;
-	JPGRegCtx->v_pJPGData_Buff = JPGMem.v_pJPGData_Buff;
-
 	if (instanceNo > MAX_INSTANCE_NUM){
 		log_msg(LOG_ERROR, "s3c_jpeg_open", "DD::Instance Number error-JPEG is running, instance number is %d\n", instanceNo);
 		unlock_jpg_mutex();
 		return FALSE;
 	}
 
+	// the data buffer is taken from the media pool only while the device is open
+	if (instanceNo == 0 && !jpg_buff_mapping(&JPGMem)) {
+		log_msg(LOG_ERROR, "s3c_jpeg_open", "DD::JPEG-DATA-MEMORY Initialize error\r\n");
+		unlock_jpg_mutex();
+		kfree(JPGRegCtx);
+		clk_disable(jpeg_hclk);
+		clk_disable(jpeg_sclk);
+		return -ENOMEM;
+	}
+
+	JPGRegCtx->v_pJPG_REG = JPGMem.v_pJPG_REG;
+	JPGRegCtx->v_pJPGData_Buff = JPGMem.v_pJPGData_Buff;
+
 	instanceNo++;
 
 	unlock_jpg_mutex();
@@ -158,8 +175,15 @@ static int s3c_jpeg_release(struct inode *inode, struct file *file)
 		return FALSE;
 	}
 
-	//if((--instanceNo) < 0)
+	jpg_enc_ring_free(file);
+
+	if (--instanceNo <= 0) {
 		instanceNo = 0;
+		if (JPGMem.v_pJPGData_Buff != NULL) {
+			jpg_buff_free(&JPGMem);
+			s3c_put_media_memory(S3C_MDEV_JPEG);
+		}
+	}
 
 	unlock_jpg_mutex();
 
@@ -186,9 +210,12 @@ static int s3c_jpeg_ioctl(struct inode *inode, struct file *file, unsigned
 {
 	static s3c6400_jpg_ctx		*JPGRegCtx;
 	JPG_DEC_PROC_PARAM	DecReturn;
+	JPG_DEC_STRIDE_PARAM	DecStride;
 	JPG_ENC_PROC_PARAM	EncParam;
+	JPG_ENC_JOB_PARAM	JobParam;
 	BOOL				result = TRUE;
 	DWORD				ret;
+	int					status;
 	int out;
 	
 
@@ -211,7 +238,9 @@ static int s3c_jpeg_ioctl(struct inode *inode, struct file *file, unsigned
 			log_msg(LOG_TRACE, "s3c_jpeg_ioctl", "IOCTL_JPEG_DECODE\n");
 
 			out = copy_from_user(&DecReturn, (JPG_DEC_PROC_PARAM *)arg, sizeof(JPG_DEC_PROC_PARAM));
-			result = decode_jpg(JPGRegCtx, &DecReturn);
+			jpg_hold_hw();
+			result = decode_jpg(JPGRegCtx, &DecReturn, NULL);
+			jpg_release_hw();
 
 			log_msg(LOG_TRACE, "s3c_jpeg_ioctl", "width : %d hegiht : %d size : %d\n", 
 					DecReturn.width, DecReturn.height, DecReturn.dataSize);
@@ -219,6 +248,25 @@ static int s3c_jpeg_ioctl(struct inode *inode, struct file *file, unsigned
 			out = copy_to_user((void *)arg, (void *)&DecReturn, sizeof(JPG_DEC_PROC_PARAM));
 			break;
 
+		/* 
+		 * as IOCTL_JPG_DECODE, but an image that is not a multiple of the MCU 
+		 * is not packed by the CPU: the post processor or the caller crops it 
+		 */
+		case IOCTL_JPG_DECODE_STRIDE:
+
+			log_msg(LOG_TRACE, "s3c_jpeg_ioctl", "IOCTL_JPG_DECODE_STRIDE\n");
+
+			out = copy_from_user(&DecStride, (JPG_DEC_STRIDE_PARAM *)arg, sizeof(JPG_DEC_STRIDE_PARAM));
+			jpg_hold_hw();
+			result = decode_jpg(JPGRegCtx, &DecStride.dec, &DecStride.stride);
+			jpg_release_hw();
+
+			log_msg(LOG_TRACE, "s3c_jpeg_ioctl", "width : %d hegiht : %d stride : %d\n", 
+					DecStride.dec.width, DecStride.dec.height, DecStride.stride);
+
+			out = copy_to_user((void *)arg, (void *)&DecStride, sizeof(JPG_DEC_STRIDE_PARAM));
+			break;
+
 		case IOCTL_JPG_ENCODE:
 		
 			log_msg(LOG_TRACE, "s3c_jpeg_ioctl", "IOCTL_JPEG_ENCODE\n");
@@ -228,7 +276,9 @@ static int s3c_jpeg_ioctl(struct inode *inode, struct file *file, unsigned
 			log_msg(LOG_TRACE, "s3c_jpeg_ioctl", "width : %d hegiht : %d\n", 
 					EncParam.width, EncParam.height);
 
+			jpg_hold_hw();
 			result = encode_jpg(JPGRegCtx, &EncParam);
+			jpg_release_hw();
 
 			log_msg(LOG_TRACE, "s3c_jpeg_ioctl", "encoded file size : %d\n", EncParam.fileSize);
 
@@ -266,6 +316,56 @@ static int s3c_jpeg_ioctl(struct inode *inode, struct file *file, unsigned
 			unlock_jpg_mutex();
 			return jpg_data_base_addr + JPG_STREAM_BUF_SIZE + JPG_STREAM_THUMB_BUF_SIZE + JPG_FRAME_BUF_SIZE;
 
+		/* shared buffer object handles, the frame is decode output and encode input */
+		case IOCTL_JPG_GET_FRMBUF_BO:
+			log_msg(LOG_TRACE, "s3c_jpeg_ioctl", "IOCTL_JPG_GET_FRMBUF_BO\n");
+			unlock_jpg_mutex();
+			return s3c_mem_bo_export(jpg_data_base_addr + JPG_STREAM_BUF_SIZE + JPG_STREAM_THUMB_BUF_SIZE,
+						JPG_FRAME_BUF_SIZE);
+
+		case IOCTL_JPG_GET_THUMB_FRMBUF_BO:
+			log_msg(LOG_TRACE, "s3c_jpeg_ioctl", "IOCTL_JPG_GET_THUMB_FRMBUF_BO\n");
+			unlock_jpg_mutex();
+			return s3c_mem_bo_export(jpg_data_base_addr + JPG_STREAM_BUF_SIZE + JPG_STREAM_THUMB_BUF_SIZE + JPG_FRAME_BUF_SIZE,
+						JPG_FRAME_THUMB_BUF_SIZE);
+
+		/* 
+		 * queued encoding of frames already in memory, e.g. FIMC capture buffers; 
+		 * the streams are written into a ring that is mapped at the returned offset 
+		 */
+		case IOCTL_JPG_ENC_INIT_QUEUE:
+			log_msg(LOG_TRACE, "s3c_jpeg_ioctl", "IOCTL_JPG_ENC_INIT_QUEUE\n");
+			status = jpg_enc_ring_alloc(file, &JPGMem);
+			unlock_jpg_mutex();
+			return status ? status : JPG_ENC_RING_OFFSET;
+
+		case IOCTL_JPG_ENC_QUEUE:
+			if (copy_from_user(&JobParam, (JPG_ENC_JOB_PARAM *)arg, sizeof(JPG_ENC_JOB_PARAM))) {
+				unlock_jpg_mutex();
+				return -EFAULT;
+			}
+
+			status = jpg_enc_queue(file, &JobParam);
+			unlock_jpg_mutex();
+			if (status)
+				return status;
+
+			if (copy_to_user((void *)arg, (void *)&JobParam, sizeof(JPG_ENC_JOB_PARAM)))
+				return -EFAULT;
+			return 0;
+
+		case IOCTL_JPG_ENC_DEQUEUE:
+			// the encodings complete without the mutex
+			unlock_jpg_mutex();
+
+			status = jpg_enc_dequeue(file, &JobParam, file->f_flags & O_NONBLOCK);
+			if (status)
+				return status;
+
+			if (copy_to_user((void *)arg, (void *)&JobParam, sizeof(JPG_ENC_JOB_PARAM)))
+				return -EFAULT;
+			return 0;
+
 		default : 
 			log_msg(LOG_ERROR, "s3c_jpeg_ioctl", "DD::JPG Invalid ioctl : 0x%X\r\n", cmd);
 	}
@@ -281,10 +381,21 @@ int s3c_jpeg_mmap(struct file *filp, struct vm_area_struct *vma)
 	unsigned long size	= vma->vm_end - vma->vm_start;
 	unsigned long maxSize;
 	unsigned long pageFrameNo;
+	UINT32 ringAddr;
 
-	pageFrameNo = __phys_to_pfn(jpg_data_base_addr);
+	// the stream buffers of queued encodings, see IOCTL_JPG_ENC_INIT_QUEUE
+	if ((vma->vm_pgoff << PAGE_SHIFT) == JPG_ENC_RING_OFFSET) {
+		ringAddr = jpg_enc_ring_addr(filp);
+		if (ringAddr == 0)
+			return -EINVAL;
 
-	maxSize = JPG_TOTAL_BUF_SIZE + PAGE_SIZE - (JPG_TOTAL_BUF_SIZE % PAGE_SIZE);
+		pageFrameNo = __phys_to_pfn(ringAddr);
+		maxSize = JPG_ENC_RING_SIZE;
+	}
+	else {
+		pageFrameNo = __phys_to_pfn(jpg_data_base_addr);
+		maxSize = JPG_TOTAL_BUF_SIZE + PAGE_SIZE - (JPG_TOTAL_BUF_SIZE % PAGE_SIZE);
+	}
 
 	if(size > maxSize) {
 		return -EINVAL;
@@ -302,6 +413,11 @@ int s3c_jpeg_mmap(struct file *filp, struct vm_area_struct *vma)
 	return 0;
 }
 
+static unsigned int s3c_jpeg_poll(struct file *file, poll_table *wait)
+{
+	return jpg_enc_poll(file, wait);
+}
+
 
 static struct file_operations jpeg_fops = {
 owner:		THIS_MODULE,
@@ -311,6 +427,7 @@ owner:		THIS_MODULE,
 			read:		s3c_jpeg_read,
 			write:		s3c_jpeg_write,
 			mmap:		s3c_jpeg_mmap,
+			poll:		s3c_jpeg_poll,
 };
 
 
@@ -416,19 +533,12 @@ static int s3c_jpeg_probe(struct platform_device *pdev)
 		return FALSE;
 	}
 
-	// Memory initialization
+	// Memory initialization, the data buffer is mapped at open
 	if( !jpeg_mem_mapping(&JPGMem) ){
 		log_msg(LOG_ERROR, "s3c_jpeg_probe", "DD::JPEG-HOST-MEMORY Initialize error\r\n");
 		unlock_jpg_mutex();
 		return FALSE;
 	}
-	else {
-		if (!jpg_buff_mapping(&JPGMem)){
-			log_msg(LOG_ERROR, "s3c_jpeg_probe", "DD::JPEG-DATA-MEMORY Initialize error : %d\n");
-			unlock_jpg_mutex();
-			return FALSE;	
-		}
-	}
 
 	instanceNo = 0;
 
@@ -487,7 +597,10 @@ static void __exit s3c_jpeg_exit(void)
 		log_msg(LOG_ERROR, "s3c_jpeg_exit", "DD::JPG Mutex Lock Fail\r\n");
 	}
 
-	jpg_buff_free(&JPGMem);
+	if (JPGMem.v_pJPGData_Buff != NULL) {
+		jpg_buff_free(&JPGMem);
+		s3c_put_media_memory(S3C_MDEV_JPEG);
+	}
 	jpg_mem_free(&JPGMem);
 	unlock_jpg_mutex();
 
@@ -23,6 +23,12 @@
 #define IOCTL_JPG_GET_THUMB_FRMBUF		0x0000000B
 #define IOCTL_JPG_GET_PHY_FRMBUF		0x0000000C
 #define IOCTL_JPG_GET_PHY_THUMB_FRMBUF	0x0000000D
+#define IOCTL_JPG_GET_FRMBUF_BO			0x0000000E
+#define IOCTL_JPG_GET_THUMB_FRMBUF_BO	0x0000000F
+#define IOCTL_JPG_ENC_INIT_QUEUE		0x00000010
+#define IOCTL_JPG_ENC_QUEUE				0x00000011
+#define IOCTL_JPG_ENC_DEQUEUE			0x00000012
+#define IOCTL_JPG_DECODE_STRIDE			0x00000013
 
 
 #endif /*__JPEG_DRIVER_H__*/
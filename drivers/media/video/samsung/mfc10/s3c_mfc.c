@@ -37,6 +37,9 @@
 #include <linux/dma-mapping.h>
 #include <linux/mutex.h>
 #include <linux/wait.h>
+#include <linux/workqueue.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <asm/cacheflush.h>
 #include <asm/memory.h>
@@ -70,6 +73,7 @@
 #include "s3c_mfc_sfr.h"
 #include "s3c_mfc_intr_noti.h"
 #include "s3c_mfc_params.h"
+#include "s3c_mfc_v4l2.h"
 
 static struct clk	*s3c_mfc_hclk;
 static struct clk	*s3c_mfc_sclk;
@@ -77,13 +81,45 @@ static struct clk	*s3c_mfc_pclk;
 
 static int s3c_mfc_openhandle_count = 0;
 
-static struct mutex *s3c_mfc_mutex = NULL;
+struct mutex *s3c_mfc_mutex = NULL;
 unsigned int s3c_mfc_intr_type = 0;
 
 #define S3C_MFC_SAVE_START_ADDR 0x100
 #define S3C_MFC_SAVE_END_ADDR	0x200
 static unsigned int s3c_mfc_save[S3C_MFC_SAVE_END_ADDR - S3C_MFC_SAVE_START_ADDR];
 
+/* 
+ * Runtime power management
+ * When no frame is queued for s3c_mfc_gate_ms, the bit processor is put to 
+ * sleep and the MFC clocks are gated. After another s3c_mfc_pdoff_ms the 
+ * power domain V is switched off as well. The next frame or synchronous 
+ * command brings the MFC back up before it is started. 
+ * A delay of 0 disables the stage; both can be changed in debugfs.
+ */
+#define S3C_MFC_PWR_ON		0
+#define S3C_MFC_PWR_GATED	1	/* bit processor asleep, clocks gated */
+#define S3C_MFC_PWR_OFF		2	/* power domain V off too */
+
+static int s3c_mfc_pwr_state = S3C_MFC_PWR_GATED;
+static unsigned long s3c_mfc_pwr_since;		/* jiffies */
+static unsigned long s3c_mfc_pwr_time[3];	/* jiffies spent in each state */
+static unsigned int s3c_mfc_nr_gates;
+static unsigned int s3c_mfc_nr_pdoffs;
+static unsigned int s3c_mfc_nr_wakeups;
+static unsigned long s3c_mfc_last_busy;		/* jiffies */
+
+static u32 s3c_mfc_gate_ms = CONFIG_VIDEO_MFC10_IDLE_GATE_MS;
+static u32 s3c_mfc_pdoff_ms = CONFIG_VIDEO_MFC10_IDLE_PDOFF_MS;
+
+static void s3c_mfc_idle_work(struct work_struct *work);
+static DECLARE_DELAYED_WORK(s3c_mfc_idle, s3c_mfc_idle_work);
+
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *s3c_mfc_debugfs;
+#endif
+
+static BOOL s3c_mfc_setup_clock(void);
+
 extern int s3c_mfc_get_config_params(s3c_mfc_inst_context_t *pMfcInst, s3c_mfc_args_t *args);
 extern int s3c_mfc_set_config_params(s3c_mfc_inst_context_t *pMfcInst, s3c_mfc_args_t *args);
 
@@ -136,29 +172,235 @@ static irqreturn_t s3c_mfc_irq(int irq, void *dev_id)
 
 	intReason	= s3c_mfc_intr_reason();
 
+	s3c_mfc_clear_intr();
+
 	/* if PIC_RUN, buffer full and buffer empty interrupt */
 	if (intReason & S3C_MFC_INTR_ENABLE_RESET) {
-		s3c_mfc_intr_type = intReason;
-		wake_up_interruptible(&s3c_mfc_wait_queue);
+		/* a queued frame is completed and the next one is started here */
+		if (!s3c_mfc_job_irq(intReason)) {
+			s3c_mfc_intr_type = intReason;
+			wake_up_interruptible(&s3c_mfc_wait_queue);
+		}
 	}
 
-	s3c_mfc_clear_intr();
-
 	return IRQ_HANDLED;
 }
 
-static int s3c_mfc_open(struct inode *inode, struct file *file)
+/* 
+ * Collect the result of the instance's frame once it is done.
+ * It is called with s3c_mfc_mutex held.
+ */
+static int s3c_mfc_finish_frame(s3c_mfc_inst_context_t *pMfcInst, s3c_mfc_job_t *job, 
+				int *nStrmLen, int *nHdrLen)
 {
-	s3c_mfc_handle_t		*handle;
+	int ret;
+	unsigned char *start;
+	int size;
 
-	/* 
-	 * Mutex Lock
-	 */
-	mutex_lock(s3c_mfc_mutex);
+	*nStrmLen = 0;
+	*nHdrLen = 0;
+
+	if (job->state != S3C_MFC_JOB_DONE)
+		return S3C_MFC_INST_ERR_STATE_CHK;
+
+	ret = job->ret;
+
+	if (job->type == S3C_MFC_JOB_ENC) {
+		start = pMfcInst->stream_buffer;
+		size = pMfcInst->stream_buffer_size;
+		dma_cache_maint(start, size, DMA_FROM_DEVICE);
+
+		if (ret == S3C_MFC_INST_RET_OK) {
+			*nStrmLen = job->enc_size;
+			s3c_mfc_inst_enc_finish(pMfcInst, job->hdr_buf, job->hdr_size, nStrmLen, nHdrLen);
+		}
+
+		if (job->hdr_buf) {
+			kfree(job->hdr_buf);
+			job->hdr_buf = NULL;
+		}
+	} else {
+		start = pMfcInst->yuv_buffer;
+		size = ((pMfcInst->width * pMfcInst->height * 3) >> 1) * pMfcInst->yuv_buffer_count;
+		dma_cache_maint(start, size, DMA_FROM_DEVICE);	
+	}
+
+	job->state = S3C_MFC_JOB_IDLE;
 
+	return ret;
+}
+
+static void s3c_mfc_clock_on(void)
+{
 	clk_enable(s3c_mfc_hclk);
 	clk_enable(s3c_mfc_sclk);
 	clk_enable(s3c_mfc_pclk);
+}
+
+static void s3c_mfc_clock_off(void)
+{
+	clk_disable(s3c_mfc_hclk);
+	clk_disable(s3c_mfc_sclk);
+	clk_disable(s3c_mfc_pclk);
+}
+
+static void s3c_mfc_domain_on(void)
+{
+	unsigned int	mfc_pwr;
+
+	mfc_pwr = readl(S3C_NORMAL_CFG);
+	mfc_pwr |= (1 << 9);
+	__raw_writel(mfc_pwr, S3C_NORMAL_CFG);
+
+	while (!(readl(S3C_BLK_PWR_STAT) & (1 << 1)))
+		udelay(1);
+}
+
+static void s3c_mfc_domain_off(void)
+{
+	unsigned int	mfc_pwr;
+
+	mfc_pwr = readl(S3C_NORMAL_CFG);
+	mfc_pwr &= ~(1 << 9);
+	__raw_writel(mfc_pwr, S3C_NORMAL_CFG);
+}
+
+static void s3c_mfc_save_context(void)
+{
+	int i, index = 0;
+
+	for (i = S3C_MFC_SAVE_START_ADDR; i <= S3C_MFC_SAVE_END_ADDR; i += 4)
+		s3c_mfc_save[index++] = readl(s3c_mfc_sfr_base_virt_addr + i);
+}
+
+static void s3c_mfc_restore_context(void)
+{
+	int i, index = 0;
+
+	for (i = S3C_MFC_SAVE_START_ADDR; i <= S3C_MFC_SAVE_END_ADDR; i += 4)
+		writel(s3c_mfc_save[index++], s3c_mfc_sfr_base_virt_addr + i);
+}
+
+static void s3c_mfc_set_pwr_state(int state)
+{
+	s3c_mfc_pwr_time[s3c_mfc_pwr_state] += jiffies - s3c_mfc_pwr_since;
+	s3c_mfc_pwr_since = jiffies;
+	s3c_mfc_pwr_state = state;
+}
+
+/* 
+ * Bring a gated MFC back before it is given a frame or a command.
+ * It is called with s3c_mfc_mutex held.
+ */
+void s3c_mfc_power_up(void)
+{
+	s3c_mfc_last_busy = jiffies;
+
+	if (s3c_mfc_openhandle_count == 0 || s3c_mfc_pwr_state == S3C_MFC_PWR_ON)
+		return;
+
+	if (s3c_mfc_pwr_state == S3C_MFC_PWR_OFF) {
+		/* same as resume: the firmware and the SFRs are lost */
+		s3c_mfc_domain_on();
+		s3c_mfc_clock_on();
+		s3c_mfc_setup_clock();
+		s3c_mfc_download_boot_firmware();
+		s3c_mfc_restore_context();
+	} else {
+		s3c_mfc_clock_on();
+	}
+
+	s3c_mfc_wakeup();
+
+	s3c_mfc_nr_wakeups++;
+	s3c_mfc_set_pwr_state(S3C_MFC_PWR_ON);
+}
+
+/* 
+ * Called by the job queue when it runs dry, possibly from the interrupt.
+ * The idle work gates the MFC if nothing is queued in the meantime.
+ */
+void s3c_mfc_power_idle(void)
+{
+	s3c_mfc_last_busy = jiffies;
+
+	if (s3c_mfc_gate_ms)
+		schedule_delayed_work(&s3c_mfc_idle, msecs_to_jiffies(s3c_mfc_gate_ms));
+}
+
+static void s3c_mfc_idle_work(struct work_struct *work)
+{
+	unsigned long idle, delay;
+
+	mutex_lock(s3c_mfc_mutex);
+
+	/* it is scheduled again when the queue runs dry */
+	if (s3c_mfc_openhandle_count == 0 || !s3c_mfc_hw_idle())
+		goto out;
+
+	idle = jiffies - s3c_mfc_last_busy;
+
+	if (s3c_mfc_pwr_state == S3C_MFC_PWR_ON && s3c_mfc_gate_ms) {
+		delay = msecs_to_jiffies(s3c_mfc_gate_ms);
+		if (idle < delay) {
+			schedule_delayed_work(&s3c_mfc_idle, delay - idle);
+			goto out;
+		}
+
+		s3c_mfc_save_context();
+		s3c_mfc_sleep();
+		s3c_mfc_clock_off();
+
+		s3c_mfc_nr_gates++;
+		s3c_mfc_set_pwr_state(S3C_MFC_PWR_GATED);
+	}
+
+	if (s3c_mfc_pwr_state == S3C_MFC_PWR_GATED && s3c_mfc_pdoff_ms) {
+		delay = msecs_to_jiffies(s3c_mfc_gate_ms + s3c_mfc_pdoff_ms);
+		if (idle < delay) {
+			schedule_delayed_work(&s3c_mfc_idle, delay - idle);
+			goto out;
+		}
+
+		s3c_mfc_domain_off();
+
+		s3c_mfc_nr_pdoffs++;
+		s3c_mfc_set_pwr_state(S3C_MFC_PWR_OFF);
+	}
+
+out:
+	mutex_unlock(s3c_mfc_mutex);
+}
+
+/* called with s3c_mfc_mutex held when the last instance is gone */
+static void s3c_mfc_last_close(void)
+{
+#if defined(CONFIG_S3C6400_KDPMD) || defined(CONFIG_S3C6400_KDPMD_MODULE)
+	s3c_mfc_pmdev.state = DEV_IDLE;
+	kdpmd_set_event(s3c_mfc_pmdev.devid, KDPMD_DRVCLOSE);
+	kdpmd_wakeup();
+	kdpmd_wait(s3c_mfc_pmdev.devid);
+#endif
+
+	/* a gated or powered off MFC has its clocks off already */
+	if (s3c_mfc_pwr_state == S3C_MFC_PWR_ON) {
+		s3c_mfc_clock_off();
+		s3c_mfc_set_pwr_state(S3C_MFC_PWR_GATED);
+	}
+
+	s3c_mfc_release_memory();
+}
+
+/* 
+ * Create an MFC instance, the first one brings the MFC up.
+ * It is shared by the MFC device and its V4L2 interface.
+ */
+int s3c_mfc_open_inst(s3c_mfc_inst_context_t **inst)
+{
+	/* 
+	 * Mutex Lock
+	 */
+	mutex_lock(s3c_mfc_mutex);
 
 	s3c_mfc_openhandle_count++;
 	if (s3c_mfc_openhandle_count == 1) {
@@ -170,31 +412,86 @@ static int s3c_mfc_open(struct inode *inode, struct file *file)
 		mfc_debug("mfc_open woke up\n");
 #endif
 
+		/*
+		 * 2. MFC Memory Setup
+		 * The buffers are taken from the media memory pool while
+		 * the device is open and given back on the last close.
+		 */
+		s3c_mfc_phys_buffer = s3c_get_media_memory(S3C_MDEV_MFC);
+		if (s3c_mfc_phys_buffer == 0 || s3c_mfc_setup_memory() == FALSE) {
+			mfc_err("fail to get mfc buffer memory\n");
+			s3c_mfc_release_memory();
+			s3c_mfc_openhandle_count--;
+			mutex_unlock(s3c_mfc_mutex);
+			return -ENOMEM;
+		}
+
 		/*
 		 * 3. MFC Hardware Initialization
+		 * The clocks stay on while the device is open, unless it is idle.
 		 */
-		if (s3c_mfc_init_hw() == FALSE) 
-			return -ENODEV;	
+		if (s3c_mfc_pwr_state == S3C_MFC_PWR_OFF)
+			s3c_mfc_domain_on();
+		s3c_mfc_clock_on();
+		s3c_mfc_set_pwr_state(S3C_MFC_PWR_ON);
+
+		if (s3c_mfc_init_hw() == FALSE) {
+			s3c_mfc_openhandle_count--;
+			s3c_mfc_last_close();
+			mutex_unlock(s3c_mfc_mutex);
+			return -ENODEV;
+		}
+	}
+
+	/* 
+	 * MFC Instance creation
+	 */
+	*inst = s3c_mfc_inst_create();
+	if (*inst == NULL) {
+		mfc_err("fail to mfc instance allocation\n");
+		if (--s3c_mfc_openhandle_count == 0)
+			s3c_mfc_last_close();
+		mutex_unlock(s3c_mfc_mutex);
+		return -EPERM;
 	}
 
+	mutex_unlock(s3c_mfc_mutex);
+
+	return 0;
+}
+
+void s3c_mfc_close_inst(s3c_mfc_inst_context_t *inst)
+{
+	mutex_lock(s3c_mfc_mutex);
+
+	mfc_debug("deleting instance number = %d\n", inst->inst_no);
+
+	s3c_mfc_cancel_job(s3c_mfc_get_job(inst));
+	s3c_mfc_inst_del(inst);
+
+	s3c_mfc_openhandle_count--;
+	if (s3c_mfc_openhandle_count == 0)
+		s3c_mfc_last_close();
+
+	mutex_unlock(s3c_mfc_mutex);
+}
+
+static int s3c_mfc_open(struct inode *inode, struct file *file)
+{
+	s3c_mfc_handle_t		*handle;
+	int				ret;
 
 	handle = (s3c_mfc_handle_t *)kmalloc(sizeof(s3c_mfc_handle_t), GFP_KERNEL);
 	if (!handle) {
 		mfc_debug("mfc open error\n");
-		mutex_unlock(s3c_mfc_mutex);
 		return -ENOMEM;
 	}
 	memset(handle, 0, sizeof(s3c_mfc_handle_t));
 
-
-	/* 
-	 * MFC Instance creation
-	 */
-	handle->mfc_inst = s3c_mfc_inst_create();
-	if (handle->mfc_inst == NULL) {
-		mfc_err("fail to mfc instance allocation\n");
-		mutex_unlock(s3c_mfc_mutex);
-		return -EPERM;
+	ret = s3c_mfc_open_inst(&handle->mfc_inst);
+	if (ret) {
+		kfree(handle);
+		return ret;
 	}
 
 	/*
@@ -203,8 +500,6 @@ static int s3c_mfc_open(struct inode *inode, struct file *file)
 	 */
 	file->private_data = (s3c_mfc_handle_t *)handle;
 
-	mutex_unlock(s3c_mfc_mutex);
-
 	mfc_debug("mfc open success\n");
 
 	return 0;
@@ -215,34 +510,12 @@ static int s3c_mfc_release(struct inode *inode, struct file *file)
 {
 	s3c_mfc_handle_t *handle = NULL;
 
-	mutex_lock(s3c_mfc_mutex);
-
 	handle = (s3c_mfc_handle_t *)file->private_data;
-	if (handle->mfc_inst == NULL) {
-		mutex_unlock(s3c_mfc_mutex);
+	if (handle->mfc_inst == NULL)
 		return -EPERM;
-	};
-
-	mfc_debug("deleting instance number = %d\n", handle->mfc_inst->inst_no);
-
-	s3c_mfc_inst_del(handle->mfc_inst);
-
-	s3c_mfc_openhandle_count--;
-	if (s3c_mfc_openhandle_count == 0) {
 
-#if defined(CONFIG_S3C6400_KDPMD) || defined(CONFIG_S3C6400_KDPMD_MODULE)
-		s3c_mfc_pmdev.state = DEV_IDLE;
-		kdpmd_set_event(s3c_mfc_pmdev.devid, KDPMD_DRVCLOSE);
-		kdpmd_wakeup();
-		kdpmd_wait(s3c_mfc_pmdev.devid);
-#endif
-
-		clk_disable(s3c_mfc_hclk);
-		clk_disable(s3c_mfc_sclk);
-		clk_disable(s3c_mfc_pclk);		
-	}
-
-	mutex_unlock(s3c_mfc_mutex);
+	s3c_mfc_close_inst(handle->mfc_inst);
+	kfree(handle);
 
 	return 0;
 }
@@ -278,6 +551,7 @@ static int s3c_mfc_ioctl(struct inode *inode, struct file *file, unsigned int cm
 	
 	s3c_mfc_inst_context_t	*pMfcInst;
 	s3c_mfc_handle_t		*handle;
+	s3c_mfc_job_t		*job;
 	s3c_mfc_codec_mode_t	codec_mode = 0;
 	s3c_mfc_args_t		args;
 	s3c_mfc_enc_info_t		enc_info;
@@ -326,7 +600,9 @@ static int s3c_mfc_ioctl(struct inode *inode, struct file *file, unsigned int cm
 		enc_info.gamma		= args.enc_init.in_gamma;
 		*/
 
+		s3c_mfc_hold_hw();
 		ret = s3c_mfc_instance_init_enc(pMfcInst, codec_mode, &enc_info);
+		s3c_mfc_release_hw();
 
 		args.enc_init.ret_code = ret;
 		out = copy_to_user((s3c_mfc_enc_init_arg_t *)arg, &args.enc_init, 
@@ -343,6 +619,12 @@ static int s3c_mfc_ioctl(struct inode *inode, struct file *file, unsigned int cm
 		out = copy_from_user(&args.enc_exe, (s3c_mfc_enc_exe_arg_t *)arg, 
 							sizeof(s3c_mfc_enc_exe_arg_t));
 
+		job = s3c_mfc_get_job(pMfcInst);
+		if (job->state != S3C_MFC_JOB_IDLE) {
+			mutex_unlock(s3c_mfc_mutex);
+			return -EBUSY;
+		}
+
 		tmp = (pMfcInst->width * pMfcInst->height * 3) >> 1;
 
 		start = pMfcInst->yuv_buffer;
@@ -351,22 +633,31 @@ static int s3c_mfc_ioctl(struct inode *inode, struct file *file, unsigned int cm
 
 		/* 
 		 * Encode MFC Instance
+		 * The frame is queued to the MFC; the mutex is not held while it runs.
 		 */
-		ret = s3c_mfc_inst_enc(pMfcInst, &nStrmLen, &nHdrLen);
+		ret = s3c_mfc_inst_enc_prepare(pMfcInst, &job->hdr_buf, &job->hdr_size);
+		if (ret == S3C_MFC_INST_RET_OK)
+			s3c_mfc_submit_job(job, S3C_MFC_JOB_ENC, 0);
 
-		start = pMfcInst->stream_buffer;
-		size = pMfcInst->stream_buffer_size;
-		dma_cache_maint(start, size, DMA_FROM_DEVICE);
+		mutex_unlock(s3c_mfc_mutex);
 
-		args.enc_exe.ret_code	= ret;
-		if (ret == S3C_MFC_INST_RET_OK) {
-			args.enc_exe.out_encoded_size = nStrmLen;
-			args.enc_exe.out_header_size  = nHdrLen;
+		/* with O_NONBLOCK the result is collected by S3C_MFC_IOCTL_MFC_WAIT_EXE */
+		if (ret == S3C_MFC_INST_RET_OK && !(file->f_flags & O_NONBLOCK)) {
+			s3c_mfc_wait_job(job, 0);
+
+			mutex_lock(s3c_mfc_mutex);
+			ret = s3c_mfc_finish_frame(pMfcInst, job, &nStrmLen, &nHdrLen);
+			mutex_unlock(s3c_mfc_mutex);
+
+			if (ret == S3C_MFC_INST_RET_OK) {
+				args.enc_exe.out_encoded_size = nStrmLen;
+				args.enc_exe.out_header_size  = nHdrLen;
+			}
 		}
+
+		args.enc_exe.ret_code	= ret;
 		out = copy_to_user((s3c_mfc_enc_exe_arg_t *)arg, &args.enc_exe, 
 						sizeof(s3c_mfc_enc_exe_arg_t));
-
-		mutex_unlock(s3c_mfc_mutex);
 		break;
 
 	case S3C_MFC_IOCTL_MFC_MPEG4_DEC_INIT:
@@ -391,8 +682,10 @@ static int s3c_mfc_ioctl(struct inode *inode, struct file *file, unsigned int cm
 		/* 
 		 * Initialize MFC Instance
 		 */
+		s3c_mfc_hold_hw();
 		ret = s3c_mfc_inst_init_dec(pMfcInst, codec_mode, 
 						args.dec_init.in_strmSize);
+		s3c_mfc_release_hw();
 
 		args.dec_init.ret_code	= ret;
 		if (ret == S3C_MFC_INST_RET_OK) {
@@ -416,23 +709,51 @@ static int s3c_mfc_ioctl(struct inode *inode, struct file *file, unsigned int cm
 		out = copy_from_user(&args.dec_exe, (s3c_mfc_dec_exe_arg_t *)arg, 
 							sizeof(s3c_mfc_dec_exe_arg_t));
 
-		tmp = (pMfcInst->width * pMfcInst->height * 3) >> 1;
+		job = s3c_mfc_get_job(pMfcInst);
+		if (job->state != S3C_MFC_JOB_IDLE) {
+			mutex_unlock(s3c_mfc_mutex);
+			return -EBUSY;
+		}
 
 		start = pMfcInst->stream_buffer;
 		size = pMfcInst->stream_buffer_size;
 		dma_cache_maint(start, size, DMA_TO_DEVICE);
 
-		ret = s3c_mfc_inst_dec(pMfcInst, args.dec_exe.in_strmSize);
+		ret = s3c_mfc_inst_dec_prepare(pMfcInst);
+		if (ret == S3C_MFC_INST_RET_OK)
+			s3c_mfc_submit_job(job, S3C_MFC_JOB_DEC, args.dec_exe.in_strmSize);
 
-		start = pMfcInst->yuv_buffer;
-		size = tmp * pMfcInst->yuv_buffer_count;
-		dma_cache_maint(start, size, DMA_FROM_DEVICE);	
+		mutex_unlock(s3c_mfc_mutex);
+
+		/* with O_NONBLOCK the result is collected by S3C_MFC_IOCTL_MFC_WAIT_EXE */
+		if (ret == S3C_MFC_INST_RET_OK && !(file->f_flags & O_NONBLOCK)) {
+			s3c_mfc_wait_job(job, 0);
+
+			mutex_lock(s3c_mfc_mutex);
+			ret = s3c_mfc_finish_frame(pMfcInst, job, &nStrmLen, &nHdrLen);
+			mutex_unlock(s3c_mfc_mutex);
+		}
 
 		args.dec_exe.ret_code = ret;
 		out = copy_to_user((s3c_mfc_dec_exe_arg_t *)arg, &args.dec_exe,
 						 sizeof(s3c_mfc_dec_exe_arg_t));
+		break;
+
+	case S3C_MFC_IOCTL_MFC_WAIT_EXE:
+		job = s3c_mfc_get_job(pMfcInst);
+
+		if (s3c_mfc_wait_job(job, 1))
+			return -ERESTARTSYS;
 
+		mutex_lock(s3c_mfc_mutex);
+		ret = s3c_mfc_finish_frame(pMfcInst, job, &nStrmLen, &nHdrLen);
 		mutex_unlock(s3c_mfc_mutex);
+
+		args.wait_exe.ret_code = ret;
+		args.wait_exe.out_encoded_size = nStrmLen;
+		args.wait_exe.out_header_size = nHdrLen;
+		out = copy_to_user((s3c_mfc_wait_exe_arg_t *)arg, &args.wait_exe,
+						 sizeof(s3c_mfc_wait_exe_arg_t));
 		break;
 
 	case S3C_MFC_IOCTL_MFC_GET_LINE_BUF_ADDR:
@@ -545,6 +866,63 @@ static int s3c_mfc_ioctl(struct inode *inode, struct file *file, unsigned int cm
 		mutex_unlock(s3c_mfc_mutex);
 		break;
 
+	case S3C_MFC_IOCTL_MFC_GET_FRAM_BUF_BO:
+		/* 
+		 * Export the current frame (decoded picture, or the encoder's
+		 * next source picture) as a shared buffer object, returned in
+		 * out_buf_addr, so it can be handed on without a copy.
+		 */
+		mutex_lock(s3c_mfc_mutex);
+
+		out = copy_from_user(&args.get_buf_addr, 
+			(s3c_mfc_get_buf_addr_arg_t *)arg, 
+			sizeof(s3c_mfc_get_buf_addr_arg_t));
+
+		if (pMfcInst->yuv_buffer == NULL) {
+			mfc_err("mfc frame buffer is not internally allocated yet\n");
+			mutex_unlock(s3c_mfc_mutex);
+			return -EFAULT;
+		}
+
+		yuv_buffer = (unsigned int)pMfcInst->yuv_buffer;
+		run_index = pMfcInst->run_index;
+		databuf_vaddr = (unsigned int)s3c_mfc_get_databuf_virt_addr();
+		databuf_paddr = (unsigned int)S3C_MFC_BASEADDR_DATA_BUF;
+
+		switch (pMfcInst->codec_mode) {
+		case MP4_ENC:
+		case AVC_ENC:
+		case H263_ENC:
+			yuv_size = (pMfcInst->width * pMfcInst->height * 3) >> 1;
+			offset = run_index * yuv_size + (yuv_buffer - databuf_vaddr);
+			break;
+
+		default:
+			yuv_size = (pMfcInst->buf_width * pMfcInst->buf_height * 3) >> 1;
+			offset = yuv_buffer + run_index * yuv_size - databuf_vaddr;
+#if (S3C_MFC_ROTATE_ENABLE == 1)
+			if ((pMfcInst->codec_mode != VC1_DEC) && (pMfcInst->post_rotation_mode & 0x0010)) {
+				yuv_buff_cnt = pMfcInst->yuv_buffer_count;
+				offset = yuv_buffer + yuv_buff_cnt * yuv_size - databuf_vaddr;
+			}
+#endif
+			break;
+		}
+
+		args.get_buf_addr.out_buf_size = yuv_size;
+		args.get_buf_addr.out_buf_addr = s3c_mem_bo_export(databuf_paddr + offset, yuv_size);
+		if (args.get_buf_addr.out_buf_addr < 0) {
+			mutex_unlock(s3c_mfc_mutex);
+			return args.get_buf_addr.out_buf_addr;
+		}
+		args.get_buf_addr.ret_code = S3C_MFC_INST_RET_OK;
+
+		out = copy_to_user((s3c_mfc_get_buf_addr_arg_t *)arg, 
+			&args.get_buf_addr, sizeof(s3c_mfc_get_buf_addr_arg_t));
+
+		mutex_unlock(s3c_mfc_mutex);
+		break;
+
 	case S3C_MFC_IOCTL_MFC_GET_MPEG4_ASP_PARAM:
 #if (defined(DIVX_ENABLE) && (DIVX_ENABLE == 1))
 
@@ -580,7 +958,9 @@ static int s3c_mfc_ioctl(struct inode *inode, struct file *file, unsigned int cm
 
 		out = copy_from_user(&args, (s3c_mfc_args_t *)arg, sizeof(s3c_mfc_args_t));
 
+		s3c_mfc_hold_hw();
 		ret = s3c_mfc_get_config_params(pMfcInst, &args);
+		s3c_mfc_release_hw();
 
 		out = copy_to_user((s3c_mfc_args_t *)arg, &args, sizeof(s3c_mfc_args_t));
 
@@ -592,7 +972,9 @@ static int s3c_mfc_ioctl(struct inode *inode, struct file *file, unsigned int cm
 
 		out = copy_from_user(&args, (s3c_mfc_args_t *)arg, sizeof(s3c_mfc_args_t));
 
+		s3c_mfc_hold_hw();
 		ret = s3c_mfc_set_config_params(pMfcInst, &args);
+		s3c_mfc_release_hw();
 
 		out = copy_to_user((s3c_mfc_args_t *)arg, &args, sizeof(s3c_mfc_args_t));
 
@@ -649,6 +1031,24 @@ int s3c_mfc_mmap(struct file *filp, struct vm_area_struct *vma)
 }
 
 
+/* readable when the frame submitted with O_NONBLOCK is done */
+static unsigned int s3c_mfc_poll(struct file *file, poll_table *wait)
+{
+	s3c_mfc_handle_t *handle = (s3c_mfc_handle_t *)file->private_data;
+	s3c_mfc_job_t *job;
+
+	if (handle->mfc_inst == NULL)
+		return POLLERR;
+
+	job = s3c_mfc_get_job(handle->mfc_inst);
+	s3c_mfc_poll_job(file, wait);
+
+	if (job->state == S3C_MFC_JOB_DONE)
+		return POLLIN | POLLRDNORM;
+
+	return 0;
+}
+
 static struct file_operations s3c_mfc_fops = {
 	owner:		THIS_MODULE,
 	open:		s3c_mfc_open,
@@ -657,6 +1057,7 @@ static struct file_operations s3c_mfc_fops = {
 	read:		s3c_mfc_read,
 	write:		s3c_mfc_write,
 	mmap:		s3c_mfc_mmap,
+	poll:		s3c_mfc_poll,
 };
 
 
@@ -666,6 +1067,45 @@ static struct miscdevice s3c_mfc_miscdev = {
 	fops:		&s3c_mfc_fops
 };
 
+#ifdef CONFIG_DEBUG_FS
+static int s3c_mfc_stats_show(struct seq_file *s, void *unused)
+{
+	static const char *names[] = { "on", "gated", "off" };
+	unsigned long time[3];
+	int i;
+
+	mutex_lock(s3c_mfc_mutex);
+
+	memcpy(time, s3c_mfc_pwr_time, sizeof(time));
+	time[s3c_mfc_pwr_state] += jiffies - s3c_mfc_pwr_since;
+
+	seq_printf(s, "power %s, gated %u, powered off %u, woken up %u times\n",
+		names[s3c_mfc_pwr_state], s3c_mfc_nr_gates, s3c_mfc_nr_pdoffs,
+		s3c_mfc_nr_wakeups);
+	for (i = 0; i < 3; i++)
+		seq_printf(s, "  %-6s %10u ms\n", names[i], jiffies_to_msecs(time[i]));
+	seq_printf(s, "\n");
+
+	s3c_mfc_show_job_stats(s);
+
+	mutex_unlock(s3c_mfc_mutex);
+
+	return 0;
+}
+
+static int s3c_mfc_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, s3c_mfc_stats_show, NULL);
+}
+
+static const struct file_operations s3c_mfc_stats_fops = {
+	.open		= s3c_mfc_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
 static BOOL s3c_mfc_setup_clock(void)
 {
 	unsigned int	mfc_clk;
@@ -739,8 +1179,6 @@ static int s3c_mfc_probe(struct platform_device *pdev)
 		return ret;
 	}
 
-	s3c_mfc_phys_buffer = s3c_get_media_memory(S3C_MDEV_MFC);
-
 	/* mutex creation and initialization */
 	s3c_mfc_mutex = (struct mutex *)kmalloc(sizeof(struct mutex), GFP_KERNEL);
 	if (s3c_mfc_mutex == NULL)
@@ -751,30 +1189,37 @@ static int s3c_mfc_probe(struct platform_device *pdev)
 	/* mfc clock set 133 Mhz */
 	if (s3c_mfc_setup_clock() == FALSE)
 		return -ENODEV;
-	
-	/*
-	 * 2. MFC Memory Setup
-	 */
-	if (s3c_mfc_setup_memory() == FALSE)
-		return -ENOMEM;
 
-	/*
-	 * 3. MFC Hardware Initialization
-	 */
-	if (s3c_mfc_init_hw() == FALSE)
-		return -ENODEV;
+	/* memory setup and hardware initialization are done on first open */
 
 	ret = misc_register(&s3c_mfc_miscdev);
 
+	/* the decoder is also offered as a V4L2 memory to memory device */
+	s3c_mfc_v4l2_register(pdev);
+
 	clk_disable(s3c_mfc_hclk);
 	clk_disable(s3c_mfc_sclk);
 	clk_disable(s3c_mfc_pclk);
 
+	s3c_mfc_pwr_since = jiffies;
+
+#ifdef CONFIG_DEBUG_FS
+	s3c_mfc_debugfs = debugfs_create_dir("s3c-mfc", NULL);
+	debugfs_create_file("stats", S_IRUGO, s3c_mfc_debugfs, NULL, &s3c_mfc_stats_fops);
+	debugfs_create_u32("gate_ms", S_IRUGO | S_IWUSR, s3c_mfc_debugfs, &s3c_mfc_gate_ms);
+	debugfs_create_u32("pdoff_ms", S_IRUGO | S_IWUSR, s3c_mfc_debugfs, &s3c_mfc_pdoff_ms);
+#endif
+
 	return 0;
 }
 
 static int s3c_mfc_remove(struct platform_device *dev)
 {
+#ifdef CONFIG_DEBUG_FS
+	debugfs_remove_recursive(s3c_mfc_debugfs);
+#endif
+	cancel_delayed_work_sync(&s3c_mfc_idle);
+
 	if (s3c_mfc_mem != NULL) {
 		release_resource(s3c_mfc_mem);
 		kfree(s3c_mfc_mem);
@@ -783,6 +1228,7 @@ static int s3c_mfc_remove(struct platform_device *dev)
 
 	free_irq(IRQ_MFC, dev);
 
+	s3c_mfc_v4l2_unregister();
 	misc_deregister(&s3c_mfc_miscdev);
 	return 0;
 }
@@ -792,13 +1238,17 @@ static int s3c_mfc_suspend(struct platform_device *dev, pm_message_t state)
 
 	int	inst_no;
 	int	is_mfc_on = 0;
-	int	i, index = 0;
 
 	s3c_mfc_inst_context_t *mfcinst_ctx;
-	unsigned int	dwMfcBase;
 
 	mutex_lock(s3c_mfc_mutex);
 
+	/* 
+	 * let the running frame finish, the queued ones are started after resume.
+	 * a gated MFC is woken up here so that its context is saved as usual.
+	 */
+	s3c_mfc_hold_hw();
+
 	is_mfc_on = 0;
 
 	/* 
@@ -822,21 +1272,16 @@ static int s3c_mfc_suspend(struct platform_device *dev, pm_message_t state)
 
 	/* 2. Command MFC sleep and save MFC SFR */
 	if (is_mfc_on) {
-		dwMfcBase = s3c_mfc_sfr_base_virt_addr;
-
-		for (i = S3C_MFC_SAVE_START_ADDR; i <= S3C_MFC_SAVE_END_ADDR; i += 4) {
-			s3c_mfc_save[index] = readl(dwMfcBase + i);
-			index++;	
-		}
-
+		s3c_mfc_save_context();
 		s3c_mfc_sleep();
 	}
 
 
-	/* 3. Disable MFC clock */
-	clk_disable(s3c_mfc_hclk);
-	clk_disable(s3c_mfc_sclk);
-	clk_disable(s3c_mfc_pclk);
+	/* 3. Disable MFC clock, it is only enabled while the device is open */
+	if (s3c_mfc_openhandle_count) {
+		s3c_mfc_clock_off();
+		s3c_mfc_set_pwr_state(S3C_MFC_PWR_OFF);
+	}
 
 	mutex_unlock(s3c_mfc_mutex);
 
@@ -846,31 +1291,23 @@ static int s3c_mfc_suspend(struct platform_device *dev, pm_message_t state)
 static int s3c_mfc_resume(struct platform_device *pdev)
 {
 
-	int 		i, index = 0;
 	int         	inst_no;
 	int		is_mfc_on = 0;
-	unsigned int	mfc_pwr, dwMfcBase;
-	unsigned int	domain_v_ready;
 	
 	s3c_mfc_inst_context_t *mfcinst_ctx;
 
 	mutex_lock(s3c_mfc_mutex);
 
-	clk_enable(s3c_mfc_hclk);
-	clk_enable(s3c_mfc_sclk);
-	clk_enable(s3c_mfc_pclk);
+	/* 1. MFC Power On(Domain V) and 2. Check MFC power on */
+	s3c_mfc_domain_on();
 
-	/* 1. MFC Power On(Domain V) */
-	mfc_pwr = readl(S3C_NORMAL_CFG);
-	mfc_pwr |= (1 << 9);
-	__raw_writel(mfc_pwr, S3C_NORMAL_CFG);
+	/* the first open initializes the MFC */
+	if (s3c_mfc_openhandle_count == 0) {
+		s3c_mfc_set_pwr_state(S3C_MFC_PWR_GATED);
+		goto out;
+	}
 
-	/* 2. Check MFC power on */
-	do {
-		domain_v_ready = readl(S3C_BLK_PWR_STAT);
-		mfc_debug("domain v ready = 0x%X\n", domain_v_ready);
-		msleep(1);
-	} while (!(domain_v_ready & (1 << 1)));
+	s3c_mfc_clock_on();
 
 	/* 3. MFC clock set 133 Mhz */
 	if (s3c_mfc_setup_clock() == FALSE)
@@ -899,16 +1336,17 @@ static int s3c_mfc_resume(struct platform_device *pdev)
 
 	if (is_mfc_on) {
 		/* 5. Restore MFC SFR */
-		dwMfcBase = s3c_mfc_sfr_base_virt_addr;
-		for (i = S3C_MFC_SAVE_START_ADDR; i <= S3C_MFC_SAVE_END_ADDR; i += 4 ) {
-			writel(s3c_mfc_save[index], dwMfcBase + i);
-			index++;
-		}
+		s3c_mfc_restore_context();
 
 		/* 6. Command MFC wakeup */
 		s3c_mfc_wakeup();
 	}
 
+	s3c_mfc_set_pwr_state(S3C_MFC_PWR_ON);
+
+out:
+	s3c_mfc_release_hw();
+
 	mutex_unlock(s3c_mfc_mutex);
 
 	return 0;
@@ -49,6 +49,8 @@
 #define S3C_MFC_IOCTL_MFC_GET_YUV_SIZE			(0x00800112)
 #define S3C_MFC_IOCTL_MFC_SET_PP_DISP_SIZE		(0x00800113)
 #define S3C_MFC_IOCTL_MFC_SET_DEC_INBUF_TYPE		(0x00800114)
+#define S3C_MFC_IOCTL_MFC_GET_FRAM_BUF_BO		(0x00800118)
+#define S3C_MFC_IOCTL_MFC_WAIT_EXE			(0x00800119)
 
 #define S3C_MFC_IOCTL_VIRT_TO_PHYS			0x12345678
 
@@ -43,6 +43,15 @@ BOOL s3c_mfc_memmap_bitproc_buff()
 	return ret;
 }
 
+void s3c_mfc_unmap_bitproc_buff()
+{
+	if (s3c_mfc_virt_bitproc_buff != NULL)
+		iounmap((void *)s3c_mfc_virt_bitproc_buff);
+
+	s3c_mfc_virt_bitproc_buff = NULL;
+	s3c_mfc_phys_bitproc_buff = 0;
+}
+
 volatile unsigned char *s3c_mfc_get_bitproc_buff_virt_addr()
 {
 	volatile unsigned char	*pBitProcBuf;
@@ -16,6 +16,7 @@
 #include "s3c_mfc_types.h"
 
 BOOL s3c_mfc_memmap_bitproc_buff(void);
+void s3c_mfc_unmap_bitproc_buff(void);
 volatile unsigned char *s3c_mfc_get_bitproc_buff_virt_addr(void);
 unsigned char *s3c_mfc_get_param_buff_virt_addr(void);
 
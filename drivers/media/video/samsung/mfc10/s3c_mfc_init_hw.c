@@ -12,6 +12,7 @@
  */
 
 #include <linux/kernel.h>
+#include <plat/media.h>
 
 #include "s3c_mfc_base.h"
 #include "s3c_mfc_sfr.h"
@@ -52,6 +53,15 @@ BOOL s3c_mfc_setup_memory(void)
 	return TRUE;
 }
 
+/* unmap the buffers and give the reserved memory back to the media pool */
+void s3c_mfc_release_memory(void)
+{
+	s3c_mfc_unmap_bitproc_buff();
+
+	s3c_put_media_memory(S3C_MDEV_MFC);
+	s3c_mfc_phys_buffer = 0;
+}
+
 
 BOOL s3c_mfc_init_hw(void)
 {
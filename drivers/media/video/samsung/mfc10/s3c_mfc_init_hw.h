@@ -16,6 +16,10 @@
 #include "s3c_mfc_types.h"
 
 BOOL s3c_mfc_setup_memory(void);
+void s3c_mfc_release_memory(void);
 BOOL s3c_mfc_init_hw(void);
 
+void s3c_mfc_power_up(void);
+void s3c_mfc_power_idle(void);
+
 #endif /* _S3C_MFC_HW_INIT_H */
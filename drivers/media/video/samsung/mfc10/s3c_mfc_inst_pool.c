@@ -11,8 +11,21 @@
  * published by the Free Software Foundation.
  */
 
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/sched.h>
+#include <linux/timer.h>
+
+#include <asm/div64.h>
+
+#include "s3c_mfc_base.h"
 #include "s3c_mfc_config.h"
+#include "s3c_mfc_init_hw.h"
 #include "s3c_mfc_inst_pool.h"
+#include "s3c_mfc_sfr.h"
+#include "s3c_mfc.h"
 
 #if !defined(S3C_MFC_NUM_INSTANCES_MAX)
 #error "S3C_MFC_NUM_INSTANCES_MAX should be defined."
@@ -96,3 +109,286 @@ void s3c_mfc_release_all_inst_pool(void)
 		}
 	}
 }
+
+
+/* a frame that does not complete within this is failed, as with the synchronous commands */
+#define S3C_MFC_JOB_TIMEOUT	500	/* jiffies */
+
+static s3c_mfc_job_t s3c_mfc_jobs[S3C_MFC_NUM_INSTANCES_MAX];
+static LIST_HEAD(s3c_mfc_job_queue);
+static s3c_mfc_job_t *s3c_mfc_job_running = NULL;
+static int s3c_mfc_hw_held = 0;
+
+static DEFINE_SPINLOCK(s3c_mfc_job_lock);
+static DECLARE_WAIT_QUEUE_HEAD(s3c_mfc_job_wait);
+
+static void s3c_mfc_job_timeout(unsigned long data);
+static DEFINE_TIMER(s3c_mfc_job_timer, s3c_mfc_job_timeout, 0, 0);
+
+s3c_mfc_job_t *s3c_mfc_get_job(s3c_mfc_inst_context_t *ctx)
+{
+	s3c_mfc_job_t *job = &s3c_mfc_jobs[ctx->inst_no];
+
+	job->ctx = ctx;
+
+	return job;
+}
+
+/* called with s3c_mfc_job_lock held */
+static void s3c_mfc_run_next_job(void)
+{
+	s3c_mfc_job_t *job;
+
+	if (s3c_mfc_job_running || s3c_mfc_hw_held)
+		return;
+
+	if (list_empty(&s3c_mfc_job_queue)) {
+		/* nothing left to do, the MFC may be gated after a while */
+		s3c_mfc_power_idle();
+		return;
+	}
+
+	job = list_first_entry(&s3c_mfc_job_queue, s3c_mfc_job_t, list);
+	list_del_init(&job->list);
+
+	job->state = S3C_MFC_JOB_RUNNING;
+	job->start = ktime_get();
+	s3c_mfc_job_running = job;
+
+	if (job->type == S3C_MFC_JOB_DEC)
+		s3c_mfc_inst_dec_start(job->ctx, job->strm_leng);
+	else
+		s3c_mfc_inst_enc_start(job->ctx);
+
+	mod_timer(&s3c_mfc_job_timer, jiffies + S3C_MFC_JOB_TIMEOUT);
+}
+
+/* called with s3c_mfc_job_lock held */
+static void s3c_mfc_complete_job(s3c_mfc_job_t *job, int ret)
+{
+	unsigned int us;
+
+	us = (unsigned int)ktime_us_delta(ktime_get(), job->start);
+	job->busy_us += us;
+	if (us > job->max_us)
+		job->max_us = us;
+
+	job->nr_frames++;
+	if (ret != S3C_MFC_INST_RET_OK)
+		job->nr_errors++;
+
+	job->ret = ret;
+	job->state = S3C_MFC_JOB_DONE;
+	s3c_mfc_job_running = NULL;
+
+	if (job->done)
+		job->done(job->priv);
+
+	wake_up(&s3c_mfc_job_wait);
+}
+
+/* 
+ * Queue the frame of the job's instance. 
+ * The caller has made the stream or yuv buffer visible to the MFC,
+ * and holds s3c_mfc_mutex.
+ */
+int s3c_mfc_submit_job(s3c_mfc_job_t *job, int type, unsigned long strm_leng)
+{
+	unsigned long flags;
+
+	s3c_mfc_power_up();
+
+	spin_lock_irqsave(&s3c_mfc_job_lock, flags);
+
+	if (job->state != S3C_MFC_JOB_IDLE) {
+		spin_unlock_irqrestore(&s3c_mfc_job_lock, flags);
+		return -EBUSY;
+	}
+
+	job->type = type;
+	job->strm_leng = strm_leng;
+	job->ret = S3C_MFC_INST_RET_OK;
+	job->state = S3C_MFC_JOB_QUEUED;
+	list_add_tail(&job->list, &s3c_mfc_job_queue);
+
+	s3c_mfc_run_next_job();
+
+	spin_unlock_irqrestore(&s3c_mfc_job_lock, flags);
+
+	return 0;
+}
+
+/* wait until the job's frame is done; it returns 0 or -ERESTARTSYS */
+int s3c_mfc_wait_job(s3c_mfc_job_t *job, int interruptible)
+{
+	if (interruptible)
+		return wait_event_interruptible(s3c_mfc_job_wait, 
+				job->state == S3C_MFC_JOB_DONE || job->state == S3C_MFC_JOB_IDLE);
+
+	wait_event(s3c_mfc_job_wait, 
+		job->state == S3C_MFC_JOB_DONE || job->state == S3C_MFC_JOB_IDLE);
+
+	return 0;
+}
+
+/* drop the job's frame, waiting for it if the MFC is already running it */
+void s3c_mfc_cancel_job(s3c_mfc_job_t *job)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&s3c_mfc_job_lock, flags);
+	if (job->state == S3C_MFC_JOB_QUEUED) {
+		list_del_init(&job->list);
+		job->state = S3C_MFC_JOB_IDLE;
+	}
+	spin_unlock_irqrestore(&s3c_mfc_job_lock, flags);
+
+	wait_event(s3c_mfc_job_wait, job->state != S3C_MFC_JOB_RUNNING);
+
+	job->state = S3C_MFC_JOB_IDLE;
+
+	if (job->hdr_buf) {
+		kfree(job->hdr_buf);
+		job->hdr_buf = NULL;
+	}
+
+	job->nr_frames = 0;
+	job->nr_errors = 0;
+	job->busy_us = 0;
+	job->max_us = 0;
+
+	job->done = NULL;
+	job->priv = NULL;
+}
+
+void s3c_mfc_poll_job(struct file *file, poll_table *wait)
+{
+	poll_wait(file, &s3c_mfc_job_wait, wait);
+}
+
+/* 
+ * Called from the MFC interrupt handler. 
+ * It returns 1 if the interrupt completed a queued frame.
+ */
+int s3c_mfc_job_irq(unsigned int intr_reason)
+{
+	s3c_mfc_job_t *job;
+	int ret;
+
+	spin_lock(&s3c_mfc_job_lock);
+
+	job = s3c_mfc_job_running;
+	if (job == NULL) {
+		spin_unlock(&s3c_mfc_job_lock);
+		return 0;
+	}
+
+	del_timer(&s3c_mfc_job_timer);
+
+	if (job->type == S3C_MFC_JOB_DEC)
+		ret = s3c_mfc_inst_dec_done(job->ctx, intr_reason);
+	else
+		ret = s3c_mfc_inst_enc_done(job->ctx, intr_reason, &job->enc_size);
+
+	s3c_mfc_complete_job(job, ret);
+	s3c_mfc_run_next_job();
+
+	spin_unlock(&s3c_mfc_job_lock);
+
+	return 1;
+}
+
+static void s3c_mfc_job_timeout(unsigned long data)
+{
+	s3c_mfc_job_t *job;
+	unsigned long flags;
+
+	spin_lock_irqsave(&s3c_mfc_job_lock, flags);
+
+	job = s3c_mfc_job_running;
+	if (job) {
+		mfc_err("instance %d, PIC_RUN timed out\n", job->ctx->inst_no);
+		s3c_mfc_stream_end();
+		s3c_mfc_complete_job(job, (job->type == S3C_MFC_JOB_DEC) ? 
+			S3C_MFC_INST_ERR_DEC_PIC_RUN_CMD_FAIL : S3C_MFC_INST_ERR_ENC_PIC_RUN_CMD_FAIL);
+		s3c_mfc_run_next_job();
+	}
+
+	spin_unlock_irqrestore(&s3c_mfc_job_lock, flags);
+}
+
+/* 
+ * Take the MFC for synchronous commands (SEQ_INIT, ENC_HEADER, ...): 
+ * wait for the running frame and keep the queued ones from starting.
+ * It is called with s3c_mfc_mutex held.
+ */
+void s3c_mfc_hold_hw(void)
+{
+	unsigned long flags;
+
+	s3c_mfc_power_up();
+
+	spin_lock_irqsave(&s3c_mfc_job_lock, flags);
+	s3c_mfc_hw_held++;
+	spin_unlock_irqrestore(&s3c_mfc_job_lock, flags);
+
+	wait_event(s3c_mfc_job_wait, s3c_mfc_job_running == NULL);
+}
+
+void s3c_mfc_release_hw(void)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&s3c_mfc_job_lock, flags);
+	if (--s3c_mfc_hw_held == 0)
+		s3c_mfc_run_next_job();
+	spin_unlock_irqrestore(&s3c_mfc_job_lock, flags);
+}
+
+/* no frame is queued or running and nobody holds the MFC */
+int s3c_mfc_hw_idle(void)
+{
+	unsigned long flags;
+	int idle;
+
+	spin_lock_irqsave(&s3c_mfc_job_lock, flags);
+	idle = !s3c_mfc_job_running && !s3c_mfc_hw_held && list_empty(&s3c_mfc_job_queue);
+	spin_unlock_irqrestore(&s3c_mfc_job_lock, flags);
+
+	return idle;
+}
+
+/* 
+ * Per instance: frames run, failed frames and the time the MFC was busy 
+ * with them. The busy time is what the instance costs in active power.
+ */
+void s3c_mfc_show_job_stats(struct seq_file *s)
+{
+	s3c_mfc_job_t job;
+	unsigned long flags;
+	u64 busy_ms, avg_us;
+	int i;
+
+	seq_printf(s, "%-4s %8s %6s %10s %8s %8s\n",
+		"inst", "frames", "errors", "busy(ms)", "avg(us)", "max(us)");
+
+	for (i = 0; i < S3C_MFC_NUM_INSTANCES_MAX; i++) {
+		if (s3c_mfc_inst_status[i] == 0)
+			continue;
+
+		spin_lock_irqsave(&s3c_mfc_job_lock, flags);
+		job = s3c_mfc_jobs[i];
+		spin_unlock_irqrestore(&s3c_mfc_job_lock, flags);
+
+		busy_ms = job.busy_us;
+		do_div(busy_ms, 1000);
+
+		avg_us = job.busy_us;
+		if (job.nr_frames)
+			do_div(avg_us, job.nr_frames);
+
+		seq_printf(s, "%-4d %8u %6u %10lu %8lu %8u\n", i,
+			job.nr_frames, job.nr_errors, (unsigned long)busy_ms,
+			(unsigned long)avg_us, job.max_us);
+	}
+}
@@ -13,6 +13,14 @@
 #ifndef _S3C_MFC_INST_POOL_H
 #define _S3C_MFC_INST_POOL_H
 
+#include <linux/list.h>
+#include <linux/fs.h>
+#include <linux/poll.h>
+#include <linux/ktime.h>
+#include <linux/seq_file.h>
+
+#include "s3c_mfc_instance.h"
+
 int s3c_mfc_get_avail_inst_pool_num(void);
 
 int s3c_mfc_occupy_inst_pool(void);
@@ -21,4 +29,57 @@ int s3c_mfc_release_inst_pool(int instance_no);
 void s3c_mfc_occupy_all_inst_pool(void);
 void s3c_mfc_release_all_inst_pool(void);
 
+/* 
+ * Frame jobs
+ * Each instance has at most one frame (PIC_RUN) queued to the MFC.
+ * The frames of all instances are run in submission order, which is 
+ * round robin between the instances since none can have two queued.
+ * The interrupt handler starts the next frame when one completes.
+ */
+#define S3C_MFC_JOB_DEC		0
+#define S3C_MFC_JOB_ENC		1
+
+#define S3C_MFC_JOB_IDLE	0	/* no frame, or its result was collected */
+#define S3C_MFC_JOB_QUEUED	1
+#define S3C_MFC_JOB_RUNNING	2
+#define S3C_MFC_JOB_DONE	3	/* result not yet collected */
+
+typedef struct {
+	struct list_head	list;
+	s3c_mfc_inst_context_t	*ctx;
+	int			type;
+	volatile int		state;
+	int			ret;		/* S3C_MFC_INST_RET_OK or error code */
+
+	unsigned long		strm_leng;	/* decoding: stream size in the line buffer */
+
+	unsigned char		*hdr_buf;	/* encoding: stream headers to put in front */
+	int			hdr_size;
+	int			enc_size;	/* encoding: size of the encoded frame */
+
+	/* called when the frame is done, in interrupt context; cleared on close */
+	void			(*done)(void *priv);
+	void			*priv;
+
+	/* statistics of the instance, cleared when it is closed */
+	ktime_t			start;
+	unsigned int		nr_frames;
+	unsigned int		nr_errors;
+	u64			busy_us;	/* time the MFC spent on its frames */
+	unsigned int		max_us;
+} s3c_mfc_job_t;
+
+s3c_mfc_job_t *s3c_mfc_get_job(s3c_mfc_inst_context_t *ctx);
+int  s3c_mfc_submit_job(s3c_mfc_job_t *job, int type, unsigned long strm_leng);
+int  s3c_mfc_wait_job(s3c_mfc_job_t *job, int interruptible);
+void s3c_mfc_cancel_job(s3c_mfc_job_t *job);
+void s3c_mfc_poll_job(struct file *file, poll_table *wait);
+int  s3c_mfc_job_irq(unsigned int intr_reason);
+
+void s3c_mfc_hold_hw(void);
+void s3c_mfc_release_hw(void);
+int  s3c_mfc_hw_idle(void);
+
+void s3c_mfc_show_job_stats(struct seq_file *s);
+
 #endif /* _S3C_MFC_INST_POOL_H */
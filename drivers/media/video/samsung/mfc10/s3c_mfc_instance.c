@@ -28,6 +28,7 @@
 #include "s3c_mfc_yuv_buf_manager.h"
 #include "s3c_mfc_config.h"
 #include "s3c_mfc_sfr.h"
+#include "s3c_mfc_intr_noti.h"
 #include "s3c_mfc_bitproc_buf.h"
 #include "s3c_mfc_inst_pool.h"
 #include "s3c_mfc.h"
@@ -753,14 +754,17 @@ int s3c_mfc_instance_init_enc(s3c_mfc_inst_context_t *ctx, s3c_mfc_codec_mode_t
 	return S3C_MFC_INST_RET_OK;
 }
 
-/* this function decodes the input stream and put the decoded frame into the yuv buffer */
-int s3c_mfc_inst_dec(s3c_mfc_inst_context_t *ctx, unsigned long strm_leng)
+/*
+ * This decodes the input stream and puts the decoded frame into the yuv buffer.
+ * Decoding a frame is split in three steps so that the frames of several
+ * instances can be queued to the MFC (see s3c_mfc_inst_pool.c):
+ *   s3c_mfc_inst_dec_prepare() checks the state when the frame is submitted,
+ *   s3c_mfc_inst_dec_start() issues PIC_RUN when the MFC becomes free,
+ *   s3c_mfc_inst_dec_done() collects the result from the interrupt handler.
+ * The last two run in interrupt context.
+ */
+int s3c_mfc_inst_dec_prepare(s3c_mfc_inst_context_t *ctx)
 {
-#if (S3C_MFC_ROTATE_ENABLE == 1)
-	int frame_size;	// width * height
-#endif
-	int frm_size;
-
 	/* checking state */
 	if (S3C_MFC_INST_STATE_CHECK(ctx, S3C_MFC_INST_STATE_DELETED)) {
 		mfc_err("mfc instance is deleted\n");
@@ -775,6 +779,33 @@ int s3c_mfc_inst_dec(s3c_mfc_inst_context_t *ctx, unsigned long strm_leng)
 		return S3C_MFC_INST_ERR_STATE_CHK;
 	}
 
+	return S3C_MFC_INST_RET_OK;
+}
+
+/* 
+ * The post-rotator, with no rotation, copies the display frame to 
+ * ctx->dst_phys_addr (YUV420 planar, buf_width stride) so that it 
+ * can be decoded straight into a buffer of the caller.
+ */
+static void s3c_mfc_inst_set_dec_dst(s3c_mfc_inst_context_t *ctx)
+{
+	int frame_size = ctx->buf_width * ctx->buf_height;
+
+	writel(0x0010, s3c_mfc_sfr_base_virt_addr + S3C_MFC_PARAM_DEC_PIC_ROT_MODE);
+	writel(ctx->dst_phys_addr, s3c_mfc_sfr_base_virt_addr + S3C_MFC_PARAM_DEC_PIC_ROT_ADDR_Y);
+	writel(ctx->dst_phys_addr + frame_size, s3c_mfc_sfr_base_virt_addr + S3C_MFC_PARAM_DEC_PIC_ROT_ADDR_CB);
+	writel(ctx->dst_phys_addr + frame_size + (frame_size >> 2), 	\
+					s3c_mfc_sfr_base_virt_addr + S3C_MFC_PARAM_DEC_PIC_ROT_ADDR_CR);
+	writel(ctx->buf_width, s3c_mfc_sfr_base_virt_addr + S3C_MFC_PARAM_DEC_PIC_ROT_STRIDE);
+}
+
+void s3c_mfc_inst_dec_start(s3c_mfc_inst_context_t *ctx, unsigned long strm_leng)
+{
+#if (S3C_MFC_ROTATE_ENABLE == 1)
+	int frame_size;	// width * height
+#endif
+	int frm_size;
+
 	/*
 	 * (strm_leng > 0) means that the video stream is waiting for being decoded in the STRM_LINE_BUF
 	 * otherwise, no more video streams are available and the decode command will flush the decoded YUV data
@@ -817,10 +848,13 @@ int s3c_mfc_inst_dec(s3c_mfc_inst_context_t *ctx, unsigned long strm_leng)
 		}
 
 		/* set the parameters in the parameters buffer for PIC_RUN command */
-		writel(ctx->post_rotation_mode, s3c_mfc_sfr_base_virt_addr + S3C_MFC_PARAM_DEC_PIC_RUN);
+		if (ctx->dst_phys_addr)
+			s3c_mfc_inst_set_dec_dst(ctx);
+		else
+			writel(ctx->post_rotation_mode, s3c_mfc_sfr_base_virt_addr + S3C_MFC_PARAM_DEC_PIC_RUN);
 		
 #if (S3C_MFC_ROTATE_ENABLE == 1)
-		if (ctx->post_rotation_mode & 0x0010) {	/* the bit of 'post_rotataion_enable' is 1 */
+		if (!ctx->dst_phys_addr && (ctx->post_rotation_mode & 0x0010)) {	/* the bit of 'post_rotataion_enable' is 1 */
 			unsigned int dec_pic_rot_addr_y;
 
 			frame_size = ctx->buf_width * ctx->buf_height;
@@ -860,15 +894,24 @@ int s3c_mfc_inst_dec(s3c_mfc_inst_context_t *ctx, unsigned long strm_leng)
 							s3c_mfc_sfr_base_virt_addr + S3C_MFC_PARAM_DEC_PIC_START_BYTE);
 		writel(strm_leng, s3c_mfc_sfr_base_virt_addr + S3C_MFC_PARAM_DEC_PIC_CHUNK_SIZE);
 	} else {
-		writel(strm_leng, s3c_mfc_sfr_base_virt_addr + S3C_MFC_PARAM_DEC_PIC_RUN);
+		if (ctx->dst_phys_addr)
+			s3c_mfc_inst_set_dec_dst(ctx);
+		else
+			writel(strm_leng, s3c_mfc_sfr_base_virt_addr + S3C_MFC_PARAM_DEC_PIC_RUN);
 		s3c_mfc_set_eos(1);
 	}
 
 	/* issue the PIC_RUN command */
-	if (!s3c_mfc_issue_command(ctx->inst_no, ctx->codec_mode, PIC_RUN)) {
+	s3c_mfc_start_command(ctx->inst_no, ctx->codec_mode, PIC_RUN);
+}
+
+int s3c_mfc_inst_dec_done(s3c_mfc_inst_context_t *ctx, unsigned int intr_reason)
+{
+	if (intr_reason & S3C_MFC_INTR_REASON_BUFFER_EMPTY) {
+		mfc_err("command = PIC_RUN, BUFFER EMPTY interrupt was raised\n");
 		return S3C_MFC_INST_ERR_DEC_PIC_RUN_CMD_FAIL;
 	}
-	
+
 	if (readl(s3c_mfc_sfr_base_virt_addr + S3C_MFC_PARAM_RET_DEC_PIC_SUCCESS) != 1) {
 		mfc_warn("RET_DEC_PIC_SUCCESS is not value of 1(=SUCCESS) value is %d\n", \
 			readl(s3c_mfc_sfr_base_virt_addr + S3C_MFC_PARAM_RET_DEC_PIC_SUCCESS));
@@ -907,13 +950,23 @@ int s3c_mfc_inst_dec(s3c_mfc_inst_context_t *ctx, unsigned long strm_leng)
 	return S3C_MFC_INST_RET_OK;
 }
 
-int s3c_mfc_inst_enc(s3c_mfc_inst_context_t *ctx, int *enc_data_size, int *header_size)
+/*
+ * Encoding a frame is split the same way as decoding.
+ * s3c_mfc_inst_enc_prepare() also generates the stream headers (ENC_HEADER)
+ * that have to precede the frame; it holds the MFC for that.
+ * s3c_mfc_inst_enc_finish() puts the headers in front of the encoded frame
+ * once the frame is done.
+ */
+int s3c_mfc_inst_enc_prepare(s3c_mfc_inst_context_t *ctx, unsigned char **hdr_buf, int *hdr_buf_size)
 {
-	int hdr_size, hdr_size2;
+	int hdr_size = 0, hdr_size2;
 	int size;
-	unsigned int bits_wr_ptr_value = 0;
+	int hold;
 	unsigned char *hdr_buf_tmp=NULL;
-	unsigned char	*start, *end;
+	unsigned char	*start;
+
+	*hdr_buf = NULL;
+	*hdr_buf_size = 0;
 
 	/* checking state */
 	if (!S3C_MFC_INST_STATE_CHECK(ctx, S3C_MFC_INST_STATE_ENC_INITIALIZED) && 	\
@@ -922,7 +975,13 @@ int s3c_mfc_inst_enc(s3c_mfc_inst_context_t *ctx, int *enc_data_size, int *heade
 		return S3C_MFC_INST_ERR_STATE_CHK;
 	}
 
-	/* the 1st call of this function (s3c_mfc_inst_enc) will generate the stream header (mpeg4:VOL, h264:SPS/PPS) */
+	/* the headers are made with synchronous commands, other instances' frames must not run */
+	hold = S3C_MFC_INST_STATE_CHECK(ctx, S3C_MFC_INST_STATE_ENC_INITIALIZED) ||
+		ctx->enc_change_framerate || (ctx->enc_pic_option & 0x0F000000);
+	if (hold)
+		s3c_mfc_hold_hw();
+
+	/* the 1st call of this function (s3c_mfc_inst_enc_prepare) will generate the stream header (mpeg4:VOL, h264:SPS/PPS) */
 	if (S3C_MFC_INST_STATE_CHECK(ctx, S3C_MFC_INST_STATE_ENC_INITIALIZED)) {
 		if (ctx->codec_mode == MP4_ENC) {
 			/*  ENC_HEADER command  */
@@ -938,6 +997,8 @@ int s3c_mfc_inst_enc(s3c_mfc_inst_context_t *ctx, int *enc_data_size, int *heade
 				size = hdr_size;
 				dma_cache_maint(start, size, DMA_FROM_DEVICE);
 			} else {
+				if (hold)
+					s3c_mfc_release_hw();
 				return S3C_MFC_INST_ERR_MEMORY_ALLOCATION_FAIL;
 			}
 		} else if (ctx->codec_mode == AVC_ENC) {
@@ -965,6 +1026,8 @@ int s3c_mfc_inst_enc(s3c_mfc_inst_context_t *ctx, int *enc_data_size, int *heade
 	
 				hdr_size += hdr_size2;
 			} else {
+				if (hold)
+					s3c_mfc_release_hw();
                 		return S3C_MFC_INST_ERR_MEMORY_ALLOCATION_FAIL;
             		}
 		}
@@ -987,8 +1050,11 @@ int s3c_mfc_inst_enc(s3c_mfc_inst_context_t *ctx, int *enc_data_size, int *heade
 			start = ctx->stream_buffer;
 			size = hdr_size;
 			dma_cache_maint(start, size, DMA_FROM_DEVICE);	
-		} else 
-			return S3C_MFC_INST_ERR_MEMORY_ALLOCATION_FAIL;            							
+		} else {
+			if (hold)
+				s3c_mfc_release_hw();
+			return S3C_MFC_INST_ERR_MEMORY_ALLOCATION_FAIL;
+		}
     	}
 
 	/* SEI message with recovery point */
@@ -1006,10 +1072,23 @@ int s3c_mfc_inst_enc(s3c_mfc_inst_context_t *ctx, int *enc_data_size, int *heade
 			dma_cache_maint(start, size, DMA_FROM_DEVICE);
 		
 		} else {
+			if (hold)
+				s3c_mfc_release_hw();
 			return S3C_MFC_INST_ERR_MEMORY_ALLOCATION_FAIL;
 		}
 	}
 
+	if (hold)
+		s3c_mfc_release_hw();
+
+	*hdr_buf = hdr_buf_tmp;
+	*hdr_buf_size = hdr_size;
+
+	return S3C_MFC_INST_RET_OK;
+}
+
+void s3c_mfc_inst_enc_start(s3c_mfc_inst_context_t *ctx)
+{
 	/* Set the address of each component of YUV420 */
 	writel(ctx->phys_addr_yuv_buffer, s3c_mfc_sfr_base_virt_addr + S3C_MFC_PARAM_ENC_PIC_SRC_ADDR_Y);
 	writel(ctx->phys_addr_yuv_buffer + ctx->buf_width * ctx->height, s3c_mfc_sfr_base_virt_addr + 	\
@@ -1021,7 +1100,15 @@ int s3c_mfc_inst_enc(s3c_mfc_inst_context_t *ctx, int *enc_data_size, int *heade
 	writel(ctx->phys_addr_stream_buffer, s3c_mfc_sfr_base_virt_addr + S3C_MFC_PARAM_ENC_PIC_BB_START);
 	writel(ctx->stream_buffer_size, s3c_mfc_sfr_base_virt_addr + S3C_MFC_PARAM_ENC_PIC_BB_SIZE);
 
-	if (!s3c_mfc_issue_command(ctx->inst_no, ctx->codec_mode, PIC_RUN)) {
+	s3c_mfc_start_command(ctx->inst_no, ctx->codec_mode, PIC_RUN);
+}
+
+int s3c_mfc_inst_enc_done(s3c_mfc_inst_context_t *ctx, unsigned int intr_reason, int *enc_data_size)
+{
+	unsigned int bits_wr_ptr_value = 0;
+
+	if (intr_reason & S3C_MFC_INTR_REASON_BUFFER_EMPTY) {
+		mfc_err("command = PIC_RUN, BUFFER EMPTY interrupt was raised\n");
 		return S3C_MFC_INST_ERR_ENC_PIC_RUN_CMD_FAIL;
 	}
 
@@ -1057,6 +1144,21 @@ int s3c_mfc_inst_enc(s3c_mfc_inst_context_t *ctx, int *enc_data_size, int *heade
 	}
 
 	*enc_data_size = bits_wr_ptr_value - ctx->phys_addr_stream_buffer;	
+
+	/* changing state */
+	/* state change to S3C_MFC_INST_STATE_ENC_PIC_RUN_LINE_BUF */
+	S3C_MFC_INST_STATE_TRANSITION(ctx, S3C_MFC_INST_STATE_ENC_PIC_RUN_LINE_BUF);
+
+	return S3C_MFC_INST_RET_OK;
+}
+
+/* the encoded frame is in the stream buffer, put the stream headers in front of it */
+void s3c_mfc_inst_enc_finish(s3c_mfc_inst_context_t *ctx, unsigned char *hdr_buf_tmp, int hdr_size,
+			     int *enc_data_size, int *header_size)
+{
+	int size;
+	unsigned char	*start;
+
 	*header_size = 0;
 
 	if (hdr_buf_tmp) {
@@ -1072,18 +1174,9 @@ int s3c_mfc_inst_enc(s3c_mfc_inst_context_t *ctx, int *enc_data_size, int *heade
 		size = hdr_size;
 		dma_cache_maint(start, size, DMA_TO_DEVICE);		
 
-		kfree(hdr_buf_tmp);
-
 		*enc_data_size += hdr_size;
 		*header_size    = hdr_size;
 	}
-
-	/* changing state */
-	/* state change to S3C_MFC_INST_STATE_ENC_PIC_RUN_LINE_BUF */
-	S3C_MFC_INST_STATE_TRANSITION(ctx, S3C_MFC_INST_STATE_ENC_PIC_RUN_LINE_BUF);
-
-
-	return S3C_MFC_INST_RET_OK;
 }
 
 /* hdr_code == 0: SPS */
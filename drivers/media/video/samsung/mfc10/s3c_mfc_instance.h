@@ -69,6 +69,8 @@ typedef struct
 	                              			/* encoding case: fixed at 2 (at lease 2 frame buffers) */
 
 	unsigned int    post_rotation_mode;
+	unsigned int	dst_phys_addr;			/* decoding: where the post-rotator puts the display frame, */
+							/*           0 leaves it in the frame buffers */
 
 	unsigned int    dec_pic_option;			/* 0-th bit : MP4ASP FLAG, */
 							/* 1-st bit : MV REPORT ENABLE, */
@@ -142,10 +144,16 @@ void s3c_mfc_inst_pow_off_state(s3c_mfc_inst_context_t *ctx);
 void s3c_mfc_inst_pow_on_state(s3c_mfc_inst_context_t *ctx);
 
 int  s3c_mfc_inst_init_dec(s3c_mfc_inst_context_t *ctx, s3c_mfc_codec_mode_t codec_mode, unsigned long strm_leng);
-int  s3c_mfc_inst_dec(s3c_mfc_inst_context_t *ctx, unsigned long arg);
+int  s3c_mfc_inst_dec_prepare(s3c_mfc_inst_context_t *ctx);
+void s3c_mfc_inst_dec_start(s3c_mfc_inst_context_t *ctx, unsigned long strm_leng);
+int  s3c_mfc_inst_dec_done(s3c_mfc_inst_context_t *ctx, unsigned int intr_reason);
 
 int  s3c_mfc_instance_init_enc(s3c_mfc_inst_context_t *ctx, s3c_mfc_codec_mode_t codec_mode, s3c_mfc_enc_info_t *enc_info);
-int  s3c_mfc_inst_enc(s3c_mfc_inst_context_t *ctx, int *enc_data_size, int *header_size);
+int  s3c_mfc_inst_enc_prepare(s3c_mfc_inst_context_t *ctx, unsigned char **hdr_buf, int *hdr_buf_size);
+void s3c_mfc_inst_enc_start(s3c_mfc_inst_context_t *ctx);
+int  s3c_mfc_inst_enc_done(s3c_mfc_inst_context_t *ctx, unsigned int intr_reason, int *enc_data_size);
+void s3c_mfc_inst_enc_finish(s3c_mfc_inst_context_t *ctx, unsigned char *hdr_buf, int hdr_size, 
+			     int *enc_data_size, int *header_size);
 int  s3c_mfc_inst_enc_header(s3c_mfc_inst_context_t *ctx, int hdr_code, int hdr_num, unsigned int outbuf_physical_addr, int outbuf_size, int *hdr_size);
 int  s3c_mfc_inst_enc_param_change(s3c_mfc_inst_context_t *ctx, unsigned int param_change_enable, unsigned int param_change_val);
 
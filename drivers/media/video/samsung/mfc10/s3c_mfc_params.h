@@ -46,6 +46,13 @@ typedef struct {
 	int in_strmSize;	/* [IN]  Size of video stream filled in STRM_BUF */
 } s3c_mfc_dec_exe_arg_t;
 
+/* result of a frame submitted with O_NONBLOCK, see S3C_MFC_IOCTL_MFC_WAIT_EXE */
+typedef struct {
+	int ret_code;		/* [OUT] Return code of the frame */
+	int out_encoded_size;	/* [OUT] Encoder: length of encoded video stream */
+	int out_header_size;	/* [OUT] Encoder: length of video stream header */
+} s3c_mfc_wait_exe_arg_t;
+
 typedef struct {
 	int ret_code;		/* [OUT] Return code */
 	int in_usr_data;	/* [IN]  User data for translating Kernel-mode address to User-mode address */
@@ -91,6 +98,7 @@ typedef union {
 	s3c_mfc_enc_exe_arg_t		enc_exe;
 	s3c_mfc_dec_init_arg_t		dec_init;
 	s3c_mfc_dec_exe_arg_t		dec_exe;
+	s3c_mfc_wait_exe_arg_t		wait_exe;
 	s3c_mfc_get_buf_addr_arg_t		get_buf_addr;
 	s3c_mfc_get_config_arg_t		get_config;
 	s3c_mfc_set_config_arg_t		set_config;
@@ -136,10 +136,13 @@ int s3c_mfc_get_firmware_ver(void)
 }
 
 
-BOOL s3c_mfc_issue_command(int inst_no, s3c_mfc_codec_mode_t codec_mode, s3c_mfc_command_t mfc_cmd)
+/* 
+ * Issue the command without waiting for it.
+ * It is safe to call from the interrupt handler; 
+ * the completion is signalled by the MFC interrupt.
+ */
+void s3c_mfc_start_command(int inst_no, s3c_mfc_codec_mode_t codec_mode, s3c_mfc_command_t mfc_cmd)
 {
-	unsigned int intr_reason;
-
 	writel(inst_no, s3c_mfc_sfr_base_virt_addr + S3C_MFC_RUN_INDEX);
 
 	if (codec_mode == H263_DEC) {
@@ -150,11 +153,18 @@ BOOL s3c_mfc_issue_command(int inst_no, s3c_mfc_codec_mode_t codec_mode, s3c_mfc
 		writel(codec_mode, s3c_mfc_sfr_base_virt_addr + S3C_MFC_RUN_COD_STD);
 	}
 
+	writel(mfc_cmd, s3c_mfc_sfr_base_virt_addr + S3C_MFC_RUN_CMD);
+}
+
+BOOL s3c_mfc_issue_command(int inst_no, s3c_mfc_codec_mode_t codec_mode, s3c_mfc_command_t mfc_cmd)
+{
+	unsigned int intr_reason;
+
 	switch (mfc_cmd) {
 	case PIC_RUN:
 	case SEQ_INIT:
 	case SEQ_END:
-		writel(mfc_cmd, s3c_mfc_sfr_base_virt_addr + S3C_MFC_RUN_CMD);
+		s3c_mfc_start_command(inst_no, codec_mode, mfc_cmd);
 
 		if(interruptible_sleep_on_timeout(&s3c_mfc_wait_queue, 500) == 0) {
 			s3c_mfc_stream_end();
@@ -182,7 +192,7 @@ BOOL s3c_mfc_issue_command(int inst_no, s3c_mfc_codec_mode_t codec_mode, s3c_mfc
 			return FALSE;
 		}
 
-		writel(mfc_cmd, s3c_mfc_sfr_base_virt_addr + S3C_MFC_RUN_CMD);
+		s3c_mfc_start_command(inst_no, codec_mode, mfc_cmd);
 		s3c_mfc_wait_for_ready();
 
 	} 
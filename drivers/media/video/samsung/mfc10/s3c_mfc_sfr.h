@@ -19,6 +19,7 @@
 int s3c_mfc_sleep(void);
 int s3c_mfc_wakeup(void);
 BOOL s3c_mfc_issue_command(int inst_no, s3c_mfc_codec_mode_t codec_mode, s3c_mfc_command_t mfc_cmd);
+void s3c_mfc_start_command(int inst_no, s3c_mfc_codec_mode_t codec_mode, s3c_mfc_command_t mfc_cmd);
 int  s3c_mfc_get_firmware_ver(void);
 
 void s3c_mfc_reset(void);
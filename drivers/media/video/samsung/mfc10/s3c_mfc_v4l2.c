@@ -0,0 +1,1074 @@
+/* linux/driver/media/video/mfc/s3c_mfc_v4l2.c
+ *
+ * V4L2 decoder interface of the Samsung MFC (Multi Function Codec - FIMV) driver
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/*
+ * Each open of the video device is one decoding instance of the MFC with
+ * two buffer queues, memory to memory:
+ *   OUTPUT  takes the bitstream, one frame (or NAL units of one picture) per buffer,
+ *   CAPTURE gives back the decoded frames, YUV 4:2:0 planar, buf_width stride.
+ * A frame is queued to the MFC as soon as both queues have a buffer, through
+ * the frame jobs of s3c_mfc_inst_pool.c, so the instances opened here share
+ * the MFC with the users of the MFC device.
+ *
+ * The first OUTPUT buffer must carry the sequence headers. The instance is
+ * initialized from it (SEQ_INIT), then it is decoded as the first frame; the
+ * CAPTURE format is known from then on. The post-rotator writes the display
+ * frame straight into the CAPTURE buffer.
+ * The CAPTURE buffers are taken from the MFC data buffer, the OUTPUT buffers
+ * from kernel memory since the bitstream is copied to the stream buffer of the
+ * instance anyway. USERPTR buffers are copied to and from them. An empty
+ * OUTPUT buffer flushes the delayed frames, and a CAPTURE buffer with
+ * bytesused 0 marks the end of the stream.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/list.h>
+#include <linux/poll.h>
+#include <linux/sched.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
+#include <linux/vmalloc.h>
+#include <linux/dma-mapping.h>
+#include <linux/platform_device.h>
+#include <linux/videodev2.h>
+#include <media/v4l2-dev.h>
+#include <media/v4l2-ioctl.h>
+
+#include <asm/uaccess.h>
+#include <asm/cacheflush.h>
+#include <asm/memory.h>
+
+#include "s3c_mfc_base.h"
+#include "s3c_mfc_config.h"
+#include "s3c_mfc_instance.h"
+#include "s3c_mfc_inst_pool.h"
+#include "s3c_mfc_databuf.h"
+#include "s3c_mfc_yuv_buf_manager.h"
+#include "s3c_mfc.h"
+#include "s3c_mfc_v4l2.h"
+
+#ifndef V4L2_PIX_FMT_MPEG4
+#define V4L2_PIX_FMT_MPEG4	v4l2_fourcc('M', 'P', 'G', '4')
+#endif
+#ifndef V4L2_PIX_FMT_H264
+#define V4L2_PIX_FMT_H264	v4l2_fourcc('H', '2', '6', '4')
+#endif
+#ifndef V4L2_PIX_FMT_H263
+#define V4L2_PIX_FMT_H263	v4l2_fourcc('H', '2', '6', '3')
+#endif
+#ifndef V4L2_PIX_FMT_VC1_ANNEX_G
+#define V4L2_PIX_FMT_VC1_ANNEX_G	v4l2_fourcc('V', 'C', '1', 'G')
+#endif
+
+#define S3C_MFC_V4L2_MAX_BUFS		8
+#define S3C_MFC_V4L2_STRM_SIZE		(256 * 1024)	/* default OUTPUT buffer size */
+
+/* mmap offset of the OUTPUT buffers, above any offset in the data buffer */
+#define S3C_MFC_V4L2_OUT_OFFSET		0x40000000
+
+/*
+ * Commit index of a buffer in the yuv buffer manager.
+ * 0 .. S3C_MFC_NUM_INSTANCES_MAX-1 are the frame buffers of the instances.
+ */
+#define S3C_MFC_V4L2_COMMIT(inst_no, qno, index)	\
+	(S3C_MFC_NUM_INSTANCES_MAX + ((inst_no) * 2 + (qno)) * S3C_MFC_V4L2_MAX_BUFS + (index))
+
+struct s3c_mfc_v4l2_fmt {
+	u32			pixelformat;
+	char			*description;
+	s3c_mfc_codec_mode_t	codec_mode;
+};
+
+static struct s3c_mfc_v4l2_fmt s3c_mfc_v4l2_formats[] = {
+	{
+		.pixelformat	= V4L2_PIX_FMT_MPEG4,
+		.description	= "MPEG-4 part 2",
+		.codec_mode	= MP4_DEC,
+	},
+	{
+		.pixelformat	= V4L2_PIX_FMT_H264,
+		.description	= "H.264",
+		.codec_mode	= AVC_DEC,
+	},
+	{
+		.pixelformat	= V4L2_PIX_FMT_H263,
+		.description	= "H.263",
+		.codec_mode	= H263_DEC,
+	},
+	{
+		.pixelformat	= V4L2_PIX_FMT_VC1_ANNEX_G,
+		.description	= "VC-1",
+		.codec_mode	= VC1_DEC,
+	},
+};
+
+#define S3C_MFC_V4L2_NR_FORMATS		ARRAY_SIZE(s3c_mfc_v4l2_formats)
+
+struct s3c_mfc_v4l2_buf {
+	struct list_head	list;		/* in queued or done of its queue */
+	struct v4l2_buffer	vb;
+	unsigned char		*vaddr;
+	unsigned int		paddr;		/* page aligned, CAPTURE only */
+	int			commit;		/* index in the yuv buffer manager */
+	atomic_t		mapcount;	/* user mappings */
+};
+
+struct s3c_mfc_v4l2_queue {
+	enum v4l2_buf_type	type;
+	enum v4l2_memory	memory;
+	unsigned int		buf_size;
+	unsigned int		nr_bufs;
+	int			streaming;
+	unsigned int		sequence;
+	struct s3c_mfc_v4l2_buf	bufs[S3C_MFC_V4L2_MAX_BUFS];
+	struct list_head	queued;		/* waiting for the MFC */
+	struct list_head	done;		/* waiting for DQBUF */
+};
+
+/*
+ * Everything but the wait queue is protected by s3c_mfc_mutex. The memory
+ * of the buffers is also protected by buf_lock, taken inside s3c_mfc_mutex:
+ * mmap runs under mmap_sem, which qbuf and dqbuf take under s3c_mfc_mutex
+ * when they copy USERPTR data, so mmap only takes buf_lock.
+ */
+struct s3c_mfc_v4l2_ctx {
+	s3c_mfc_inst_context_t		*inst;
+	s3c_mfc_job_t			*job;
+	struct s3c_mfc_v4l2_fmt		*fmt;		/* of the OUTPUT queue */
+
+	struct s3c_mfc_v4l2_queue	out;		/* bitstream */
+	struct s3c_mfc_v4l2_queue	cap;		/* decoded frames */
+
+	/* the buffers of the frame given to the MFC */
+	struct s3c_mfc_v4l2_buf		*run_out;
+	struct s3c_mfc_v4l2_buf		*run_cap;
+
+	int				seq_done;	/* SEQ_INIT done, the CAPTURE format is known */
+	int				error;		/* SEQ_INIT or a frame could not be started */
+
+	struct mutex			buf_lock;
+
+	struct work_struct		work;
+	wait_queue_head_t		wait;
+};
+
+static int s3c_mfc_v4l2_registered;
+
+
+static struct s3c_mfc_v4l2_queue *s3c_mfc_v4l2_get_queue(struct s3c_mfc_v4l2_ctx *ctx,
+							  enum v4l2_buf_type type)
+{
+	if (type == V4L2_BUF_TYPE_VIDEO_OUTPUT)
+		return &ctx->out;
+	if (type == V4L2_BUF_TYPE_VIDEO_CAPTURE)
+		return &ctx->cap;
+
+	return NULL;
+}
+
+static void s3c_mfc_v4l2_init_queue(struct s3c_mfc_v4l2_queue *q, enum v4l2_buf_type type,
+				    unsigned int buf_size)
+{
+	q->type = type;
+	q->memory = V4L2_MEMORY_MMAP;
+	q->buf_size = buf_size;
+	INIT_LIST_HEAD(&q->queued);
+	INIT_LIST_HEAD(&q->done);
+}
+
+static void s3c_mfc_v4l2_free_bufs(struct s3c_mfc_v4l2_queue *q)
+{
+	int i;
+
+	for (i = 0; i < q->nr_bufs; i++) {
+		if (q->type == V4L2_BUF_TYPE_VIDEO_OUTPUT)
+			vfree(q->bufs[i].vaddr);
+		else
+			s3c_mfc_free_yuv_buffer_mgr(q->bufs[i].commit);
+	}
+
+	q->nr_bufs = 0;
+	INIT_LIST_HEAD(&q->queued);
+	INIT_LIST_HEAD(&q->done);
+}
+
+/*
+ * The OUTPUT buffers are only read by the CPU, they don't take the data
+ * buffer the frame buffers of SEQ_INIT come from.
+ */
+static int s3c_mfc_v4l2_alloc_out_buf(struct s3c_mfc_v4l2_queue *q, struct s3c_mfc_v4l2_buf *buf)
+{
+	buf->vaddr = vmalloc_user(PAGE_ALIGN(q->buf_size));
+	if (buf->vaddr == NULL)
+		return -ENOMEM;
+
+	buf->paddr = 0;
+	buf->commit = -1;
+
+	return 0;
+}
+
+static int s3c_mfc_v4l2_alloc_cap_buf(struct s3c_mfc_v4l2_ctx *ctx, struct s3c_mfc_v4l2_queue *q,
+				      struct s3c_mfc_v4l2_buf *buf, int index)
+{
+	unsigned char *vaddr;
+	unsigned int paddr;
+
+	buf->commit = S3C_MFC_V4L2_COMMIT(ctx->inst->inst_no, 1, index);
+
+	/* one more page so that the buffer can be mapped from its start, whole pages */
+	vaddr = s3c_mfc_commit_yuv_buffer_mgr(buf->commit, PAGE_ALIGN(q->buf_size) + PAGE_SIZE);
+	if (vaddr == NULL)
+		return -ENOMEM;
+
+	paddr = s3c_mfc_get_databuf_phys_addr() +
+			(vaddr - (unsigned char *)s3c_mfc_get_databuf_virt_addr());
+	buf->paddr = PAGE_ALIGN(paddr);
+	buf->vaddr = vaddr + (buf->paddr - paddr);
+
+	return 0;
+}
+
+/* it returns the number of buffers it could allocate */
+static int s3c_mfc_v4l2_alloc_bufs(struct s3c_mfc_v4l2_ctx *ctx, struct s3c_mfc_v4l2_queue *q,
+				   unsigned int count)
+{
+	struct s3c_mfc_v4l2_buf *buf;
+	int ret;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		buf = &q->bufs[i];
+
+		if (q == &ctx->out)
+			ret = s3c_mfc_v4l2_alloc_out_buf(q, buf);
+		else
+			ret = s3c_mfc_v4l2_alloc_cap_buf(ctx, q, buf, i);
+		if (ret)
+			break;
+
+		atomic_set(&buf->mapcount, 0);
+
+		memset(&buf->vb, 0, sizeof(buf->vb));
+		buf->vb.index = i;
+		buf->vb.type = q->type;
+		buf->vb.memory = q->memory;
+		buf->vb.field = V4L2_FIELD_NONE;
+		buf->vb.length = q->buf_size;
+		if (q->memory != V4L2_MEMORY_MMAP)
+			continue;
+		if (q == &ctx->out)
+			buf->vb.m.offset = S3C_MFC_V4L2_OUT_OFFSET + i * PAGE_ALIGN(q->buf_size);
+		else
+			buf->vb.m.offset = buf->paddr - s3c_mfc_get_databuf_phys_addr();
+	}
+
+	q->nr_bufs = i;
+
+	return i;
+}
+
+/*
+ * SEQ_INIT from the first OUTPUT buffer. The buffer stays queued,
+ * it is decoded as the first frame.
+ */
+static void s3c_mfc_v4l2_init_seq(struct s3c_mfc_v4l2_ctx *ctx, struct s3c_mfc_v4l2_buf *out)
+{
+	s3c_mfc_inst_context_t *inst = ctx->inst;
+	int ret;
+
+	if (out->vb.bytesused == 0) {
+		mfc_err("the first buffer has no sequence headers\n");
+		ctx->error = 1;
+		wake_up_interruptible(&ctx->wait);
+		return;
+	}
+
+	memcpy(inst->stream_buffer, out->vaddr, out->vb.bytesused);
+	dma_cache_maint(inst->stream_buffer, out->vb.bytesused, DMA_TO_DEVICE);
+
+	s3c_mfc_hold_hw();
+	ret = s3c_mfc_inst_init_dec(inst, ctx->fmt->codec_mode, out->vb.bytesused);
+	s3c_mfc_release_hw();
+
+	if (ret != S3C_MFC_INST_RET_OK) {
+		mfc_err("fail to initialize the decoder from the first buffer (%d)\n", ret);
+		ctx->error = 1;
+	} else {
+		ctx->seq_done = 1;
+		ctx->cap.buf_size = (inst->buf_width * inst->buf_height * 3) >> 1;
+	}
+
+	wake_up_interruptible(&ctx->wait);
+}
+
+/* called from the MFC interrupt handler */
+static void s3c_mfc_v4l2_job_done(void *priv)
+{
+	struct s3c_mfc_v4l2_ctx *ctx = priv;
+
+	schedule_work(&ctx->work);
+}
+
+/* start what can be started; it is called with s3c_mfc_mutex held */
+static void s3c_mfc_v4l2_run(struct s3c_mfc_v4l2_ctx *ctx)
+{
+	s3c_mfc_inst_context_t *inst = ctx->inst;
+	struct s3c_mfc_v4l2_buf *out, *cap;
+	int ret;
+
+	if (ctx->error || !ctx->out.streaming || list_empty(&ctx->out.queued))
+		return;
+
+	out = list_first_entry(&ctx->out.queued, struct s3c_mfc_v4l2_buf, list);
+
+	if (!ctx->seq_done) {
+		s3c_mfc_v4l2_init_seq(ctx, out);
+		return;
+	}
+
+	if (ctx->run_out || !ctx->cap.streaming || list_empty(&ctx->cap.queued))
+		return;
+
+	cap = list_first_entry(&ctx->cap.queued, struct s3c_mfc_v4l2_buf, list);
+
+	if (out->vb.bytesused) {
+		memcpy(inst->stream_buffer, out->vaddr, out->vb.bytesused);
+		dma_cache_maint(inst->stream_buffer, out->vb.bytesused, DMA_TO_DEVICE);
+	}
+	/* no dirty line may be written back over the frame */
+	dma_cache_maint(cap->vaddr, ctx->cap.buf_size, DMA_FROM_DEVICE);
+
+	inst->dst_phys_addr = cap->paddr;
+	ctx->job->done = s3c_mfc_v4l2_job_done;
+	ctx->job->priv = ctx;
+
+	ret = s3c_mfc_inst_dec_prepare(inst);
+	if (ret == S3C_MFC_INST_RET_OK)
+		ret = s3c_mfc_submit_job(ctx->job, S3C_MFC_JOB_DEC, out->vb.bytesused);
+
+	if (ret != S3C_MFC_INST_RET_OK) {
+		mfc_err("fail to start decoding (%d)\n", ret);
+		ctx->error = 1;
+		wake_up_interruptible(&ctx->wait);
+		return;
+	}
+
+	list_del_init(&out->list);
+	list_del_init(&cap->list);
+	ctx->run_out = out;
+	ctx->run_cap = cap;
+}
+
+/* hand out the buffers of the decoded frame; it is called with s3c_mfc_mutex held */
+static void s3c_mfc_v4l2_collect(struct s3c_mfc_v4l2_ctx *ctx)
+{
+	s3c_mfc_inst_context_t *inst = ctx->inst;
+	s3c_mfc_job_t *job = ctx->job;
+	struct s3c_mfc_v4l2_buf *out = ctx->run_out;
+	struct s3c_mfc_v4l2_buf *cap = ctx->run_cap;
+
+	if (out == NULL || job->state != S3C_MFC_JOB_DONE)
+		return;
+
+	ctx->run_out = NULL;
+	ctx->run_cap = NULL;
+	inst->dst_phys_addr = 0;
+
+	out->vb.flags &= ~V4L2_BUF_FLAG_QUEUED;
+	out->vb.flags |= V4L2_BUF_FLAG_DONE;
+	list_add_tail(&out->list, &ctx->out.done);
+
+	if (job->ret == S3C_MFC_INST_RET_OK && inst->run_index >= 0) {
+		/* timestamp of the OUTPUT buffer that completed the frame */
+		dma_cache_maint(cap->vaddr, ctx->cap.buf_size, DMA_FROM_DEVICE);
+		cap->vb.bytesused = ctx->cap.buf_size;
+		cap->vb.timestamp = out->vb.timestamp;
+		cap->vb.sequence = ctx->cap.sequence++;
+	} else if (job->ret == S3C_MFC_INST_ERR_DEC_EOS) {
+		cap->vb.bytesused = 0;
+		cap->vb.sequence = ctx->cap.sequence++;
+	} else {
+		/* nothing to display yet, or a broken frame: the buffer is used again */
+		if (job->ret != S3C_MFC_INST_RET_OK)
+			mfc_warn("fail to decode a frame (%d)\n", job->ret);
+		list_add(&cap->list, &ctx->cap.queued);
+		cap = NULL;
+	}
+
+	if (cap) {
+		cap->vb.flags &= ~V4L2_BUF_FLAG_QUEUED;
+		cap->vb.flags |= V4L2_BUF_FLAG_DONE;
+		list_add_tail(&cap->list, &ctx->cap.done);
+	}
+
+	job->state = S3C_MFC_JOB_IDLE;
+
+	wake_up_interruptible(&ctx->wait);
+}
+
+static void s3c_mfc_v4l2_work(struct work_struct *work)
+{
+	struct s3c_mfc_v4l2_ctx *ctx = container_of(work, struct s3c_mfc_v4l2_ctx, work);
+
+	mutex_lock(s3c_mfc_mutex);
+	s3c_mfc_v4l2_collect(ctx);
+	s3c_mfc_v4l2_run(ctx);
+	mutex_unlock(s3c_mfc_mutex);
+}
+
+/* give back all the buffers of the queue; it is called with s3c_mfc_mutex held */
+static void s3c_mfc_v4l2_stop(struct s3c_mfc_v4l2_ctx *ctx, struct s3c_mfc_v4l2_queue *q)
+{
+	int i;
+
+	/* the frame in flight has a buffer of each queue */
+	if (ctx->run_out) {
+		s3c_mfc_wait_job(ctx->job, 0);
+		s3c_mfc_v4l2_collect(ctx);
+	}
+
+	for (i = 0; i < q->nr_bufs; i++)
+		q->bufs[i].vb.flags &= ~(V4L2_BUF_FLAG_QUEUED | V4L2_BUF_FLAG_DONE);
+
+	INIT_LIST_HEAD(&q->queued);
+	INIT_LIST_HEAD(&q->done);
+	q->streaming = 0;
+
+	wake_up_interruptible(&ctx->wait);
+}
+
+
+static int s3c_mfc_v4l2_querycap(struct file *file, void *fh, struct v4l2_capability *cap)
+{
+	strlcpy(cap->driver, "s3c-mfc", sizeof(cap->driver));
+	strlcpy(cap->card, "Samsung MFC decoder", sizeof(cap->card));
+	strlcpy(cap->bus_info, "AHB-bus", sizeof(cap->bus_info));
+
+	cap->version = 0;
+	cap->capabilities = (V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_VIDEO_OUTPUT | V4L2_CAP_STREAMING);
+
+	return 0;
+}
+
+static int s3c_mfc_v4l2_enum_fmt_vid_out(struct file *file, void *fh, struct v4l2_fmtdesc *f)
+{
+	struct s3c_mfc_v4l2_fmt *fmt;
+	int index = f->index;
+
+	if (index >= S3C_MFC_V4L2_NR_FORMATS)
+		return -EINVAL;
+
+	fmt = &s3c_mfc_v4l2_formats[index];
+
+	memset(f, 0, sizeof(*f));
+	f->index = index;
+	f->type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+	f->flags = V4L2_FMT_FLAG_COMPRESSED;
+	strlcpy(f->description, fmt->description, sizeof(f->description));
+	f->pixelformat = fmt->pixelformat;
+
+	return 0;
+}
+
+static int s3c_mfc_v4l2_enum_fmt_vid_cap(struct file *file, void *fh, struct v4l2_fmtdesc *f)
+{
+	if (f->index != 0)
+		return -EINVAL;
+
+	memset(f, 0, sizeof(*f));
+	f->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	strlcpy(f->description, "4:2:0, planar, Y-Cb-Cr", sizeof(f->description));
+	f->pixelformat = V4L2_PIX_FMT_YUV420;
+
+	return 0;
+}
+
+static int s3c_mfc_v4l2_g_fmt_vid_out(struct file *file, void *fh, struct v4l2_format *f)
+{
+	struct s3c_mfc_v4l2_ctx *ctx = fh;
+
+	memset(&f->fmt.pix, 0, sizeof(f->fmt.pix));
+
+	mutex_lock(s3c_mfc_mutex);
+	f->fmt.pix.pixelformat = ctx->fmt->pixelformat;
+	f->fmt.pix.field = V4L2_FIELD_NONE;
+	f->fmt.pix.sizeimage = ctx->out.buf_size;
+	mutex_unlock(s3c_mfc_mutex);
+
+	return 0;
+}
+
+static int s3c_mfc_v4l2_try_fmt_vid_out(struct file *file, void *fh, struct v4l2_format *f)
+{
+	struct v4l2_pix_format *pix = &f->fmt.pix;
+	int i;
+
+	for (i = 0; i < S3C_MFC_V4L2_NR_FORMATS; i++)
+		if (s3c_mfc_v4l2_formats[i].pixelformat == pix->pixelformat)
+			break;
+	if (i == S3C_MFC_V4L2_NR_FORMATS)
+		return -EINVAL;
+
+	if (pix->sizeimage == 0)
+		pix->sizeimage = S3C_MFC_V4L2_STRM_SIZE;
+	if (pix->sizeimage > S3C_MFC_LINE_BUF_SIZE_PER_INSTANCE)
+		pix->sizeimage = S3C_MFC_LINE_BUF_SIZE_PER_INSTANCE;
+
+	pix->width = 0;
+	pix->height = 0;
+	pix->bytesperline = 0;
+	pix->field = V4L2_FIELD_NONE;
+
+	return 0;
+}
+
+static int s3c_mfc_v4l2_s_fmt_vid_out(struct file *file, void *fh, struct v4l2_format *f)
+{
+	struct s3c_mfc_v4l2_ctx *ctx = fh;
+	int ret;
+	int i;
+
+	ret = s3c_mfc_v4l2_try_fmt_vid_out(file, fh, f);
+	if (ret)
+		return ret;
+
+	mutex_lock(s3c_mfc_mutex);
+
+	/* the codec is fixed by SEQ_INIT */
+	if (ctx->seq_done || ctx->out.nr_bufs) {
+		mutex_unlock(s3c_mfc_mutex);
+		return -EBUSY;
+	}
+
+	for (i = 0; i < S3C_MFC_V4L2_NR_FORMATS; i++)
+		if (s3c_mfc_v4l2_formats[i].pixelformat == f->fmt.pix.pixelformat)
+			ctx->fmt = &s3c_mfc_v4l2_formats[i];
+	ctx->out.buf_size = f->fmt.pix.sizeimage;
+
+	mutex_unlock(s3c_mfc_mutex);
+
+	return 0;
+}
+
+/* the CAPTURE format is known once SEQ_INIT is done, this waits for it */
+static int s3c_mfc_v4l2_g_fmt_vid_cap(struct file *file, void *fh, struct v4l2_format *f)
+{
+	struct s3c_mfc_v4l2_ctx *ctx = fh;
+	struct v4l2_pix_format *pix = &f->fmt.pix;
+
+	mutex_lock(s3c_mfc_mutex);
+
+	while (!ctx->seq_done) {
+		if (ctx->error || !ctx->out.streaming) {
+			mutex_unlock(s3c_mfc_mutex);
+			return -EINVAL;
+		}
+		mutex_unlock(s3c_mfc_mutex);
+
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		if (wait_event_interruptible(ctx->wait,
+				ctx->seq_done || ctx->error || !ctx->out.streaming))
+			return -ERESTARTSYS;
+
+		mutex_lock(s3c_mfc_mutex);
+	}
+
+	memset(pix, 0, sizeof(*pix));
+	pix->width = ctx->inst->buf_width;
+	pix->height = ctx->inst->buf_height;
+	pix->pixelformat = V4L2_PIX_FMT_YUV420;
+	pix->field = V4L2_FIELD_NONE;
+	pix->bytesperline = ctx->inst->buf_width;
+	pix->sizeimage = ctx->cap.buf_size;
+
+	mutex_unlock(s3c_mfc_mutex);
+
+	return 0;
+}
+
+/* the decoded size within the frame */
+static int s3c_mfc_v4l2_g_crop(struct file *file, void *fh, struct v4l2_crop *c)
+{
+	struct s3c_mfc_v4l2_ctx *ctx = fh;
+
+	if (c->type != V4L2_BUF_TYPE_VIDEO_CAPTURE)
+		return -EINVAL;
+
+	mutex_lock(s3c_mfc_mutex);
+
+	if (!ctx->seq_done) {
+		mutex_unlock(s3c_mfc_mutex);
+		return -EINVAL;
+	}
+
+	c->c.left = 0;
+	c->c.top = 0;
+	c->c.width = ctx->inst->width;
+	c->c.height = ctx->inst->height;
+
+	mutex_unlock(s3c_mfc_mutex);
+
+	return 0;
+}
+
+/* it may give fewer buffers than requested, the data buffer is shared */
+static int s3c_mfc_v4l2_reqbufs(struct file *file, void *fh, struct v4l2_requestbuffers *req)
+{
+	struct s3c_mfc_v4l2_ctx *ctx = fh;
+	struct s3c_mfc_v4l2_queue *q;
+	unsigned int count;
+	int ret = 0;
+	int i;
+
+	q = s3c_mfc_v4l2_get_queue(ctx, req->type);
+	if (q == NULL)
+		return -EINVAL;
+
+	if (req->memory != V4L2_MEMORY_MMAP && req->memory != V4L2_MEMORY_USERPTR)
+		return -EINVAL;
+
+	mutex_lock(s3c_mfc_mutex);
+
+	if (q->streaming) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	if (q == &ctx->cap && !ctx->seq_done) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	mutex_lock(&ctx->buf_lock);
+
+	/* the memory of a mapped buffer must not go to another instance */
+	for (i = 0; i < q->nr_bufs; i++) {
+		if (atomic_read(&q->bufs[i].mapcount)) {
+			ret = -EBUSY;
+			goto out_buf;
+		}
+	}
+
+	s3c_mfc_v4l2_free_bufs(q);
+
+	q->memory = req->memory;
+	count = min(req->count, (u32)S3C_MFC_V4L2_MAX_BUFS);
+	if (count && s3c_mfc_v4l2_alloc_bufs(ctx, q, count) == 0) {
+		mfc_err("fail to allocate %s buffers\n", (q == &ctx->out) ? "OUTPUT" : "CAPTURE");
+		ret = -ENOMEM;
+	}
+
+	req->count = q->nr_bufs;
+
+out_buf:
+	mutex_unlock(&ctx->buf_lock);
+out:
+	mutex_unlock(s3c_mfc_mutex);
+
+	return ret;
+}
+
+static int s3c_mfc_v4l2_querybuf(struct file *file, void *fh, struct v4l2_buffer *b)
+{
+	struct s3c_mfc_v4l2_ctx *ctx = fh;
+	struct s3c_mfc_v4l2_queue *q;
+	int ret = 0;
+
+	q = s3c_mfc_v4l2_get_queue(ctx, b->type);
+	if (q == NULL)
+		return -EINVAL;
+
+	mutex_lock(s3c_mfc_mutex);
+
+	if (b->index >= q->nr_bufs) {
+		ret = -EINVAL;
+	} else {
+		*b = q->bufs[b->index].vb;
+		if (atomic_read(&q->bufs[b->index].mapcount))
+			b->flags |= V4L2_BUF_FLAG_MAPPED;
+	}
+
+	mutex_unlock(s3c_mfc_mutex);
+
+	return ret;
+}
+
+static int s3c_mfc_v4l2_qbuf(struct file *file, void *fh, struct v4l2_buffer *b)
+{
+	struct s3c_mfc_v4l2_ctx *ctx = fh;
+	struct s3c_mfc_v4l2_queue *q;
+	struct s3c_mfc_v4l2_buf *buf;
+	int ret = 0;
+
+	q = s3c_mfc_v4l2_get_queue(ctx, b->type);
+	if (q == NULL)
+		return -EINVAL;
+
+	mutex_lock(s3c_mfc_mutex);
+
+	if (b->index >= q->nr_bufs || b->memory != q->memory) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	buf = &q->bufs[b->index];
+	if (buf->vb.flags & (V4L2_BUF_FLAG_QUEUED | V4L2_BUF_FLAG_DONE)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	if (q->memory == V4L2_MEMORY_USERPTR) {
+		if ((q == &ctx->cap && b->length < q->buf_size) || b->m.userptr == 0) {
+			ret = -EINVAL;
+			goto out;
+		}
+		buf->vb.m.userptr = b->m.userptr;
+		buf->vb.length = b->length;
+	}
+
+	if (q == &ctx->out) {
+		if (b->bytesused > q->buf_size) {
+			ret = -EINVAL;
+			goto out;
+		}
+
+		if (q->memory == V4L2_MEMORY_USERPTR &&
+		    copy_from_user(buf->vaddr, (void __user *)b->m.userptr, b->bytesused)) {
+			ret = -EFAULT;
+			goto out;
+		}
+
+		buf->vb.bytesused = b->bytesused;
+		buf->vb.timestamp = b->timestamp;
+	}
+
+	buf->vb.flags |= V4L2_BUF_FLAG_QUEUED;
+	list_add_tail(&buf->list, &q->queued);
+
+	s3c_mfc_v4l2_run(ctx);
+
+out:
+	mutex_unlock(s3c_mfc_mutex);
+
+	return ret;
+}
+
+static int s3c_mfc_v4l2_dqbuf(struct file *file, void *fh, struct v4l2_buffer *b)
+{
+	struct s3c_mfc_v4l2_ctx *ctx = fh;
+	struct s3c_mfc_v4l2_queue *q;
+	struct s3c_mfc_v4l2_buf *buf;
+	int ret = 0;
+
+	q = s3c_mfc_v4l2_get_queue(ctx, b->type);
+	if (q == NULL)
+		return -EINVAL;
+
+	mutex_lock(s3c_mfc_mutex);
+
+	while (list_empty(&q->done)) {
+		if (!q->streaming) {
+			mutex_unlock(s3c_mfc_mutex);
+			return -EINVAL;
+		}
+		if (ctx->error) {
+			mutex_unlock(s3c_mfc_mutex);
+			return -EIO;
+		}
+		mutex_unlock(s3c_mfc_mutex);
+
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		if (wait_event_interruptible(ctx->wait,
+				!list_empty(&q->done) || !q->streaming || ctx->error))
+			return -ERESTARTSYS;
+
+		mutex_lock(s3c_mfc_mutex);
+	}
+
+	buf = list_first_entry(&q->done, struct s3c_mfc_v4l2_buf, list);
+	list_del_init(&buf->list);
+	buf->vb.flags &= ~V4L2_BUF_FLAG_DONE;
+
+	if (q == &ctx->cap && q->memory == V4L2_MEMORY_USERPTR && buf->vb.bytesused &&
+	    copy_to_user((void __user *)buf->vb.m.userptr, buf->vaddr, buf->vb.bytesused))
+		ret = -EFAULT;
+
+	*b = buf->vb;
+	if (atomic_read(&buf->mapcount))
+		b->flags |= V4L2_BUF_FLAG_MAPPED;
+
+	mutex_unlock(s3c_mfc_mutex);
+
+	return ret;
+}
+
+static int s3c_mfc_v4l2_streamon(struct file *file, void *fh, enum v4l2_buf_type type)
+{
+	struct s3c_mfc_v4l2_ctx *ctx = fh;
+	struct s3c_mfc_v4l2_queue *q;
+	int ret = 0;
+
+	q = s3c_mfc_v4l2_get_queue(ctx, type);
+	if (q == NULL)
+		return -EINVAL;
+
+	mutex_lock(s3c_mfc_mutex);
+
+	if (q->nr_bufs == 0) {
+		ret = -EINVAL;
+	} else if (!q->streaming) {
+		q->streaming = 1;
+		q->sequence = 0;
+		s3c_mfc_v4l2_run(ctx);
+	}
+
+	mutex_unlock(s3c_mfc_mutex);
+
+	return ret;
+}
+
+static int s3c_mfc_v4l2_streamoff(struct file *file, void *fh, enum v4l2_buf_type type)
+{
+	struct s3c_mfc_v4l2_ctx *ctx = fh;
+	struct s3c_mfc_v4l2_queue *q;
+
+	q = s3c_mfc_v4l2_get_queue(ctx, type);
+	if (q == NULL)
+		return -EINVAL;
+
+	mutex_lock(s3c_mfc_mutex);
+	s3c_mfc_v4l2_stop(ctx, q);
+	mutex_unlock(s3c_mfc_mutex);
+
+	return 0;
+}
+
+static const struct v4l2_ioctl_ops s3c_mfc_v4l2_ops = {
+	.vidioc_querycap		= s3c_mfc_v4l2_querycap,
+	.vidioc_enum_fmt_vid_out	= s3c_mfc_v4l2_enum_fmt_vid_out,
+	.vidioc_enum_fmt_vid_cap	= s3c_mfc_v4l2_enum_fmt_vid_cap,
+	.vidioc_g_fmt_vid_out		= s3c_mfc_v4l2_g_fmt_vid_out,
+	.vidioc_try_fmt_vid_out		= s3c_mfc_v4l2_try_fmt_vid_out,
+	.vidioc_s_fmt_vid_out		= s3c_mfc_v4l2_s_fmt_vid_out,
+	.vidioc_g_fmt_vid_cap		= s3c_mfc_v4l2_g_fmt_vid_cap,
+	.vidioc_try_fmt_vid_cap		= s3c_mfc_v4l2_g_fmt_vid_cap,
+	.vidioc_s_fmt_vid_cap		= s3c_mfc_v4l2_g_fmt_vid_cap,
+	.vidioc_g_crop			= s3c_mfc_v4l2_g_crop,
+	.vidioc_reqbufs			= s3c_mfc_v4l2_reqbufs,
+	.vidioc_querybuf		= s3c_mfc_v4l2_querybuf,
+	.vidioc_qbuf			= s3c_mfc_v4l2_qbuf,
+	.vidioc_dqbuf			= s3c_mfc_v4l2_dqbuf,
+	.vidioc_streamon		= s3c_mfc_v4l2_streamon,
+	.vidioc_streamoff		= s3c_mfc_v4l2_streamoff,
+};
+
+
+static int s3c_mfc_v4l2_open(struct inode *inode, struct file *file)
+{
+	struct s3c_mfc_v4l2_ctx *ctx;
+	int ret;
+
+	ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+	if (ctx == NULL)
+		return -ENOMEM;
+
+	ret = s3c_mfc_open_inst(&ctx->inst);
+	if (ret) {
+		kfree(ctx);
+		return ret;
+	}
+
+	ctx->job = s3c_mfc_get_job(ctx->inst);
+	ctx->fmt = &s3c_mfc_v4l2_formats[0];
+	s3c_mfc_v4l2_init_queue(&ctx->out, V4L2_BUF_TYPE_VIDEO_OUTPUT, S3C_MFC_V4L2_STRM_SIZE);
+	s3c_mfc_v4l2_init_queue(&ctx->cap, V4L2_BUF_TYPE_VIDEO_CAPTURE, 0);
+	INIT_WORK(&ctx->work, s3c_mfc_v4l2_work);
+	init_waitqueue_head(&ctx->wait);
+	mutex_init(&ctx->buf_lock);
+
+	file->private_data = ctx;
+
+	return 0;
+}
+
+static int s3c_mfc_v4l2_release(struct inode *inode, struct file *file)
+{
+	struct s3c_mfc_v4l2_ctx *ctx = file->private_data;
+
+	mutex_lock(s3c_mfc_mutex);
+	s3c_mfc_v4l2_stop(ctx, &ctx->out);
+	s3c_mfc_v4l2_stop(ctx, &ctx->cap);
+	mutex_lock(&ctx->buf_lock);
+	s3c_mfc_v4l2_free_bufs(&ctx->out);
+	s3c_mfc_v4l2_free_bufs(&ctx->cap);
+	mutex_unlock(&ctx->buf_lock);
+	mutex_unlock(s3c_mfc_mutex);
+
+	/* the work takes s3c_mfc_mutex */
+	cancel_work_sync(&ctx->work);
+
+	s3c_mfc_close_inst(ctx->inst);
+	kfree(ctx);
+
+	return 0;
+}
+
+/*
+ * A mapping holds the file, so the buffers outlive it. These run under
+ * mmap_sem without any lock; reqbufs checks the count under buf_lock.
+ */
+static void s3c_mfc_v4l2_vm_open(struct vm_area_struct *vma)
+{
+	struct s3c_mfc_v4l2_buf *buf = vma->vm_private_data;
+
+	atomic_inc(&buf->mapcount);
+}
+
+static void s3c_mfc_v4l2_vm_close(struct vm_area_struct *vma)
+{
+	struct s3c_mfc_v4l2_buf *buf = vma->vm_private_data;
+
+	atomic_dec(&buf->mapcount);
+}
+
+static struct vm_operations_struct s3c_mfc_v4l2_vm_ops = {
+	.open	= s3c_mfc_v4l2_vm_open,
+	.close	= s3c_mfc_v4l2_vm_close,
+};
+
+static int s3c_mfc_v4l2_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct s3c_mfc_v4l2_ctx *ctx = file->private_data;
+	struct s3c_mfc_v4l2_queue *queues[2] = { &ctx->out, &ctx->cap };
+	struct s3c_mfc_v4l2_buf *buf = NULL;
+	unsigned long offset = vma->vm_pgoff << PAGE_SHIFT;
+	unsigned long size = vma->vm_end - vma->vm_start;
+	int ret = 0;
+	int i, j;
+
+	mutex_lock(&ctx->buf_lock);
+
+	for (i = 0; i < 2 && buf == NULL; i++) {
+		if (queues[i]->memory != V4L2_MEMORY_MMAP)
+			continue;
+		for (j = 0; j < queues[i]->nr_bufs; j++) {
+			if (queues[i]->bufs[j].vb.m.offset == offset) {
+				buf = &queues[i]->bufs[j];
+				break;
+			}
+		}
+	}
+
+	if (buf == NULL || size > PAGE_ALIGN(buf->vb.length)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	if (buf->vb.type == V4L2_BUF_TYPE_VIDEO_OUTPUT) {
+		ret = remap_vmalloc_range(vma, buf->vaddr, 0);
+		if (ret) {
+			mfc_err("fail to remap\n");
+			goto out;
+		}
+	} else {
+		/* cached, like the mapping of the MFC device */
+		vma->vm_flags |= VM_RESERVED | VM_IO;
+
+		if (remap_pfn_range(vma, vma->vm_start, __phys_to_pfn(buf->paddr), size,
+				    vma->vm_page_prot)) {
+			mfc_err("fail to remap\n");
+			ret = -EAGAIN;
+			goto out;
+		}
+	}
+
+	vma->vm_flags |= VM_DONTEXPAND;
+	vma->vm_ops = &s3c_mfc_v4l2_vm_ops;
+	vma->vm_private_data = buf;
+	s3c_mfc_v4l2_vm_open(vma);
+
+out:
+	mutex_unlock(&ctx->buf_lock);
+
+	return ret;
+}
+
+/* readable when a frame can be dequeued, writable when a bitstream buffer can */
+static unsigned int s3c_mfc_v4l2_poll(struct file *file, poll_table *wait)
+{
+	struct s3c_mfc_v4l2_ctx *ctx = file->private_data;
+	unsigned int mask = 0;
+
+	poll_wait(file, &ctx->wait, wait);
+
+	mutex_lock(s3c_mfc_mutex);
+
+	if (ctx->error)
+		mask |= POLLERR;
+	if (!list_empty(&ctx->cap.done))
+		mask |= POLLIN | POLLRDNORM;
+	if (!list_empty(&ctx->out.done))
+		mask |= POLLOUT | POLLWRNORM;
+
+	mutex_unlock(s3c_mfc_mutex);
+
+	return mask;
+}
+
+static const struct file_operations s3c_mfc_v4l2_fops = {
+	.owner		= THIS_MODULE,
+	.open		= s3c_mfc_v4l2_open,
+	.release	= s3c_mfc_v4l2_release,
+	.ioctl		= video_ioctl2,
+	.mmap		= s3c_mfc_v4l2_mmap,
+	.poll		= s3c_mfc_v4l2_poll,
+};
+
+static struct video_device s3c_mfc_v4l2_vdev = {
+	.name		= "s3c-mfc",
+	.vfl_type	= VID_TYPE_MPEG_DECODER | VID_TYPE_CAPTURE,
+	.fops		= &s3c_mfc_v4l2_fops,
+	.ioctl_ops	= &s3c_mfc_v4l2_ops,
+	.release	= video_device_release_empty,
+	.minor		= -1,
+};
+
+int s3c_mfc_v4l2_register(struct platform_device *pdev)
+{
+	int ret;
+
+	s3c_mfc_v4l2_vdev.parent = &pdev->dev;
+
+	ret = video_register_device(&s3c_mfc_v4l2_vdev, VFL_TYPE_GRABBER, -1);
+	if (ret) {
+		mfc_err("cannot register the V4L2 decoder (%d)\n", ret);
+		return ret;
+	}
+
+	s3c_mfc_v4l2_registered = 1;
+
+	return 0;
+}
+
+void s3c_mfc_v4l2_unregister(void)
+{
+	if (s3c_mfc_v4l2_registered) {
+		video_unregister_device(&s3c_mfc_v4l2_vdev);
+		s3c_mfc_v4l2_registered = 0;
+	}
+}
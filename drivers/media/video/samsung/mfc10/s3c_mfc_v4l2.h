@@ -0,0 +1,33 @@
+/* linux/driver/media/video/mfc/s3c_mfc_v4l2.h
+ *
+ * Header file for the V4L2 decoder interface of the Samsung MFC
+ * (Multi Function Codec - FIMV) driver
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _S3C_MFC_V4L2_H
+#define _S3C_MFC_V4L2_H
+
+#include <linux/mutex.h>
+#include <linux/platform_device.h>
+
+#include "s3c_mfc_instance.h"
+
+/* shared with the MFC device, s3c_mfc.c */
+extern struct mutex *s3c_mfc_mutex;
+
+int  s3c_mfc_open_inst(s3c_mfc_inst_context_t **inst);
+void s3c_mfc_close_inst(s3c_mfc_inst_context_t *inst);
+
+#ifdef CONFIG_VIDEO_MFC10_V4L2
+int  s3c_mfc_v4l2_register(struct platform_device *pdev);
+void s3c_mfc_v4l2_unregister(void);
+#else
+static inline int s3c_mfc_v4l2_register(struct platform_device *pdev) { return 0; }
+static inline void s3c_mfc_v4l2_unregister(void) { }
+#endif
+
+#endif /* _S3C_MFC_V4L2_H */
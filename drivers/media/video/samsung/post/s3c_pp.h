@@ -52,6 +52,12 @@ typedef struct {
 	unsigned int 	phy_addr;
 } s3c_pp_mem_alloc_t;
 
+// Structure type for IOCTL commands S3C_PP_SET_SRC_BUF_BO, S3C_PP_SET_DST_BUF_BO.
+typedef struct {
+	int		        handle;		    // s3c-mem buffer object handle
+	unsigned int 	offset;		    // offset of the image in the buffer
+} s3c_pp_bo_t;
+
 #define PP_IOCTL_MAGIC 'P'
 
 #define S3C_PP_SET_PARAMS			        _IO(PP_IOCTL_MAGIC, 0)
@@ -65,6 +71,8 @@ typedef struct {
 #define S3C_PP_FREE_KMEM                    _IO(PP_IOCTL_MAGIC, 8)
 #define S3C_PP_GET_RESERVED_MEM_SIZE        _IO(PP_IOCTL_MAGIC, 9)
 #define S3C_PP_GET_RESERVED_MEM_ADDR_PHY    _IO(PP_IOCTL_MAGIC, 10)
+#define S3C_PP_SET_SRC_BUF_BO               _IO(PP_IOCTL_MAGIC, 11)
+#define S3C_PP_SET_DST_BUF_BO               _IO(PP_IOCTL_MAGIC, 12)
 
 #endif // _S3C_PP_H_
 
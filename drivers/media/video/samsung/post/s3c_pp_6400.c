@@ -837,6 +837,11 @@ int s3c_pp_release ( struct inode *inode, struct file *file )
 
     dprintk ( "%s: handle=%d, count=%d\n", __FUNCTION__, current_instance->instance_no, s3c_pp_instance_info.in_use_instance_count );
 
+    if ( current_instance->src_bo )
+        s3c_mem_bo_put ( current_instance->src_bo );
+    if ( current_instance->dst_bo )
+        s3c_mem_bo_put ( current_instance->dst_bo );
+
 	kfree(current_instance);
 
 	mutex_unlock(h_mutex);
@@ -1194,6 +1199,57 @@ static int s3c_pp_ioctl(struct inode *inode, struct file *file, unsigned int cmd
             mutex_unlock(h_mutex);
             return PP_RESERVED_MEM_ADDR_PHY;
 
+        // take the source or destination from a shared buffer object, no copy into the reserved area
+        case S3C_PP_SET_SRC_BUF_BO:
+        case S3C_PP_SET_DST_BUF_BO:
+            {
+                s3c_pp_bo_t bo;
+                dma_addr_t bo_addr_phy;
+
+                if ( PP_INSTANCE_READY == s3c_pp_instance_info.instance_state[current_instance->instance_no] )
+                {
+                    dprintk ( "%s: S3C_PP_SET_xxx_BUF_BO must be executed after running S3C_PP_SET_PARAMS.\n", __FUNCTION__ );
+                    mutex_unlock(h_mutex);
+                    return -EINVAL;
+                }
+
+                if ( copy_from_user(&bo, (s3c_pp_bo_t *) arg, sizeof(s3c_pp_bo_t)) )
+                {
+                    mutex_unlock(h_mutex);
+                    return -EFAULT;
+                }
+
+                if ( S3C_PP_SET_SRC_BUF_BO == cmd )
+                    temp = cal_data_size ( current_instance->src_color_space, current_instance->src_full_width, current_instance->src_full_height );
+                else
+                    temp = cal_data_size ( current_instance->dst_color_space, current_instance->dst_full_width, current_instance->dst_full_height );
+
+                if ( s3c_mem_bo_get(bo.handle, bo.offset, temp, &bo_addr_phy) )
+                {
+                    dprintk ( "%s: invalid buffer object %d\n", __FUNCTION__, bo.handle );
+                    mutex_unlock(h_mutex);
+                    return -EINVAL;
+                }
+
+                if ( S3C_PP_SET_SRC_BUF_BO == cmd )
+                {
+                    if ( current_instance->src_bo )
+                        s3c_mem_bo_put ( current_instance->src_bo );
+                    current_instance->src_bo = bo.handle;
+                    current_instance->src_buf_addr_phy = bo_addr_phy;
+                    current_instance->value_changed |= PP_VALUE_CHANGED_SRC_BUF_ADDR_PHY;
+                }
+                else
+                {
+                    if ( current_instance->dst_bo )
+                        s3c_mem_bo_put ( current_instance->dst_bo );
+                    current_instance->dst_bo = bo.handle;
+                    current_instance->dst_buf_addr_phy = bo_addr_phy;
+                    current_instance->value_changed |= PP_VALUE_CHANGED_DST_BUF_ADDR_PHY;
+                }
+            }
+            break;
+
 		default:
 			mutex_unlock(h_mutex);
 			return -EINVAL;
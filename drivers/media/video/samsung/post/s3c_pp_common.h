@@ -44,6 +44,7 @@ typedef struct {
 
     unsigned int instance_no;               // Instance No
     unsigned int value_changed;             // 0: Parameter is not changed, 1: Parameter is changed 
+    int src_bo, dst_bo;                     // buffer objects held for src/dst, 0 if none
     //unsigned int RegisterContext[164];    // Register Context
 } s3c_pp_instance_context_t;
 
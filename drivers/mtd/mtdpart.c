@@ -294,6 +294,31 @@ static int part_block_markbad(struct mtd_info *mtd, loff_t ofs)
 	return res;
 }
 
+/*
+ * Pass a refresh request for a block of the master device on to whoever
+ * uses the partition that holds it.
+ */
+
+int mtd_block_refresh(struct mtd_info *master, loff_t ofs)
+{
+	struct mtd_part *slave;
+
+	list_for_each_entry(slave, &mtd_partitions, list) {
+		if (slave->master != master || ofs < slave->offset ||
+		    ofs >= slave->offset + slave->mtd.size)
+			continue;
+		if (!slave->mtd.block_refresh)
+			return -EOPNOTSUPP;
+		return slave->mtd.block_refresh(&slave->mtd, ofs - slave->offset);
+	}
+
+	if (master->block_refresh)
+		return master->block_refresh(master, ofs);
+
+	return -EOPNOTSUPP;
+}
+EXPORT_SYMBOL_GPL(mtd_block_refresh);
+
 /*
  * This function unregisters and destroy all slave MTD objects which are
  * attached to the given master MTD object.
@@ -1051,6 +1051,7 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 	struct mtd_ecc_stats stats;
 	int blkcheck = (1 << (chip->phys_erase_shift - chip->page_shift)) - 1;
 	int sndcmd = 1;
+	int cached = 0, nextpage;
 	int ret = 0;
 	uint32_t readlen = ops->len;
 	uint32_t oobreadlen = ops->ooblen;
@@ -1073,6 +1074,16 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 		bytes = min(mtd->writesize - col, readlen);
 		aligned = (bytes == mtd->writesize);
 
+		/*
+		 * With cache read the next page is loaded from the array
+		 * while this one is transferred from the cache register.
+		 * Only within a block, and only if it has to be read from
+		 * the chip at all.
+		 */
+		nextpage = NAND_HAS_CACHEREAD(chip) && readlen > bytes &&
+			((page + 1) & blkcheck) &&
+			(realpage + 1 != chip->pagebuf || oob);
+
 		/* Is the current page in the buffer ? */
 		if (realpage != chip->pagebuf || oob) {
 			bufpoi = aligned ? buf : chip->buffers->databuf;
@@ -1081,6 +1092,16 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 				/* 发送读页命令 */
 				chip->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page);
 				sndcmd = 0;
+				if (nextpage) {
+					chip->cmdfunc(mtd, NAND_CMD_READCACHESEQ,
+						      -1, -1);
+					cached = 1;
+				}
+			} else if (cached) {
+				/* page loaded in the background -> cache register */
+				chip->cmdfunc(mtd, nextpage ? NAND_CMD_READCACHESEQ :
+					      NAND_CMD_READCACHEEND, -1, -1);
+				cached = nextpage;
 			}
 
 			/* Now read the page into the buffer */
@@ -1158,10 +1179,14 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 		/* Check, if the chip supports auto page increment
 		 * or if we have hit a block boundary.
 		 */
-		if (!NAND_CANAUTOINCR(chip) || !(page & blkcheck))
+		if (!cached && (!NAND_CANAUTOINCR(chip) || !(page & blkcheck)))
 			sndcmd = 1;
 	}
 
+	/* leave cache read mode if we bailed out in the middle of a run */
+	if (cached)
+		chip->cmdfunc(mtd, NAND_CMD_READCACHEEND, -1, -1);
+
 	ops->retlen = ops->len - (size_t) readlen;
 	if (oob)
 		ops->oobretlen = ops->ooblen - oobreadlen;
@@ -55,6 +55,8 @@
 #include <linux/clk.h>
 #include <linux/jiffies.h>
 #include <linux/sched.h>
+#include <linux/dma-mapping.h>
+#include <linux/completion.h>
 
 #include <linux/mtd/mtd.h>
 #include <linux/mtd/nand.h>
@@ -66,6 +68,13 @@
 #include <plat/regs-nand.h>
 #include <plat/nand.h>
 
+#if defined(CONFIG_MTD_NAND_S3C_DMA)
+#include <mach/dma.h>
+#endif
+#if defined(CONFIG_MTD_NAND_S3C_SCRUB)
+#include <linux/kthread.h>
+#endif
+
 enum s3c_cpu_type {
 	TYPE_S3C6400,
 	TYPE_S3C6410,	/* including s3c6430/31 */
@@ -87,6 +96,34 @@ struct s3c_nand_info {
 	int				mtd_count;
 
 	enum s3c_cpu_type		cpu_type;
+
+#if defined(CONFIG_MTD_NAND_S3C_DMA)
+	/* main area transfers through DMACH_NAND */
+	unsigned long			data_phys;
+	int				dma_ready;
+	struct completion		dma_done;
+
+	/* a transfer of the current page failed, see s3c_nand_dma_failed() */
+	int				dma_error;
+	int				(*ecc_read_page)(struct mtd_info *mtd,
+						struct nand_chip *chip, uint8_t *buf);
+	int				(*ecc_read_page_raw)(struct mtd_info *mtd,
+						struct nand_chip *chip, uint8_t *buf);
+#endif
+
+#if defined(CONFIG_MTD_NAND_S3C_SCRUB)
+	/* corrected bits per block, see s3c_nand_scrub_note() */
+	u8				*block_bits;
+	unsigned int			nr_blocks;
+	int				block_shift;
+	int				read_page;
+	int				read_cached;
+	unsigned long			last_io;
+	struct task_struct		*scrub_task;
+	void (*cmdfunc)(struct mtd_info *mtd, unsigned int command,
+			int column, int page_addr);
+	void (*erase_cmd)(struct mtd_info *mtd, int page);
+#endif
 };
 static struct s3c_nand_info s3c_nand;
 
@@ -144,6 +181,399 @@ static struct nand_ecclayout s3c_nand_oob_mlc_64 = {
 };
 #endif
 
+#if defined(CONFIG_MTD_NAND_S3C_DMA)
+/* can be flipped at runtime to compare DMA and PIO throughput */
+static int use_dma = 1;
+module_param(use_dma, int, 0644);
+MODULE_PARM_DESC(use_dma, "move page data with the PL080 DMA controller (0 = PIO)");
+
+static struct s3c2410_dma_client s3c_nand_dma_client = {
+	.name		= "s3c-nand-dma",
+};
+
+static void s3c_nand_dma_finish(struct s3c2410_dma_chan *chan, void *buf_id,
+				int size, enum s3c2410_dma_buffresult result)
+{
+	complete(&s3c_nand.dma_done);
+}
+
+/*
+ * Only whole words of a lowmem buffer, from process context, and only
+ * for transfers where the setup cost pays off (an ECC step or more).
+ */
+static int s3c_nand_dma_ok(const void *buf, int len)
+{
+	if (!use_dma || !s3c_nand.dma_ready || len < 512)
+		return 0;
+
+	if (((unsigned long)buf & 3) || (len & 3))
+		return 0;
+
+	if (!virt_addr_valid(buf) || !virt_addr_valid(buf + len - 1))
+		return 0;
+
+	return !in_interrupt() && !irqs_disabled();
+}
+
+/*
+ * Move len bytes between buf and NFDATA and sleep until the channel
+ * is done. The ECC engine snoops NFDATA, so the caller's per-step
+ * hwctl/calculate/correct sequence is unaffected.
+ */
+static int s3c_nand_dma_xfer(const void *buf, int len, enum dma_data_direction dir)
+{
+	dma_addr_t addr;
+	int ret = 0;
+
+	addr = dma_map_single(s3c_nand.device, (void *)buf, len, dir);
+
+	INIT_COMPLETION(s3c_nand.dma_done);
+
+	s3c2410_dma_devconfig(DMACH_NAND, (dir == DMA_FROM_DEVICE) ?
+			      S3C_DMA_FIXED2MEM : S3C_DMA_MEM2FIXED,
+			      0, s3c_nand.data_phys);
+	s3c2410_dma_config(DMACH_NAND, 4, 0);
+
+	if (s3c2410_dma_enqueue(DMACH_NAND, NULL, addr, len)) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	if (!wait_for_completion_timeout(&s3c_nand.dma_done, HZ)) {
+		printk(KERN_ERR "s3c-nand: DMA transfer timed out\n");
+		s3c2410_dma_ctrl(DMACH_NAND, S3C2410_DMAOP_FLUSH);
+		ret = -ETIMEDOUT;
+	}
+
+out:
+	dma_unmap_single(s3c_nand.device, addr, len, dir);
+	return ret;
+}
+
+static void s3c_nand_dma_init(struct resource *res)
+{
+	init_completion(&s3c_nand.dma_done);
+	s3c_nand.data_phys = res->start + S3C_NFDATA;
+
+	if (s3c2410_dma_request(DMACH_NAND, &s3c_nand_dma_client, NULL)) {
+		printk(KERN_WARNING "s3c-nand: no DMA channel, using PIO\n");
+		return;
+	}
+
+	s3c2410_dma_set_buffdone_fn(DMACH_NAND, s3c_nand_dma_finish);
+	s3c2410_dma_setflags(DMACH_NAND, S3C2410_DMAF_AUTOSTART);
+	s3c_nand.dma_ready = 1;
+}
+
+/*
+ * A DMA that timed out may have moved part of the data, and the
+ * controller's column with it, so PIO cannot finish the transfer.
+ * The page read or write that contains it fails with -EIO instead.
+ */
+static int s3c_nand_dma_failed(void)
+{
+	int failed = s3c_nand.dma_error;
+
+	s3c_nand.dma_error = 0;
+	return failed;
+}
+
+static int s3c_nand_read_page_dma(struct mtd_info *mtd, struct nand_chip *chip,
+				  uint8_t *buf)
+{
+	int ret;
+
+	s3c_nand.dma_error = 0;
+	ret = s3c_nand.ecc_read_page(mtd, chip, buf);
+
+	return s3c_nand_dma_failed() ? -EIO : ret;
+}
+
+static int s3c_nand_read_page_raw_dma(struct mtd_info *mtd, struct nand_chip *chip,
+				      uint8_t *buf)
+{
+	int ret;
+
+	s3c_nand.dma_error = 0;
+	ret = s3c_nand.ecc_read_page_raw(mtd, chip, buf);
+
+	return s3c_nand_dma_failed() ? -EIO : ret;
+}
+
+/* as nand_write_page(), but a page whose data did not all go out is not programmed */
+static int s3c_nand_write_page(struct mtd_info *mtd, struct nand_chip *chip,
+			       const uint8_t *buf, int page, int cached, int raw)
+{
+	int status;
+
+	s3c_nand.dma_error = 0;
+
+	chip->cmdfunc(mtd, NAND_CMD_SEQIN, 0x00, page);
+
+	if (unlikely(raw))
+		chip->ecc.write_page_raw(mtd, chip, buf);
+	else
+		chip->ecc.write_page(mtd, chip, buf);
+
+	if (s3c_nand_dma_failed()) {
+		/* abort the data input, the page keeps its old contents */
+		chip->cmdfunc(mtd, NAND_CMD_RESET, -1, -1);
+		return -EIO;
+	}
+
+	if (!cached || !(chip->options & NAND_CACHEPRG)) {
+		chip->cmdfunc(mtd, NAND_CMD_PAGEPROG, -1, -1);
+		status = chip->waitfunc(mtd, chip);
+
+		if ((status & NAND_STATUS_FAIL) && (chip->errstat))
+			status = chip->errstat(mtd, chip, FL_WRITING, status,
+					       page);
+
+		if (status & NAND_STATUS_FAIL)
+			return -EIO;
+	} else {
+		chip->cmdfunc(mtd, NAND_CMD_CACHEDPROG, -1, -1);
+		status = chip->waitfunc(mtd, chip);
+	}
+
+#ifdef CONFIG_MTD_NAND_VERIFY_WRITE
+	chip->cmdfunc(mtd, NAND_CMD_READ0, 0, page);
+
+	if (chip->verify_buf(mtd, buf, mtd->writesize))
+		return -EIO;
+#endif
+	return 0;
+}
+#endif
+
+/*
+ * Data transfer functions. Word aligned runs use 32bit NFDATA
+ * accesses, large ones go through DMA when it is enabled.
+ */
+static void s3c_nand_read_buf(struct mtd_info *mtd, uint8_t *buf, int len)
+{
+	void __iomem *data = s3c_nand.regs + S3C_NFDATA;
+
+#if defined(CONFIG_MTD_NAND_S3C_DMA)
+	if (s3c_nand_dma_ok(buf, len)) {
+		int ret = s3c_nand_dma_xfer(buf, len, DMA_FROM_DEVICE);
+
+		if (ret != -ENOMEM) {
+			if (ret)
+				s3c_nand.dma_error = 1;
+			return;
+		}
+	}
+#endif
+
+	if (!((unsigned long)buf & 3) && !(len & 3))
+		readsl(data, buf, len >> 2);
+	else
+		readsb(data, buf, len);
+}
+
+static void s3c_nand_write_buf(struct mtd_info *mtd, const uint8_t *buf, int len)
+{
+	void __iomem *data = s3c_nand.regs + S3C_NFDATA;
+
+#if defined(CONFIG_MTD_NAND_S3C_DMA)
+	if (s3c_nand_dma_ok(buf, len)) {
+		int ret = s3c_nand_dma_xfer(buf, len, DMA_TO_DEVICE);
+
+		if (ret != -ENOMEM) {
+			if (ret)
+				s3c_nand.dma_error = 1;
+			return;
+		}
+	}
+#endif
+
+	if (!((unsigned long)buf & 3) && !(len & 3))
+		writesl(data, buf, len >> 2);
+	else
+		writesb(data, buf, len);
+}
+
+#if defined(CONFIG_MTD_NAND_S3C_SCRUB)
+/*
+ * Background scrubber. The page readers record the highest number of
+ * bits corrected in any ECC step of a block since it was last erased.
+ * When the bus has been idle for a while, a low priority thread reads
+ * one block at a time, and asks the owner of the partition to move the
+ * data out of blocks that are close to the correction limit, before
+ * read disturb makes them uncorrectable.
+ */
+static int scrub_interval = 2000;
+module_param(scrub_interval, int, 0644);
+MODULE_PARM_DESC(scrub_interval, "ms between scrubbed blocks (0 = off)");
+
+static int scrub_idle = 1000;
+module_param(scrub_idle, int, 0644);
+MODULE_PARM_DESC(scrub_idle, "ms without other NAND access before scrubbing");
+
+static int scrub_threshold;
+module_param(scrub_threshold, int, 0644);
+MODULE_PARM_DESC(scrub_threshold, "corrected bits that trigger a refresh (0 = ECC limit - 1)");
+
+#define S3C_SCRUB_FAILED	0x7f	/* uncorrectable step seen */
+#define S3C_SCRUB_REQUESTED	0x80	/* refresh already asked for */
+
+static void s3c_nand_scrub_note(int stat)
+{
+	u8 *bits;
+
+	if (!s3c_nand.block_bits || stat == 0 || s3c_nand.read_page < 0)
+		return;
+
+	if (stat < 0)
+		stat = S3C_SCRUB_FAILED;
+
+	bits = &s3c_nand.block_bits[s3c_nand.read_page >> s3c_nand.block_shift];
+	if ((*bits & ~S3C_SCRUB_REQUESTED) < stat)
+		*bits = (*bits & S3C_SCRUB_REQUESTED) | stat;
+}
+
+/*
+ * Follows the page that is in the cache register, so that corrected bits
+ * are accounted to the right block with cache read as well.
+ */
+static void s3c_nand_scrub_command(struct mtd_info *mtd, unsigned int command,
+				   int column, int page_addr)
+{
+	switch (command) {
+	case NAND_CMD_READ0:
+		s3c_nand.read_page = page_addr;
+		s3c_nand.read_cached = 0;
+		break;
+	case NAND_CMD_READCACHESEQ:
+	case NAND_CMD_READCACHEEND:
+		if (s3c_nand.read_cached++ && s3c_nand.read_page >= 0)
+			s3c_nand.read_page++;
+		break;
+	case NAND_CMD_RNDOUT:
+	case NAND_CMD_RNDOUTSTART:
+		break;
+	default:
+		s3c_nand.read_page = -1;
+		break;
+	}
+
+	if (current != s3c_nand.scrub_task)
+		s3c_nand.last_io = jiffies;
+
+	s3c_nand.cmdfunc(mtd, command, column, page_addr);
+}
+
+static void s3c_nand_scrub_erase(struct mtd_info *mtd, int page)
+{
+	if (s3c_nand.block_bits)
+		s3c_nand.block_bits[page >> s3c_nand.block_shift] = 0;
+
+	s3c_nand.erase_cmd(mtd, page);
+}
+
+static void s3c_nand_scrub_block(struct mtd_info *mtd, unsigned int block,
+				 u_char *buf)
+{
+	loff_t ofs = (loff_t)block * mtd->erasesize;
+	unsigned int i;
+	int threshold = scrub_threshold;
+	size_t retlen;
+	int ret;
+
+	if (mtd->block_isbad(mtd, ofs))
+		return;
+
+	for (i = 0; i < mtd->erasesize; i += mtd->writesize) {
+		if (kthread_should_stop())
+			return;
+		mtd->read(mtd, ofs + i, mtd->writesize, &retlen, buf);
+	}
+
+	if (!threshold)
+		threshold = (nand_type == S3C_NAND_TYPE_SLC) ? 1 : 3;
+
+	if (s3c_nand.block_bits[block] & S3C_SCRUB_REQUESTED ||
+	    s3c_nand.block_bits[block] < threshold)
+		return;
+
+	/* the filesystem is busy, try again on the next pass */
+	ret = mtd_block_refresh(mtd, ofs);
+	if (ret == -EBUSY)
+		return;
+
+	printk(KERN_INFO "s3c-nand: block %u has %d corrected bit(s), "
+	       "refresh %s\n", block, s3c_nand.block_bits[block],
+	       ret ? "not possible" : "requested");
+
+	s3c_nand.block_bits[block] |= S3C_SCRUB_REQUESTED;
+}
+
+static int s3c_nand_scrub_thread(void *arg)
+{
+	struct mtd_info *mtd = arg;
+	unsigned int block = 0;
+	u_char *buf;
+
+	buf = kmalloc(mtd->writesize, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	set_user_nice(current, 19);
+
+	while (!kthread_should_stop()) {
+		/* poll once a second while disabled to pick up the parameter */
+		schedule_timeout_interruptible(msecs_to_jiffies(scrub_interval > 0 ?
+						scrub_interval : 1000));
+
+		if (scrub_interval <= 0 || time_before(jiffies, s3c_nand.last_io +
+						       msecs_to_jiffies(scrub_idle)))
+			continue;
+
+		s3c_nand_scrub_block(mtd, block, buf);
+
+		if (++block >= s3c_nand.nr_blocks)
+			block = 0;
+	}
+
+	kfree(buf);
+	return 0;
+}
+
+static void s3c_nand_scrub_init(struct mtd_info *mtd)
+{
+	struct nand_chip *chip = mtd->priv;
+
+	s3c_nand.block_shift = chip->phys_erase_shift - chip->page_shift;
+	s3c_nand.nr_blocks = mtd->size >> chip->phys_erase_shift;
+	s3c_nand.block_bits = kzalloc(s3c_nand.nr_blocks, GFP_KERNEL);
+	if (!s3c_nand.block_bits)
+		return;
+
+	s3c_nand.read_page = -1;
+	s3c_nand.last_io = jiffies;
+	s3c_nand.cmdfunc = chip->cmdfunc;
+	s3c_nand.erase_cmd = chip->erase_cmd;
+	chip->cmdfunc = s3c_nand_scrub_command;
+	chip->erase_cmd = s3c_nand_scrub_erase;
+
+	s3c_nand.scrub_task = kthread_run(s3c_nand_scrub_thread, mtd, "nand_scrub");
+	if (IS_ERR(s3c_nand.scrub_task)) {
+		printk(KERN_WARNING "s3c-nand: cannot start scrub thread\n");
+		s3c_nand.scrub_task = NULL;
+	}
+}
+
+static void s3c_nand_scrub_exit(void)
+{
+	if (s3c_nand.scrub_task)
+		kthread_stop(s3c_nand.scrub_task);
+	s3c_nand.scrub_task = NULL;
+}
+#else
+#define s3c_nand_scrub_note(stat)	do { } while (0)
+#endif
+
 #if defined(CONFIG_MTD_NAND_S3C_DEBUG)
 /*
  * Function to print out oob buffer for debugging
@@ -627,6 +1057,7 @@ static int s3c_nand_read_page_1bit(struct mtd_info *mtd, struct nand_chip *chip,
 		stat = chip->ecc.correct(mtd, p, chip->oob_poi + mecc_pos[0] + ((chip->ecc.steps - eccsteps) * eccbytes), 0);
 		if (stat == -1)
 			mtd->ecc_stats.failed++;
+		s3c_nand_scrub_note(stat);
 
 		col = eccsize * (chip->ecc.steps + 1 - eccsteps);
 	}
@@ -664,6 +1095,7 @@ static int s3c_nand_read_page_4bit(struct mtd_info *mtd, struct nand_chip *chip,
 
 		if (stat == -1)
 			mtd->ecc_stats.failed++;
+		s3c_nand_scrub_note(stat);
 
 		col = eccsize * (chip->ecc.steps + 1 - eccsteps);
 	}
@@ -761,6 +1193,10 @@ static int s3c_nand_probe(struct platform_device *pdev, enum s3c_cpu_type cpu_ty
 		goto exit_error;
 	}
 
+#if defined(CONFIG_MTD_NAND_S3C_DMA)
+	s3c_nand_dma_init(res);
+#endif
+
 	/* allocate memory for MTD device structure and private data */
 	s3c_mtd = kmalloc(sizeof(struct mtd_info) + sizeof(struct nand_chip), GFP_KERNEL);
 
@@ -790,8 +1226,13 @@ static int s3c_nand_probe(struct platform_device *pdev, enum s3c_cpu_type cpu_ty
 		nand->IO_ADDR_W		= (char *)(s3c_nand.regs + S3C_NFDATA);
 		nand->cmd_ctrl		= s3c_nand_hwcontrol;
 		nand->dev_ready		= s3c_nand_device_ready;		
+		nand->read_buf		= s3c_nand_read_buf;
+		nand->write_buf		= s3c_nand_write_buf;
 		nand->scan_bbt		= s3c_nand_scan_bbt;
 		nand->options		= 0;
+#if defined(CONFIG_MTD_NAND_S3C_DMA)
+		nand->write_page	= s3c_nand_write_page;
+#endif
 
 #if defined(CONFIG_MTD_NAND_S3C_CACHEDPROG)
 		nand->options		|= NAND_CACHEPRG;
@@ -846,11 +1287,35 @@ static int s3c_nand_probe(struct platform_device *pdev, enum s3c_cpu_type cpu_ty
 			goto exit_error;
 		}
 
+#if defined(CONFIG_MTD_NAND_S3C_DMA)
+		/* fail the pages whose DMA failed, whichever ECC functions nand_scan() chose */
+		if (nand->ecc.read_page != s3c_nand_read_page_dma) {
+			s3c_nand.ecc_read_page = nand->ecc.read_page;
+			nand->ecc.read_page = s3c_nand_read_page_dma;
+		}
+		if (nand->ecc.read_page_raw != s3c_nand_read_page_raw_dma) {
+			s3c_nand.ecc_read_page_raw = nand->ecc.read_page_raw;
+			nand->ecc.read_page_raw = s3c_nand_read_page_raw_dma;
+		}
+#endif
+
+#if defined(CONFIG_MTD_NAND_S3C_CACHEDREAD)
+		/* cache read exists on large page chips only */
+		if (s3c_mtd->writesize >= 2048) {
+			nand->options |= NAND_CACHERD;
+			printk(KERN_INFO "S3C NAND Driver is using cache read.\n");
+		}
+#endif
+
 		/* Register the partitions */
 		/* 每一个chip都添加s3c_mtd一次 */
 		add_mtd_partitions(s3c_mtd, partition_info, plat_info->mtd_part_nr);
 	}
 
+#if defined(CONFIG_MTD_NAND_S3C_SCRUB)
+	s3c_nand_scrub_init(s3c_mtd);
+#endif
+
 	pr_debug("initialized ok\n");
 	return 0;
 
@@ -894,6 +1359,9 @@ static int s3c_nand_resume(struct platform_device *dev)
 /* device management functions */
 static int s3c_nand_remove(struct platform_device *dev)
 {
+#if defined(CONFIG_MTD_NAND_S3C_SCRUB)
+	s3c_nand_scrub_exit();
+#endif
 	platform_set_drvdata(dev, NULL);
 
 	return 0;
@@ -63,9 +63,12 @@
 #include <linux/spinlock.h>
 #include <linux/crc32.h>
 #include <linux/mii.h>
+#include <linux/ethtool.h>
 #include <linux/dm9000.h>
 #include <linux/delay.h>
 #include <linux/platform_device.h>
+#include <linux/hrtimer.h>
+#include <linux/dma-mapping.h>
 
 #include <asm/delay.h>
 #include <asm/irq.h>
@@ -79,6 +82,10 @@
 #include <mach/regs-mem.h>
 #include <mach/regs-irq.h>
 #include <asm/gpio.h>
+#ifdef CONFIG_DM9000_DMA
+#include <mach/dma.h>
+#include <mach/map.h>
+#endif
 
 
 #include "dm9000.h"
@@ -94,6 +101,8 @@
 
 #define DM9000_TIMER_WUT  jiffies+(HZ*2)	/* timer wakeup time : 2 second */
 
+#define DM9000_NAPI_WEIGHT	64	/* max packets pulled per poll round */
+
 #define DM9000_DEBUG 0
 
 #if DM9000_DEBUG > 2
@@ -135,6 +144,61 @@ static int watchdog = 5000;
 module_param(watchdog, int, 0400);
 MODULE_PARM_DESC(watchdog, "transmit timeout in milliseconds");
 
+/*
+ * Receive mode: NAPI polling (default) or one netif_rx() per packet
+ * from the interrupt handler.
+ */
+static int use_napi = 1;
+module_param(use_napi, int, 0400);
+MODULE_PARM_DESC(use_napi, "receive with NAPI polling (0 = per-packet interrupts)");
+
+#ifdef CONFIG_DM9000_DMA
+/*
+ * Frame transfers through the PL080: frames of at least dma_threshold
+ * bytes are moved by DMA, everything else by PIO.
+ */
+static int use_dma = 1;
+module_param(use_dma, int, 0400);
+MODULE_PARM_DESC(use_dma, "move large frames with the PL080 DMA controller (0 = PIO only)");
+
+static int dma_threshold = 256;
+module_param(dma_threshold, int, 0400);
+MODULE_PARM_DESC(dma_threshold, "smallest frame in bytes moved by DMA");
+
+static struct s3c2410_dma_client dm9000_dma_client = {
+	.name		= "dm9000-dma",
+};
+#endif
+
+/* driver private counters, reported through ethtool -S */
+struct dm9000_xstats {
+	unsigned long irq_count;	/* interrupts taken */
+	unsigned long rx_irq_count;	/* interrupts with ISR_PRS set */
+	unsigned long poll_count;	/* NAPI poll rounds */
+	unsigned long poll_exhausted;	/* rounds that used the full budget */
+	unsigned long rx_pio_bytes;	/* bytes moved by inblk */
+	unsigned long tx_pio_bytes;	/* bytes moved by outblk */
+	unsigned long rx_dma_bytes;	/* bytes moved by the DMA channel */
+	unsigned long tx_dma_bytes;
+	unsigned long tx_poll_reaped;	/* TX completions reaped by dm9000_poll() */
+	unsigned long rx_coalesce_polls; /* polls started by the coalescing timer */
+};
+
+static const char dm9000_gstrings_stats[][ETH_GSTRING_LEN] = {
+	"irq_count",
+	"rx_irq_count",
+	"napi_poll_count",
+	"napi_poll_exhausted",
+	"rx_pio_bytes",
+	"tx_pio_bytes",
+	"rx_dma_bytes",
+	"tx_dma_bytes",
+	"tx_poll_reaped",
+	"rx_coalesce_polls",
+};
+
+#define DM9000_STATS_LEN	ARRAY_SIZE(dm9000_gstrings_stats)
+
 /* Structure/enum declaration ------------------------------- */
 typedef struct board_info {
 
@@ -148,6 +212,8 @@ typedef struct board_info {
 	u16 dbug_cnt;
 	u8 io_mode;		/* 0:word, 2:byte */
 	u8 phy_addr;
+	u8 imr_all;		/* interrupt mask restored by the ISR */
+	u8 io_width;		/* bus width of the data port in bytes */
 
 	void (*inblk)(void __iomem *port, void *data, int length);
 	void (*outblk)(void __iomem *port, void *data, int length);
@@ -165,6 +231,27 @@ typedef struct board_info {
 
 	struct mii_if_info mii;
 	u32 msg_enable;
+
+	struct net_device *ndev;
+	struct napi_struct napi;
+	struct dm9000_xstats xstats;
+
+	/* RX interrupt coalescing, see dm9000_set_coalesce() */
+	struct hrtimer rx_timer;
+	u32 rx_coalesce_usecs;
+	u32 rx_coalesce_frames;
+
+#ifdef CONFIG_DM9000_DMA
+	struct device *dev;
+	unsigned long data_phys;	/* bus address of the data port */
+	int dma_ready;			/* DMACH_DM9000 requested */
+	int dma_busy;			/* data port owned by the DMA channel */
+	int irq_deferred;		/* ISR postponed until the DMA finished */
+	struct sk_buff *dma_skb;
+	dma_addr_t dma_addr;
+	enum dma_data_direction dma_dir;
+	int dma_len;
+#endif
 } board_info_t;
 
 /* function declaration ------------------------------------- */
@@ -178,12 +265,15 @@ static void dm9000_timer(unsigned long);
 static void dm9000_init_dm9000(struct net_device *);
 
 static irqreturn_t dm9000_interrupt(int, void *);
+static void dm9000_send_packet(struct net_device *, board_info_t *, int);
+static int dm9000_poll(struct napi_struct *, int);
+static enum hrtimer_restart dm9000_rx_timer(struct hrtimer *);
 
 static int dm9000_phy_read(struct net_device *dev, int phyaddr_unsused, int reg);
 static void dm9000_phy_write(struct net_device *dev, int phyaddr_unused, int reg,
 			   int value);
 static u16 read_srom_word(board_info_t *, int);
-static void dm9000_rx(struct net_device *);
+static int dm9000_rx(struct net_device *, struct sk_buff_head *, int);
 static void dm9000_hash_table(struct net_device *);
 
 #undef DM9000_PROGRAM_EEPROM
@@ -310,12 +400,14 @@ static void dm9000_set_io(struct board_info *db, int byte_width)
 
 	switch (byte_width) {
 	case 1:
+		db->io_width = 1;
 		db->dumpblk = dm9000_dumpblk_8bit;
 		db->outblk  = dm9000_outblk_8bit;
 		db->inblk   = dm9000_inblk_8bit;
 		break;
 
 	case 2:
+		db->io_width = 2;
 		db->dumpblk = dm9000_dumpblk_16bit;
 		db->outblk  = dm9000_outblk_16bit;
 		db->inblk   = dm9000_inblk_16bit;
@@ -323,6 +415,7 @@ static void dm9000_set_io(struct board_info *db, int byte_width)
 
 	case 3:
 		printk(KERN_ERR PFX ": 3 byte IO, falling back to 16bit\n");
+		db->io_width = 2;
 		db->dumpblk = dm9000_dumpblk_16bit;
 		db->outblk  = dm9000_outblk_16bit;
 		db->inblk   = dm9000_inblk_16bit;
@@ -330,6 +423,7 @@ static void dm9000_set_io(struct board_info *db, int byte_width)
 
 	case 4:
 	default:
+		db->io_width = 4;
 		db->dumpblk = dm9000_dumpblk_32bit;
 		db->outblk  = dm9000_outblk_32bit;
 		db->inblk   = dm9000_inblk_32bit;
@@ -337,6 +431,184 @@ static void dm9000_set_io(struct board_info *db, int byte_width)
 	}
 }
 
+#ifdef CONFIG_DM9000_DMA
+static void dm9000_dma_done(struct s3c2410_dma_chan *, void *, int,
+			    enum s3c2410_dma_buffresult);
+
+/* dm9000_dma_request
+ *
+ * claim the DMA channel when the interface comes up, falling back to
+ * PIO if it is not available
+ */
+
+static void dm9000_dma_request(board_info_t *db)
+{
+	db->dma_ready = 0;
+
+	if (!use_dma)
+		return;
+
+	if (s3c2410_dma_request(DMACH_DM9000, &dm9000_dma_client, NULL)) {
+		printk(KERN_WARNING PFX "no DMA channel, using PIO\n");
+		return;
+	}
+
+	s3c2410_dma_set_buffdone_fn(DMACH_DM9000, dm9000_dma_done);
+	s3c2410_dma_setflags(DMACH_DM9000, S3C2410_DMAF_AUTOSTART);
+	db->dma_ready = 1;
+}
+
+static void dm9000_dma_release(board_info_t *db)
+{
+	if (db->dma_ready) {
+		s3c2410_dma_free(DMACH_DM9000, &dm9000_dma_client);
+		db->dma_ready = 0;
+	}
+}
+
+/* dm9000_dma_flush
+ *
+ * abort a transfer in flight, dm9000_dma_done() is called back with
+ * S3C2410_RES_ABORT. Must not be called with db->lock held.
+ */
+
+static void dm9000_dma_flush(board_info_t *db)
+{
+	if (db->dma_ready)
+		s3c2410_dma_ctrl(DMACH_DM9000, S3C2410_DMAOP_FLUSH);
+}
+
+/* check whether len bytes at buf should be moved by the DMA channel */
+
+static int dm9000_dma_ok(board_info_t *db, void *buf, int len)
+{
+	if (!db->dma_ready || len < dma_threshold)
+		return 0;
+
+	return ((unsigned long)buf & (db->io_width - 1)) == 0;
+}
+
+/* dm9000_dma_start
+ *
+ * start moving len bytes between buf and the data port. The caller
+ * holds db->lock and has already selected MRCMD or MWCMD; from here
+ * until dm9000_dma_done() nothing else may touch the chip.
+ */
+
+static int dm9000_dma_start(board_info_t *db, struct sk_buff *skb, void *buf,
+			    int len, enum dma_data_direction dir)
+{
+	int count = (len + db->io_width - 1) & ~(db->io_width - 1);
+
+	db->dma_addr = dma_map_single(db->dev, buf, count, dir);
+	db->dma_dir = dir;
+	db->dma_len = len;
+	db->dma_skb = skb;
+	db->dma_busy = 1;
+
+	s3c2410_dma_devconfig(DMACH_DM9000, (dir == DMA_FROM_DEVICE) ?
+			      S3C_DMA_FIXED2MEM : S3C_DMA_MEM2FIXED,
+			      0, db->data_phys);
+	s3c2410_dma_config(DMACH_DM9000, db->io_width, 0);
+
+	if (s3c2410_dma_enqueue(DMACH_DM9000, db, db->dma_addr, count)) {
+		dma_unmap_single(db->dev, db->dma_addr, count, dir);
+		db->dma_skb = NULL;
+		db->dma_busy = 0;
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+/* dm9000_dma_done
+ *
+ * buffer done callback, runs from the DMA interrupt (or from
+ * dm9000_dma_flush() on abort) and finishes the frame the transfer
+ * belonged to.
+ */
+
+static void dm9000_dma_done(struct s3c2410_dma_chan *chan, void *buf_id,
+			    int size, enum s3c2410_dma_buffresult result)
+{
+	board_info_t *db = buf_id;
+	struct net_device *dev = db->ndev;
+	struct sk_buff *skb;
+	unsigned long flags;
+
+	spin_lock_irqsave(&db->lock, flags);
+
+	skb = db->dma_skb;
+	db->dma_skb = NULL;
+	db->dma_busy = 0;
+	dma_unmap_single(db->dev, db->dma_addr, size, db->dma_dir);
+
+	if (db->dma_dir == DMA_TO_DEVICE) {
+		if (result == S3C2410_RES_OK) {
+			db->xstats.tx_dma_bytes += db->dma_len;
+			dev->stats.tx_bytes += db->dma_len;
+			dm9000_send_packet(dev, db, db->dma_len);
+		} else
+			dev->stats.tx_dropped++;
+
+		dev_kfree_skb_irq(skb);
+	} else {
+		if (result == S3C2410_RES_OK) {
+			db->xstats.rx_dma_bytes += db->dma_len;
+			dev->stats.rx_bytes += db->dma_len;
+			skb->protocol = eth_type_trans(skb, dev);
+			netif_rx(skb);
+			dev->stats.rx_packets++;
+		} else {
+			dev->stats.rx_dropped++;
+			dev_kfree_skb_irq(skb);
+		}
+	}
+
+	/* let the ISR, transmit queue and RX poll at the chip again */
+	if (db->irq_deferred) {
+		db->irq_deferred = 0;
+		enable_irq(dev->irq);
+	}
+
+	if (db->tx_pkt_cnt < 2)
+		netif_wake_queue(dev);
+
+	if (!(db->imr_all & IMR_PRM))
+		netif_rx_schedule(dev, &db->napi);
+
+	spin_unlock_irqrestore(&db->lock, flags);
+}
+#else
+static inline void dm9000_dma_request(board_info_t *db) { }
+static inline void dm9000_dma_release(board_info_t *db) { }
+static inline void dm9000_dma_flush(board_info_t *db) { }
+#endif
+
+/* dm9000_lock_chip
+ *
+ * take db->lock with no DMA transfer owning the data port. Only for
+ * callers that run with interrupts enabled.
+ */
+
+#define dm9000_lock_chip(db, flags)					\
+	do {								\
+		spin_lock_irqsave(&(db)->lock, flags);			\
+		while (dm9000_dma_busy(db)) {				\
+			spin_unlock_irqrestore(&(db)->lock, flags);	\
+			cpu_relax();					\
+			spin_lock_irqsave(&(db)->lock, flags);		\
+		}							\
+	} while (0)
+
+static inline int dm9000_dma_busy(board_info_t *db)
+{
+#ifdef CONFIG_DM9000_DMA
+	return db->dma_busy;
+#else
+	return 0;
+#endif
+}
 
 /* Our watchdog timed out. Called by the networking layer */
 static void dm9000_timeout(struct net_device *dev)
@@ -349,6 +621,9 @@ static void dm9000_timeout(struct net_device *dev)
 	PRINTK1("****************************dm9000x: dm9000_set_timeout  ***************************\n");
 
 
+	/* a stuck transfer is dropped along with the chip state */
+	dm9000_dma_flush(db);
+
 	/* Save previous register address */
 	reg_save = readb(db->io_addr);
 	spin_lock_irqsave(&db->lock,flags);
@@ -377,6 +652,135 @@ static void dm9000_poll_controller(struct net_device *dev)
 }
 #endif
 
+/* ethtool ops */
+
+static void dm9000_get_drvinfo(struct net_device *dev,
+			       struct ethtool_drvinfo *info)
+{
+	strcpy(info->driver, CARDNAME);
+	strcpy(info->version, "1.2");
+	strcpy(info->bus_info, dev->dev.parent ? dev->dev.parent->bus_id : "");
+}
+
+static u32 dm9000_get_msglevel(struct net_device *dev)
+{
+	board_info_t *db = (board_info_t *) dev->priv;
+
+	return db->msg_enable;
+}
+
+static void dm9000_set_msglevel(struct net_device *dev, u32 value)
+{
+	board_info_t *db = (board_info_t *) dev->priv;
+
+	db->msg_enable = value;
+}
+
+static int dm9000_get_settings(struct net_device *dev, struct ethtool_cmd *cmd)
+{
+	board_info_t *db = (board_info_t *) dev->priv;
+
+	mii_ethtool_gset(&db->mii, cmd);
+	return 0;
+}
+
+static int dm9000_set_settings(struct net_device *dev, struct ethtool_cmd *cmd)
+{
+	board_info_t *db = (board_info_t *) dev->priv;
+
+	return mii_ethtool_sset(&db->mii, cmd);
+}
+
+static int dm9000_nway_reset(struct net_device *dev)
+{
+	board_info_t *db = (board_info_t *) dev->priv;
+
+	return mii_nway_restart(&db->mii);
+}
+
+static u32 dm9000_get_link(struct net_device *dev)
+{
+	board_info_t *db = (board_info_t *) dev->priv;
+
+	return mii_link_ok(&db->mii);
+}
+
+static int dm9000_get_coalesce(struct net_device *dev,
+			       struct ethtool_coalesce *ec)
+{
+	board_info_t *db = (board_info_t *) dev->priv;
+
+	memset(ec, 0, sizeof(*ec));
+	ec->rx_coalesce_usecs = db->rx_coalesce_usecs;
+	ec->rx_max_coalesced_frames = db->rx_coalesce_frames;
+	return 0;
+}
+
+/*
+ * rx-usecs: once a poll round has drained the RX SRAM, poll again after
+ * this many microseconds instead of re-enabling the receive interrupt.
+ * rx-frames: stay in timer mode only while a round sees at least this
+ * many frames, otherwise fall back to interrupts. 0 usecs disables it.
+ */
+static int dm9000_set_coalesce(struct net_device *dev,
+			       struct ethtool_coalesce *ec)
+{
+	board_info_t *db = (board_info_t *) dev->priv;
+
+	if (!use_napi && ec->rx_coalesce_usecs)
+		return -EOPNOTSUPP;
+
+	if (ec->rx_coalesce_usecs > USEC_PER_SEC / HZ)
+		return -EINVAL;
+
+	db->rx_coalesce_usecs = ec->rx_coalesce_usecs;
+	db->rx_coalesce_frames = ec->rx_max_coalesced_frames ? : 1;
+	return 0;
+}
+
+static int dm9000_get_sset_count(struct net_device *dev, int sset)
+{
+	switch (sset) {
+	case ETH_SS_STATS:
+		return DM9000_STATS_LEN;
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static void dm9000_get_strings(struct net_device *dev, u32 stringset, u8 *data)
+{
+	if (stringset == ETH_SS_STATS)
+		memcpy(data, dm9000_gstrings_stats, sizeof(dm9000_gstrings_stats));
+}
+
+static void dm9000_get_ethtool_stats(struct net_device *dev,
+				     struct ethtool_stats *stats, u64 *data)
+{
+	board_info_t *db = (board_info_t *) dev->priv;
+	unsigned long *counter = (unsigned long *)&db->xstats;
+	int i;
+
+	/* struct dm9000_xstats is laid out in dm9000_gstrings_stats order */
+	for (i = 0; i < DM9000_STATS_LEN; i++)
+		data[i] = counter[i];
+}
+
+static const struct ethtool_ops dm9000_ethtool_ops = {
+	.get_drvinfo		= dm9000_get_drvinfo,
+	.get_settings		= dm9000_get_settings,
+	.set_settings		= dm9000_set_settings,
+	.get_msglevel		= dm9000_get_msglevel,
+	.set_msglevel		= dm9000_set_msglevel,
+	.nway_reset		= dm9000_nway_reset,
+	.get_link		= dm9000_get_link,
+	.get_coalesce		= dm9000_get_coalesce,
+	.set_coalesce		= dm9000_set_coalesce,
+	.get_sset_count		= dm9000_get_sset_count,
+	.get_strings		= dm9000_get_strings,
+	.get_ethtool_stats	= dm9000_get_ethtool_stats,
+};
+
 /* dm9000_release_board
  *
  * release a board, and any mapped resources
@@ -472,6 +876,10 @@ dm9000_probe(struct platform_device *pdev)
 	memset(db, 0, sizeof (*db));
 
 	spin_lock_init(&db->lock);
+	db->ndev = ndev;
+#ifdef CONFIG_DM9000_DMA
+	db->dev = &pdev->dev;
+#endif
 
 	if (pdev->num_resources < 2) {
 		ret = -ENODEV;
@@ -488,6 +896,10 @@ dm9000_probe(struct platform_device *pdev)
 		ndev->irq = pdev->resource[1].start;
 		db->io_addr = (void __iomem *)base;
 		db->io_data = (void __iomem *)(base + DM9000_CMD);
+#ifdef CONFIG_DM9000_DMA
+		/* the resource is the static mapping of the chip */
+		db->data_phys = S3C64XX_PA_DM9000 + DM9000_CMD;
+#endif
 		/* ensure at least we have a default set of IO routines */
 		dm9000_set_io(db, 2);
 
@@ -532,6 +944,9 @@ dm9000_probe(struct platform_device *pdev)
 		}
 
 		db->io_data = ioremap(db->data_res->start, iosize);
+#ifdef CONFIG_DM9000_DMA
+		db->data_phys = db->data_res->start;
+#endif
 
 		if (db->io_data == NULL) {
 			printk(KERN_ERR "failed to ioremap data reg\n");
@@ -613,6 +1028,11 @@ dm9000_probe(struct platform_device *pdev)
 #ifdef CONFIG_NET_POLL_CONTROLLER
 	ndev->poll_controller	 = &dm9000_poll_controller;
 #endif
+	SET_ETHTOOL_OPS(ndev, &dm9000_ethtool_ops);
+	netif_napi_add(ndev, &db->napi, dm9000_poll, DM9000_NAPI_WEIGHT);
+	hrtimer_init(&db->rx_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	db->rx_timer.function = dm9000_rx_timer;
+	db->rx_coalesce_frames = 1;
 
 #ifdef DM9000_PROGRAM_EEPROM
 	program_eeprom(db);
@@ -680,6 +1100,9 @@ dm9000_open(struct net_device *dev)
 	/* Init driver variable */
 	db->dbug_cnt = 0;
 
+	napi_enable(&db->napi);
+	dm9000_dma_request(db);
+
 	/* set and active a timer process */
 	init_timer(&db->timer);
 	db->timer.expires  = DM9000_TIMER_WUT;
@@ -726,7 +1149,8 @@ dm9000_init_dm9000(struct net_device *dev)
 	/* Activate DM9000 */
 	iow(db, DM9000_RCR, RCR_DIS_LONG | RCR_DIS_CRC | RCR_RXEN);
 	/* Enable TX/RX interrupt mask */
-	iow(db, DM9000_IMR, IMR_PAR | IMR_PTM | IMR_PRM);
+	db->imr_all = IMR_PAR | IMR_PTM | IMR_PRM;
+	iow(db, DM9000_IMR, db->imr_all);
 
 	/* Init Driver variable */
 	db->tx_pkt_cnt = 0;
@@ -751,18 +1175,53 @@ dm9000_start_xmit(struct sk_buff *skb, struct net_device *dev)
 
 	spin_lock_irqsave(&db->lock, flags);
 
+	if (dm9000_dma_busy(db)) {
+		/* dm9000_dma_done() wakes the queue */
+		netif_stop_queue(dev);
+		spin_unlock_irqrestore(&db->lock, flags);
+		return NETDEV_TX_BUSY;
+	}
+
 	/* Move data to DM9000 TX RAM */
 	writeb(DM9000_MWCMD, db->io_addr);
 
+#ifdef CONFIG_DM9000_DMA
+	/* dm9000_dma_done() queues the frame and frees the skb */
+	if (dm9000_dma_ok(db, skb->data, skb->len) &&
+	    dm9000_dma_start(db, skb, skb->data, skb->len, DMA_TO_DEVICE) == 0) {
+		netif_stop_queue(dev);
+		spin_unlock_irqrestore(&db->lock, flags);
+		return 0;
+	}
+#endif
+
 	(db->outblk)(db->io_data, skb->data, skb->len);
+	db->xstats.tx_pio_bytes += skb->len;
 	dev->stats.tx_bytes += skb->len;
 
+	dm9000_send_packet(dev, db, skb->len);
+
+	spin_unlock_irqrestore(&db->lock, flags);
+
+	/* free this SKB */
+	dev_kfree_skb(skb);
+
+	return 0;
+}
+
+/*
+ *  Hand a frame already copied to TX SRAM to the MAC.
+ *  Called with db->lock held.
+ */
+static void
+dm9000_send_packet(struct net_device *dev, board_info_t *db, int len)
+{
 	db->tx_pkt_cnt++;
 	/* TX control: First packet immediately send, second packet queue */
 	if (db->tx_pkt_cnt == 1) {
 		/* Set TX length to DM9000 */
-		iow(db, DM9000_TXPLL, skb->len & 0xff);
-		iow(db, DM9000_TXPLH, (skb->len >> 8) & 0xff);
+		iow(db, DM9000_TXPLL, len & 0xff);
+		iow(db, DM9000_TXPLH, (len >> 8) & 0xff);
 
 		/* Issue TX polling command */
 		iow(db, DM9000_TCR, TCR_TXREQ);	/* Cleared after TX complete */
@@ -770,16 +1229,9 @@ dm9000_start_xmit(struct sk_buff *skb, struct net_device *dev)
 		dev->trans_start = jiffies;	/* save the time stamp */
 	} else {
 		/* Second packet */
-		db->queue_pkt_len = skb->len;
+		db->queue_pkt_len = len;
 		netif_stop_queue(dev);
 	}
-
-	spin_unlock_irqrestore(&db->lock, flags);
-
-	/* free this SKB */
-	dev_kfree_skb(skb);
-
-	return 0;
 }
 
 static void
@@ -810,9 +1262,13 @@ dm9000_stop(struct net_device *ndev)
 
 	netif_stop_queue(ndev);
 	netif_carrier_off(ndev);
+	napi_disable(&db->napi);
+	hrtimer_cancel(&db->rx_timer);
+	dm9000_dma_flush(db);
 
 	/* free interrupt */
 	free_irq(ndev->irq, ndev);
+	dm9000_dma_release(db);
 
 	dm9000_shutdown(ndev);
 
@@ -824,7 +1280,12 @@ dm9000_stop(struct net_device *ndev)
  * receive the packet to upper layer, free the transmitted packet
  */
 
-static void
+/*
+ *  Reap a completed transmission and start the queued one.
+ *  Returns non-zero if a TX SRAM slot was freed; waking the queue is
+ *  left to the caller so the poll path can do it once per round.
+ */
+static int
 dm9000_tx_done(struct net_device *dev, board_info_t * db)
 {
 	int tx_status = ior(db, DM9000_NSR);	/* Got TX status */
@@ -841,8 +1302,10 @@ dm9000_tx_done(struct net_device *dev, board_info_t * db)
 			iow(db, DM9000_TCR, TCR_TXREQ);
 			dev->trans_start = jiffies;
 		}
-		netif_wake_queue(dev);
+		return 1;
 	}
+
+	return 0;
 }
 
 static irqreturn_t
@@ -864,6 +1327,16 @@ dm9000_interrupt(int irq, void *dev_id)
 	db = (board_info_t *) dev->priv;
 	spin_lock(&db->lock);
 
+#ifdef CONFIG_DM9000_DMA
+	if (db->dma_busy) {
+		/* the data port is mid-transfer, dm9000_dma_done() re-enables us */
+		disable_irq_nosync(irq);
+		db->irq_deferred = 1;
+		spin_unlock(&db->lock);
+		return IRQ_HANDLED;
+	}
+#endif
+
 	/* Save previous register address */
 	reg_save = readb(db->io_addr);
 
@@ -874,16 +1347,33 @@ dm9000_interrupt(int irq, void *dev_id)
 	int_status = ior(db, DM9000_ISR);	/* Got ISR */
 	iow(db, DM9000_ISR, int_status);	/* Clear ISR status */
 
-	/* Received the coming packet */
+	db->xstats.irq_count++;
+
 	if (int_status & ISR_PRS)
-		dm9000_rx(dev);
+		db->xstats.rx_irq_count++;
+
+	if (use_napi) {
+		/*
+		 * Both RX and TX completions are handled by dm9000_poll(),
+		 * and stay masked until it has caught up with the chip.
+		 */
+		if ((int_status & (ISR_PRS | ISR_PTS)) &&
+		    netif_rx_schedule_prep(dev, &db->napi)) {
+			db->imr_all &= ~(IMR_PRM | IMR_PTM);
+			__netif_rx_schedule(dev, &db->napi);
+		}
+	} else {
+		/* Received the coming packet */
+		if (int_status & ISR_PRS)
+			dm9000_rx(dev, NULL, INT_MAX);
 
-	/* Trnasmit Interrupt check */
-	if (int_status & ISR_PTS)
-		dm9000_tx_done(dev, db);
+		/* Trnasmit Interrupt check */
+		if ((int_status & ISR_PTS) && dm9000_tx_done(dev, db))
+			netif_wake_queue(dev);
+	}
 
 	/* Re-enable interrupt mask */
-	iow(db, DM9000_IMR, IMR_PAR | IMR_PTM | IMR_PRM);
+	iow(db, DM9000_IMR, db->imr_all);
 
 	/* Restore previous register address */
 	writeb(reg_save, db->io_addr);
@@ -918,10 +1408,16 @@ struct dm9000_rxhdr {
 } __attribute__((__packed__));
 
 /*
- *  Received a packet and pass to upper layer
+ *  Received packets and pass to upper layer
+ *
+ *  At most limit packets are taken from the RX SRAM. Good packets are
+ *  queued on rxq when it is given (NAPI, delivered once db->lock has
+ *  been dropped), otherwise they are handed to netif_rx() directly.
+ *  Returns the number of packets taken; less than limit means the
+ *  SRAM is empty.
  */
-static void
-dm9000_rx(struct net_device *dev)
+static int
+dm9000_rx(struct net_device *dev, struct sk_buff_head *rxq, int limit)
 {
 	board_info_t *db = (board_info_t *) dev->priv;
 	struct dm9000_rxhdr rxhdr;
@@ -929,9 +1425,10 @@ dm9000_rx(struct net_device *dev)
 	u8 rxbyte, *rdptr;
 	bool GoodPacket;
 	int RxLen;
+	int done = 0;
 
 	/* Check packet ready or not */
-	do {
+	while (done < limit) {
 		ior(db, DM9000_MRCMDX);	/* Dummy read */
 
 		/* Get most updated data */
@@ -942,11 +1439,13 @@ dm9000_rx(struct net_device *dev)
 			printk("status check failed: %d\n", rxbyte);
 			iow(db, DM9000_RCR, 0x00);	/* Stop Device */
 			iow(db, DM9000_ISR, IMR_PAR);	/* Stop INT request */
-			return;
+			break;
 		}
 
 		if (rxbyte != DM9000_PKT_RDY)
-			return;
+			break;
+
+		done++;
 
 		/* A packet ready now  & Get status/length */
 		GoodPacket = true;
@@ -988,14 +1487,26 @@ dm9000_rx(struct net_device *dev)
 			skb_reserve(skb, 2);
 			rdptr = (u8 *) skb_put(skb, RxLen - 4);
 
+#ifdef CONFIG_DM9000_DMA
+			/* dm9000_dma_done() passes the frame up */
+			if (rxq && dm9000_dma_ok(db, rdptr, RxLen) &&
+			    dm9000_dma_start(db, skb, rdptr, RxLen,
+					     DMA_FROM_DEVICE) == 0)
+				break;
+#endif
+
 			/* Read received packet from RX SRAM */
 
 			(db->inblk)(db->io_data, rdptr, RxLen);
+			db->xstats.rx_pio_bytes += RxLen;
 			dev->stats.rx_bytes += RxLen;
 
 			/* Pass to upper layer */
 			skb->protocol = eth_type_trans(skb, dev);
-			netif_rx(skb);
+			if (rxq)
+				__skb_queue_tail(rxq, skb);
+			else
+				netif_rx(skb);
 			dev->stats.rx_packets++;
 
 		} else {
@@ -1003,7 +1514,112 @@ dm9000_rx(struct net_device *dev)
 
 			(db->dumpblk)(db->io_data, RxLen);
 		}
-	} while (rxbyte == DM9000_PKT_RDY);
+	}
+
+	return done;
+}
+
+/*
+ *  NAPI poll: drain the RX SRAM up to budget packets and turn the
+ *  receive interrupt back on once it is empty.
+ */
+static int
+dm9000_poll(struct napi_struct *napi, int budget)
+{
+	board_info_t *db = container_of(napi, board_info_t, napi);
+	struct net_device *dev = db->ndev;
+	struct sk_buff_head rxq;
+	struct sk_buff *skb;
+	unsigned long flags;
+	u8 reg_save;
+	int work_done;
+	int tx_freed = 0;
+	int rx_dma;
+
+	__skb_queue_head_init(&rxq);
+
+	spin_lock_irqsave(&db->lock, flags);
+
+	if (dm9000_dma_busy(db)) {
+		/* a transmit DMA owns the data port, dm9000_dma_done() reschedules us */
+		__netif_rx_complete(dev, napi);
+		spin_unlock_irqrestore(&db->lock, flags);
+		return 0;
+	}
+
+	reg_save = readb(db->io_addr);
+
+	if (dm9000_tx_done(dev, db)) {
+		db->xstats.tx_poll_reaped++;
+		tx_freed = 1;
+	}
+
+	work_done = dm9000_rx(dev, &rxq, budget);
+	rx_dma = dm9000_dma_busy(db);
+	if (!rx_dma)
+		writeb(reg_save, db->io_addr);
+	spin_unlock_irqrestore(&db->lock, flags);
+
+	/* one wake-up for everything reaped in this round */
+	if (tx_freed)
+		netif_wake_queue(dev);
+
+	/* hand packets up without db->lock, the stack may transmit */
+	while ((skb = __skb_dequeue(&rxq)) != NULL)
+		netif_receive_skb(skb);
+
+	db->xstats.poll_count++;
+
+	if (rx_dma) {
+		/* the frame left to the DMA channel need not be the last one */
+		spin_lock_irqsave(&db->lock, flags);
+		if (dm9000_dma_busy(db)) {
+			__netif_rx_complete(dev, napi);
+			spin_unlock_irqrestore(&db->lock, flags);
+			return min(work_done, budget - 1);
+		}
+		spin_unlock_irqrestore(&db->lock, flags);
+
+		/* already finished, stay on the poll list */
+		return budget;
+	}
+
+	if (work_done < budget) {
+		spin_lock_irqsave(&db->lock, flags);
+		__netif_rx_complete(dev, napi);
+
+		/* a packet arriving from here on latches ISR_PRS again */
+		reg_save = readb(db->io_addr);
+		db->imr_all |= IMR_PTM;
+		if (db->rx_coalesce_usecs && work_done >= db->rx_coalesce_frames)
+			/* traffic is flowing, come back from the timer */
+			hrtimer_start(&db->rx_timer,
+				      ktime_set(0, db->rx_coalesce_usecs * NSEC_PER_USEC),
+				      HRTIMER_MODE_REL);
+		else
+			db->imr_all |= IMR_PRM;
+		iow(db, DM9000_IMR, db->imr_all);
+		writeb(reg_save, db->io_addr);
+		spin_unlock_irqrestore(&db->lock, flags);
+	} else
+		db->xstats.poll_exhausted++;
+
+	return work_done;
+}
+
+/*
+ *  RX coalescing timer: poll the SRAM again while the receive
+ *  interrupt stays masked.
+ */
+static enum hrtimer_restart
+dm9000_rx_timer(struct hrtimer *timer)
+{
+	board_info_t *db = container_of(timer, board_info_t, rx_timer);
+
+	db->xstats.rx_coalesce_polls++;
+	netif_rx_schedule(db->ndev, &db->napi);
+
+	return HRTIMER_NORESTART;
 }
 
 /*
@@ -1089,7 +1705,7 @@ dm9000_hash_table(struct net_device *dev)
 
 	PRINTK2("dm9000_hash_table()\n");
 
-	spin_lock_irqsave(&db->lock,flags);
+	dm9000_lock_chip(db, flags);
 
 	for (i = 0, oft = 0x10; i < 6; i++, oft++)
 		iow(db, oft, dev->dev_addr[i]);
@@ -1128,7 +1744,7 @@ dm9000_phy_read(struct net_device *dev, int phy_reg_unused, int reg)
 	unsigned int reg_save;
 	int ret;
 
-	spin_lock_irqsave(&db->lock,flags);
+	dm9000_lock_chip(db, flags);
 
 	/* Save previous register address */
 	reg_save = readb(db->io_addr);
@@ -1161,7 +1777,7 @@ dm9000_phy_write(struct net_device *dev, int phyaddr_unused, int reg, int value)
 	unsigned long flags;
 	unsigned long reg_save;
 
-	spin_lock_irqsave(&db->lock,flags);
+	dm9000_lock_chip(db, flags);
 
 	/* Save previous register address */
 	reg_save = readb(db->io_addr);
@@ -1191,6 +1807,7 @@ dm9000_drv_suspend(struct platform_device *dev, pm_message_t state)
 	if (ndev) {
 		if (netif_running(ndev)) {
 			netif_device_detach(ndev);
+			dm9000_dma_flush((board_info_t *) ndev->priv);
 			dm9000_shutdown(ndev);
 		}
 	}
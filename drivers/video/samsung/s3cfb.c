@@ -186,6 +186,13 @@ static int s3cfb_check_var(struct fb_var_screeninfo *var, struct fb_info *info)
 	if( (fbi->win_id == 0) && (var->bits_per_pixel == 28) ){
 		var->transp.length = 0;
 	}
+
+	/* extra screens for page flipping have to fit in the video memory */
+	if (var->yres_virtual < var->yres)
+		var->yres_virtual = var->yres;
+
+	if (var->xres_virtual * var->yres_virtual * s3cfb_fimd.bytes_per_pixel > fbi->fb.fix.smem_len)
+		return -EINVAL;
 	
 	return 0;
 }
@@ -222,11 +229,20 @@ static int s3cfb_set_par(struct fb_info *info)
  *	`xoffset' and `yoffset' fields of the `var' structure.
  *	If the values don't fit, return -EINVAL.
  *
+ *	The new address is only queued here and written by the vsync
+ *	interrupt, so a flip never shows up in the middle of a frame. With
+ *	yres_virtual = 3 * yres an application can draw the third buffer
+ *	while the second one is queued; a pan that finds a flip still queued
+ *	waits for it. Without the frame interrupt the address is written
+ *	straight away.
+ *
  *	Returns negative errno on error, or zero on success.
  */
 static int s3cfb_pan_display(struct fb_var_screeninfo *var, struct fb_info *info)
 {
 	s3cfb_info_t *fbi = (s3cfb_info_t *)info;
+	unsigned long flags;
+	int ret;
 
 	DPRINTK("s3c_fb_pan_display(var=%p, info=%p)\n", var, info);
 
@@ -236,10 +252,29 @@ static int s3cfb_pan_display(struct fb_var_screeninfo *var, struct fb_info *info
 	if (var->yoffset + info->var.yres > info->var.yres_virtual)
 		return -EINVAL;
 
+	if (!(s3cfb_fimd.vidintcon0 & S3C_VIDINTCON0_INTFRMEN_ENABLE)) {
+		fbi->fb.var.xoffset = var->xoffset;
+		fbi->fb.var.yoffset = var->yoffset;
+
+		s3cfb_set_fb_addr(fbi);
+		fbi->flip_count++;
+
+		return 0;
+	}
+
+	/* on timeout (display off) the queued flip is simply replaced */
+	ret = wait_event_interruptible_timeout(s3cfb_fimd.vsync_info.wait_queue, !fbi->flip_pending, HZ / 10);
+
+	if (ret < 0)
+		return ret;
+
+	local_irq_save(flags);
+
 	fbi->fb.var.xoffset = var->xoffset;
 	fbi->fb.var.yoffset = var->yoffset;
+	fbi->flip_pending = 1;
 
-	s3cfb_set_fb_addr(fbi);
+	local_irq_restore(flags);
 
 	return 0;
 }
@@ -540,6 +575,162 @@ int s3cfb_wait_for_vsync(void)
   	return cnt;
 }
 
+/* Called from the vsync interrupt: write the addresses of queued pans */
+void s3cfb_commit_flips(void)
+{
+	int i;
+
+	for (i = 0; i < S3CFB_NUM; i++) {
+		if (!s3cfb_info[i].flip_pending)
+			continue;
+
+		s3cfb_set_fb_addr(&s3cfb_info[i]);
+		s3cfb_info[i].flip_pending = 0;
+		s3cfb_info[i].flip_count++;
+	}
+}
+
+/*
+ * S3CFB_WIN_COMMIT: change several windows at once. Everything is checked
+ * and queued with interrupts off, and the vsync interrupt writes it all
+ * in one go, so the windows of a commit change on the same frame. The
+ * buffer part goes through the same next_fb_info path as
+ * S3CFB_SET_NEXT_FB_INFO. A commit that is not on screen yet is merged
+ * with the next one. Without the frame interrupt it is written at once.
+ */
+static int s3cfb_check_win_state(s3cfb_win_state_t *state)
+{
+	s3cfb_next_info_t *next = &state->fb_info;
+
+	if (state->win_id >= S3CFB_NUM)
+		return -EINVAL;
+
+	if ((state->flags & (S3CFB_WIN_SET_ALPHA | S3CFB_WIN_SET_COLOR_KEY)) && state->win_id == 0)
+		return -EINVAL;
+
+	if ((state->flags & S3CFB_WIN_SET_ALPHA) &&
+		(state->alpha0 > S3CFB_MAX_ALPHA_LEVEL || state->alpha1 > S3CFB_MAX_ALPHA_LEVEL))
+		return -EINVAL;
+
+	if ((state->flags & S3CFB_WIN_SET_BUFFER) &&
+		((next->xres + next->xoffset) > next->xres_virtual ||
+		(next->yres + next->yoffset) > next->yres_virtual ||
+		(next->xres + next->lcd_offset_x) > s3cfb_fimd.width ||
+		(next->yres + next->lcd_offset_y) > s3cfb_fimd.height))
+		return -EINVAL;
+
+	return 0;
+}
+
+int s3cfb_win_commit(s3cfb_win_commit_t *commit)
+{
+	s3cfb_win_state_t *state, *next;
+	s3cfb_info_t *fbi;
+	unsigned long flags;
+	int i, ret;
+
+	if (commit->num > S3CFB_COMMIT_MAX_WIN)
+		return -EINVAL;
+
+	for (i = 0; i < commit->num; i++) {
+		ret = s3cfb_check_win_state(&commit->win[i]);
+
+		if (ret)
+			return ret;
+	}
+
+	local_irq_save(flags);
+
+	for (i = 0; i < commit->num; i++) {
+		state = &commit->win[i];
+		fbi = &s3cfb_info[state->win_id];
+		next = &fbi->next_win_state;
+
+		if (state->flags & S3CFB_WIN_SET_BUFFER) {
+			fbi->next_fb_info = state->fb_info;
+			fbi->next_fb_info_change_req = 1;
+		}
+
+		if (state->flags & S3CFB_WIN_SET_ENABLE)
+			next->enable = state->enable;
+
+		if (state->flags & S3CFB_WIN_SET_ALPHA) {
+			next->alpha0 = state->alpha0;
+			next->alpha1 = state->alpha1;
+		}
+
+		if (state->flags & S3CFB_WIN_SET_COLOR_KEY) {
+			next->color_key_enable = state->color_key_enable;
+			next->color_key = state->color_key;
+			next->color_val = state->color_val;
+		}
+
+		next->flags |= state->flags & ~S3CFB_WIN_SET_BUFFER;
+		fbi->next_win_state_req = 1;
+	}
+
+	/* without the frame interrupt nothing would ever write it, as in s3cfb_pan_display() */
+	if (!(s3cfb_fimd.vidintcon0 & S3C_VIDINTCON0_INTFRMEN_ENABLE)) {
+		s3cfb_commit_next_fb_info();
+		s3cfb_commit_win_states();
+	}
+
+	local_irq_restore(flags);
+
+	return 0;
+}
+
+/* Called from the vsync interrupt, after the next_fb_info changes */
+void s3cfb_commit_win_states(void)
+{
+	s3cfb_win_state_t *next;
+	s3cfb_info_t *fbi;
+	int i;
+
+	for (i = 0; i < S3CFB_NUM; i++) {
+		fbi = &s3cfb_info[i];
+
+		if (!fbi->next_win_state_req)
+			continue;
+
+		next = &fbi->next_win_state;
+
+		if (next->flags & S3CFB_WIN_SET_ALPHA) {
+			s3cfb_set_alpha_level(fbi, next->alpha0, 0);
+			s3cfb_set_alpha_level(fbi, next->alpha1, 1);
+		}
+
+		if (next->flags & S3CFB_WIN_SET_COLOR_KEY) {
+			s3cfb_set_color_key_registers(fbi, next->color_key);
+			s3cfb_set_color_value(fbi, next->color_val);
+			s3cfb_onoff_color_key(fbi, next->color_key_enable);
+		}
+
+		if (next->flags & S3CFB_WIN_SET_ENABLE)
+			s3cfb_onoff_win(fbi, next->enable);
+
+		next->flags = 0;
+		fbi->next_win_state_req = 0;
+	}
+}
+
+/*
+ * Wait until flip_count has reached count, eg. the value S3CFB_GET_FLIP_COUNT
+ * returned plus the number of pans queued since. S3CFB_GET_FLIP_COUNT itself
+ * never blocks, so a renderer can check for completion between frames.
+ */
+int s3cfb_wait_for_flip(s3cfb_info_t *fbi, unsigned int count)
+{
+	int ret;
+
+	ret = wait_event_interruptible_timeout(s3cfb_fimd.vsync_info.wait_queue, (int)(fbi->flip_count - count) >= 0, HZ / 10);
+
+	if (ret < 0)
+		return ret;
+
+	return ret ? 0 : -ETIMEDOUT;
+}
+
 static void s3cfb_update_palette(s3cfb_info_t *fbi, unsigned int regno, unsigned int val)
 {
 	unsigned long flags;
@@ -676,6 +867,73 @@ static DEVICE_ATTR(backlight_level, 0644,
 			s3cfb_sysfs_show_backlight_level,
 			s3cfb_sysfs_store_backlight_level);
 
+#if defined(CONFIG_FB_S3C_G2D_ACCEL)
+/*
+ * Console drawing through the FIMG-2D engine. Fills and copies are queued
+ * and not waited for; anything that draws with the CPU syncs first. The
+ * formats and copies the engine can't do fall back to the cfb_* code.
+ */
+static int s3cfb_g2d_bpp(struct fb_info *info)
+{
+	if (info->state != FBINFO_STATE_RUNNING)
+		return 0;
+
+	if (info->var.bits_per_pixel == 16)
+		return 16;
+
+	/* 24bpp is 888 in a 32 bit word */
+	if (info->var.bits_per_pixel == 24)
+		return 32;
+
+	return 0;
+}
+
+static void s3cfb_fillrect(struct fb_info *info, const struct fb_fillrect *rect)
+{
+	int bpp = s3cfb_g2d_bpp(info);
+	u32 color;
+
+	if (bpp && rect->rop == ROP_COPY) {
+		color = ((u32 *) info->pseudo_palette)[rect->color];
+
+		if (s3c_g2d_kernel_fill(info->fix.smem_start, bpp,
+				info->fix.line_length / (bpp / 8), info->var.yres_virtual,
+				rect->dx, rect->dy, rect->width, rect->height, color) == 0)
+			return;
+	}
+
+	s3c_g2d_kernel_sync();
+	cfb_fillrect(info, rect);
+}
+
+static void s3cfb_copyarea(struct fb_info *info, const struct fb_copyarea *area)
+{
+	int bpp = s3cfb_g2d_bpp(info);
+
+	if (bpp) {
+		if (s3c_g2d_kernel_copy(info->fix.smem_start, bpp,
+				info->fix.line_length / (bpp / 8), info->var.yres_virtual,
+				area->sx, area->sy, area->dx, area->dy,
+				area->width, area->height) == 0)
+			return;
+	}
+
+	s3c_g2d_kernel_sync();
+	cfb_copyarea(info, area);
+}
+
+static void s3cfb_imageblit(struct fb_info *info, const struct fb_image *image)
+{
+	s3c_g2d_kernel_sync();
+	cfb_imageblit(info, image);
+}
+
+static int s3cfb_sync(struct fb_info *info)
+{
+	return s3c_g2d_kernel_sync();
+}
+#endif
+
 struct fb_ops s3cfb_ops = {
 	.owner		= THIS_MODULE,
 	.fb_check_var	= s3cfb_check_var,
@@ -683,9 +941,16 @@ struct fb_ops s3cfb_ops = {
 	.fb_blank	= s3cfb_blank,
 	.fb_pan_display	= s3cfb_pan_display,
 	.fb_setcolreg	= s3cfb_setcolreg,
+#if defined(CONFIG_FB_S3C_G2D_ACCEL)
+	.fb_fillrect	= s3cfb_fillrect,
+	.fb_copyarea	= s3cfb_copyarea,
+	.fb_imageblit	= s3cfb_imageblit,
+	.fb_sync	= s3cfb_sync,
+#else
 	.fb_fillrect	= cfb_fillrect,
 	.fb_copyarea	= cfb_copyarea,
 	.fb_imageblit	= cfb_imageblit,
+#endif
 	.fb_cursor	= soft_cursor,
 	.fb_ioctl	= s3cfb_ioctl,
 };
@@ -709,6 +974,10 @@ static void s3cfb_init_fbinfo(s3cfb_info_t *finfo, char *drv_name, int index)
 
 	finfo->fb.fbops = &s3cfb_ops;
 	finfo->fb.flags	= FBINFO_FLAG_DEFAULT;
+#if defined(CONFIG_FB_S3C_G2D_ACCEL)
+	/* copying is cheaper than redrawing, let fbcon scroll by moving */
+	finfo->fb.flags |= FBINFO_HWACCEL_COPYAREA | FBINFO_HWACCEL_FILLRECT;
+#endif
 
 	finfo->fb.pseudo_palette = &finfo->pseudo_pal;
 
@@ -763,6 +1032,7 @@ static void s3cfb_init_fbinfo(s3cfb_info_t *finfo, char *drv_name, int index)
 	/*
 	* Some systems(ex. DirectFB) use FB0 memory as a video memory.
 	* You can modify the size of multiple.
+	* This is also where yres_virtual finds its page flipping screens.
 	*/
 	if (index == 0)
 		finfo->fb.fix.smem_len *= 5;
@@ -85,6 +85,13 @@ extern int s5pc100_timer_setup (int channel, int usec, unsigned long g_tcnt, uns
 #define S3CFB_VS_MOVE_DOWN		18
 #define S3CFB_ALPHA_MODE_PLANE		0
 #define S3CFB_ALPHA_MODE_PIXEL		1
+#define S3CFB_COMMIT_MAX_WIN		5
+
+/* s3cfb_win_state_t flags: what S3CFB_WIN_COMMIT changes for a window */
+#define S3CFB_WIN_SET_ENABLE		(1 << 0)
+#define S3CFB_WIN_SET_BUFFER		(1 << 1)	/* address, size and position */
+#define S3CFB_WIN_SET_ALPHA		(1 << 2)
+#define S3CFB_WIN_SET_COLOR_KEY		(1 << 3)
 
 /*
  *  macros
@@ -136,6 +143,9 @@ extern int s5pc100_timer_setup (int channel, int usec, unsigned long g_tcnt, uns
 #define S3CFB_SET_VSYNC_INT		_IOW ('F', 309, int)
 #define S3CFB_SET_NEXT_FB_INFO		_IOW ('F', 320, s3cfb_next_info_t)
 #define S3CFB_GET_CURR_FB_INFO		_IOR ('F', 321, s3cfb_next_info_t)
+#define S3CFB_GET_FLIP_COUNT		_IOR ('F', 322, unsigned int)
+#define S3CFB_WAIT_FOR_FLIP		_IOW ('F', 323, unsigned int)
+#define S3CFB_WIN_COMMIT		_IOW ('F', 324, s3cfb_win_commit_t)
 
 /*
  *  structures
@@ -192,6 +202,24 @@ typedef struct {
 	unsigned int lcd_offset_y;
 } s3cfb_next_info_t;
 
+/* one window of an S3CFB_WIN_COMMIT, only the fields named in flags are used */
+typedef struct {
+	unsigned int win_id;
+	unsigned int flags;
+	int enable;
+	s3cfb_next_info_t fb_info;	/* eg. a post processor output buffer */
+	unsigned int alpha0;		/* not for WIN0 */
+	unsigned int alpha1;
+	int color_key_enable;		/* not for WIN0 */
+	s3cfb_color_key_info_t color_key;
+	s3cfb_color_val_info_t color_val;
+} s3cfb_win_state_t;
+
+typedef struct {
+	unsigned int num;
+	s3cfb_win_state_t win[S3CFB_COMMIT_MAX_WIN];
+} s3cfb_win_commit_t;
+
 typedef struct {
 	struct fb_bitfield red;
 	struct fb_bitfield green;
@@ -278,6 +306,14 @@ typedef struct {
 	unsigned int		lcd_offset_y;
 	unsigned int		next_fb_info_change_req;
 	s3cfb_next_info_t	next_fb_info;
+
+	/* pan queued by s3cfb_pan_display(), written at the next vsync */
+	unsigned int		flip_pending;
+	unsigned int		flip_count;	/* pans that reached the screen */
+
+	/* rest of an S3CFB_WIN_COMMIT, written at the next vsync */
+	unsigned int		next_win_state_req;
+	s3cfb_win_state_t	next_win_state;
 } s3cfb_info_t;
 
 typedef struct {
@@ -496,6 +532,12 @@ extern int s3cfb_set_win_size(s3cfb_info_t *fbi, int width, int height);
 extern int s3cfb_set_fb_size(s3cfb_info_t *fbi);
 extern int s3cfb_set_vs_info(s3cfb_vs_info_t vs_info);
 extern int s3cfb_wait_for_vsync(void);
+extern void s3cfb_commit_flips(void);
+extern int s3cfb_wait_for_flip(s3cfb_info_t *fbi, unsigned int count);
+extern int s3cfb_win_commit(s3cfb_win_commit_t *commit);
+extern void s3cfb_commit_win_states(void);
+extern void s3cfb_commit_next_fb_info(void);
+extern int s3cfb_set_alpha_level(s3cfb_info_t *fbi, unsigned int level, unsigned int alpha_index);
 extern int s3cfb_onoff_color_key(s3cfb_info_t *fbi, int onoff);
 extern int s3cfb_onoff_color_key_alpha(s3cfb_info_t *fbi, int onoff);
 extern int s3cfb_set_color_key_registers(s3cfb_info_t *fbi, s3cfb_color_key_info_t colkey_info);
@@ -515,5 +557,14 @@ extern void s3cfb_spi_set_lcd_data(int ch);
 extern int s3cfb_spi_gpio_free(int ch);
 extern void s3cfb_pre_init(void);
 
+#if defined(CONFIG_FB_S3C_G2D_ACCEL)
+/* drivers/media/video/samsung/g2d/s3c_fimg2d2x.c */
+extern int s3c_g2d_kernel_fill(u32 base, int bpp, u32 full_width, u32 full_height,
+			u32 x, u32 y, u32 width, u32 height, u32 color);
+extern int s3c_g2d_kernel_copy(u32 base, int bpp, u32 full_width, u32 full_height,
+			u32 sx, u32 sy, u32 dx, u32 dy, u32 width, u32 height);
+extern int s3c_g2d_kernel_sync(void);
+#endif
+
 #endif
 
@@ -304,16 +304,18 @@ void s3cfb_write_palette(s3cfb_info_t *fbi)
 	writel(s3cfb_fimd.wpalcon, S3C_WPALCON);
 }
 
-irqreturn_t s3cfb_irq(int irqno, void *param)
+/*
+ * Write the buffers queued with S3CFB_SET_NEXT_FB_INFO or S3CFB_WIN_COMMIT.
+ * Called from the vsync interrupt, or with interrupts off when the frame
+ * interrupt is disabled.
+ */
+void s3cfb_commit_next_fb_info(void)
 {
 	unsigned long buffer_size = 0;
 	unsigned int i;
 	unsigned int buffer_page_offset, buffer_page_width;
 	unsigned int fb_start_address, fb_end_address;
 
-	if (s3cfb_info[s3cfb_fimd.palette_win].palette_ready)
-		s3cfb_write_palette(&s3cfb_info[s3cfb_fimd.palette_win]);
-
 	for (i = 0; i < CONFIG_FB_S3C_NUM; i++) {
 		if (s3cfb_info[i].next_fb_info_change_req) {
 			/* fb variable setting */
@@ -380,6 +382,16 @@ irqreturn_t s3cfb_irq(int irqno, void *param)
 			s3cfb_info[i].next_fb_info_change_req = 0;
 		}
 	}
+}
+
+irqreturn_t s3cfb_irq(int irqno, void *param)
+{
+	if (s3cfb_info[s3cfb_fimd.palette_win].palette_ready)
+		s3cfb_write_palette(&s3cfb_info[s3cfb_fimd.palette_win]);
+
+	s3cfb_commit_next_fb_info();
+	s3cfb_commit_win_states();
+	s3cfb_commit_flips();
 
 	/* for clearing the interrupt source */
 	writel(readl(S3C_VIDINTCON1), S3C_VIDINTCON1);
@@ -785,7 +797,7 @@ void s3cfb_set_fb_addr(s3cfb_info_t *fbi)
 	}
 }
 
-static int s3cfb_set_alpha_level(s3cfb_info_t *fbi, unsigned int level, unsigned int alpha_index)
+int s3cfb_set_alpha_level(s3cfb_info_t *fbi, unsigned int level, unsigned int alpha_index)
 {
 	unsigned long alpha_val;
 	int win_num = fbi->win_id;
@@ -937,8 +949,9 @@ int s3cfb_ioctl(struct fb_info *info, unsigned int cmd, unsigned long arg)
 	s3cfb_color_val_info_t colval_info;
 	s3cfb_dma_info_t dma_info;
 	s3cfb_next_info_t next_fb_info;
+	s3cfb_win_commit_t win_commit;
 	struct fb_var_screeninfo *var= &fbi->fb.var;
-	unsigned int crt, alpha_level, alpha_mode;
+	unsigned int crt, alpha_level, alpha_mode, flip_count;
 
 /* should be fixed for c100 */
 #if defined(CONFIG_S3C6410_PWM) || defined(CONFIG_S5PC1XX_PWM)
@@ -1124,6 +1137,25 @@ int s3cfb_ioctl(struct fb_info *info, unsigned int cmd, unsigned long arg)
 			return -EFAULT;
 		break;
 
+	case S3CFB_GET_FLIP_COUNT:
+		flip_count = fbi->flip_count;
+
+		if (put_user(flip_count, (unsigned int __user *)arg))
+			return -EFAULT;
+		break;
+
+	case S3CFB_WAIT_FOR_FLIP:
+		if (get_user(flip_count, (unsigned int __user *)arg))
+			return -EFAULT;
+
+		return s3cfb_wait_for_flip(fbi, flip_count);
+
+	case S3CFB_WIN_COMMIT:
+		if (copy_from_user(&win_commit, (s3cfb_win_commit_t *) arg, sizeof(s3cfb_win_commit_t)))
+			return -EFAULT;
+
+		return s3cfb_win_commit(&win_commit);
+
 	case S3CFB_GET_BRIGHTNESS:
 		if (copy_to_user((void *)arg, (const void *) &s3cfb_fimd.brightness, sizeof(int)))
 			return -EFAULT;
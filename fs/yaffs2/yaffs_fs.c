@@ -51,6 +51,7 @@ extern const char *yaffs_guts_c_version;
 #include <linux/interrupt.h>
 #include <linux/string.h>
 #include <linux/ctype.h>
+#include <linux/kthread.h>
 
 #include "asm/div64.h"
 
@@ -154,6 +155,7 @@ static struct inode * yaffs_iget(struct super_block *sb, unsigned long ino);
 #endif
 
 static void yaffs_put_super(struct super_block *sb);
+static int yaffs_remount_fs(struct super_block *sb, int *flags, char *data);
 
 static ssize_t yaffs_file_write(struct file *f, const char *buf, size_t n,
 				loff_t * pos);
@@ -227,6 +229,12 @@ static int yaffs_writepage(struct page *page, struct writeback_control *wbc);
 #else
 static int yaffs_writepage(struct page *page);
 #endif
+#if (LINUX_VERSION_CODE > KERNEL_VERSION(2,6,22))
+static int yaffs_readpages(struct file *file, struct address_space *mapping,
+			   struct list_head *pages, unsigned nr_pages);
+static int yaffs_writepages(struct address_space *mapping,
+			    struct writeback_control *wbc);
+#endif
 
 
 #if (YAFFS_USE_WRITE_BEGIN_END != 0)
@@ -255,6 +263,10 @@ static int yaffs_follow_link(struct dentry *dentry, struct nameidata *nd);
 static struct address_space_operations yaffs_file_address_operations = {
 	.readpage = yaffs_readpage,
 	.writepage = yaffs_writepage,
+#if (LINUX_VERSION_CODE > KERNEL_VERSION(2,6,22))
+	.readpages = yaffs_readpages,
+	.writepages = yaffs_writepages,
+#endif
 #if (YAFFS_USE_WRITE_BEGIN_END > 0)
 	.write_begin = yaffs_write_begin,
 	.write_end = yaffs_write_end,
@@ -344,6 +356,7 @@ static struct super_operations yaffs_super_ops = {
 	.put_inode = yaffs_put_inode,
 #endif
 	.put_super = yaffs_put_super,
+	.remount_fs = yaffs_remount_fs,
 	.delete_inode = yaffs_delete_inode,
 	.clear_inode = yaffs_clear_inode,
 	.sync_fs = yaffs_sync_fs,
@@ -354,14 +367,37 @@ static void yaffs_GrossLock(yaffs_Device * dev)
 {
 	T(YAFFS_TRACE_OS, (KERN_DEBUG "yaffs locking\n"));
 
-	down(&dev->grossLock);
+	down_write(&dev->grossLock);
+
+	if (current != dev->bgGCThread)
+		dev->lastAccess = jiffies;
 }
 
 static void yaffs_GrossUnlock(yaffs_Device * dev)
 {
 	T(YAFFS_TRACE_OS, (KERN_DEBUG "yaffs unlocking\n"));
-	up(&dev->grossLock);
+	up_write(&dev->grossLock);
+
+}
+
+/*
+ * Shared locking for paths that do not change the fs, so that reads and
+ * lookups don't queue up behind each other. They must not modify objects,
+ * tnodes or block state; see scratchLock in yaffs_Device for the rest.
+ */
+static void yaffs_GrossLockRead(yaffs_Device * dev)
+{
+	T(YAFFS_TRACE_OS, (KERN_DEBUG "yaffs locking shared\n"));
+
+	down_read(&dev->grossLock);
 
+	dev->lastAccess = jiffies;
+}
+
+static void yaffs_GrossUnlockRead(yaffs_Device * dev)
+{
+	T(YAFFS_TRACE_OS, (KERN_DEBUG "yaffs unlocking shared\n"));
+	up_read(&dev->grossLock);
 }
 
 static int yaffs_readlink(struct dentry *dentry, char __user * buffer,
@@ -372,11 +408,11 @@ static int yaffs_readlink(struct dentry *dentry, char __user * buffer,
 
 	yaffs_Device *dev = yaffs_DentryToObject(dentry)->myDev;
 
-	yaffs_GrossLock(dev);
+	yaffs_GrossLockRead(dev);
 
 	alias = yaffs_GetSymlinkAlias(yaffs_DentryToObject(dentry));
 
-	yaffs_GrossUnlock(dev);
+	yaffs_GrossUnlockRead(dev);
 
 	if (!alias)
 		return -ENOMEM;
@@ -396,11 +432,11 @@ static int yaffs_follow_link(struct dentry *dentry, struct nameidata *nd)
 	int ret;
 	yaffs_Device *dev = yaffs_DentryToObject(dentry)->myDev;
 
-	yaffs_GrossLock(dev);
+	yaffs_GrossLockRead(dev);
 
 	alias = yaffs_GetSymlinkAlias(yaffs_DentryToObject(dentry));
 
-	yaffs_GrossUnlock(dev);
+	yaffs_GrossUnlockRead(dev);
 
 	if (!alias)
         {
@@ -437,7 +473,7 @@ static struct dentry *yaffs_lookup(struct inode *dir, struct dentry *dentry)
 
 	yaffs_Device *dev = yaffs_InodeToObject(dir)->myDev;
 
-	yaffs_GrossLock(dev);
+	yaffs_GrossLockRead(dev);
 
 	T(YAFFS_TRACE_OS,
 	  (KERN_DEBUG "yaffs_lookup for %d:%s\n",
@@ -450,7 +486,7 @@ static struct dentry *yaffs_lookup(struct inode *dir, struct dentry *dentry)
 	obj = yaffs_GetEquivalentObject(obj);	/* in case it was a hardlink */
 
 	/* Can't hold gross lock when calling yaffs_get_inode() */
-	yaffs_GrossUnlock(dev);
+	yaffs_GrossUnlockRead(dev);
 
 	if (obj) {
 		T(YAFFS_TRACE_OS,
@@ -614,13 +650,13 @@ static int yaffs_readpage_nolock(struct file *f, struct page *pg)
 	pg_buf = kmap(pg);
 	/* FIXME: Can kmap fail? */
 
-	yaffs_GrossLock(dev);
+	yaffs_GrossLockRead(dev);
 
 	ret =
 	    yaffs_ReadDataFromFile(obj, pg_buf, pg->index << PAGE_CACHE_SHIFT,
 				   PAGE_CACHE_SIZE);
 
-	yaffs_GrossUnlock(dev);
+	yaffs_GrossUnlockRead(dev);
 
 	if (ret >= 0)
 		ret = 0;
@@ -728,6 +764,166 @@ static int yaffs_writepage(struct page *page)
 	return (nWritten == nBytes) ? 0 : -ENOSPC;
 }
 
+#if (LINUX_VERSION_CODE > KERNEL_VERSION(2,6,22))
+/* readpages and writepages take the grossLock once per batch of up to
+ * YAFFS_PAGE_BATCH consecutive pages.
+ */
+#define YAFFS_PAGE_BATCH	16
+
+static void yaffs_ReadPageBatch(yaffs_Object *obj, struct page **pages, int n)
+{
+	yaffs_Device *dev = obj->myDev;
+	__u8 *buffers[YAFFS_PAGE_BATCH];
+	int i;
+
+	T(YAFFS_TRACE_OS, (KERN_DEBUG "yaffs_readpages at %08x, %d pages\n",
+			   (unsigned)(pages[0]->index << PAGE_CACHE_SHIFT), n));
+
+	for (i = 0; i < n; i++)
+		buffers[i] = kmap(pages[i]);
+
+	yaffs_GrossLockRead(dev);
+
+	yaffs_ReadDataRunFromFile(obj, buffers, n, PAGE_CACHE_SIZE,
+				  (loff_t)pages[0]->index << PAGE_CACHE_SHIFT);
+
+	yaffs_GrossUnlockRead(dev);
+
+	for (i = 0; i < n; i++) {
+		SetPageUptodate(pages[i]);
+		ClearPageError(pages[i]);
+		flush_dcache_page(pages[i]);
+		kunmap(pages[i]);
+		unlock_page(pages[i]);
+		page_cache_release(pages[i]);
+	}
+}
+
+static int yaffs_readpages(struct file *f, struct address_space *mapping,
+			   struct list_head *pages, unsigned nr_pages)
+{
+	yaffs_Object *obj = yaffs_DentryToObject(f->f_dentry);
+	struct page *batch[YAFFS_PAGE_BATCH];
+	int n = 0;
+	unsigned i;
+
+	for (i = 0; i < nr_pages; i++) {
+		struct page *pg = list_entry(pages->prev, struct page, lru);
+
+		list_del(&pg->lru);
+		if (add_to_page_cache_lru(pg, mapping, pg->index, GFP_KERNEL)) {
+			page_cache_release(pg);
+			continue;
+		}
+
+		if (n == YAFFS_PAGE_BATCH ||
+		    (n && pg->index != batch[n - 1]->index + 1)) {
+			yaffs_ReadPageBatch(obj, batch, n);
+			n = 0;
+		}
+		batch[n++] = pg;
+	}
+
+	if (n)
+		yaffs_ReadPageBatch(obj, batch, n);
+
+	return 0;
+}
+
+struct yaffs_PageBatch {
+	struct page *pages[YAFFS_PAGE_BATCH];
+	int n;
+	int error;
+};
+
+/* Write out a batch of pages collected by yaffs_writepages_add. The pages
+ * are unlocked and under writeback, so the grossLock is never waited for
+ * while holding a page lock that a reader could be waiting on.
+ */
+static void yaffs_WritePageBatch(struct inode *inode,
+				 struct yaffs_PageBatch *batch)
+{
+	yaffs_Object *obj = yaffs_InodeToObject(inode);
+	yaffs_Device *dev = obj->myDev;
+	char *buffers[YAFFS_PAGE_BATCH];
+	loff_t size = i_size_read(inode);
+	int i;
+
+	for (i = 0; i < batch->n; i++)
+		buffers[i] = kmap(batch->pages[i]);
+
+	yaffs_GrossLock(dev);
+
+	for (i = 0; i < batch->n; i++) {
+		loff_t offset = (loff_t)batch->pages[i]->index << PAGE_CACHE_SHIFT;
+		unsigned nBytes;
+
+		if (offset > size)
+			continue;	/* beyond EOF, don't care */
+
+		if (batch->pages[i]->index < (size >> PAGE_CACHE_SHIFT))
+			nBytes = PAGE_CACHE_SIZE;
+		else
+			nBytes = size & (PAGE_CACHE_SIZE - 1);
+
+		if (yaffs_WriteDataToFile(obj, buffers[i], offset, nBytes, 0) !=
+		    nBytes)
+			batch->error = -ENOSPC;
+	}
+
+	yaffs_GrossUnlock(dev);
+
+	for (i = 0; i < batch->n; i++) {
+		kunmap(batch->pages[i]);
+		end_page_writeback(batch->pages[i]);
+		page_cache_release(batch->pages[i]);
+	}
+
+	batch->n = 0;
+}
+
+static int yaffs_writepages_add(struct page *page,
+				struct writeback_control *wbc, void *data)
+{
+	struct yaffs_PageBatch *batch = data;
+
+	if (batch->n == YAFFS_PAGE_BATCH ||
+	    (batch->n &&
+	     page->index != batch->pages[batch->n - 1]->index + 1))
+		yaffs_WritePageBatch(page->mapping->host, batch);
+
+	page_cache_get(page);
+	set_page_writeback(page);
+	unlock_page(page);
+	batch->pages[batch->n++] = page;
+
+	return 0;
+}
+
+static int yaffs_writepages(struct address_space *mapping,
+			    struct writeback_control *wbc)
+{
+	struct yaffs_PageBatch batch;
+	int ret;
+
+	/* A cyclic integrity sync can come back round to a page still held
+	 * in the batch and wait for its writeback forever.
+	 */
+	if (wbc->sync_mode != WB_SYNC_NONE && wbc->range_cyclic)
+		return generic_writepages(mapping, wbc);
+
+	batch.n = 0;
+	batch.error = 0;
+
+	ret = write_cache_pages(mapping, wbc, yaffs_writepages_add, &batch);
+
+	if (batch.n)
+		yaffs_WritePageBatch(mapping->host, &batch);
+
+	return ret ? ret : batch.error;
+}
+#endif
+
 
 #if (YAFFS_USE_WRITE_BEGIN_END > 0)
 static int yaffs_write_begin(struct file *filp, struct address_space *mapping,
@@ -1139,7 +1335,7 @@ static int yaffs_readdir(struct file *f, void *dirent, filldir_t filldir)
 	obj = yaffs_DentryToObject(f->f_dentry);
 	dev = obj->myDev;
 
-	yaffs_GrossLock(dev);
+	yaffs_GrossLockRead(dev);
 
 	offset = f->f_pos;
 
@@ -1209,7 +1405,7 @@ static int yaffs_readdir(struct file *f, void *dirent, filldir_t filldir)
       up_and_out:
       out:
 
-	yaffs_GrossUnlock(dev);
+	yaffs_GrossUnlockRead(dev);
 
 	return 0;
 }
@@ -1560,7 +1756,7 @@ static int yaffs_statfs(struct super_block *sb, struct statfs *buf)
 
 	T(YAFFS_TRACE_OS, (KERN_DEBUG "yaffs_statfs\n"));
 
-	yaffs_GrossLock(dev);
+	yaffs_GrossLockRead(dev);
 
 	buf->f_type = YAFFS_MAGIC;
 	buf->f_bsize = sb->s_blocksize;
@@ -1610,7 +1806,7 @@ static int yaffs_statfs(struct super_block *sb, struct statfs *buf)
 	buf->f_ffree = 0;
 	buf->f_bavail = buf->f_bfree;
 
-	yaffs_GrossUnlock(dev);
+	yaffs_GrossUnlockRead(dev);
 	return 0;
 }
 
@@ -1691,13 +1887,13 @@ static struct inode * yaffs_iget(struct super_block *sb, unsigned long ino)
 	* need to lock again.
 	*/
     
-	yaffs_GrossLock(dev);
+	yaffs_GrossLockRead(dev);
 
 	obj = yaffs_FindObjectByNumber(dev, inode->i_ino);
 
 	yaffs_FillInodeFromObject(inode, obj);
 
-	yaffs_GrossUnlock(dev);
+	yaffs_GrossUnlockRead(dev);
 	
 	unlock_new_inode(inode);
 	return inode;
@@ -1718,49 +1914,211 @@ static void yaffs_read_inode(struct inode *inode)
 	T(YAFFS_TRACE_OS,
 	  (KERN_DEBUG "yaffs_read_inode for %d\n", (int)inode->i_ino));
 
-	yaffs_GrossLock(dev);
+	yaffs_GrossLockRead(dev);
 
 	obj = yaffs_FindObjectByNumber(dev, inode->i_ino);
 
 	yaffs_FillInodeFromObject(inode, obj);
 
-	yaffs_GrossUnlock(dev);
+	yaffs_GrossUnlockRead(dev);
 }
 
 #endif
 
 static YLIST_HEAD(yaffs_dev_list);
 
-#if 0 // not used
-static int yaffs_remount_fs(struct super_block *sb, int *flags, char *data)
+/*
+ * Background garbage collection. Passive gc is done here while the
+ * device is idle and fewer than bgGCWatermark blocks are erased, so that
+ * writers are left with the aggressive gc they can't avoid.
+ *
+ * The same thread writes the checkpoint once the device has been idle for
+ * bgCheckpointIdle, so that unmount and sync usually find it done and a
+ * power cut while idle still leaves a checkpoint to mount from. Any write
+ * invalidates it again, so gc leaves a valid checkpoint alone and only one
+ * attempt is made per idle period.
+ */
+#define YAFFS_BG_GC_IDLE	(HZ / 2)	/* quiet time before gc starts */
+#define YAFFS_BG_GC_INTERVAL	(HZ / 2)	/* poll period when nothing to do */
+
+static void yaffs_BackgroundCheckpoint(yaffs_Device *dev)
 {
-	yaffs_Device    *dev = yaffs_SuperToDevice(sb);
+	if (!dev->bgCheckpointIdle || dev->skipCheckpointWrite ||
+	    dev->isCheckpointed ||
+	    dev->bgCheckpointTried == dev->lastAccess ||
+	    time_before(jiffies, dev->lastAccess + dev->bgCheckpointIdle))
+		return;
 
-	if( *flags & MS_RDONLY ) {
-		struct mtd_info *mtd = yaffs_SuperToDevice(sb)->genericDevice;
+	yaffs_GrossLock(dev);
 
-		T(YAFFS_TRACE_OS,
-			(KERN_DEBUG "yaffs_remount_fs: %s: RO\n", dev->name ));
+	dev->bgCheckpointTried = dev->lastAccess;
+	yaffs_FlushEntireDeviceCache(dev);
+	if (!dev->isCheckpointed && yaffs_CheckpointSave(dev))
+		dev->nBackgroundCheckpoints++;
 
-		yaffs_GrossLock(dev);
+	yaffs_GrossUnlock(dev);
+}
 
-		yaffs_FlushEntireDeviceCache(dev);
+static int yaffs_BackgroundGCThread(void *data)
+{
+	yaffs_Device *dev = (yaffs_Device *)data;
+	int more = 0;
 
-		yaffs_CheckpointSave(dev);
+	set_user_nice(current, 10);
 
-		if (mtd->sync)
-			mtd->sync(mtd);
+	while (!kthread_should_stop()) {
+		if (more)
+			cond_resched();
+		else
+			schedule_timeout_interruptible(YAFFS_BG_GC_INTERVAL);
 
-		yaffs_GrossUnlock(dev);
-	}
-	else {
-		T(YAFFS_TRACE_OS,
-			(KERN_DEBUG "yaffs_remount_fs: %s: RW\n", dev->name ));
+		more = 0;
+
+		if (time_before(jiffies, dev->lastAccess + YAFFS_BG_GC_IDLE))
+			continue;
+
+		if (dev->backgroundGC &&
+		    !(dev->isCheckpointed && dev->bgCheckpointIdle)) {
+			yaffs_GrossLock(dev);
+			more = yaffs_BackgroundGarbageCollect(dev,
+							      dev->bgGCWatermark);
+			yaffs_GrossUnlock(dev);
+		}
+
+		if (!more)
+			yaffs_BackgroundCheckpoint(dev);
 	}
 
 	return 0;
 }
-#endif
+
+/* watermark < 0 runs the thread for background checkpoints only */
+static void yaffs_StartBackgroundGC(yaffs_Device *dev, int watermark,
+				    int checkpointIdle)
+{
+	dev->bgGCWatermark = (watermark < 0) ? 0 :
+			     (dev->endBlock - dev->startBlock + 1) *
+			     watermark / 100;
+	dev->bgCheckpointIdle = checkpointIdle * HZ;
+	dev->lastAccess = jiffies;
+	dev->bgCheckpointTried = dev->lastAccess - 1;
+
+	dev->bgGCThread = kthread_run(yaffs_BackgroundGCThread, dev,
+				      "yaffs-gc/%s", dev->name);
+	if (IS_ERR(dev->bgGCThread)) {
+		T(YAFFS_TRACE_ALWAYS,
+		  ("yaffs: could not start background gc for %s\n",
+		   dev->name));
+		dev->bgGCThread = NULL;
+		return;
+	}
+
+	dev->backgroundGC = (watermark >= 0);
+}
+
+static void yaffs_StopBackgroundGC(yaffs_Device *dev)
+{
+	if (!dev->bgGCThread)
+		return;
+
+	dev->backgroundGC = 0;
+	kthread_stop(dev->bgGCThread);
+	dev->bgGCThread = NULL;
+}
+
+/*
+ * Backward scan for a mount with bg-scan. The mount returns as soon as the
+ * scan thread holds the gross lock, so the fs is there early but every
+ * operation on it waits for the scan rather than seeing half the tree.
+ * Progress shows in /proc/yaffs. Background gc is only started once the
+ * scan is done, and not at all if it failed.
+ */
+struct yaffs_ScanStart {
+	struct super_block *sb;
+	int startBackgroundGC;
+	int bgGCWatermark;
+	int bgCheckpointIdle;
+	struct completion started;
+};
+
+/* Called with the gross lock held */
+static int yaffs_FinishScan(struct super_block *sb)
+{
+	yaffs_Device *dev = yaffs_SuperToDevice(sb);
+
+	if (yaffs_GutsFinishScan(dev) != YAFFS_OK) {
+		T(YAFFS_TRACE_ALWAYS,
+		  ("yaffs: scan of %s failed, mounted read-only\n",
+		   dev->name));
+		/* Don't checkpoint the partial tree */
+		dev->skipCheckpointWrite = 1;
+		sb->s_flags |= MS_RDONLY;
+		return 0;
+	}
+
+	/* The root inode was made before the root header was scanned */
+	yaffs_FillInodeFromObject(sb->s_root->d_inode, yaffs_Root(dev));
+
+	return 1;
+}
+
+static int yaffs_BackgroundScanThread(void *data)
+{
+	struct yaffs_ScanStart *start = (struct yaffs_ScanStart *)data;
+	struct super_block *sb = start->sb;
+	yaffs_Device *dev = yaffs_SuperToDevice(sb);
+	int startBackgroundGC = start->startBackgroundGC;
+	int bgGCWatermark = start->bgGCWatermark;
+	int bgCheckpointIdle = start->bgCheckpointIdle;
+	int ok;
+
+	yaffs_GrossLock(dev);
+	/* start lives on the mounter's stack, don't touch it after this */
+	complete(&start->started);
+
+	ok = yaffs_FinishScan(sb);
+
+	yaffs_GrossUnlock(dev);
+
+	if (ok && startBackgroundGC)
+		yaffs_StartBackgroundGC(dev, bgGCWatermark, bgCheckpointIdle);
+
+	complete_and_exit(&dev->scanDone, 0);
+}
+
+static void yaffs_StartBackgroundScan(struct super_block *sb,
+				      int startBackgroundGC, int watermark,
+				      int checkpointIdle)
+{
+	yaffs_Device *dev = yaffs_SuperToDevice(sb);
+	struct yaffs_ScanStart start;
+
+	start.sb = sb;
+	start.startBackgroundGC = startBackgroundGC;
+	start.bgGCWatermark = watermark;
+	start.bgCheckpointIdle = checkpointIdle;
+	init_completion(&start.started);
+	init_completion(&dev->scanDone);
+
+	dev->scanThread = kthread_run(yaffs_BackgroundScanThread, &start,
+				      "yaffs-scan/%s", dev->name);
+	if (!IS_ERR(dev->scanThread)) {
+		wait_for_completion(&start.started);
+		return;
+	}
+
+	T(YAFFS_TRACE_ALWAYS,
+	  ("yaffs: could not start background scan for %s\n", dev->name));
+	dev->scanThread = NULL;
+
+	yaffs_GrossLock(dev);
+	if (!yaffs_FinishScan(sb))
+		startBackgroundGC = 0;
+	yaffs_GrossUnlock(dev);
+
+	if (startBackgroundGC)
+		yaffs_StartBackgroundGC(dev, watermark, checkpointIdle);
+}
 
 static void yaffs_put_super(struct super_block *sb)
 {
@@ -1768,6 +2126,13 @@ static void yaffs_put_super(struct super_block *sb)
 
 	T(YAFFS_TRACE_OS, (KERN_DEBUG "yaffs_put_super\n"));
 
+	/* The scan thread may still be about to start background gc */
+	if (dev->scanThread)
+		wait_for_completion(&dev->scanDone);
+
+	/* The thread takes the gross lock */
+	yaffs_StopBackgroundGC(dev);
+
 	yaffs_GrossLock(dev);
 
 	yaffs_FlushEntireDeviceCache(dev);
@@ -1803,9 +2168,47 @@ static void yaffs_MTDPutSuper(struct super_block *sb)
 		mtd->sync(mtd);
 	}
 
+	mtd->block_refresh = NULL;
+
 	put_mtd_device(mtd);
 }
 
+/* Called by the NAND driver when a block is close to the ECC limit. */
+static int yaffs_MTDBlockRefresh(struct mtd_info *mtd, loff_t ofs)
+{
+	struct ylist_head *item;
+	int ret = -ENODEV;
+
+	/* hold lock_kernel while traversing yaffs_dev_list */
+	lock_kernel();
+
+	ylist_for_each(item, &yaffs_dev_list) {
+		yaffs_Device *dev = ylist_entry(item, yaffs_Device, devList);
+
+		if (dev->genericDevice != mtd)
+			continue;
+
+		/* Don't sleep here: put_super frees dev under lock_kernel */
+		if (!down_write_trylock(&dev->grossLock)) {
+			ret = -EBUSY;
+			break;
+		}
+
+		if (yaffs_RefreshBlock(dev, (u_int32_t)ofs / mtd->erasesize) ==
+		    YAFFS_OK)
+			ret = 0;
+		else
+			ret = -EINVAL;
+
+		yaffs_GrossUnlock(dev);
+		break;
+	}
+
+	unlock_kernel();
+
+	return ret;
+}
+
 
 static void yaffs_MarkSuperBlockDirty(void *vsb)
 {
@@ -1821,6 +2224,11 @@ typedef struct {
 	int skip_checkpoint_read;
 	int skip_checkpoint_write;
 	int no_cache;
+	int cache_size;		/* short op cache chunks */
+	int no_bg_gc;
+	int bg_gc_watermark;	/* percent of blocks */
+	int bg_checkpoint_idle;	/* seconds, 0 = off */
+	int bg_scan;
 } yaffs_options;
 
 #define MAX_OPT_LEN 20
@@ -1844,10 +2252,19 @@ static int yaffs_parse_options(yaffs_options *options, const char *options_str)
 			options_str++;
 		}
 
+		if(*options_str == ',')
+			options_str++;
+
 		if(!strcmp(cur_opt,"inband-tags"))
 			options->inband_tags = 1;
 		else if(!strcmp(cur_opt,"no-cache"))
 			options->no_cache = 1;
+		else if(!strncmp(cur_opt,"cache-size=",11)){
+			options->cache_size =
+				simple_strtoul(cur_opt + 11, NULL, 10);
+			if(options->cache_size > YAFFS_MAX_SHORT_OP_CACHES)
+				error = 1;
+		}
 		else if(!strcmp(cur_opt,"no-checkpoint-read"))
 			options->skip_checkpoint_read = 1;
 		else if(!strcmp(cur_opt,"no-checkpoint-write"))
@@ -1855,7 +2272,19 @@ static int yaffs_parse_options(yaffs_options *options, const char *options_str)
 		else if(!strcmp(cur_opt,"no-checkpoint")){
 			options->skip_checkpoint_read = 1;
 			options->skip_checkpoint_write = 1;
-		} else {
+		} else if(!strcmp(cur_opt,"no-bg-gc"))
+			options->no_bg_gc = 1;
+		else if(!strncmp(cur_opt,"bg-gc-watermark=",16)){
+			options->bg_gc_watermark =
+				simple_strtoul(cur_opt + 16, NULL, 10);
+			if(options->bg_gc_watermark > 100)
+				error = 1;
+		} else if(!strncmp(cur_opt,"bg-checkpoint=",14)){
+			options->bg_checkpoint_idle =
+				simple_strtoul(cur_opt + 14, NULL, 10);
+		} else if(!strcmp(cur_opt,"bg-scan"))
+			options->bg_scan = 1;
+		else {
 			printk(KERN_INFO "yaffs: Bad mount option \"%s\"\n",cur_opt);
 			error = 1;
 		}
@@ -1865,6 +2294,72 @@ static int yaffs_parse_options(yaffs_options *options, const char *options_str)
 	return error;
 }
 
+static void yaffs_default_options(yaffs_options *options)
+{
+	memset(options,0,sizeof(*options));
+	options->bg_gc_watermark = 30;
+	/* bg-checkpoint=<seconds> turns it on, each one costs a full checkpoint write */
+	options->bg_checkpoint_idle = 0;
+	options->cache_size = 10;
+}
+
+/*
+ * Remounting read-only stops background gc and checkpointing, as they
+ * write. Remounting read-write starts them again as the mount options,
+ * those of the remount if it has any, ask.
+ */
+static int yaffs_remount_fs(struct super_block *sb, int *flags, char *data)
+{
+	yaffs_Device *dev = yaffs_SuperToDevice(sb);
+	struct mtd_info *mtd = dev->genericDevice;
+	yaffs_options options;
+
+	if (data && *data) {
+		yaffs_default_options(&options);
+		if (yaffs_parse_options(&options, data))
+			return -EINVAL;
+
+		dev->bgMountWatermark = options.no_bg_gc ?
+					-1 : options.bg_gc_watermark;
+		dev->bgMountCheckpointIdle = options.bg_checkpoint_idle;
+	}
+
+	/* The scan thread may still be about to start background gc */
+	if (dev->scanThread) {
+		wait_for_completion(&dev->scanDone);
+		dev->scanThread = NULL;
+	}
+
+	/* The thread takes the gross lock */
+	yaffs_StopBackgroundGC(dev);
+
+	if (*flags & MS_RDONLY) {
+		T(YAFFS_TRACE_OS,
+			(KERN_DEBUG "yaffs_remount_fs: %s: RO\n", dev->name ));
+
+		yaffs_GrossLock(dev);
+
+		yaffs_FlushEntireDeviceCache(dev);
+
+		yaffs_CheckpointSave(dev);
+
+		if (mtd->sync)
+			mtd->sync(mtd);
+
+		yaffs_GrossUnlock(dev);
+	}
+	else {
+		T(YAFFS_TRACE_OS,
+			(KERN_DEBUG "yaffs_remount_fs: %s: RW\n", dev->name ));
+
+		if (dev->bgMountWatermark >= 0 || dev->bgMountCheckpointIdle)
+			yaffs_StartBackgroundGC(dev, dev->bgMountWatermark,
+						dev->bgMountCheckpointIdle);
+	}
+
+	return 0;
+}
+
 static struct super_block *yaffs_internal_read_super(int yaffsVersion,
 						     struct super_block *sb,
 						     void *data, int silent)
@@ -1876,6 +2371,8 @@ static struct super_block *yaffs_internal_read_super(int yaffsVersion,
 	char devname_buf[BDEVNAME_SIZE + 1];
 	struct mtd_info *mtd;
 	int err;
+	int bgGC;
+	int bgGCWatermark;
 	char *data_str = (char *)data;
 
 	yaffs_options options;
@@ -1900,7 +2397,7 @@ static struct super_block *yaffs_internal_read_super(int yaffsVersion,
 
 	printk(KERN_INFO "yaffs: passed flags \"%s\"\n",data_str);
 
-	memset(&options,0,sizeof(options));
+	yaffs_default_options(&options);
 
 	if(yaffs_parse_options(&options,data_str)){
 		/* Option parsing failed */
@@ -2057,7 +2554,7 @@ static struct super_block *yaffs_internal_read_super(int yaffsVersion,
 	dev->nChunksPerBlock = YAFFS_CHUNKS_PER_BLOCK;
 	dev->totalBytesPerChunk = YAFFS_BYTES_PER_CHUNK;
 	dev->nReservedBlocks = 5;
-	dev->nShortOpCaches = (options.no_cache) ? 0 : 10;
+	dev->nShortOpCaches = (options.no_cache) ? 0 : options.cache_size;
 	dev->inbandTags = options.inband_tags;
 
 	/* ... and the functions. */
@@ -2066,6 +2563,8 @@ static struct super_block *yaffs_internal_read_super(int yaffsVersion,
 		    nandmtd2_WriteChunkWithTagsToNAND;
 		dev->readChunkWithTagsFromNAND =
 		    nandmtd2_ReadChunkWithTagsFromNAND;
+		dev->readChunkRunFromNAND = nandmtd2_ReadChunkRunFromNAND;
+		dev->readTagsRunFromNAND = nandmtd2_ReadTagsRunFromNAND;
 		dev->markNANDBlockBad = nandmtd2_MarkNANDBlockBad;
 		dev->queryNANDBlock = nandmtd2_QueryNANDBlock;
 		dev->spareBuffer = YMALLOC(mtd->oobsize);
@@ -2116,11 +2615,14 @@ static struct super_block *yaffs_internal_read_super(int yaffsVersion,
 
 	dev->skipCheckpointRead = options.skip_checkpoint_read;
 	dev->skipCheckpointWrite = options.skip_checkpoint_write;
+	dev->deferScan = options.bg_scan;
 
 	/* we assume this is protected by lock_kernel() in mount/umount */
 	ylist_add_tail(&dev->devList, &yaffs_dev_list);
 
-	init_MUTEX(&dev->grossLock);
+	init_rwsem(&dev->grossLock);
+	spin_lock_init(&dev->scratchLock);
+	mutex_init(&dev->loadLock);
 
 	yaffs_GrossLock(dev);
 
@@ -2130,6 +2632,9 @@ static struct super_block *yaffs_internal_read_super(int yaffsVersion,
 	  ("yaffs_read_super: guts initialised %s\n",
 	   (err == YAFFS_OK) ? "OK" : "FAILED"));
 
+	if (err == YAFFS_OK)
+		mtd->block_refresh = yaffs_MTDBlockRefresh;
+
 	/* Release lock before yaffs_get_inode() */
 	yaffs_GrossUnlock(dev);
 
@@ -2159,6 +2664,21 @@ static struct super_block *yaffs_internal_read_super(int yaffsVersion,
 	T(YAFFS_TRACE_ALWAYS,
 	  ("yaffs_read_super: isCheckpointed %d\n", dev->isCheckpointed));
 
+	bgGC = (!options.no_bg_gc || options.bg_checkpoint_idle) &&
+	       !(sb->s_flags & MS_RDONLY);
+	bgGCWatermark = options.no_bg_gc ? -1 : options.bg_gc_watermark;
+
+	/* for yaffs_remount_fs() */
+	dev->bgMountWatermark = bgGCWatermark;
+	dev->bgMountCheckpointIdle = options.bg_checkpoint_idle;
+
+	if (dev->scanPending)
+		yaffs_StartBackgroundScan(sb, bgGC, bgGCWatermark,
+					  options.bg_checkpoint_idle);
+	else if (bgGC)
+		yaffs_StartBackgroundGC(dev, bgGCWatermark,
+					options.bg_checkpoint_idle);
+
 	T(YAFFS_TRACE_OS, ("yaffs_read_super: done\n"));
 	return sb;
 }
@@ -2262,6 +2782,24 @@ static struct proc_dir_entry *my_proc_entry;
 
 static char *yaffs_dump_dev(char *buf, yaffs_Device * dev)
 {
+	int longestBucket = 0;
+	int emptyBuckets = 0;
+	int i;
+
+	/* A resize frees the bucket table. The scan holds the lock for
+	 * long, so leave the buckets out while it runs.
+	 */
+	if (!dev->scanPending) {
+		yaffs_GrossLockRead(dev);
+		for (i = 0; i < dev->nObjectBuckets; i++) {
+			if (dev->objectBucket[i].count > longestBucket)
+				longestBucket = dev->objectBucket[i].count;
+			if (!dev->objectBucket[i].count)
+				emptyBuckets++;
+		}
+		yaffs_GrossUnlockRead(dev);
+	}
+
 	buf += sprintf(buf, "startBlock......... %d\n", dev->startBlock);
 	buf += sprintf(buf, "endBlock........... %d\n", dev->endBlock);
 	buf += sprintf(buf, "totalBytesPerChunk. %d\n", dev->totalBytesPerChunk);
@@ -2271,20 +2809,38 @@ static char *yaffs_dump_dev(char *buf, yaffs_Device * dev)
 	buf += sprintf(buf, "nErasedBlocks...... %d\n", dev->nErasedBlocks);
 	buf += sprintf(buf, "nReservedBlocks.... %d\n", dev->nReservedBlocks);
 	buf += sprintf(buf, "blocksInCheckpoint. %d\n", dev->blocksInCheckpoint);
+	buf += sprintf(buf, "scanPending........ %d\n", dev->scanPending);
+	buf += sprintf(buf, "blocksToScan....... %d\n", dev->nBlocksToScan);
+	buf += sprintf(buf, "blocksScanned...... %d\n", dev->nBlocksScanned);
 	buf += sprintf(buf, "nTnodesCreated..... %d\n", dev->nTnodesCreated);
 	buf += sprintf(buf, "nFreeTnodes........ %d\n", dev->nFreeTnodes);
 	buf += sprintf(buf, "nObjectsCreated.... %d\n", dev->nObjectsCreated);
 	buf += sprintf(buf, "nFreeObjects....... %d\n", dev->nFreeObjects);
+	buf += sprintf(buf, "nObjectBuckets..... %d\n", dev->nObjectBuckets);
+	buf += sprintf(buf, "nHashedObjects..... %d\n", dev->nHashedObjects);
+	buf += sprintf(buf, "longestBucket...... %d\n", longestBucket);
+	buf += sprintf(buf, "emptyBuckets....... %d\n", emptyBuckets);
+	buf += sprintf(buf, "objectHashResizes.. %d\n", dev->nObjectHashResizes);
 	buf += sprintf(buf, "nFreeChunks........ %d\n", dev->nFreeChunks);
 	buf += sprintf(buf, "nPageWrites........ %d\n", dev->nPageWrites);
 	buf += sprintf(buf, "nPageReads......... %d\n", dev->nPageReads);
+	buf += sprintf(buf, "nChunkRunReads..... %d\n", dev->nChunkRunReads);
 	buf += sprintf(buf, "nBlockErasures..... %d\n", dev->nBlockErasures);
 	buf += sprintf(buf, "nGCCopies.......... %d\n", dev->nGCCopies);
 	buf += sprintf(buf, "garbageCollections. %d\n", dev->garbageCollections);
 	buf += sprintf(buf, "passiveGCs......... %d\n",
 		    dev->passiveGarbageCollections);
+	buf += sprintf(buf, "backgroundGC....... %d\n", dev->backgroundGC);
+	buf += sprintf(buf, "bgGCWatermark...... %d\n", dev->bgGCWatermark);
+	buf += sprintf(buf, "bgCheckpointIdle... %lu\n",
+		       dev->bgCheckpointIdle / HZ);
+	buf += sprintf(buf, "bgCheckpoints...... %d\n",
+		       dev->nBackgroundCheckpoints);
+	buf += sprintf(buf, "backgroundGCs...... %d\n",
+		    dev->backgroundGarbageCollections);
 	buf += sprintf(buf, "nRetriedWrites..... %d\n", dev->nRetriedWrites);
 	buf += sprintf(buf, "nShortOpCaches..... %d\n", dev->nShortOpCaches);
+	buf += sprintf(buf, "nDirtyCacheChunks.. %d\n", dev->nDirtyCacheChunks);
 	buf += sprintf(buf, "nRetireBlocks...... %d\n", dev->nRetiredBlocks);
 	buf += sprintf(buf, "eccFixed........... %d\n", dev->eccFixed);
 	buf += sprintf(buf, "eccUnfixed......... %d\n", dev->eccUnfixed);
@@ -40,6 +40,33 @@ const char *yaffs_guts_c_version =
 
 /* Robustification (if it ever comes about...) */
 static void yaffs_RetireBlock(yaffs_Device * dev, int blockInNAND);
+/* The driver thinks the data in this block is about to go bad (eg. read
+ * disturb). Get the garbage collector to copy it off, but unlike a chunk
+ * error this is not held against the block.
+ */
+int yaffs_RefreshBlock(yaffs_Device *dev, int blockInNAND)
+{
+	yaffs_BlockInfo *bi;
+
+	blockInNAND += dev->blockOffset;
+	if (blockInNAND < dev->internalStartBlock ||
+	    blockInNAND > dev->internalEndBlock)
+		return YAFFS_FAIL;
+
+	bi = yaffs_GetBlockInfo(dev, blockInNAND);
+	if (bi->blockState != YAFFS_BLOCK_STATE_FULL &&
+	    bi->blockState != YAFFS_BLOCK_STATE_ALLOCATING)
+		return YAFFS_FAIL;
+
+	T(YAFFS_TRACE_GC,
+	  (TSTR("yaffs: refreshing block %d" TENDSTR), blockInNAND));
+
+	bi->gcPrioritise = 1;
+	dev->hasPendingPrioritisedGCs = 1;
+
+	return YAFFS_OK;
+}
+
 static void yaffs_HandleWriteChunkError(yaffs_Device * dev, int chunkInNAND, int erasedOk);
 static void yaffs_HandleWriteChunkOk(yaffs_Device * dev, int chunkInNAND,
 				     const __u8 * data,
@@ -214,6 +241,8 @@ __u8 *yaffs_GetTempBuffer(yaffs_Device * dev, int lineNo)
 {
 	int i, j;
 
+	yaffs_LockScratch(dev);
+
 	dev->tempInUse++;
 	if(dev->tempInUse > dev->maxTemp)
 		dev->maxTemp = dev->tempInUse;
@@ -228,10 +257,15 @@ __u8 *yaffs_GetTempBuffer(yaffs_Device * dev, int lineNo)
 					    dev->tempBuffer[j].line;
 			}
 
+			yaffs_UnlockScratch(dev);
 			return dev->tempBuffer[i].buffer;
 		}
 	}
 
+	dev->unmanagedTempAllocations++;
+
+	yaffs_UnlockScratch(dev);
+
 	T(YAFFS_TRACE_BUFFERS,
 	  (TSTR("Out of temp buffers at line %d, other held by lines:"),
 	   lineNo));
@@ -245,7 +279,6 @@ __u8 *yaffs_GetTempBuffer(yaffs_Device * dev, int lineNo)
 	 * This is not good.
 	 */
 
-	dev->unmanagedTempAllocations++;
 	return YMALLOC(dev->nDataBytesPerChunk);
 
 }
@@ -255,53 +288,33 @@ void yaffs_ReleaseTempBuffer(yaffs_Device * dev, __u8 * buffer,
 {
 	int i;
 	
+	yaffs_LockScratch(dev);
+
 	dev->tempInUse--;
 	
 	for (i = 0; i < YAFFS_N_TEMP_BUFFERS; i++) {
 		if (dev->tempBuffer[i].buffer == buffer) {
 			dev->tempBuffer[i].line = 0;
+			yaffs_UnlockScratch(dev);
 			return;
 		}
 	}
 
+	if (buffer)
+		dev->unmanagedTempDeallocations++;
+
+	yaffs_UnlockScratch(dev);
+
 	if (buffer) {
 		/* assume it is an unmanaged one. */
 		T(YAFFS_TRACE_BUFFERS,
 		  (TSTR("Releasing unmanaged temp buffer in line %d" TENDSTR),
 		   lineNo));
 		YFREE(buffer);
-		dev->unmanagedTempDeallocations++;
 	}
 
 }
 
-/*
- * Determine if we have a managed buffer.
- */
-int yaffs_IsManagedTempBuffer(yaffs_Device * dev, const __u8 * buffer)
-{
-	int i;
-	for (i = 0; i < YAFFS_N_TEMP_BUFFERS; i++) {
-		if (dev->tempBuffer[i].buffer == buffer)
-			return 1;
-
-	}
-
-    for (i = 0; i < dev->nShortOpCaches; i++) {
-        if( dev->srCache[i].data == buffer )
-            return 1;
-
-    }
-
-    if (buffer == dev->checkpointBuffer)
-      return 1;
-
-    T(YAFFS_TRACE_ALWAYS,
-	  (TSTR("yaffs: unmaged buffer detected.\n" TENDSTR)));
-    return 0;
-}
-
-
 
 /*
  * Chunk bitmap manipulations
@@ -850,7 +863,7 @@ static void yaffs_VerifyObjects(yaffs_Device *dev)
 	
         /* Iterate through the objects in each hash entry */
          
-         for(i = 0; i <  YAFFS_NOBJECT_BUCKETS; i++){
+         for(i = 0; i <  dev->nObjectBuckets; i++){
                 ylist_for_each(lh, &dev->objectBucket[i].list) {
                         if (lh) {
                                 obj = ylist_entry(lh, yaffs_Object, hashLink);
@@ -866,10 +879,9 @@ static void yaffs_VerifyObjects(yaffs_Device *dev)
  *  Simple hash function. Needs to have a reasonable spread
  */
  
-static Y_INLINE int yaffs_HashFunction(int n)
+static Y_INLINE int yaffs_HashFunction(yaffs_Device * dev, __u32 n)
 {
-	n = abs(n);
-	return (n % YAFFS_NOBJECT_BUCKETS);
+	return (n & (dev->nObjectBuckets - 1));
 }
 
 /*
@@ -1083,6 +1095,9 @@ static void yaffs_HandleUpdateChunk(yaffs_Device * dev, int chunkInNAND,
 
 void yaffs_HandleChunkError(yaffs_Device *dev, yaffs_BlockInfo *bi)
 {
+	/* Can be called from the read paths, which run concurrently */
+	yaffs_LockScratch(dev);
+
 	if(!bi->gcPrioritise){
 		bi->gcPrioritise = 1;
 		dev->hasPendingPrioritisedGCs = 1;
@@ -1095,6 +1110,8 @@ void yaffs_HandleChunkError(yaffs_Device *dev, yaffs_BlockInfo *bi)
 		}
 		
 	}
+
+	yaffs_UnlockScratch(dev);
 }
 
 static void yaffs_HandleWriteChunkError(yaffs_Device * dev, int chunkInNAND, int erasedOk)
@@ -1143,6 +1160,13 @@ static __u16 yaffs_CalcNameSum(const YCHAR * name)
 	return sum;
 }
 
+static struct ylist_head *yaffs_NameBucket(yaffs_Object * directory,
+					   __u16 sum)
+{
+	return &directory->variant.directoryVariant.
+	    nameIndex[sum % YAFFS_NDIR_BUCKETS];
+}
+
 static void yaffs_SetObjectName(yaffs_Object * obj, const YCHAR * name)
 {
 #ifdef CONFIG_YAFFS_SHORT_NAMES_IN_RAM
@@ -1154,6 +1178,12 @@ static void yaffs_SetObjectName(yaffs_Object * obj, const YCHAR * name)
 	}
 #endif
 	obj->sum = yaffs_CalcNameSum(name);
+
+	/* Move it to the right bucket if the parent is indexed */
+	if (!ylist_empty(&obj->nameLink)) {
+		ylist_del(&obj->nameLink);
+		ylist_add(&obj->nameLink, yaffs_NameBucket(obj->parent, obj->sum));
+	}
 }
 
 /*-------------------- TNODES -------------------
@@ -1958,6 +1988,8 @@ static yaffs_Object *yaffs_AllocateEmptyObject(yaffs_Device * dev)
 		YINIT_LIST_HEAD(&(tn->hardLinks));
 		YINIT_LIST_HEAD(&(tn->hashLink));
 		YINIT_LIST_HEAD(&tn->siblings);
+		YINIT_LIST_HEAD(&tn->nameLink);
+		YINIT_LIST_HEAD(&tn->cacheChunks);
 		
 
 		/* Now make the directory sane */
@@ -2011,8 +2043,9 @@ static void yaffs_UnhashObject(yaffs_Object * tn)
         /* If it is still linked into the bucket list, free from the list */
         if (!ylist_empty(&tn->hashLink)) {
                 ylist_del_init(&tn->hashLink);
-                bucket = yaffs_HashFunction(tn->objectId);
+                bucket = yaffs_HashFunction(dev, tn->objectId);
                 dev->objectBucket[bucket].count--;
+                dev->nHashedObjects--;
         }
 
 }
@@ -2029,6 +2062,12 @@ static void yaffs_FreeObject(yaffs_Object * tn)
 	if(!ylist_empty(&tn->siblings))
 		YBUG();
 
+	if (tn->variantType == YAFFS_OBJECT_TYPE_DIRECTORY &&
+	    tn->variant.directoryVariant.nameIndex) {
+		YFREE(tn->variant.directoryVariant.nameIndex);
+		tn->variant.directoryVariant.nameIndex = NULL;
+	}
+
 
 #ifdef  __KERNEL__
 	if (tn->myInode) {
@@ -2065,6 +2104,74 @@ void yaffs_HandleDeferedFree(yaffs_Object * obj)
 
 #endif
 
+static yaffs_ObjectBucket *yaffs_AllocateObjectBuckets(int n, int *alt)
+{
+	yaffs_ObjectBucket *buckets;
+	int i;
+
+	/* If the first allocation strategy fails, thry the alternate one */
+	*alt = 0;
+	buckets = YMALLOC(n * sizeof(yaffs_ObjectBucket));
+	if (!buckets) {
+		buckets = YMALLOC_ALT(n * sizeof(yaffs_ObjectBucket));
+		*alt = 1;
+	}
+
+	if (buckets) {
+		for (i = 0; i < n; i++) {
+			YINIT_LIST_HEAD(&buckets[i].list);
+			buckets[i].count = 0;
+		}
+	}
+
+	return buckets;
+}
+
+static void yaffs_FreeObjectBuckets(yaffs_ObjectBucket *buckets, int alt)
+{
+	if (alt && buckets)
+		YFREE_ALT(buckets);
+	else if (buckets)
+		YFREE(buckets);
+}
+
+/* Move every object to a hash table of n buckets. If the new table can't
+ * be allocated we just carry on with the longer chains.
+ */
+static void yaffs_ResizeObjectHash(yaffs_Device * dev, int n)
+{
+	yaffs_ObjectBucket *buckets;
+	yaffs_Object *obj;
+	int alt;
+	int i;
+	int b;
+
+	buckets = yaffs_AllocateObjectBuckets(n, &alt);
+	if (!buckets)
+		return;
+
+	for (i = 0; i < dev->nObjectBuckets; i++) {
+		while (!ylist_empty(&dev->objectBucket[i].list)) {
+			obj = ylist_entry(dev->objectBucket[i].list.next,
+					  yaffs_Object, hashLink);
+			ylist_del(&obj->hashLink);
+			b = obj->objectId & (n - 1);
+			ylist_add(&obj->hashLink, &buckets[b].list);
+			buckets[b].count++;
+		}
+	}
+
+	T(YAFFS_TRACE_ALLOCATE,
+	  (TSTR("yaffs: object hash resized from %d to %d buckets" TENDSTR),
+	   dev->nObjectBuckets, n));
+
+	yaffs_FreeObjectBuckets(dev->objectBucket, dev->objectBucketAlt);
+	dev->objectBucket = buckets;
+	dev->objectBucketAlt = alt;
+	dev->nObjectBuckets = n;
+	dev->nObjectHashResizes++;
+}
+
 static void yaffs_DeinitialiseObjects(yaffs_Device * dev)
 {
 	/* Free the list of allocated Objects */
@@ -2081,21 +2188,38 @@ static void yaffs_DeinitialiseObjects(yaffs_Device * dev)
 
 	dev->freeObjects = NULL;
 	dev->nFreeObjects = 0;
+
+	yaffs_FreeObjectBuckets(dev->objectBucket, dev->objectBucketAlt);
+	dev->objectBucket = NULL;
+	dev->objectBucketAlt = 0;
+	dev->nObjectBuckets = 0;
+	dev->nHashedObjects = 0;
 }
 
-static void yaffs_InitialiseObjects(yaffs_Device * dev)
+static int yaffs_InitialiseObjects(yaffs_Device * dev)
 {
-	int i;
+	int nChunks;
+	int n = YAFFS_NOBJECT_BUCKETS;
+	int alt;
 
 	dev->allocatedObjectList = NULL;
 	dev->freeObjects = NULL;
         dev->nFreeObjects = 0;
 
-        for (i = 0; i < YAFFS_NOBJECT_BUCKETS; i++) {
-                YINIT_LIST_HEAD(&dev->objectBucket[i].list);
-                dev->objectBucket[i].count = 0;
-        }
+	/* Guess how many objects the device will hold */
+	nChunks = (dev->internalEndBlock - dev->internalStartBlock + 1) *
+		  dev->nChunksPerBlock;
+	while (n < YAFFS_MAX_NOBJECT_BUCKETS &&
+	       n * YAFFS_OBJECT_BUCKET_LOAD * YAFFS_CHUNKS_PER_OBJECT_GUESS < nChunks)
+		n <<= 1;
 
+	dev->objectBucket = yaffs_AllocateObjectBuckets(n, &alt);
+	dev->objectBucketAlt = alt;
+	dev->nObjectBuckets = dev->objectBucket ? n : 0;
+	dev->nHashedObjects = 0;
+	dev->nObjectHashResizes = 0;
+
+	return dev->objectBucket ? YAFFS_OK : YAFFS_FAIL;
 }
 
 static int yaffs_FindNiceObjectBucket(yaffs_Device * dev)
@@ -2109,7 +2233,7 @@ static int yaffs_FindNiceObjectBucket(yaffs_Device * dev)
 
 	for (i = 0; i < 10 && lowest > 0; i++) {
 		x++;
-		x %= YAFFS_NOBJECT_BUCKETS;
+		x %= dev->nObjectBuckets;
 		if (dev->objectBucket[x].count < lowest) {
 			lowest = dev->objectBucket[x].count;
 			l = x;
@@ -2123,7 +2247,7 @@ static int yaffs_FindNiceObjectBucket(yaffs_Device * dev)
 
 	for (i = 0; i < 10 && lowest > 3; i++) {
 		x++;
-		x %= YAFFS_NOBJECT_BUCKETS;
+		x %= dev->nObjectBuckets;
 		if (dev->objectBucket[x].count < lowest) {
 			lowest = dev->objectBucket[x].count;
 			l = x;
@@ -2151,7 +2275,7 @@ static int yaffs_CreateNewObjectNumber(yaffs_Device * dev)
 
 	while (!found) {
                 found = 1;
-                n += YAFFS_NOBJECT_BUCKETS;
+                n += dev->nObjectBuckets;
                 if (1 || dev->objectBucket[bucket].count > 0) {
                         ylist_for_each(i, &dev->objectBucket[bucket].list) {
                                 /* If there is already one in the list */
@@ -2170,17 +2294,21 @@ static int yaffs_CreateNewObjectNumber(yaffs_Device * dev)
 
 static void yaffs_HashObject(yaffs_Object * in)
 {
-        int bucket = yaffs_HashFunction(in->objectId);
         yaffs_Device *dev = in->myDev;
+        int bucket = yaffs_HashFunction(dev, in->objectId);
 
         ylist_add(&in->hashLink, &dev->objectBucket[bucket].list);
         dev->objectBucket[bucket].count++;
+        dev->nHashedObjects++;
 
+	if (dev->nHashedObjects > dev->nObjectBuckets * YAFFS_OBJECT_BUCKET_LOAD &&
+	    dev->nObjectBuckets < YAFFS_MAX_NOBJECT_BUCKETS)
+		yaffs_ResizeObjectHash(dev, dev->nObjectBuckets * 2);
 }
 
 yaffs_Object *yaffs_FindObjectByNumber(yaffs_Device * dev, __u32 number)
 {
-        int bucket = yaffs_HashFunction(number);
+        int bucket = yaffs_HashFunction(dev, number);
         struct ylist_head *i;
         yaffs_Object *in;
 
@@ -3297,6 +3425,10 @@ static int yaffs_CheckGarbageCollection(yaffs_Device * dev)
 		} else {
 			/* We're in no hurry */
 			aggressive = 0;
+
+			/* Leave passive gc to the background */
+			if (dev->backgroundGC)
+				return YAFFS_OK;
 		}
 
 		if(dev->gcBlock <= 0){
@@ -3333,6 +3465,38 @@ static int yaffs_CheckGarbageCollection(yaffs_Device * dev)
 	return aggressive ? gcOk : YAFFS_OK;
 }
 
+/* Do one passive gc step, on behalf of a background thread. Called with
+ * the same locking as the writers. Returns 1 if there might be more to do.
+ */
+int yaffs_BackgroundGarbageCollect(yaffs_Device *dev, int erasedWatermark)
+{
+	if (dev->isDoingGC)
+		return 0;
+
+	if (dev->gcBlock <= 0) {
+		if (dev->nErasedBlocks >= erasedWatermark &&
+		    !dev->hasPendingPrioritisedGCs)
+			return 0;
+
+		dev->gcBlock = yaffs_FindBlockForGarbageCollection(dev, 0);
+		dev->gcChunk = 0;
+		if (dev->gcBlock <= 0)
+			return 0;
+	}
+
+	dev->garbageCollections++;
+	dev->passiveGarbageCollections++;
+	dev->backgroundGarbageCollections++;
+
+	T(YAFFS_TRACE_GC,
+	  (TSTR("yaffs: background GC erasedBlocks %d block %d" TENDSTR),
+	   dev->nErasedBlocks, dev->gcBlock));
+
+	yaffs_GarbageCollectBlock(dev, dev->gcBlock, 0);
+
+	return 1;
+}
+
 /*-------------------------  TAGS --------------------------------*/
 
 static int yaffs_TagsMatch(const yaffs_ExtendedTags * tags, int objectId,
@@ -3919,24 +4083,77 @@ int yaffs_UpdateObjectHeader(yaffs_Object * in, const YCHAR * name, int force,
  *   In Linux, the page cache provides read buffering aand the short op cache provides write 
  *   buffering.
  *
- *   There are a limited number (~10) of cache chunks per device so that we don't
- *   need a very intelligent search.
+ *   The cache can hold hundreds of chunks, so entries in use are hashed on
+ *   object and chunk id, and all entries sit on an LRU list. The most recently
+ *   used entry is at the head, free entries are kept at the tail.
+ *   Each object also lists its own entries in chunk id order, so flushing or
+ *   invalidating a file only looks at that file's chunks.
  */
 
+static Y_INLINE struct ylist_head *yaffs_ChunkCacheBucket(yaffs_Device * dev,
+							  const yaffs_Object * obj,
+							  int chunkId)
+{
+	return &dev->srCacheHash[(obj->objectId * 31 + chunkId) &
+				 (dev->nCacheBuckets - 1)];
+}
+
+static void yaffs_MarkChunkCacheClean(yaffs_Device * dev,
+				      yaffs_ChunkCache * cache)
+{
+	if (cache->dirty)
+		dev->nDirtyCacheChunks--;
+	cache->dirty = 0;
+}
+
+/* Give a cache entry to a chunk. The entry may still hold a clean chunk. */
+static void yaffs_AssignChunkCache(yaffs_Device * dev, yaffs_ChunkCache * cache,
+				   yaffs_Object * obj, int chunkId)
+{
+	struct ylist_head *i;
+
+	ylist_del(&cache->hashLink);
+	ylist_del(&cache->objLink);
+	yaffs_MarkChunkCacheClean(dev, cache);
+
+	cache->object = obj;
+	cache->chunkId = chunkId;
+	cache->locked = 0;
+	ylist_add(&cache->hashLink, yaffs_ChunkCacheBucket(dev, obj, chunkId));
+
+	/* Writes are mostly sequential, so search for the spot from the end */
+	for (i = obj->cacheChunks.prev; i != &obj->cacheChunks; i = i->prev) {
+		if (ylist_entry(i, yaffs_ChunkCache, objLink)->chunkId < chunkId)
+			break;
+	}
+	ylist_add(&cache->objLink, i);
+}
+
+/* Drop the chunk held in a cache entry, dirty or not */
+static void yaffs_FreeChunkCache(yaffs_Device * dev, yaffs_ChunkCache * cache)
+{
+	ylist_del_init(&cache->hashLink);
+	ylist_del_init(&cache->objLink);
+	yaffs_MarkChunkCacheClean(dev, cache);
+
+	cache->object = NULL;
+	ylist_del(&cache->lruLink);
+	ylist_add_tail(&cache->lruLink, &dev->srCacheLRU);
+}
+
 static int yaffs_ObjectHasCachedWriteData(yaffs_Object *obj)
 {
 	yaffs_Device *dev = obj->myDev;
-	int i;
-	yaffs_ChunkCache *cache;
-	int nCaches = obj->myDev->nShortOpCaches;
-	
-	for(i = 0; i < nCaches; i++){
-		cache = &dev->srCache[i];
-		if (cache->object == obj &&
-		    cache->dirty)
+	struct ylist_head *i;
+
+	if (dev->nShortOpCaches <= 0 || !dev->nDirtyCacheChunks)
+		return 0;
+
+	ylist_for_each(i, &obj->cacheChunks) {
+		if (ylist_entry(i, yaffs_ChunkCache, objLink)->dirty)
 			return 1;
 	}
-	
+
 	return 0;
 }
 
@@ -3944,49 +4161,37 @@ static int yaffs_ObjectHasCachedWriteData(yaffs_Object *obj)
 static void yaffs_FlushFilesChunkCache(yaffs_Object * obj)
 {
 	yaffs_Device *dev = obj->myDev;
-	int lowest = -99;	/* Stop compiler whining. */
-	int i;
+	struct ylist_head *i, *n;
 	yaffs_ChunkCache *cache;
-	int chunkWritten = 0;
-	int nCaches = obj->myDev->nShortOpCaches;
-
-	if (nCaches > 0) {
-		do {
-			cache = NULL;
-
-			/* Find the dirty cache for this object with the lowest chunk id. */
-			for (i = 0; i < nCaches; i++) {
-				if (dev->srCache[i].object == obj &&
-				    dev->srCache[i].dirty) {
-					if (!cache
-					    || dev->srCache[i].chunkId <
-					    lowest) {
-						cache = &dev->srCache[i];
-						lowest = cache->chunkId;
-					}
-				}
-			}
+	int chunkWritten;
 
-			if (cache && !cache->locked) {
-				/* Write it out and free it up */
+	if (dev->nShortOpCaches <= 0)
+		return;
 
-				chunkWritten =
-				    yaffs_WriteChunkDataToObject(cache->object,
-								 cache->chunkId,
-								 cache->data,
-								 cache->nBytes,
-								 1);
-				cache->dirty = 0;
-				cache->object = NULL;
-			}
+	/* The object's entries are in chunk id order, write the dirty ones
+	 * out and free them up. Writing a chunk does not touch the cache.
+	 */
+	ylist_for_each_safe(i, n, &obj->cacheChunks) {
+		if (!dev->nDirtyCacheChunks)
+			break;
 
-		} while (cache && chunkWritten > 0);
+		cache = ylist_entry(i, yaffs_ChunkCache, objLink);
+		if (!cache->dirty)
+			continue;
+		if (cache->locked)
+			break;
 
-		if (cache) {
+		chunkWritten = yaffs_WriteChunkDataToObject(cache->object,
+							    cache->chunkId,
+							    cache->data,
+							    cache->nBytes, 1);
+		yaffs_FreeChunkCache(dev, cache);
+
+		if (chunkWritten <= 0) {
 			/* Hoosterman, disk full while writing cache out. */
 			T(YAFFS_TRACE_ERROR,
 			  (TSTR("yaffs tragedy: no space during cache write" TENDSTR)));
-
+			break;
 		}
 	}
 
@@ -3999,43 +4204,34 @@ static void yaffs_FlushFilesChunkCache(yaffs_Object * obj)
 
 void yaffs_FlushEntireDeviceCache(yaffs_Device *dev)
 {
-	yaffs_Object *obj;
 	int nCaches = dev->nShortOpCaches;
 	int i;
-	
-	/* Find a dirty object in the cache and flush it...
-	 * until there are no further dirty objects.
+
+	/* Flush the object of each dirty entry. Flushing only frees entries,
+	 * so one pass leaves no dirty object behind.
 	 */
-	do {
-		obj = NULL;
-		for( i = 0; i < nCaches && !obj; i++) {
-			if (dev->srCache[i].object &&
-			    dev->srCache[i].dirty)
-				obj = dev->srCache[i].object;
-			    
-		}
-		if(obj)
-			yaffs_FlushFilesChunkCache(obj);
-			
-	} while(obj);
-	
+	for (i = 0; i < nCaches && dev->nDirtyCacheChunks; i++) {
+		if (dev->srCache[i].object && dev->srCache[i].dirty)
+			yaffs_FlushFilesChunkCache(dev->srCache[i].object);
+	}
+
 }
 
 
 /* Grab us a cache chunk for use.
- * First look for an empty one. 
- * Then look for the least recently used non-dirty one.
- * Then look for the least recently used dirty one...., flush and look again.
+ * First look for an empty one, they are at the tail of the LRU list.
+ * Then look for the least recently used unlocked one. If that is dirty,
+ * flush its object and look again.
  */
 static yaffs_ChunkCache *yaffs_GrabChunkCacheWorker(yaffs_Device * dev)
 {
-	int i;
+	yaffs_ChunkCache *cache;
 
-	if (dev->nShortOpCaches > 0) {
-		for (i = 0; i < dev->nShortOpCaches; i++) {
-			if (!dev->srCache[i].object) 
-				return &dev->srCache[i];
-		}
+	if (dev->nShortOpCaches > 0 && !ylist_empty(&dev->srCacheLRU)) {
+		cache = ylist_entry(dev->srCacheLRU.prev, yaffs_ChunkCache,
+				    lruLink);
+		if (!cache->object)
+			return cache;
 	}
 
 	return NULL;
@@ -4044,45 +4240,30 @@ static yaffs_ChunkCache *yaffs_GrabChunkCacheWorker(yaffs_Device * dev)
 static yaffs_ChunkCache *yaffs_GrabChunkCache(yaffs_Device * dev)
 {
 	yaffs_ChunkCache *cache;
-	yaffs_Object *theObj;
-	int usage;
-	int i;
-	int pushout;
+	struct ylist_head *i;
 
 	if (dev->nShortOpCaches > 0) {
-		/* Try find a non-dirty one... */
+		/* Try find a free one... */
 
 		cache = yaffs_GrabChunkCacheWorker(dev);
 
 		if (!cache) {
-			/* They were all dirty, find the last recently used object and flush
-			 * its cache, then  find again.
-			 * NB what's here is not very accurate, we actually flush the object
-			 * the last recently used page.
-			 */
-
-			/* With locking we can't assume we can use entry zero */
-
-			theObj = NULL;
-			usage = -1;
-			cache = NULL;
-			pushout = -1;
-
-			for (i = 0; i < dev->nShortOpCaches; i++) {
-				if (dev->srCache[i].object &&
-				    !dev->srCache[i].locked &&
-				    (dev->srCache[i].lastUse < usage || !cache))
-				{
-					usage = dev->srCache[i].lastUse;
-					theObj = dev->srCache[i].object;
-					cache = &dev->srCache[i];
-					pushout = i;
-				}
+			/* With locking we can't assume we can use the tail */
+			for (i = dev->srCacheLRU.prev; i != &dev->srCacheLRU;
+			     i = i->prev) {
+				cache = ylist_entry(i, yaffs_ChunkCache,
+						    lruLink);
+				if (!cache->locked)
+					break;
+				cache = NULL;
 			}
 
-			if (!cache || cache->dirty) {
-				/* Flush and try again */
-				yaffs_FlushFilesChunkCache(theObj);
+			if (cache && cache->dirty) {
+				/* Flush and try again.
+				 * NB we flush the whole object that owns the
+				 * least recently used chunk.
+				 */
+				yaffs_FlushFilesChunkCache(cache->object);
 				cache = yaffs_GrabChunkCacheWorker(dev);
 			}
 
@@ -4098,14 +4279,17 @@ static yaffs_ChunkCache *yaffs_FindChunkCache(const yaffs_Object * obj,
 					      int chunkId)
 {
 	yaffs_Device *dev = obj->myDev;
-	int i;
+	struct ylist_head *i;
+	yaffs_ChunkCache *cache;
+
 	if (dev->nShortOpCaches > 0) {
-		for (i = 0; i < dev->nShortOpCaches; i++) {
-			if (dev->srCache[i].object == obj &&
-			    dev->srCache[i].chunkId == chunkId) {
+		ylist_for_each(i, yaffs_ChunkCacheBucket(dev, obj, chunkId)) {
+			cache = ylist_entry(i, yaffs_ChunkCache, hashLink);
+			if (cache->object == obj &&
+			    cache->chunkId == chunkId) {
 				dev->cacheHits++;
 
-				return &dev->srCache[i];
+				return cache;
 			}
 		}
 	}
@@ -4118,21 +4302,12 @@ static void yaffs_UseChunkCache(yaffs_Device * dev, yaffs_ChunkCache * cache,
 {
 
 	if (dev->nShortOpCaches > 0) {
-		if (dev->srLastUse < 0 || dev->srLastUse > 100000000) {
-			/* Reset the cache usages */
-			int i;
-			for (i = 1; i < dev->nShortOpCaches; i++) {
-				dev->srCache[i].lastUse = 0;
-			}
-			dev->srLastUse = 0;
-		}
-
-		dev->srLastUse++;
+		ylist_del(&cache->lruLink);
+		ylist_add(&cache->lruLink, &dev->srCacheLRU);
 
-		cache->lastUse = dev->srLastUse;
-
-		if (isAWrite) {
+		if (isAWrite && !cache->dirty) {
 			cache->dirty = 1;
+			dev->nDirtyCacheChunks++;
 		}
 	}
 }
@@ -4147,7 +4322,7 @@ static void yaffs_InvalidateChunkCache(yaffs_Object * object, int chunkId)
 		yaffs_ChunkCache *cache = yaffs_FindChunkCache(object, chunkId);
 
 		if (cache) {
-			cache->object = NULL;
+			yaffs_FreeChunkCache(object->myDev, cache);
 		}
 	}
 }
@@ -4157,17 +4332,96 @@ static void yaffs_InvalidateChunkCache(yaffs_Object * object, int chunkId)
  */
 static void yaffs_InvalidateWholeChunkCache(yaffs_Object * in)
 {
-	int i;
+	struct ylist_head *i, *n;
 	yaffs_Device *dev = in->myDev;
 
 	if (dev->nShortOpCaches > 0) {
 		/* Invalidate it. */
+		ylist_for_each_safe(i, n, &in->cacheChunks) {
+			yaffs_FreeChunkCache(dev, ylist_entry(i, yaffs_ChunkCache,
+							      objLink));
+		}
+	}
+}
+
+/* Set up the short op cache, its hash and LRU list */
+static int yaffs_InitialiseChunkCache(yaffs_Device * dev)
+{
+	int i;
+	int srCacheBytes;
+
+	dev->srCache = NULL;
+	dev->srCacheHash = NULL;
+	dev->nDirtyCacheChunks = 0;
+	YINIT_LIST_HEAD(&dev->srCacheLRU);
+
+	if (dev->nShortOpCaches <= 0)
+		return YAFFS_OK;
+
+	if (dev->nShortOpCaches > YAFFS_MAX_SHORT_OP_CACHES)
+		dev->nShortOpCaches = YAFFS_MAX_SHORT_OP_CACHES;
+
+	srCacheBytes = dev->nShortOpCaches * sizeof(yaffs_ChunkCache);
+
+	dev->srCache = YMALLOC(srCacheBytes);
+	dev->srCacheAlt = 0;
+	if (!dev->srCache) {
+		dev->srCache = YMALLOC_ALT(srCacheBytes);
+		dev->srCacheAlt = 1;
+	}
+	if (!dev->srCache)
+		return YAFFS_FAIL;
+
+	memset(dev->srCache, 0, srCacheBytes);
+
+	/* About one chunk per bucket */
+	dev->nCacheBuckets = 1;
+	while (dev->nCacheBuckets < dev->nShortOpCaches)
+		dev->nCacheBuckets <<= 1;
+
+	dev->srCacheHash =
+	    YMALLOC(dev->nCacheBuckets * sizeof(struct ylist_head));
+	if (!dev->srCacheHash)
+		return YAFFS_FAIL;
+
+	for (i = 0; i < dev->nCacheBuckets; i++)
+		YINIT_LIST_HEAD(&dev->srCacheHash[i]);
+
+	for (i = 0; i < dev->nShortOpCaches; i++) {
+		yaffs_ChunkCache *cache = &dev->srCache[i];
+
+		YINIT_LIST_HEAD(&cache->hashLink);
+		YINIT_LIST_HEAD(&cache->objLink);
+		ylist_add_tail(&cache->lruLink, &dev->srCacheLRU);
+		cache->data = YMALLOC_DMA(dev->totalBytesPerChunk);
+		if (!cache->data)
+			return YAFFS_FAIL;
+	}
+
+	return YAFFS_OK;
+}
+
+static void yaffs_DeinitialiseChunkCache(yaffs_Device * dev)
+{
+	int i;
+
+	if (dev->srCache) {
 		for (i = 0; i < dev->nShortOpCaches; i++) {
-			if (dev->srCache[i].object == in) {
-				dev->srCache[i].object = NULL;
-			}
+			if (dev->srCache[i].data)
+				YFREE(dev->srCache[i].data);
+			dev->srCache[i].data = NULL;
 		}
+
+		if (dev->srCacheAlt)
+			YFREE_ALT(dev->srCache);
+		else
+			YFREE(dev->srCache);
+		dev->srCache = NULL;
 	}
+
+	if (dev->srCacheHash)
+		YFREE(dev->srCacheHash);
+	dev->srCacheHash = NULL;
 }
 
 /*--------------------- Checkpointing --------------------*/
@@ -4488,7 +4742,7 @@ static int yaffs_WriteCheckpointObjects(yaffs_Device *dev)
 	 * dumping them to the checkpointing stream.
          */
          
-         for(i = 0; ok &&  i <  YAFFS_NOBJECT_BUCKETS; i++){
+         for(i = 0; ok &&  i <  dev->nObjectBuckets; i++){
                 ylist_for_each(lh, &dev->objectBucket[i].list) {
                         if (lh) {
                                 obj = ylist_entry(lh, yaffs_Object, hashLink);
@@ -4744,6 +4998,28 @@ int yaffs_CheckpointRestore(yaffs_Device *dev)
 	return retval;
 }
 
+/* Copy part of a chunk out of the short op cache if it is cached there.
+ * Callers only hold the grossLock shared, so the cache is used for hits
+ * only. Loading a chunk into it could mean writing out a dirty entry first.
+ * Returns 1 on a hit.
+ */
+static int yaffs_ReadChunkFromCache(yaffs_Object * in, int chunk, __u32 start,
+				    __u8 * buffer, int nBytes)
+{
+	yaffs_Device *dev = in->myDev;
+	yaffs_ChunkCache *cache;
+
+	yaffs_LockScratch(dev);
+	cache = yaffs_FindChunkCache(in, chunk);
+	if (cache) {
+		yaffs_UseChunkCache(dev, cache, 0);
+		memcpy(buffer, &cache->data[start], nBytes);
+	}
+	yaffs_UnlockScratch(dev);
+
+	return cache ? 1 : 0;
+}
+
 /*--------------------- File read/write ------------------------
  * Read and write have very similar structures.
  * In general the read/write has three parts to it
@@ -4763,7 +5039,6 @@ int yaffs_ReadDataFromFile(yaffs_Object * in, __u8 * buffer, loff_t offset,
 	int nToCopy;
 	int n = nBytes;
 	int nDone = 0;
-	yaffs_ChunkCache *cache;
 
 	yaffs_Device *dev;
 
@@ -4784,52 +5059,21 @@ int yaffs_ReadDataFromFile(yaffs_Object * in, __u8 * buffer, loff_t offset,
 			nToCopy = dev->nDataBytesPerChunk - start;
 		}
 
-		cache = yaffs_FindChunkCache(in, chunk);
-
-		/* If the chunk is already in the cache or it is less than a whole chunk
-		 * or we're using inband tags then use the cache (if there is caching)
-		 * else bypass the cache.
-		 */
-		if (cache || nToCopy != dev->nDataBytesPerChunk || dev->inbandTags) {
-			if (dev->nShortOpCaches > 0) {
-
-				/* If we can't find the data in the cache, then load it up. */
-
-				if (!cache) {
-					cache = yaffs_GrabChunkCache(in->myDev);
-					cache->object = in;
-					cache->chunkId = chunk;
-					cache->dirty = 0;
-					cache->locked = 0;
-					yaffs_ReadChunkDataFromObject(in, chunk,
-								      cache->
-								      data);
-					cache->nBytes = 0;
-				}
-
-				yaffs_UseChunkCache(dev, cache, 0);
-
-				cache->locked = 1;
-
+		if (yaffs_ReadChunkFromCache(in, chunk, start, buffer, nToCopy)) {
+			/* Already copied out of the cache */
+		} else if (nToCopy != dev->nDataBytesPerChunk || dev->inbandTags) {
+			/* Read into the local buffer then copy..*/
 
-				memcpy(buffer, &cache->data[start], nToCopy);
-
-				cache->locked = 0;
-			} else {
-				/* Read into the local buffer then copy..*/
-
-				__u8 *localBuffer =
-				    yaffs_GetTempBuffer(dev, __LINE__);
-				yaffs_ReadChunkDataFromObject(in, chunk,
-							      localBuffer);
+			__u8 *localBuffer =
+			    yaffs_GetTempBuffer(dev, __LINE__);
+			yaffs_ReadChunkDataFromObject(in, chunk,
+						      localBuffer);
 
-				memcpy(buffer, &localBuffer[start], nToCopy);
+			memcpy(buffer, &localBuffer[start], nToCopy);
 
 
-				yaffs_ReleaseTempBuffer(dev, localBuffer,
-							__LINE__);
-			}
-
+			yaffs_ReleaseTempBuffer(dev, localBuffer,
+						__LINE__);
 		} else {
 
 			/* A full chunk. Read directly into the supplied buffer. */
@@ -4847,6 +5091,165 @@ int yaffs_ReadDataFromFile(yaffs_Object * in, __u8 * buffer, loff_t offset,
 	return nDone;
 }
 
+/* Find the NAND chunk holding chunkInInode for a reader walking the file in
+ * order. *tn and *tnBase remember the last level 0 tnode, so a run of chunks
+ * costs one tree walk per YAFFS_NTNODES_LEVEL0 chunks. With chunk groups the
+ * tags have to be checked, so that case uses the normal search.
+ */
+static int yaffs_FindNextChunkInFile(yaffs_Object * in, int chunkInInode,
+				     yaffs_Tnode ** tn, int *tnBase)
+{
+	yaffs_Device *dev = in->myDev;
+	int base = chunkInInode & ~YAFFS_TNODES_LEVEL0_MASK;
+	int theChunk;
+
+	if (dev->chunkGroupBits)
+		return yaffs_FindChunkInFile(in, chunkInInode, NULL);
+
+	if (base != *tnBase) {
+		*tn = yaffs_FindLevel0Tnode(dev, &in->variant.fileVariant,
+					    chunkInInode);
+		*tnBase = base;
+	}
+
+	if (!*tn)
+		return -1;
+
+	theChunk = yaffs_GetChunkGroupBase(dev, *tn, chunkInInode);
+	if (!theChunk ||
+	    !yaffs_CheckChunkBit(dev, theChunk / dev->nChunksPerBlock,
+				 theChunk % dev->nChunksPerBlock))
+		return -1;
+
+	return theChunk;
+}
+
+static __u8 *yaffs_GetRunBuffer(yaffs_Device * dev)
+{
+	__u8 *buffer = NULL;
+
+	yaffs_LockScratch(dev);
+	if (dev->runBuffer && !dev->runBufferInUse) {
+		dev->runBufferInUse = 1;
+		buffer = dev->runBuffer;
+	}
+	yaffs_UnlockScratch(dev);
+
+	return buffer;
+}
+
+static void yaffs_ReleaseRunBuffer(yaffs_Device * dev, __u8 * buffer)
+{
+	if (buffer) {
+		yaffs_LockScratch(dev);
+		dev->runBufferInUse = 0;
+		yaffs_UnlockScratch(dev);
+	}
+}
+
+/* yaffs_ReadDataRunFromFile() fills nBuffers buffers of bufferSize bytes
+ * from consecutive file positions starting at offset, eg. the pages of a
+ * readahead window. Like yaffs_ReadDataFromFile() it only needs the
+ * grossLock shared.
+ *
+ * Chunks that follow each other in NAND are read with a single NAND call,
+ * straight into the buffer if the run fits in one, else through
+ * dev->runBuffer. Unaligned requests go through yaffs_ReadDataFromFile().
+ * Returns the number of bytes read.
+ */
+int yaffs_ReadDataRunFromFile(yaffs_Object * in, __u8 ** buffers, int nBuffers,
+			      int bufferSize, loff_t offset)
+{
+	yaffs_Device *dev = in->myDev;
+	int chunkSize = dev->nDataBytesPerChunk;
+	int chunksPerBuffer;
+	int nChunks;
+	int firstChunk;
+	__u32 start;
+	int map[YAFFS_MAX_RUN_CHUNKS];
+	yaffs_Tnode *tn = NULL;
+	int tnBase = -1;
+	__u8 *runBuffer;
+	int window;
+	int nWindow;
+	int i, j, k, n;
+
+	yaffs_AddrToChunk(dev, offset, &firstChunk, &start);
+
+	if (start || dev->inbandTags || bufferSize % chunkSize) {
+		int nDone = 0;
+
+		for (i = 0; i < nBuffers; i++)
+			nDone += yaffs_ReadDataFromFile(in, buffers[i],
+					offset + (loff_t) i * bufferSize,
+					bufferSize);
+		return nDone;
+	}
+
+	firstChunk++;
+	chunksPerBuffer = bufferSize / chunkSize;
+	nChunks = nBuffers * chunksPerBuffer;
+
+	runBuffer = yaffs_GetRunBuffer(dev);
+
+	for (window = 0; window < nChunks; window += nWindow) {
+		nWindow = nChunks - window;
+		if (nWindow > YAFFS_MAX_RUN_CHUNKS)
+			nWindow = YAFFS_MAX_RUN_CHUNKS;
+
+		for (j = 0; j < nWindow; j++)
+			map[j] = yaffs_FindNextChunkInFile(in,
+							   firstChunk + window + j,
+							   &tn, &tnBase);
+
+		for (j = 0; j < nWindow; j += n) {
+			int left;
+			__u8 *dest;
+
+			i = window + j;
+			left = chunksPerBuffer - i % chunksPerBuffer;
+			dest = buffers[i / chunksPerBuffer] +
+			    (i % chunksPerBuffer) * chunkSize;
+
+			n = 1;
+			if (map[j] < 0) {
+				/* get sane (zero) data if you read a hole */
+				memset(dest, 0, chunkSize);
+				continue;
+			}
+
+			while (j + n < nWindow && map[j + n] == map[j] + n &&
+			       (runBuffer || n < left))
+				n++;
+
+			if (n <= left) {
+				yaffs_ReadChunkRunFromNAND(dev, map[j], n, dest);
+			} else {
+				yaffs_ReadChunkRunFromNAND(dev, map[j], n,
+							   runBuffer);
+				for (k = 0; k < n; k++, i++)
+					memcpy(buffers[i / chunksPerBuffer] +
+					       (i % chunksPerBuffer) * chunkSize,
+					       runBuffer + k * chunkSize,
+					       chunkSize);
+			}
+		}
+
+		/* Dirty chunks in the short op cache are newer than NAND */
+		for (j = 0; j < nWindow; j++) {
+			i = window + j;
+			yaffs_ReadChunkFromCache(in, firstChunk + i, 0,
+						 buffers[i / chunksPerBuffer] +
+						 (i % chunksPerBuffer) * chunkSize,
+						 chunkSize);
+		}
+	}
+
+	yaffs_ReleaseRunBuffer(dev, runBuffer);
+
+	return nChunks * chunkSize;
+}
+
 int yaffs_WriteDataToFile(yaffs_Object * in, const __u8 * buffer, loff_t offset,
 			  int nBytes, int writeThrough)
 {
@@ -4928,13 +5331,13 @@ int yaffs_WriteDataToFile(yaffs_Object * in, const __u8 * buffer, loff_t offset,
 				    && yaffs_CheckSpaceForAllocation(in->
 								     myDev)) {
 					cache = yaffs_GrabChunkCache(in->myDev);
-					cache->object = in;
-					cache->chunkId = chunk;
-					cache->dirty = 0;
-					cache->locked = 0;
-					yaffs_ReadChunkDataFromObject(in, chunk,
-								      cache->
-								      data);
+					if (cache) {
+						yaffs_AssignChunkCache(dev, cache,
+								       in, chunk);
+						yaffs_ReadChunkDataFromObject(in, chunk,
+									      cache->
+									      data);
+					}
 				}
 				else if(cache && 
 				        !cache->dirty &&
@@ -4964,7 +5367,7 @@ int yaffs_WriteDataToFile(yaffs_Object * in, const __u8 * buffer, loff_t offset,
 						     cache->chunkId,
 						     cache->data, cache->nBytes,
 						     1);
-						cache->dirty = 0;
+						yaffs_MarkChunkCacheClean(dev, cache);
 					}
 
 				} else {
@@ -5973,15 +6376,58 @@ static int yaffs_Scan(yaffs_Device * dev)
 	return YAFFS_OK;
 }
 
-static void yaffs_CheckObjectDetailsLoaded(yaffs_Object *in)
+/* Fill in a lazy loaded object from its header. Called with loadLock held. */
+static void yaffs_LoadObjectDetails(yaffs_Object *in)
 {
 	__u8 *chunkData;
 	yaffs_ObjectHeader *oh;
-	yaffs_Device *dev;
+	yaffs_Device *dev = in->myDev;
 	yaffs_ExtendedTags tags;
 	int result;
 	int alloc_failed = 0;
 
+	chunkData = yaffs_GetTempBuffer(dev, __LINE__);
+
+	result = yaffs_ReadChunkWithTagsFromNAND(dev,in->hdrChunk,chunkData,&tags);
+	oh = (yaffs_ObjectHeader *) chunkData;
+
+	in->yst_mode = oh->yst_mode;
+#ifdef CONFIG_YAFFS_WINCE
+	in->win_atime[0] = oh->win_atime[0];
+	in->win_ctime[0] = oh->win_ctime[0];
+	in->win_mtime[0] = oh->win_mtime[0];
+	in->win_atime[1] = oh->win_atime[1];
+	in->win_ctime[1] = oh->win_ctime[1];
+	in->win_mtime[1] = oh->win_mtime[1];
+#else
+	in->yst_uid = oh->yst_uid;
+	in->yst_gid = oh->yst_gid;
+	in->yst_atime = oh->yst_atime;
+	in->yst_mtime = oh->yst_mtime;
+	in->yst_ctime = oh->yst_ctime;
+	in->yst_rdev = oh->yst_rdev;
+	
+#endif
+	yaffs_SetObjectName(in, oh->name);
+	
+	if(in->variantType == YAFFS_OBJECT_TYPE_SYMLINK){
+		 in->variant.symLinkVariant.alias =
+					    yaffs_CloneString(oh->alias);
+		if(!in->variant.symLinkVariant.alias)
+			alloc_failed = 1; /* Not returned to caller */
+	}
+					    
+	yaffs_ReleaseTempBuffer(dev,chunkData, __LINE__);
+
+	/* Only let lock-free callers see the object once it is complete */
+	YWMB();
+	in->lazyLoaded = 0;
+}
+
+static void yaffs_CheckObjectDetailsLoaded(yaffs_Object *in)
+{
+	yaffs_Device *dev;
+
 	if(!in)
 		return;
 		
@@ -5994,39 +6440,11 @@ static void yaffs_CheckObjectDetailsLoaded(yaffs_Object *in)
 #endif
 
 	if(in->lazyLoaded && in->hdrChunk > 0){
-		in->lazyLoaded = 0;
-		chunkData = yaffs_GetTempBuffer(dev, __LINE__);
-
-		result = yaffs_ReadChunkWithTagsFromNAND(dev,in->hdrChunk,chunkData,&tags);
-		oh = (yaffs_ObjectHeader *) chunkData;
-
-		in->yst_mode = oh->yst_mode;
-#ifdef CONFIG_YAFFS_WINCE
-		in->win_atime[0] = oh->win_atime[0];
-		in->win_ctime[0] = oh->win_ctime[0];
-		in->win_mtime[0] = oh->win_mtime[0];
-		in->win_atime[1] = oh->win_atime[1];
-		in->win_ctime[1] = oh->win_ctime[1];
-		in->win_mtime[1] = oh->win_mtime[1];
-#else
-		in->yst_uid = oh->yst_uid;
-		in->yst_gid = oh->yst_gid;
-		in->yst_atime = oh->yst_atime;
-		in->yst_mtime = oh->yst_mtime;
-		in->yst_ctime = oh->yst_ctime;
-		in->yst_rdev = oh->yst_rdev;
-		
-#endif
-		yaffs_SetObjectName(in, oh->name);
-		
-		if(in->variantType == YAFFS_OBJECT_TYPE_SYMLINK){
-			 in->variant.symLinkVariant.alias =
-						    yaffs_CloneString(oh->alias);
-			if(!in->variant.symLinkVariant.alias)
-				alloc_failed = 1; /* Not returned to caller */
-		}
-						    
-		yaffs_ReleaseTempBuffer(dev,chunkData, __LINE__);
+		/* Another reader may be filling it in already */
+		yaffs_LockLoad(dev);
+		if(in->lazyLoaded)
+			yaffs_LoadObjectDetails(in);
+		yaffs_UnlockLoad(dev);
 	}
 }
 
@@ -6064,6 +6482,10 @@ static int yaffs_ScanBackwards(yaffs_Device * dev)
 	yaffs_BlockIndex *blockIndex = NULL;
 	int altBlockIndex = 0;
 
+	/* Tags of the block being scanned, read in one go. May be NULL. */
+	yaffs_ExtendedTags *blockTags = NULL;
+	int blockTagsRead;
+
 	if (!dev->isYaffs2) {
 		T(YAFFS_TRACE_SCAN,
 		  (TSTR("yaffs_ScanBackwards is only for YAFFS2!" TENDSTR)));
@@ -6092,6 +6514,11 @@ static int yaffs_ScanBackwards(yaffs_Device * dev)
 	}
 	
 	dev->blocksInCheckpoint = 0;
+	dev->nBlocksToScan = 0;
+	dev->nBlocksScanned = 0;
+
+	if (!dev->inbandTags)
+		blockTags = YMALLOC(dev->nChunksPerBlock * sizeof(yaffs_ExtendedTags));
 	
 	chunkData = yaffs_GetTempBuffer(dev, __LINE__);
 
@@ -6191,6 +6618,7 @@ static int yaffs_ScanBackwards(yaffs_Device * dev)
 	/* Now scan the blocks looking at the data. */
 	startIterator = 0;
 	endIterator = nBlocksToScan - 1;
+	dev->nBlocksToScan = nBlocksToScan;
 	T(YAFFS_TRACE_SCAN_DEBUG,
 	  (TSTR("%d blocks to be scanned" TENDSTR), nBlocksToScan));
 
@@ -6211,6 +6639,16 @@ static int yaffs_ScanBackwards(yaffs_Device * dev)
 
 		deleted = 0;
 
+		/* Fetch all the tags of the block with one driver call rather
+		 * than one per chunk, falling back to reading them below.
+		 */
+		blockTagsRead = blockTags &&
+			(state == YAFFS_BLOCK_STATE_NEEDS_SCANNING ||
+			 state == YAFFS_BLOCK_STATE_ALLOCATING) &&
+			yaffs_ReadTagsRunFromNAND(dev, blk * dev->nChunksPerBlock,
+						  dev->nChunksPerBlock,
+						  blockTags) == YAFFS_OK;
+
 		/* For each chunk in each block that needs scanning.... */
 		foundChunksInBlock = 0;
 		for (c = dev->nChunksPerBlock - 1; 
@@ -6223,8 +6661,11 @@ static int yaffs_ScanBackwards(yaffs_Device * dev)
 			
 			chunk = blk * dev->nChunksPerBlock + c;
 
-			result = yaffs_ReadChunkWithTagsFromNAND(dev, chunk, NULL,
-							&tags);
+			if (blockTagsRead)
+				tags = blockTags[c];
+			else
+				result = yaffs_ReadChunkWithTagsFromNAND(dev, chunk,
+								NULL, &tags);
 
 			/* Let's have a good look at this chunk... */
 
@@ -6682,12 +7123,16 @@ static int yaffs_ScanBackwards(yaffs_Device * dev)
 			yaffs_BlockBecameDirty(dev, blk);
 		}
 
+		dev->nBlocksScanned++;
 	}
 
 	if (altBlockIndex) 
 		YFREE_ALT(blockIndex);
 	else
 		YFREE(blockIndex);
+
+	if (blockTags)
+		YFREE(blockTags);
 	
 	/* Ok, we've done all the scanning.
 	 * Fix up the hard link chains.
@@ -6802,6 +7247,7 @@ static void yaffs_RemoveObjectFromDirectory(yaffs_Object * obj)
 
            
         ylist_del_init(&obj->siblings);
+        ylist_del_init(&obj->nameLink);
         obj->parent = NULL;
 
 	yaffs_VerifyDirectory(parent);
@@ -6846,6 +7292,12 @@ static void yaffs_AddObjectToDirectory(yaffs_Object * directory,
         ylist_add(&obj->siblings, &directory->variant.directoryVariant.children);
         obj->parent = directory;
 
+	if (directory->variant.directoryVariant.nameIndex) {
+		/* Need the real name sum to hash it */
+		yaffs_CheckObjectDetailsLoaded(obj);
+		ylist_add(&obj->nameLink, yaffs_NameBucket(directory, obj->sum));
+	}
+
         if (directory == obj->myDev->unlinkedDir
 	    || directory == obj->myDev->deletedDir) {
 		obj->unlinked = 1;
@@ -6859,6 +7311,121 @@ static void yaffs_AddObjectToDirectory(yaffs_Object * directory,
 
 }
 
+/* Hash the children of a big directory by name sum, so that lookups don't
+ * have to walk the whole list. Built on the first lookup, which may only
+ * hold the grossLock shared, and kept up to date by the directory add and
+ * remove functions after that.
+ */
+static void yaffs_BuildNameIndex(yaffs_Object * directory)
+{
+	yaffs_Device *dev = directory->myDev;
+	struct ylist_head *index;
+	struct ylist_head *i;
+	yaffs_Object *l;
+	int n = 0;
+
+	ylist_for_each(i, &directory->variant.directoryVariant.children) {
+		if (++n >= YAFFS_DIR_INDEX_MIN)
+			break;
+	}
+	if (n < YAFFS_DIR_INDEX_MIN)
+		return;
+
+	yaffs_LockLoad(dev);
+
+	if (directory->variant.directoryVariant.nameIndex) {
+		yaffs_UnlockLoad(dev);
+		return;
+	}
+
+	index = YMALLOC(YAFFS_NDIR_BUCKETS * sizeof(struct ylist_head));
+	if (!index) {
+		/* Not fatal, lookups just fall back to the list */
+		yaffs_UnlockLoad(dev);
+		return;
+	}
+
+	for (n = 0; n < YAFFS_NDIR_BUCKETS; n++)
+		YINIT_LIST_HEAD(&index[n]);
+
+	ylist_for_each(i, &directory->variant.directoryVariant.children) {
+		l = ylist_entry(i, yaffs_Object, siblings);
+		if (l->lazyLoaded && l->hdrChunk > 0)
+			yaffs_LoadObjectDetails(l);
+		ylist_add(&l->nameLink, &index[l->sum % YAFFS_NDIR_BUCKETS]);
+	}
+
+	/* Lookups that see the index must see it filled in */
+	YWMB();
+	directory->variant.directoryVariant.nameIndex = index;
+
+	yaffs_UnlockLoad(dev);
+}
+
+static void yaffs_FreeNameIndexes(yaffs_Device * dev)
+{
+	struct ylist_head *i;
+	yaffs_Object *obj;
+	int b;
+
+	for (b = 0; b < dev->nObjectBuckets; b++) {
+		ylist_for_each(i, &dev->objectBucket[b].list) {
+			obj = ylist_entry(i, yaffs_Object, hashLink);
+			if (obj->variantType == YAFFS_OBJECT_TYPE_DIRECTORY &&
+			    obj->variant.directoryVariant.nameIndex) {
+				YFREE(obj->variant.directoryVariant.nameIndex);
+				obj->variant.directoryVariant.nameIndex = NULL;
+			}
+		}
+	}
+}
+
+/* Lookup through the name index. Objects without a header only answer to
+ * their made up "objNNN" name, so they are found by number instead.
+ */
+static yaffs_Object *yaffs_FindObjectByNameIndexed(yaffs_Object * directory,
+						   const YCHAR * name, int sum)
+{
+	yaffs_Device *dev = directory->myDev;
+	YCHAR buffer[YAFFS_MAX_NAME_LENGTH + 1];
+	const YCHAR *p;
+	struct ylist_head *i;
+	yaffs_Object *l;
+	__u32 objectId = 0;
+
+	if (dev->lostNFoundDir && dev->lostNFoundDir->parent == directory &&
+	    yaffs_strcmp(name, YAFFS_LOSTNFOUND_NAME) == 0)
+		return dev->lostNFoundDir;
+
+	if (yaffs_strncmp(name, YAFFS_LOSTNFOUND_PREFIX,
+			  yaffs_strlen(YAFFS_LOSTNFOUND_PREFIX)) == 0) {
+		p = name + yaffs_strlen(YAFFS_LOSTNFOUND_PREFIX);
+		while (*p >= '0' && *p <= '9' && (objectId || *p != '0'))
+			objectId = objectId * 10 + (*p++ - '0');
+
+		if (!*p && objectId) {
+			l = yaffs_FindObjectByNumber(dev, objectId);
+			if (l && l->parent == directory && l->hdrChunk <= 0 &&
+			    l->objectId != YAFFS_OBJECTID_LOSTNFOUND)
+				return l;
+		}
+	}
+
+	ylist_for_each(i, yaffs_NameBucket(directory, sum)) {
+		l = ylist_entry(i, yaffs_Object, nameLink);
+
+		if (l->objectId == YAFFS_OBJECTID_LOSTNFOUND ||
+		    l->hdrChunk <= 0 || !yaffs_SumCompare(l->sum, sum))
+			continue;
+
+		yaffs_GetObjectName(l, buffer, YAFFS_MAX_NAME_LENGTH);
+		if (yaffs_strncmp(name, buffer, YAFFS_MAX_NAME_LENGTH) == 0)
+			return l;
+	}
+
+	return NULL;
+}
+
 yaffs_Object *yaffs_FindObjectByName(yaffs_Object * directory,
 				     const YCHAR * name)
 {
@@ -6889,6 +7456,11 @@ yaffs_Object *yaffs_FindObjectByName(yaffs_Object * directory,
 
         sum = yaffs_CalcNameSum(name);
 
+	if (!directory->variant.directoryVariant.nameIndex)
+		yaffs_BuildNameIndex(directory);
+	if (directory->variant.directoryVariant.nameIndex)
+		return yaffs_FindObjectByNameIndexed(directory, name, sum);
+
         ylist_for_each(i, &directory->variant.directoryVariant.children) {
                 if (i) {
                         l = ylist_entry(i, yaffs_Object, siblings);
@@ -7394,6 +7966,7 @@ int yaffs_GutsInitialise(yaffs_Device * dev)
 	/* More device initialisation */
 	dev->garbageCollections = 0;
 	dev->passiveGarbageCollections = 0;
+	dev->backgroundGarbageCollections = 0;
 	dev->currentDirtyChecker = 0;
 	dev->bufferedBlock = -1;
 	dev->doingBufferedBlockRewrite = 0;
@@ -7407,44 +7980,28 @@ int yaffs_GutsInitialise(yaffs_Device * dev)
 	dev->nErasureFailures = 0;
 	dev->nErasedBlocks = 0;
 	dev->isDoingGC = 0;
+	dev->scanPending = 0;
+	dev->nBlocksToScan = 0;
+	dev->nBlocksScanned = 0;
 	dev->hasPendingPrioritisedGCs = 1; /* Assume the worst for now, will get fixed on first GC */
 
 	/* Initialise temporary buffers and caches. */
 	if(!yaffs_InitialiseTempBuffers(dev))
 		init_failed = 1;
+
+	/* Only an optimisation for readahead, so failing to get it is fine */
+	dev->runBufferInUse = 0;
+	dev->runBuffer = NULL;
+	if (!init_failed && !dev->inbandTags)
+		dev->runBuffer =
+		    YMALLOC_DMA(YAFFS_MAX_RUN_CHUNKS * dev->nDataBytesPerChunk);
 	
 	dev->srCache = NULL;
+	dev->srCacheHash = NULL;
 	dev->gcCleanupList = NULL;
-	
-	
-	if (!init_failed &&
-	    dev->nShortOpCaches > 0) {
-		int i;
-		void *buf;
-		int srCacheBytes = dev->nShortOpCaches * sizeof(yaffs_ChunkCache);
-
-		if (dev->nShortOpCaches > YAFFS_MAX_SHORT_OP_CACHES) {
-			dev->nShortOpCaches = YAFFS_MAX_SHORT_OP_CACHES;
-		}
 
-		dev->srCache =  YMALLOC(srCacheBytes);
-		
-		buf = (__u8 *) dev->srCache;
-		    
-		if(dev->srCache)
-			memset(dev->srCache,0,srCacheBytes);
-		   
-		for (i = 0; i < dev->nShortOpCaches && buf; i++) {
-			dev->srCache[i].object = NULL;
-			dev->srCache[i].lastUse = 0;
-			dev->srCache[i].dirty = 0;
-			dev->srCache[i].data = buf = YMALLOC_DMA(dev->totalBytesPerChunk);
-		}
-		if(!buf)
-			init_failed = 1;
-			
-		dev->srLastUse = 0;
-	}
+	if (!init_failed && !yaffs_InitialiseChunkCache(dev))
+		init_failed = 1;
 
 	dev->cacheHits = 0;
 	
@@ -7461,7 +8018,8 @@ int yaffs_GutsInitialise(yaffs_Device * dev)
 		init_failed = 1;
 		
 	yaffs_InitialiseTnodes(dev);
-	yaffs_InitialiseObjects(dev);
+	if(!init_failed && !yaffs_InitialiseObjects(dev))
+		init_failed = 1;
 
 	if(!init_failed && !yaffs_CreateInitialDirectories(dev))
 		init_failed = 1;
@@ -7497,19 +8055,23 @@ int yaffs_GutsInitialise(yaffs_Device * dev)
 					init_failed = 1;
 					
 				yaffs_InitialiseTnodes(dev);
-				yaffs_InitialiseObjects(dev);
+				if(!init_failed && !yaffs_InitialiseObjects(dev))
+					init_failed = 1;
 
 				if(!init_failed && !yaffs_CreateInitialDirectories(dev))
 					init_failed = 1;
 
-				if(!init_failed && !yaffs_ScanBackwards(dev))
+				if(!init_failed && dev->deferScan)
+					dev->scanPending = 1;
+				else if(!init_failed && !yaffs_ScanBackwards(dev))
 					init_failed = 1;
 			}
 		}else
 			if(!yaffs_Scan(dev))
 				init_failed = 1;
 
-		yaffs_StripDeletedObjects(dev);
+		if(!dev->scanPending)
+			yaffs_StripDeletedObjects(dev);
 	}
 		
 	if(init_failed){
@@ -7523,6 +8085,7 @@ int yaffs_GutsInitialise(yaffs_Device * dev)
 
 	/* Zero out stats */
 	dev->nPageReads = 0;
+	dev->nChunkRunReads = 0;
 	dev->nPageWrites = 0;
 	dev->nBlockErasures = 0;
 	dev->nGCCopies = 0;
@@ -7540,6 +8103,34 @@ int yaffs_GutsInitialise(yaffs_Device * dev)
 
 }
 
+/* Complete a mount that yaffs_GutsInitialise() left with scanPending set.
+ * Until this returns the caller must keep everything else off the device.
+ * If the scan fails the object tree is incomplete and the device must not
+ * be written to.
+ */
+int yaffs_GutsFinishScan(yaffs_Device * dev)
+{
+	int result;
+
+	if (!dev->scanPending)
+		return YAFFS_OK;
+
+	result = yaffs_ScanBackwards(dev);
+	if (result == YAFFS_OK)
+		yaffs_StripDeletedObjects(dev);
+
+	dev->scanPending = 0;
+
+	yaffs_VerifyFreeChunks(dev);
+	yaffs_VerifyBlocks(dev);
+
+	T(YAFFS_TRACE_TRACING,
+	  (TSTR("yaffs: yaffs_GutsFinishScan() %s" TENDSTR),
+	   result == YAFFS_OK ? "done" : "failed"));
+
+	return result;
+}
+
 void yaffs_Deinitialise(yaffs_Device * dev)
 {
 	if (dev->isMounted) {
@@ -7547,19 +8138,9 @@ void yaffs_Deinitialise(yaffs_Device * dev)
 
 		yaffs_DeinitialiseBlocks(dev);
 		yaffs_DeinitialiseTnodes(dev);
+		yaffs_FreeNameIndexes(dev);
 		yaffs_DeinitialiseObjects(dev);
-		if (dev->nShortOpCaches > 0 &&
-		    dev->srCache) {
-
-			for (i = 0; i < dev->nShortOpCaches; i++) {
-				if(dev->srCache[i].data)
-					YFREE(dev->srCache[i].data);
-				dev->srCache[i].data = NULL;
-			}
-
-			YFREE(dev->srCache);
-			dev->srCache = NULL;
-		}
+		yaffs_DeinitialiseChunkCache(dev);
 
 		YFREE(dev->gcCleanupList);
 
@@ -7567,6 +8148,10 @@ void yaffs_Deinitialise(yaffs_Device * dev)
 			YFREE(dev->tempBuffer[i].buffer);
 		}
 
+		if (dev->runBuffer)
+			YFREE(dev->runBuffer);
+		dev->runBuffer = NULL;
+
 
 		dev->isMounted = 0;
 		
@@ -7610,7 +8195,6 @@ int yaffs_GetNumberOfFreeChunks(yaffs_Device * dev)
 	/* This is what we report to the outside world */
 
 	int nFree;
-	int nDirtyCacheChunks;
 	int blocksForCheckpoint;
 
 #if 1
@@ -7623,15 +8207,7 @@ int yaffs_GetNumberOfFreeChunks(yaffs_Device * dev)
 	
 	/* Now count the number of dirty chunks in the cache and subtract those */
 
-	{
-		int i;
-		for (nDirtyCacheChunks = 0, i = 0; i < dev->nShortOpCaches; i++) {
-			if (dev->srCache[i].dirty)
-				nDirtyCacheChunks++;
-		}
-	}
-
-	nFree -= nDirtyCacheChunks;
+	nFree -= dev->nDirtyCacheChunks;
 
 	nFree -= ((dev->nReservedBlocks + 1) * dev->nChunksPerBlock);
 	
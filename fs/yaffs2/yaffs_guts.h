@@ -58,7 +58,14 @@
 #define YAFFS_ALLOCATION_NTNODES	100
 #define YAFFS_ALLOCATION_NLINKS		100
 
+/* The object number hash is sized at mount time from the device size and
+ * doubled whenever there are more than YAFFS_OBJECT_BUCKET_LOAD objects
+ * per bucket. Sizes are powers of 2.
+ */
 #define YAFFS_NOBJECT_BUCKETS		256
+#define YAFFS_MAX_NOBJECT_BUCKETS	16384
+#define YAFFS_OBJECT_BUCKET_LOAD	4
+#define YAFFS_CHUNKS_PER_OBJECT_GUESS	32
 
 
 #define YAFFS_OBJECT_SPACE		0x40000
@@ -88,10 +95,19 @@
 
 /* */
 
-#define YAFFS_MAX_SHORT_OP_CACHES	20
+#define YAFFS_MAX_SHORT_OP_CACHES	1024
 
 #define YAFFS_N_TEMP_BUFFERS		6
 
+/* Longest run of chunks read from NAND in one go by yaffs_ReadDataRunFromFile */
+#define YAFFS_MAX_RUN_CHUNKS		16
+
+/* Directories with at least YAFFS_DIR_INDEX_MIN children get a name hash
+ * of YAFFS_NDIR_BUCKETS buckets on the first lookup.
+ */
+#define YAFFS_NDIR_BUCKETS		128
+#define YAFFS_DIR_INDEX_MIN		32
+
 /* We limit the number attempts at sucessfully saving a chunk of data.
  * Small-page devices have 32 pages per block; large-page devices have 64.
  * Default to something in the order of 5 to 10 blocks worth of chunks.
@@ -113,9 +129,11 @@
 
 /* ChunkCache is used for short read/write operations.*/
 typedef struct {
+	struct ylist_head hashLink;	/* srCacheHash bucket, while in use */
+	struct ylist_head lruLink;	/* srCacheLRU, most recent first */
+	struct ylist_head objLink;	/* object's cacheChunks, by chunk id */
 	struct yaffs_ObjectStruct *object;
 	int chunkId;
-	int lastUse;
 	int dirty;
 	int nBytes;		/* Only valid if the cache is dirty */
 	int locked;		/* Can't push out or flush while locked. */
@@ -388,6 +406,7 @@ typedef struct {
 
 typedef struct {
         struct ylist_head children;     /* list of child links */
+        struct ylist_head *nameIndex;   /* children hashed by name sum, or NULL */
 } yaffs_DirectoryStructure;
 
 typedef struct {
@@ -439,6 +458,9 @@ struct yaffs_ObjectStruct {
         /* also used for linking up the free list */
         struct yaffs_ObjectStruct *parent; 
         struct ylist_head siblings;
+        struct ylist_head nameLink;     /* in the parent's nameIndex, if any */
+
+        struct ylist_head cacheChunks;  /* short op cache entries, by chunk id */
 
 	/* Where's my object header in NAND? */
 	int hdrChunk;
@@ -556,7 +578,8 @@ struct yaffs_DeviceStruct {
 
 
 	int nShortOpCaches;	/* If <= 0, then short op caching is disabled, else
-				 * the number of short op caches (don't use too many)
+				 * the number of short op caches, up to
+				 * YAFFS_MAX_SHORT_OP_CACHES
 				 */
 
 	int useHeaderFileSize;	/* Flag to determine if we should use file sizes from the header */
@@ -591,6 +614,13 @@ struct yaffs_DeviceStruct {
 	int (*markNANDBlockBad) (struct yaffs_DeviceStruct * dev, int blockNo);
 	int (*queryNANDBlock) (struct yaffs_DeviceStruct * dev, int blockNo,
 			       yaffs_BlockState * state, __u32 *sequenceNumber);
+	/* Optional: data of consecutive chunks in one call, no tags */
+	int (*readChunkRunFromNAND) (struct yaffs_DeviceStruct * dev,
+				     int chunkInNAND, int nChunks, __u8 * data);
+	/* Optional: tags of consecutive chunks in one call, no data */
+	int (*readTagsRunFromNAND) (struct yaffs_DeviceStruct * dev,
+				    int chunkInNAND, int nChunks,
+				    yaffs_ExtendedTags * tags);
 #endif
 
 	int isYaffs2;
@@ -615,6 +645,16 @@ struct yaffs_DeviceStruct {
 	__u8 skipCheckpointRead;
 	__u8 skipCheckpointWrite;
 
+	/* Set if the OS glue calls yaffs_BackgroundGarbageCollect(). Writers
+	 * then only do aggressive GC inline. Can be changed at any time.
+	 */
+	__u8 backgroundGC;
+
+	/* If set and there is no checkpoint, yaffs_GutsInitialise() leaves
+	 * the backward scan to yaffs_GutsFinishScan(). Set before initialisation.
+	 */
+	__u8 deferScan;
+
 	/* Runtime parameters. Set up by YAFFS. */
 
 	__u16 chunkGroupBits;	/* 0 for devices <= 32MB. else log2(nchunks) - 16 */
@@ -636,17 +676,42 @@ struct yaffs_DeviceStruct {
 #ifdef __KERNEL__
 
 	struct semaphore sem;	/* Semaphore for waiting on erasure.*/
-	struct semaphore grossLock;	/* Gross locking semaphore */
+	/* Object metadata. Taken shared by the read paths (readpage, lookup,
+	 * readdir, ...), exclusive by anything that changes the fs, which
+	 * includes garbage collection and block allocation.
+	 */
+	struct rw_semaphore grossLock;
+	/* State that readers still share: temp buffers, chunk cache hits and
+	 * block error flags. The statistics counters are not covered and may
+	 * be slightly off.
+	 */
+	spinlock_t scratchLock;
+	struct mutex loadLock;	/* Filling in lazy loaded objects */
 	__u8 *spareBuffer;	/* For mtdif2 use. Don't know the size of the buffer 
 				 * at compile time so we have to allocate it.
 				 */
 	void (*putSuperFunc) (struct super_block * sb);
+
+	struct task_struct *bgGCThread;
+	unsigned long lastAccess;	/* jiffies of the last VFS operation */
+	int bgGCWatermark;		/* erased blocks to keep ready */
+	unsigned long bgCheckpointIdle;	/* quiet jiffies before checkpointing, 0 = off */
+	unsigned long bgCheckpointTried; /* lastAccess when last attempted */
+	int nBackgroundCheckpoints;
+	int bgMountWatermark;		/* percent from the mount options, -1 = no-bg-gc */
+	int bgMountCheckpointIdle;	/* seconds from the mount options */
+	struct task_struct *scanThread;	/* finishing a bg-scan mount */
+	struct completion scanDone;
 #endif
 
 	int isMounted;
 	
 	int isCheckpointed;
 
+	int scanPending;	/* Waiting for yaffs_GutsFinishScan() */
+	int nBlocksToScan;	/* Scan progress, for reporting */
+	int nBlocksScanned;
+
 
 	/* Stuff to support block offsetting to support start block zero */
 	int internalStartBlock;
@@ -704,7 +769,11 @@ struct yaffs_DeviceStruct {
 
 	yaffs_ObjectList *allocatedObjectList;
 
-	yaffs_ObjectBucket objectBucket[YAFFS_NOBJECT_BUCKETS];
+	yaffs_ObjectBucket *objectBucket;
+	int nObjectBuckets;
+	int nHashedObjects;
+	int nObjectHashResizes;
+	unsigned objectBucketAlt:1;	/* was allocated using alternative strategy */
 
 	int nFreeChunks;
 
@@ -716,11 +785,13 @@ struct yaffs_DeviceStruct {
 	/* Statistcs */
 	int nPageWrites;
 	int nPageReads;
+	int nChunkRunReads;
 	int nBlockErasures;
 	int nErasureFailures;
 	int nGCCopies;
 	int garbageCollections;
 	int passiveGarbageCollections;
+	int backgroundGarbageCollections;
 	int nRetriedWrites;
 	int nRetiredBlocks;
 	int eccFixed;
@@ -745,7 +816,11 @@ struct yaffs_DeviceStruct {
 	int doingBufferedBlockRewrite;
 
 	yaffs_ChunkCache *srCache;
-	int srLastUse;
+	struct ylist_head *srCacheHash;
+	int nCacheBuckets;
+	struct ylist_head srCacheLRU;
+	int nDirtyCacheChunks;
+	unsigned srCacheAlt:1;	/* srCache was allocated using alternative strategy */
 
 	int cacheHits;
 
@@ -765,6 +840,10 @@ struct yaffs_DeviceStruct {
 	int unmanagedTempAllocations;
 	int unmanagedTempDeallocations;
 
+	/* Bounce buffer for reading runs of chunks, may be NULL */
+	__u8 *runBuffer;
+	int runBufferInUse;
+
 	/* yaffs2 runtime stuff */
 	unsigned sequenceNumber;	/* Sequence number of currently allocating block */
 	unsigned oldestDirtySequence;
@@ -816,6 +895,7 @@ typedef struct {
 /*----------------------- YAFFS Functions -----------------------*/
 
 int yaffs_GutsInitialise(yaffs_Device * dev);
+int yaffs_GutsFinishScan(yaffs_Device * dev);
 void yaffs_Deinitialise(yaffs_Device * dev);
 
 int yaffs_GetNumberOfFreeChunks(yaffs_Device * dev);
@@ -838,6 +918,8 @@ int yaffs_GetAttributes(yaffs_Object * obj, struct iattr *attr);
 /* File operations */
 int yaffs_ReadDataFromFile(yaffs_Object * obj, __u8 * buffer, loff_t offset,
                            int nBytes);
+int yaffs_ReadDataRunFromFile(yaffs_Object * obj, __u8 ** buffers, int nBuffers,
+			      int bufferSize, loff_t offset);
 int yaffs_WriteDataToFile(yaffs_Object * obj, const __u8 * buffer, loff_t offset,
                           int nBytes, int writeThrough);
 int yaffs_ResizeFile(yaffs_Object * obj, loff_t newSize);
@@ -901,6 +983,8 @@ void yaffs_InitialiseTags(yaffs_ExtendedTags * tags);
 void yaffs_DeleteChunk(yaffs_Device * dev, int chunkId, int markNAND, int lyn);
 int yaffs_CheckFF(__u8 * buffer, int nBytes);
 void yaffs_HandleChunkError(yaffs_Device *dev, yaffs_BlockInfo *bi);
+int yaffs_RefreshBlock(yaffs_Device *dev, int blockInNAND);
+int yaffs_BackgroundGarbageCollect(yaffs_Device *dev, int erasedWatermark);
 
 __u8 *yaffs_GetTempBuffer(yaffs_Device * dev, int lineNo);
 void yaffs_ReleaseTempBuffer(yaffs_Device * dev, __u8 * buffer, int lineNo);
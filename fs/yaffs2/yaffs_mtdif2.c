@@ -137,7 +137,8 @@ int nandmtd2_ReadChunkWithTagsFromNAND(yaffs_Device * dev, int chunkInNAND,
 		ops.len = data ? dev->nDataBytesPerChunk : sizeof(pt);
 		ops.ooboffs = 0;
 		ops.datbuf = data;
-		ops.oobbuf = dev->spareBuffer;
+		/* not dev->spareBuffer, readers run concurrently */
+		ops.oobbuf = (void *)&pt;
 		retval = mtd->read_oob(mtd, addr, &ops);
 	}
 #else
@@ -168,7 +169,9 @@ int nandmtd2_ReadChunkWithTagsFromNAND(yaffs_Device * dev, int chunkInNAND,
 	}
 	else {
 		if (tags){
+#if (LINUX_VERSION_CODE <= KERNEL_VERSION(2,6,17))
 			memcpy(&pt, dev->spareBuffer, sizeof(pt));
+#endif
 			yaffs_UnpackTags2(tags, &pt);
 		}
 	}
@@ -178,12 +181,104 @@ int nandmtd2_ReadChunkWithTagsFromNAND(yaffs_Device * dev, int chunkInNAND,
 	
 	if(tags && retval == -EBADMSG && tags->eccResult == YAFFS_ECC_RESULT_NO_ERROR)
 		tags->eccResult = YAFFS_ECC_RESULT_UNFIXED;		
+	/* corrected bitflips: the block should be refreshed by gc */
+	if(tags && retval == -EUCLEAN && tags->eccResult == YAFFS_ECC_RESULT_NO_ERROR)
+		tags->eccResult = YAFFS_ECC_RESULT_FIXED;
 	if (retval == 0)
 		return YAFFS_OK;
 	else
 		return YAFFS_FAIL;
 }
 
+/* Read the data of nChunks consecutive chunks with one MTD call so that the
+ * NAND driver can stream the pages (cache read). Tags are not returned; the
+ * caller re-reads chunk by chunk if this fails so that ECC failures, and
+ * corrected bitflips, get attributed to the right block.
+ */
+int nandmtd2_ReadChunkRunFromNAND(yaffs_Device * dev, int chunkInNAND,
+				  int nChunks, __u8 * data)
+{
+	struct mtd_info *mtd = (struct mtd_info *)(dev->genericDevice);
+	size_t dummy;
+	int retval;
+
+	loff_t addr = ((loff_t) chunkInNAND) * dev->totalBytesPerChunk;
+
+	T(YAFFS_TRACE_MTD,
+	  (TSTR("nandmtd2_ReadChunkRunFromNAND chunk %d n %d data %p"
+		TENDSTR), chunkInNAND, nChunks, data));
+
+	if (dev->inbandTags)
+		return YAFFS_FAIL;
+
+	retval = mtd->read(mtd, addr, nChunks * dev->nDataBytesPerChunk,
+			   &dummy, data);
+
+	if (retval == 0 && dummy == nChunks * dev->nDataBytesPerChunk)
+		return YAFFS_OK;
+	else
+		return YAFFS_FAIL;
+}
+
+/* Read the tags of nChunks consecutive chunks with one OOB-only MTD call.
+ * In MTD_OOB_AUTO mode the driver packs the free bytes of each page one
+ * after the other, oobavail bytes per page.
+ */
+int nandmtd2_ReadTagsRunFromNAND(yaffs_Device * dev, int chunkInNAND,
+				 int nChunks, yaffs_ExtendedTags * tags)
+{
+#if (LINUX_VERSION_CODE > KERNEL_VERSION(2,6,17))
+	struct mtd_info *mtd = (struct mtd_info *)(dev->genericDevice);
+	struct mtd_oob_ops ops;
+	yaffs_PackedTags2 pt;
+	__u8 *oob;
+	int oobavail;
+	int retval;
+	int i;
+
+	loff_t addr = ((loff_t) chunkInNAND) * dev->totalBytesPerChunk;
+
+	T(YAFFS_TRACE_MTD,
+	  (TSTR("nandmtd2_ReadTagsRunFromNAND chunk %d n %d" TENDSTR),
+	   chunkInNAND, nChunks));
+
+	if (dev->inbandTags || !mtd->ecclayout)
+		return YAFFS_FAIL;
+
+	oobavail = mtd->ecclayout->oobavail;
+	if (oobavail < sizeof(pt))
+		return YAFFS_FAIL;
+
+	oob = YMALLOC(nChunks * oobavail);
+	if (!oob)
+		return YAFFS_FAIL;
+
+	ops.mode = MTD_OOB_AUTO;
+	ops.ooblen = nChunks * oobavail;
+	ops.len = ops.ooblen;
+	ops.ooboffs = 0;
+	ops.datbuf = NULL;
+	ops.oobbuf = oob;
+	retval = mtd->read_oob(mtd, addr, &ops);
+
+	if (retval == 0 && ops.oobretlen == ops.ooblen) {
+		for (i = 0; i < nChunks; i++) {
+			memcpy(&pt, oob + i * oobavail, sizeof(pt));
+			yaffs_UnpackTags2(&tags[i], &pt);
+		}
+	}
+
+	YFREE(oob);
+
+	if (retval == 0 && ops.oobretlen == ops.ooblen)
+		return YAFFS_OK;
+	else
+		return YAFFS_FAIL;
+#else
+	return YAFFS_FAIL;
+#endif
+}
+
 int nandmtd2_MarkNANDBlockBad(struct yaffs_DeviceStruct *dev, int blockNo)
 {
 	struct mtd_info *mtd = (struct mtd_info *)(dev->genericDevice);
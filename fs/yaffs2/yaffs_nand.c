@@ -51,6 +51,59 @@ int yaffs_ReadChunkWithTagsFromNAND(yaffs_Device * dev, int chunkInNAND,
 	return result;
 }
 
+/* Read the data of nChunks chunks that follow each other in NAND into one
+ * buffer. The driver's run read lets the chip stream the pages; if there is
+ * none, or it fails, read a chunk at a time so that ECC errors are handled
+ * per block as usual.
+ */
+int yaffs_ReadChunkRunFromNAND(yaffs_Device * dev, int chunkInNAND,
+			       int nChunks, __u8 * buffer)
+{
+	int i;
+	int result = YAFFS_OK;
+
+	if (nChunks > 1 && dev->readChunkRunFromNAND && !dev->inbandTags &&
+	    dev->readChunkRunFromNAND(dev, chunkInNAND - dev->chunkOffset,
+				      nChunks, buffer) == YAFFS_OK) {
+		dev->nChunkRunReads++;
+		return YAFFS_OK;
+	}
+
+	for (i = 0; i < nChunks; i++) {
+		if (yaffs_ReadChunkWithTagsFromNAND(dev, chunkInNAND + i,
+				buffer + i * dev->nDataBytesPerChunk,
+				NULL) != YAFFS_OK)
+			result = YAFFS_FAIL;
+	}
+
+	return result;
+}
+
+/* Read the tags of nChunks chunks that follow each other in NAND, eg. a
+ * whole block while scanning, with one driver call. Returns YAFFS_FAIL if
+ * the driver can't do that; the caller then reads the tags a chunk at a time.
+ */
+int yaffs_ReadTagsRunFromNAND(yaffs_Device * dev, int chunkInNAND,
+			      int nChunks, yaffs_ExtendedTags * tags)
+{
+	int i;
+
+	if (!dev->readTagsRunFromNAND || dev->inbandTags ||
+	    dev->readTagsRunFromNAND(dev, chunkInNAND - dev->chunkOffset,
+				     nChunks, tags) != YAFFS_OK)
+		return YAFFS_FAIL;
+
+	for (i = 0; i < nChunks; i++) {
+		if (tags[i].eccResult > YAFFS_ECC_RESULT_NO_ERROR) {
+			yaffs_BlockInfo *bi = yaffs_GetBlockInfo(dev,
+				(chunkInNAND + i) / dev->nChunksPerBlock);
+			yaffs_HandleChunkError(dev, bi);
+		}
+	}
+
+	return YAFFS_OK;
+}
+
 int yaffs_WriteChunkWithTagsToNAND(yaffs_Device * dev,
 						   int chunkInNAND,
 						   const __u8 * buffer,
@@ -23,6 +23,12 @@ int yaffs_ReadChunkWithTagsFromNAND(yaffs_Device * dev, int chunkInNAND,
 					   __u8 * buffer,
 					   yaffs_ExtendedTags * tags);
 
+int yaffs_ReadChunkRunFromNAND(yaffs_Device * dev, int chunkInNAND,
+			       int nChunks, __u8 * buffer);
+
+int yaffs_ReadTagsRunFromNAND(yaffs_Device * dev, int chunkInNAND,
+			      int nChunks, yaffs_ExtendedTags * tags);
+
 int yaffs_WriteChunkWithTagsToNAND(yaffs_Device * dev,
 						   int chunkInNAND,
 						   const __u8 * buffer,
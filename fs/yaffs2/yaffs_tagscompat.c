@@ -340,7 +340,9 @@ static void yaffs_HandleReadDataError(yaffs_Device * dev, int chunkInNAND)
 	int blockInNAND = chunkInNAND / dev->nChunksPerBlock;
 
 	/* Mark the block for retirement */
+	yaffs_LockScratch(dev);
 	yaffs_GetBlockInfo(dev, blockInNAND + dev->blockOffset)->needsRetiring = 1;
+	yaffs_UnlockScratch(dev);
 	T(YAFFS_TRACE_ERROR | YAFFS_TRACE_BAD_BLOCKS,
 	  (TSTR("**>>Block %d marked for retirement" TENDSTR), blockInNAND));
 
@@ -101,6 +101,13 @@
 #define compile_time_assertion(assertion) \
 	({ int x = __builtin_choose_expr(assertion, 0, (void)0); (void) x; })
 
+/* Readers run concurrently under a shared grossLock, see yaffs_Device */
+#define yaffs_LockScratch(dev)		spin_lock(&(dev)->scratchLock)
+#define yaffs_UnlockScratch(dev)	spin_unlock(&(dev)->scratchLock)
+#define yaffs_LockLoad(dev)		mutex_lock(&(dev)->loadLock)
+#define yaffs_UnlockLoad(dev)		mutex_unlock(&(dev)->loadLock)
+#define YWMB()				smp_wmb()
+
 #elif defined CONFIG_YAFFS_DIRECT
 
 #define MTD_VERSION_CODE MTD_VERSION(2,6,22)
@@ -158,6 +165,15 @@
 
 #endif
 
+/* Single threaded environments need no locking */
+#ifndef yaffs_LockScratch
+#define yaffs_LockScratch(dev)		do { } while (0)
+#define yaffs_UnlockScratch(dev)	do { } while (0)
+#define yaffs_LockLoad(dev)		do { } while (0)
+#define yaffs_UnlockLoad(dev)		do { } while (0)
+#define YWMB()				do { } while (0)
+#endif
+
 /* see yaffs_fs.c */
 extern unsigned int yaffs_traceMask;
 extern unsigned int yaffs_wr_attempts;
@@ -216,6 +216,11 @@ struct mtd_info {
 	int (*block_isbad) (struct mtd_info *mtd, loff_t ofs);
 	int (*block_markbad) (struct mtd_info *mtd, loff_t ofs);
 
+	/* Set by the user of the device (e.g. a filesystem). Called by the
+	 * driver when the data in a block should be moved elsewhere before
+	 * it becomes unreadable, e.g. because of read disturb. */
+	int (*block_refresh) (struct mtd_info *mtd, loff_t ofs);
+
 	struct notifier_block reboot_notifier;  /* default mode before reboot */
 
 	/* ECC status information */
@@ -61,6 +61,7 @@ struct mtd_partition {
 
 int add_mtd_partitions(struct mtd_info *, const struct mtd_partition *, int);
 int del_mtd_partitions(struct mtd_info *);
+int mtd_block_refresh(struct mtd_info *, loff_t);
 
 /*
  * Functions dealing with the various ways of partitioning the space